@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -24,7 +24,23 @@ SOURCES += \
     sources/motionFilter.cpp \
     sources/main.cpp \
     sources/mainwindow.cpp \
-    sources/write_message.cpp
+    sources/camera_config.cpp \
+    sources/control_server.cpp \
+    sources/event_bus.cpp \
+    sources/async_log.cpp \
+    sources/detection_store.cpp \
+    sources/activity_chart.cpp \
+    sources/segment_recorder.cpp \
+    sources/segment_index.cpp \
+    sources/thread_pool.cpp \
+    sources/clip_encoder.cpp \
+    sources/avi_writer.cpp \
+    sources/captured_frame.cpp \
+    sources/frame_metadata.cpp \
+    sources/box_tracker.cpp \
+    sources/thumbnail_cache.cpp \
+    sources/recordings_model.cpp \
+    sources/camera_clock.cpp
 
 HEADERS += \
     sources/camera.hpp \
@@ -34,7 +50,24 @@ HEADERS += \
     sources/humanFilter.hpp \
     sources/motionFilter.hpp \
     sources/mainwindow.h \
-    sources/write_message.h
+    sources/camera_config.h \
+    sources/control_server.h \
+    sources/event_bus.h \
+    sources/async_log.h \
+    sources/signal_free_thread.h \
+    sources/detection_store.h \
+    sources/activity_chart.h \
+    sources/segment_recorder.h \
+    sources/segment_index.h \
+    sources/thread_pool.h \
+    sources/clip_encoder.h \
+    sources/avi_writer.h \
+    sources/captured_frame.h \
+    sources/frame_metadata.h \
+    sources/box_tracker.h \
+    sources/thumbnail_cache.h \
+    sources/recordings_model.h \
+    sources/camera_clock.h
 
 FORMS += \
     sources/mainwindow.ui
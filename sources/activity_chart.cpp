@@ -0,0 +1,246 @@
+/**
+ * File Name:   activity_chart.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions that compute the activity chart of the GUI,
+ * from the detection store and from the daily log files.
+ */
+
+#include "activity_chart.h"
+#include "detection_store.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for fstat() */
+#include <sys/mman.h>   /* for mmap(), munmap(), madvise() */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for close(), access() */
+#include <syslog.h>     /* for syslog() */
+#include <chrono>       /* for std::chrono::steady_clock */
+#include <cstdio>       /* for sscanf() */
+#include <cstdlib>      /* for strtoull() */
+#include <cstring>      /* for memchr(), memmem(), memset() */
+#include <ctime>        /* for struct tm, mktime() */
+
+using std::string;
+using std::vector;
+using std::uint32_t;
+using std::uint64_t;
+using std::int64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+/**
+ * This helper function finds a string within a line.
+ *
+ * @return const char* - Where the string starts, or nullptr if it is not in the line.
+ */
+static const char* find_in(const char* begin, const char* end, const char* needle)
+{
+    return static_cast<const char*>(memmem(begin, end - begin, needle, strlen(needle)));
+}
+
+
+/**
+ * This helper function reads the time of day of a syslog line, which starts either with
+ * "Mmm dd HH:MM:SS" (the traditional format) or with "yyyy-mm-ddTHH:MM:SS" (the RFC 3339 format).
+ *
+ * @return double - The time of day in hours, or -1 if the line does not start with a time.
+ */
+static double line_hour(const char* begin, const char* end)
+{
+    const char* time = nullptr;
+    if (end - begin > 19 && begin[4] == '-' && begin[10] == 'T') {
+        time = begin + 11;
+    } else {
+        // Skip the month and the day, the day is padded with a space rather than a zero.
+        const char* field = begin;
+        for (int skipped = 0; skipped < 2; ++skipped) {
+            while (field < end && *field != ' ') ++field;
+            while (field < end && *field == ' ') ++field;
+        }
+        time = field;
+    }
+
+    if (end - time < 8 || time[2] != ':' || time[5] != ':') {
+        return -1;
+    }
+    int hours = (time[0] - '0') * 10 + (time[1] - '0');
+    int minutes = (time[3] - '0') * 10 + (time[4] - '0');
+    int seconds = (time[6] - '0') * 10 + (time[7] - '0');
+    if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 60) {
+        return -1;
+    }
+    return hours + minutes / 60.0 + seconds / 3600.0;
+}
+
+
+/**
+ * This helper function decides how many detections a line of a daily log file stands for.
+ *
+ * @return uint64_t - 0 if the line is not a detection. A line the asynchronous logger coalesced
+ *                    ("... (repeated N times)") stands for all of them.
+ */
+static uint64_t line_detections(const char* begin, const char* end)
+{
+    const char* tag_end = find_in(begin, end, "]: ");
+    if (tag_end == nullptr) {
+        return 0;
+    }
+    // "camera[pid]" is how the daemon was called when document.R was written.
+    if (find_in(begin, tag_end, "SmartCCTV_Daemon[") == nullptr && find_in(begin, tag_end, "camera[") == nullptr) {
+        return 0;
+    }
+    const char* message = tag_end + 3;
+    if (find_in(message, end, "Motion") == nullptr && find_in(message, end, "Found humans") == nullptr) {
+        return 0;
+    }
+
+    const char* repeated = find_in(message, end, " (repeated ");
+    if (repeated != nullptr) {
+        return 1 + strtoull(repeated + 11, nullptr, 10);
+    }
+    return 1;
+}
+
+
+bool parse_activity_log(const string& path, Day_activity& activity)
+{
+    activity.bins.assign(ACTIVITY_BINS, 0);
+    activity.total = 0;
+    activity.mean_hour = 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat file_status;
+    if (fstat(fd, &file_status) == -1) {
+        close(fd);
+        return false;
+    }
+    size_t size = file_status.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        syslog(log_facility | LOG_ERR, "Error: Could not map %s : %m", path.c_str());
+        return false;
+    }
+    // The file is read once from start to end, the kernel can read ahead and drop the pages behind.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(mapped);
+    const char* data_end = data + size;
+    double hour_sum = 0;
+    for (const char* line = data; line < data_end; ) {
+        const char* line_end = static_cast<const char*>(memchr(line, '\n', data_end - line));
+        if (line_end == nullptr) {
+            line_end = data_end;
+        }
+
+        uint64_t detections = line_detections(line, line_end);
+        if (detections > 0) {
+            double hour = line_hour(line, line_end);
+            if (hour >= 0) {
+                int bin = (int) (hour * ACTIVITY_BINS_PER_HOUR);
+                activity.bins[bin < ACTIVITY_BINS ? bin : ACTIVITY_BINS - 1] += detections;
+                activity.total += detections;
+                hour_sum += hour * detections;
+            }
+        }
+
+        line = line_end + 1;
+    }
+
+    munmap(mapped, size);
+    if (activity.total > 0) {
+        activity.mean_hour = hour_sum / activity.total;
+    }
+    return true;
+}
+
+
+/**
+ * This helper function reads the detections of a day from the rollups of the detection store.
+ *
+ * @return bool - false if the store does not have the day.
+ */
+static bool read_store_activity(const string& store_directory, const string& day, Day_activity& activity)
+{
+    string rollup_path = store_directory + day + ".rollup";
+    if (access(rollup_path.c_str(), R_OK) == -1) {
+        return false;
+    }
+
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    if (sscanf(day.c_str(), "%d.%d.%d", &local.tm_mday, &local.tm_mon, &local.tm_year) != 3) {
+        return false;
+    }
+    local.tm_mon -= 1;
+    local.tm_year -= 1900;
+    local.tm_isdst = -1;
+    int64_t start_us = (int64_t) mktime(&local) * 1000000;
+    local.tm_mday += 1;
+    local.tm_isdst = -1;
+    int64_t end_us = (int64_t) mktime(&local) * 1000000;
+
+    vector<Minute_rollup> minutes;
+    if (!query_rollup(store_directory, start_us, end_us, minutes)) {
+        return false;
+    }
+
+    activity.bins.assign(ACTIVITY_BINS, 0);
+    activity.total = 0;
+    double hour_sum = 0;
+    for (size_t minute = 0; minute < minutes.size(); ++minute) {
+        uint32_t detections = minutes[minute].detections;
+        if (detections == 0) {
+            continue;
+        }
+        size_t bin = minute * ACTIVITY_BINS_PER_HOUR / 60;
+        activity.bins[bin < ACTIVITY_BINS ? bin : ACTIVITY_BINS - 1] += detections;
+        activity.total += detections;
+        hour_sum += (minute + 0.5) / 60.0 * detections;
+    }
+    activity.mean_hour = activity.total > 0 ? hour_sum / activity.total : 0;
+    return true;
+}
+
+
+Activity_chart compute_activity_chart(const string& store_directory, const string& log_directory, const vector<string>& days)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Activity_chart chart;
+    chart.mean_hour = 0;
+    int days_with_detections = 0;
+    for (const string& day : days) {
+        Day_activity activity;
+        activity.day = day;
+        activity.from_log = false;
+        activity.has_data = read_store_activity(store_directory, day, activity);
+        if (!activity.has_data) {
+            activity.from_log = true;
+            activity.has_data = parse_activity_log(log_directory + day + ".out", activity);
+        }
+        if (activity.total > 0) {
+            chart.mean_hour += activity.mean_hour;
+            ++days_with_detections;
+        }
+        chart.days.push_back(std::move(activity));
+    }
+    if (days_with_detections > 0) {
+        chart.mean_hour /= days_with_detections;
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start;
+    chart.compute_us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return chart;
+}
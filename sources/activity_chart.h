@@ -0,0 +1,82 @@
+/**
+ * File Name:   activity_chart.h
+ *
+ * Description:
+ * This file contains the declarations of the functions that compute the activity chart of the GUI:
+ * how the detections of every day of a range are spread over the hours of the day, and the peak hour
+ * of each day, which is what document.R used to plot.
+ *
+ * The detections of a day are taken from the per-minute rollups of the detection store (see detection_store.h)
+ * when it has that day. The days from before the store existed are read from their daily log file,
+ * dd.MM.yyyy.out, with a parser that streams over the mapped file instead of reading it line by line.
+ *
+ * Nothing here uses Qt, so it can run in a background thread of the GUI.
+ */
+
+#ifndef ACTIVITY_CHART_H
+#define ACTIVITY_CHART_H
+
+#include <cstdint>  /* for std::uint32_t, std::uint64_t, std::int64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// How many bins every hour of the chart is split into.
+#define ACTIVITY_BINS_PER_HOUR 4
+// The number of bins of a day.
+#define ACTIVITY_BINS (24 * ACTIVITY_BINS_PER_HOUR)
+
+
+/**
+ * The detections of a single day.
+ */
+struct Day_activity {
+    std::string day;                   // The day, as "dd.MM.yyyy".
+    bool has_data;                     // Was there a rollup or a log file for the day?
+    bool from_log;                     // Was it read from the log file, rather than the detection store?
+    std::vector<std::uint32_t> bins;   // The detections per ACTIVITY_BINS of the day.
+    std::uint64_t total;               // The detections of the day.
+    double mean_hour;                  // The average time of day of the detections, in hours, 0 if there were none.
+};
+
+
+/**
+ * The activity chart of a range of days.
+ */
+struct Activity_chart {
+    std::vector<Day_activity> days;    // The days of the range, oldest first.
+    double mean_hour;                  // The average of the mean_hour of the days with detections.
+    std::int64_t compute_us;           // How long computing the chart took.
+};
+
+
+/**
+ * This function counts the detections in a daily log file, a copy of the syslog of one day.
+ * A detection is a line logged by the camera daemon that contains "Motion" or "Found humans".
+ * The file is mapped and scanned once, without copying its lines.
+ *
+ * @param const std::string& path - The log file.
+ *
+ * @param Day_activity& activity - Its bins, total and mean_hour are set.
+ *
+ * @return bool - false if the file could not be read.
+ */
+bool parse_activity_log(const std::string& path, Day_activity& activity);
+
+
+/**
+ * This function computes the activity chart of a range of days.
+ *
+ * @param const std::string& store_directory - The directory of the detection store, ending in '/'.
+ *
+ * @param const std::string& log_directory - The directory of the daily log files, ending in '/',
+ *                                           or empty for the working directory.
+ *
+ * @param const std::vector<std::string>& days - The days, as "dd.MM.yyyy", oldest first.
+ *
+ * @return Activity_chart - The chart. A day with neither a rollup nor a log file has no data.
+ */
+Activity_chart compute_activity_chart(const std::string& store_directory, const std::string& log_directory,
+                                      const std::vector<std::string>& days);
+
+
+#endif  /* ACTIVITY_CHART_H */
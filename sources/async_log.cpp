@@ -0,0 +1,353 @@
+/**
+ * File Name:   async_log.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions of the asynchronous logger of the camera daemon,
+ * which keeps the blocking syslog() writes off the capture and detection path.
+ */
+
+#include "async_log.h"
+#include "signal_free_thread.h"
+
+#include <syslog.h>              /* for syslog(), vsyslog() */
+#include <atomic>                /* for std::atomic */
+#include <chrono>                /* for std::chrono */
+#include <condition_variable>    /* for std::condition_variable */
+#include <cstdarg>               /* for va_list, va_start(), va_end() */
+#include <cstdio>                /* for FILE, fopen(), fprintf(), fflush(), snprintf(), vsnprintf() */
+#include <cstring>               /* for strcmp() */
+#include <ctime>                 /* for time_t, localtime_r(), strftime() */
+#include <memory>                /* for std::unique_ptr */
+#include <mutex>                 /* for std::mutex */
+#include <thread>                /* for std::thread */
+#include <unordered_map>         /* for std::unordered_map */
+#include <vector>                /* for std::vector */
+
+using std::int64_t;
+using std::uint32_t;
+using std::uint64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+/**
+ * A line waiting in a ring buffer.
+ */
+struct Log_line {
+    int priority;                       // The facility and the level, as for syslog().
+    const char* format;                 // The format the line was made from, the key of the rate limit.
+    int64_t time_us;                    // When the line was logged, in microseconds since the epoch.
+    char text[ASYNC_LOG_LINE_LENGTH];   // The formatted line.
+};
+
+
+/**
+ * The ring buffer of a single thread. Only that thread advances head, only the flushing thread advances tail.
+ */
+struct Log_ring {
+    Log_line lines[ASYNC_LOG_RING_SIZE];
+    std::atomic<uint32_t> head;      // The next line the owning thread writes.
+    std::atomic<uint32_t> tail;      // The next line the flushing thread reads.
+    std::atomic<uint64_t> dropped;   // The lines dropped because the ring was full.
+
+    // Only used by the flushing thread: the last line written out, while it keeps being repeated.
+    Log_line last;
+    bool has_last;
+    uint64_t repeats;
+    int64_t first_repeat_us;
+
+    Log_ring() : head(0), tail(0), dropped(0), has_last(false), repeats(0), first_repeat_us(0) {}
+};
+
+
+/**
+ * How many lines of one format were written in the current one second window.
+ */
+struct Rate {
+    int64_t window_start_us;
+    uint32_t written;
+    uint64_t suppressed;
+};
+
+
+// Is the flushing thread running? Until it is, async_log() calls syslog() directly.
+static std::atomic<bool> running(false);
+// Where the lines are written to.
+static int log_sinks = ASYNC_LOG_TO_SYSLOG;
+static FILE* log_file = nullptr;
+
+// The ring buffers of every thread that has logged a line. A ring outlives its thread,
+// the few threads of the daemon all live until it exits.
+static std::mutex rings_mutex;
+static std::vector<std::unique_ptr<Log_ring>> rings;
+static thread_local Log_ring* thread_ring = nullptr;
+
+// Taken while writing out lines, so flush_async_log() and the flushing thread do not interleave.
+static std::mutex flush_mutex;
+static std::unordered_map<const char*, Rate> rates;
+static uint64_t reported_dropped = 0;
+
+// Wakes up the flushing thread when the logger is stopped.
+static std::mutex wake_mutex;
+static std::condition_variable wake;
+
+static std::atomic<uint64_t> suppressed_total(0);
+
+
+/**
+ * This helper function returns the wall clock time in microseconds.
+ */
+static int64_t now_us()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+/**
+ * This helper function writes a line to the sinks.
+ * It is called with flush_mutex locked.
+ */
+static void write_line(int priority, int64_t time_us, const char* text)
+{
+    if (log_sinks & ASYNC_LOG_TO_SYSLOG) {
+        syslog(priority, "%s", text);
+    }
+    if ((log_sinks & ASYNC_LOG_TO_FILE) && log_file != nullptr) {
+        time_t seconds = time_us / 1000000;
+        struct tm local;
+        char stamp[32];
+        localtime_r(&seconds, &local);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        fprintf(log_file, "%s.%03d %s\n", stamp, (int) (time_us / 1000 % 1000), text);
+    }
+}
+
+
+/**
+ * This helper function writes out the repeat count of the last line of a ring, if it was repeated.
+ * It is called with flush_mutex locked.
+ */
+static void write_repeats(Log_ring& ring)
+{
+    if (ring.repeats > 0) {
+        char text[ASYNC_LOG_LINE_LENGTH + 48];
+        snprintf(text, sizeof(text), "%s (repeated %llu times)", ring.last.text, (unsigned long long) ring.repeats);
+        write_line(ring.last.priority, now_us(), text);
+        ring.repeats = 0;
+    }
+}
+
+
+/**
+ * This helper function applies the rate limit to a line and writes it out if it is allowed through.
+ * It is called with flush_mutex locked.
+ */
+static void write_limited(const Log_line& line)
+{
+    Rate& rate = rates[line.format];
+    if (line.time_us - rate.window_start_us >= 1000000) {
+        if (rate.suppressed > 0) {
+            char text[ASYNC_LOG_LINE_LENGTH + 64];
+            snprintf(text, sizeof(text), "%llu more lines like \"%s\" were suppressed",
+                     (unsigned long long) rate.suppressed, line.format);
+            write_line(line.priority, line.time_us, text);
+        }
+        rate.window_start_us = line.time_us;
+        rate.written = 0;
+        rate.suppressed = 0;
+    }
+
+    if (rate.written < ASYNC_LOG_RATE_LIMIT) {
+        ++rate.written;
+        write_line(line.priority, line.time_us, line.text);
+    } else {
+        ++rate.suppressed;
+        ++suppressed_total;
+    }
+}
+
+
+/**
+ * This helper function writes out every line buffered in every ring.
+ * It is called with flush_mutex locked.
+ */
+static void drain()
+{
+    std::vector<Log_ring*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto& ring : rings) {
+            snapshot.push_back(ring.get());
+        }
+    }
+
+    int64_t now = now_us();
+    uint64_t dropped = 0;
+    for (Log_ring* ring : snapshot) {
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const Log_line& line = ring->lines[tail % ASYNC_LOG_RING_SIZE];
+            if (ring->has_last && line.priority == ring->last.priority && strcmp(line.text, ring->last.text) == 0) {
+                if (ring->repeats++ == 0) {
+                    ring->first_repeat_us = line.time_us;
+                }
+                continue;
+            }
+            write_repeats(*ring);
+            ring->last = line;
+            ring->has_last = true;
+            write_limited(line);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        // A line that keeps being repeated still shows up in the log about once per ASYNC_LOG_COALESCE_US.
+        if (ring->repeats > 0 && now - ring->first_repeat_us >= ASYNC_LOG_COALESCE_US) {
+            write_repeats(*ring);
+        }
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+
+    // The suppressed lines of a format that is no longer logged are reported once its window is over.
+    for (auto& each : rates) {
+        Rate& rate = each.second;
+        if (rate.suppressed > 0 && now - rate.window_start_us >= 1000000) {
+            char text[ASYNC_LOG_LINE_LENGTH + 64];
+            snprintf(text, sizeof(text), "%llu more lines like \"%s\" were suppressed",
+                     (unsigned long long) rate.suppressed, each.first);
+            write_line(log_facility | LOG_NOTICE, now, text);
+            rate.suppressed = 0;
+        }
+    }
+
+    if (dropped > reported_dropped) {
+        char text[96];
+        snprintf(text, sizeof(text), "Async log: %llu lines dropped because a log buffer was full",
+                 (unsigned long long) (dropped - reported_dropped));
+        write_line(log_facility | LOG_WARNING, now, text);
+        reported_dropped = dropped;
+    }
+
+    if (log_file != nullptr) {
+        fflush(log_file);
+    }
+}
+
+
+/**
+ * This function is the body of the flushing thread.
+ */
+static void flush_loop()
+{
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    while (running) {
+        wake.wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_FLUSH_INTERVAL_MS));
+        flush_async_log();
+    }
+}
+
+
+bool start_async_log(int sinks, const char* file_path)
+{
+    if (running) {
+        return true;
+    }
+
+    log_sinks = sinks;
+    if (sinks & ASYNC_LOG_TO_FILE) {
+        if (file_path == nullptr || (log_file = fopen(file_path, "ae")) == nullptr) {
+            syslog(log_facility | LOG_ERR, "Error: Could not open the log file %s : %m", file_path ? file_path : "(none)");
+            return false;
+        }
+    }
+
+    running = true;
+    // The thread is detached, stop_async_log() writes out what it left and the process exits without it.
+    start_signal_free_thread(flush_loop).detach();
+    return true;
+}
+
+
+void async_log(int priority, const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+
+    if (!running) {
+        vsyslog(priority, format, arguments);
+        va_end(arguments);
+        return;
+    }
+
+    if (thread_ring == nullptr) {
+        std::unique_ptr<Log_ring> ring(new Log_ring());
+        thread_ring = ring.get();
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(std::move(ring));
+    }
+
+    Log_ring& ring = *thread_ring;
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ASYNC_LOG_RING_SIZE) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        va_end(arguments);
+        return;
+    }
+
+    Log_line& line = ring.lines[head % ASYNC_LOG_RING_SIZE];
+    line.priority = priority;
+    line.format = format;
+    line.time_us = now_us();
+    // glibc's vsnprintf() understands "%m", the same as syslog() does.
+    vsnprintf(line.text, sizeof(line.text), format, arguments);
+    va_end(arguments);
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+
+void flush_async_log()
+{
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    drain();
+}
+
+
+void stop_async_log()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    wake.notify_all();
+
+    // The flushing thread may be writing out lines, its last ones are written out here when it is done.
+    // It is not waited for long, the process is about to exit.
+    std::unique_lock<std::mutex> lock(flush_mutex, std::try_to_lock);
+    for (int tries = 0; !lock.owns_lock() && tries < 20; ++tries) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        lock.try_lock();
+    }
+    if (lock.owns_lock()) {
+        drain();
+    }
+}
+
+
+uint64_t async_log_dropped()
+{
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (auto& ring : rings) {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+
+uint64_t async_log_suppressed()
+{
+    return suppressed_total;
+}
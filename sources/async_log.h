@@ -0,0 +1,94 @@
+/**
+ * File Name:   async_log.h
+ *
+ * Description:
+ * This file contains the declarations of the asynchronous logger of the camera daemon.
+ * async_log() is called like syslog(), but it only formats the line into a buffer owned by the calling
+ * thread and returns, the line is written out later by a background thread. This keeps the blocking
+ * syslog() writes off the capture and detection path, which runs once per frame.
+ *
+ * Each thread has its own ring buffer of ASYNC_LOG_RING_SIZE lines, which only that thread writes and only
+ * the flushing thread reads, so no lock is taken when logging. When a ring is full the line is dropped and
+ * counted. Before writing the lines out, the flushing thread:
+ *     - coalesces a line that is repeated by the same thread into one "(repeated N times)" line,
+ *     - lets through at most ASYNC_LOG_RATE_LIMIT lines per second of the same format, and counts the rest.
+ * The dropped and suppressed lines are reported in the log itself.
+ *
+ * Until start_async_log() is called, and after stop_async_log(), async_log() just calls syslog(),
+ * so the code it is used in also works in the GUI and the LiveStream Viewer processes.
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <cstdint>  /* for std::uint64_t */
+
+// How many lines the ring buffer of every thread holds.
+#define ASYNC_LOG_RING_SIZE 128
+// The longest line that is logged, longer lines are cut.
+#define ASYNC_LOG_LINE_LENGTH 256
+// How often the flushing thread writes out the buffered lines.
+#define ASYNC_LOG_FLUSH_INTERVAL_MS 50
+// How many lines of the same format are written per second, the rest are counted.
+#define ASYNC_LOG_RATE_LIMIT 10
+// How long a repeated line is held back before its repeat count is written.
+#define ASYNC_LOG_COALESCE_US 1000000
+
+// Where the lines are written to, these can be combined with |.
+#define ASYNC_LOG_TO_SYSLOG 1
+#define ASYNC_LOG_TO_FILE   2
+
+
+/**
+ * This function starts the flushing thread. From now on async_log() buffers the lines.
+ * It has to be called after the process has forked, since threads do not survive a fork().
+ *
+ * @param int sinks - ASYNC_LOG_TO_SYSLOG and/or ASYNC_LOG_TO_FILE.
+ *
+ * @param const char* file_path - The file the lines are appended to, if ASYNC_LOG_TO_FILE is given.
+ *
+ * @return bool - true  if the logger is running.
+ *                false if the log file could not be opened, the reason is written to the syslog.
+ */
+bool start_async_log(int sinks, const char* file_path = nullptr);
+
+
+/**
+ * This function logs a line, the same as syslog() does.
+ * It never blocks, and the only work done in the calling thread is formatting the line.
+ *
+ * @param int priority - The facility and the level, as for syslog().
+ *
+ * @param const char* format - A printf() format, which must be a string literal: lines are rate limited
+ *                             by the address of their format. "%m" is supported.
+ */
+void async_log(int priority, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+
+/**
+ * This function writes out every buffered line now.
+ * It is called by terminate_daemon(), so the last lines before the daemon exits are not lost.
+ */
+void flush_async_log();
+
+
+/**
+ * This function stops the flushing thread after writing out every buffered line.
+ * It is called by terminate_daemon(), just before the process exits.
+ */
+void stop_async_log();
+
+
+/**
+ * @return std::uint64_t - The number of lines dropped because the ring buffer of a thread was full.
+ */
+std::uint64_t async_log_dropped();
+
+
+/**
+ * @return std::uint64_t - The number of lines suppressed by the rate limit.
+ */
+std::uint64_t async_log_suppressed();
+
+
+#endif  /* ASYNC_LOG_H */
@@ -0,0 +1,266 @@
+/**
+ * File Name:   avi_writer.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Avi_writer class's methods, which write an MJPEG AVI
+ * from frames that are already encoded as JPEG.
+ */
+
+#include "avi_writer.h"
+#include "async_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for mode permissions constants */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for write(), pwrite(), close() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <algorithm>    /* for std::max() */
+#include <cmath>        /* for std::lround() */
+#include <cstring>      /* for memcpy() */
+
+using std::string;
+using std::vector;
+using std::uint32_t;
+using std::uint64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// The size of everything before the first '00dc' chunk.
+#define AVI_HEADERS_SIZE 224
+// The flag of avih that says the file has an 'idx1'.
+#define AVIF_HASINDEX 0x10
+// The flag of an 'idx1' entry that says the chunk is a keyframe.
+#define AVIIF_KEYFRAME 0x10
+
+
+/**
+ * These helper functions append the fields of the file.
+ */
+static void put_fourcc(vector<char>& out, const char* fourcc)
+{
+    out.insert(out.end(), fourcc, fourcc + 4);
+}
+
+static void put_u32(vector<char>& out, uint32_t value)
+{
+    char bytes[4];
+    memcpy(bytes, &value, sizeof(bytes));
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+static void put_u16(vector<char>& out, std::uint16_t value)
+{
+    char bytes[2];
+    memcpy(bytes, &value, sizeof(bytes));
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+
+static_assert(AVI_HEADERS_SIZE == 12 + 8 + 192 + 12, "The headers are RIFF, LIST hdrl and LIST movi");
+
+
+Avi_writer::Avi_writer()
+ : fd(-1), width(0), height(0), fps(0), movi_bytes(0), largest_frame(0), failed(false)
+{
+    //
+}
+
+
+Avi_writer::~Avi_writer()
+{
+    close();
+}
+
+
+bool Avi_writer::open(const string& path, int width, int height, double fps)
+{
+    close();
+    if ( (fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR)) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not create %s : %m", path.c_str());
+        return false;
+    }
+    this->path = path;
+    this->width = width;
+    this->height = height;
+    this->fps = fps > 0 ? fps : 10;
+    index.clear();
+    movi_bytes = 0;
+    largest_frame = 0;
+    failed = false;
+
+    buffer.clear();
+    buffer.reserve(AVI_WRITE_BUFFER + (1 << 16));
+    make_headers(buffer);
+    return true;
+}
+
+
+void Avi_writer::make_headers(vector<char>& headers) const
+{
+    uint32_t frames = index.size();
+    uint32_t riff_size = 4 + 200 + 12 + movi_bytes + 8 + frames * sizeof(Index_entry);
+    uint32_t microseconds_per_frame = std::lround(1000000 / fps);
+    uint32_t suggested_buffer = largest_frame + 8;
+
+    headers.clear();
+    put_fourcc(headers, "RIFF");
+    put_u32(headers, riff_size);
+    put_fourcc(headers, "AVI ");
+
+    put_fourcc(headers, "LIST");
+    put_u32(headers, 192);
+    put_fourcc(headers, "hdrl");
+
+    put_fourcc(headers, "avih");
+    put_u32(headers, 56);
+    put_u32(headers, microseconds_per_frame);
+    put_u32(headers, std::lround(suggested_buffer * fps));   // The most bytes per second.
+    put_u32(headers, 0);                                      // The padding granularity.
+    put_u32(headers, AVIF_HASINDEX);
+    put_u32(headers, frames);
+    put_u32(headers, 0);                                      // The initial frames.
+    put_u32(headers, 1);                                      // The streams.
+    put_u32(headers, suggested_buffer);
+    put_u32(headers, width);
+    put_u32(headers, height);
+    for (int i = 0; i < 4; ++i) {
+        put_u32(headers, 0);
+    }
+
+    put_fourcc(headers, "LIST");
+    put_u32(headers, 116);
+    put_fourcc(headers, "strl");
+
+    // The rate is kept as a fraction, so a frame rate such as 14.7 is not rounded off.
+    put_fourcc(headers, "strh");
+    put_u32(headers, 56);
+    put_fourcc(headers, "vids");
+    put_fourcc(headers, "MJPG");
+    put_u32(headers, 0);                                      // The flags.
+    put_u16(headers, 0);                                      // The priority.
+    put_u16(headers, 0);                                      // The language.
+    put_u32(headers, 0);                                      // The initial frames.
+    put_u32(headers, 1000);                                   // The scale.
+    put_u32(headers, std::lround(fps * 1000));                // The rate, frames per scale seconds.
+    put_u32(headers, 0);                                      // The start.
+    put_u32(headers, frames);                                 // The length.
+    put_u32(headers, suggested_buffer);
+    put_u32(headers, 0xFFFFFFFF);                             // The quality, the default.
+    put_u32(headers, 0);                                      // The sample size, the frames vary in size.
+    put_u16(headers, 0);
+    put_u16(headers, 0);
+    put_u16(headers, width);
+    put_u16(headers, height);
+
+    put_fourcc(headers, "strf");
+    put_u32(headers, 40);
+    put_u32(headers, 40);                                     // The size of the BITMAPINFOHEADER.
+    put_u32(headers, width);
+    put_u32(headers, height);
+    put_u16(headers, 1);                                      // The planes.
+    put_u16(headers, 24);                                     // The bits per pixel.
+    put_fourcc(headers, "MJPG");
+    put_u32(headers, width * height * 3);
+    for (int i = 0; i < 4; ++i) {
+        put_u32(headers, 0);
+    }
+
+    put_fourcc(headers, "LIST");
+    put_u32(headers, 4 + movi_bytes);
+    put_fourcc(headers, "movi");
+}
+
+
+bool Avi_writer::write_frame(const unsigned char* jpeg, std::size_t size)
+{
+    if (fd == -1 || failed) {
+        return false;
+    }
+
+    // A chunk has an even size, with a byte of padding after an odd sized JPEG.
+    uint64_t chunk_bytes = 8 + size + (size & 1);
+    uint64_t file_bytes = AVI_HEADERS_SIZE + movi_bytes + chunk_bytes + 8 + (index.size() + 1) * sizeof(Index_entry);
+    if (file_bytes > AVI_MAX_BYTES) {
+        return false;
+    }
+
+    Index_entry entry;
+    memcpy(entry.chunk_id, "00dc", 4);
+    entry.flags = AVIIF_KEYFRAME;
+    entry.offset = 4 + movi_bytes;
+    entry.size = size;
+    index.push_back(entry);
+
+    put_fourcc(buffer, "00dc");
+    put_u32(buffer, size);
+    buffer.insert(buffer.end(), jpeg, jpeg + size);
+    if (size & 1) {
+        buffer.push_back(0);
+    }
+    movi_bytes += chunk_bytes;
+    largest_frame = std::max<uint32_t>(largest_frame, size);
+
+    if (buffer.size() >= AVI_WRITE_BUFFER) {
+        return flush();
+    }
+    return true;
+}
+
+
+bool Avi_writer::flush()
+{
+    const char* data = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0 && !failed) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            async_log(log_facility | LOG_ERR, "Error: Could not write %s : %m", path.c_str());
+            failed = true;
+            break;
+        }
+        data += written;
+        remaining -= written;
+    }
+    buffer.clear();
+    return !failed;
+}
+
+
+bool Avi_writer::close()
+{
+    if (fd == -1) {
+        return false;
+    }
+
+    put_fourcc(buffer, "idx1");
+    put_u32(buffer, index.size() * sizeof(Index_entry));
+    const char* entries = reinterpret_cast<const char*>(index.data());
+    buffer.insert(buffer.end(), entries, entries + index.size() * sizeof(Index_entry));
+    flush();
+
+    // Now that everything is known, the placeholder headers are written again.
+    vector<char> headers;
+    make_headers(headers);
+    if (!failed && pwrite(fd, headers.data(), headers.size(), 0) != (ssize_t) headers.size()) {
+        async_log(log_facility | LOG_ERR, "Error: Could not write the headers of %s : %m", path.c_str());
+        failed = true;
+    }
+    if (::close(fd) == -1) {
+        failed = true;
+    }
+    fd = -1;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    return !failed;
+}
+
+
+uint32_t Avi_writer::frame_count() const
+{
+    return index.size();
+}
@@ -0,0 +1,120 @@
+/**
+ * File Name:   avi_writer.h
+ *
+ * Description:
+ * This file contains the declaration of the Avi_writer class, which writes an MJPEG AVI from frames that
+ * are already encoded as JPEG, so the JPEGs can be encoded in parallel, or taken from the live stream.
+ *
+ * The file is an AVI 1.0 RIFF with a single video stream:
+ *     RIFF 'AVI '
+ *         LIST 'hdrl'   'avih', and LIST 'strl' with the 'strh' and the 'strf' of the stream
+ *         LIST 'movi'   one '00dc' chunk per JPEG frame
+ *         'idx1'        one entry per frame, every frame is a keyframe
+ * The chunks are collected in a buffer and written out AVI_WRITE_BUFFER bytes at a time. The sizes and
+ * counts of the headers are only known at the end, close() writes the headers again with them filled in.
+ * The fields of the file are little-endian, the same as the machines SmartCCTV runs on.
+ */
+
+#ifndef AVI_WRITER_H
+#define AVI_WRITER_H
+
+#include <cstddef>   /* for std::size_t */
+#include <cstdint>   /* for std::uint32_t, std::uint64_t */
+#include <string>    /* for std::string */
+#include <vector>    /* for std::vector */
+
+// How much is collected before it is written to the file.
+#define AVI_WRITE_BUFFER (1 << 20)
+// The largest AVI 1.0 file that every player reads.
+#define AVI_MAX_BYTES (1u << 30)
+
+
+class Avi_writer {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     */
+    Avi_writer();
+
+    /**
+     * The destructor calls Avi_writer::close().
+     */
+    ~Avi_writer();
+
+    /**
+     * This function creates the file and writes the placeholder headers.
+     *
+     * @param const std::string& path - The file to create, an existing file is replaced.
+     *
+     * @param int width - The width of the frames.
+     *
+     * @param int height - The height of the frames.
+     *
+     * @param double fps - The frame rate the video plays back at.
+     *
+     * @return bool - true if the file was created.
+     */
+    bool open(const std::string& path, int width, int height, double fps);
+
+    /**
+     * This function adds a frame to the video.
+     *
+     * @param const unsigned char* jpeg - The frame, encoded as a JPEG of the width and height the file was opened with.
+     *
+     * @param std::size_t size - The size of the JPEG.
+     *
+     * @return bool - false if the frame could not be written, or the file would grow past AVI_MAX_BYTES.
+     */
+    bool write_frame(const unsigned char* jpeg, std::size_t size);
+
+    /**
+     * This function writes the index and the final headers, and closes the file.
+     *
+     * @return bool - true if the whole file was written.
+     */
+    bool close();
+
+    /**
+     * @return std::uint32_t - The number of frames written so far.
+     */
+    std::uint32_t frame_count() const;
+
+  private:
+    /**
+     * An entry of the 'idx1' chunk.
+     */
+    struct Index_entry {
+        char chunk_id[4];       // '00dc'
+        std::uint32_t flags;    // AVIIF_KEYFRAME
+        std::uint32_t offset;   // Where the chunk starts, from the 'movi' of the LIST.
+        std::uint32_t size;     // The size of the JPEG.
+    };
+
+    /**
+     * This function puts the headers together, with the counts of the frames written so far.
+     *
+     * @param std::vector<char>& headers - Set to everything up to the first '00dc' chunk.
+     */
+    void make_headers(std::vector<char>& headers) const;
+
+    /**
+     * This function writes out the buffer.
+     *
+     * @return bool - true if all of it was written.
+     */
+    bool flush();
+
+    int fd;                              // The file, -1 if not open.
+    std::string path;                    // The name of the file.
+    int width;                           // The width of the frames.
+    int height;                          // The height of the frames.
+    double fps;                          // The frame rate.
+    std::vector<char> buffer;            // The chunks not written out yet.
+    std::vector<Index_entry> index;      // The 'idx1' entries of the frames.
+    std::uint64_t movi_bytes;            // The size of the chunks of the 'movi' list so far.
+    std::uint32_t largest_frame;         // The size of the largest chunk.
+    bool failed;                         // Did a write fail?
+};
+
+
+#endif  /* AVI_WRITER_H */
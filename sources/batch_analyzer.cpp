@@ -0,0 +1,696 @@
+/**
+ * File Name:   batch_analyzer.cpp
+ *
+ * Description:
+ * This file contains the implementation of the batch analysis of a video file.
+ */
+
+#include "batch_analyzer.h"
+#include "camera_clock.h"
+#include "humanFilter.hpp"
+#include "faceFilter.hpp"
+#include "motionFilter.hpp"
+#include "box_tracker.h"
+#include "captured_frame.h"
+#include "clip_encoder.h"
+#include "detection_store.h"
+#include "thread_pool.h"
+
+#include <opencv2/core.hpp>     /* for cv::Mat, cv::Rect, cv::absdiff(), cv::countNonZero(), cv::setNumThreads() */
+#include <opencv2/imgproc.hpp>  /* for cv::resize(), cv::cvtColor(), cv::GaussianBlur(), cv::threshold() */
+#include <opencv2/videoio.hpp>  /* for cv::VideoCapture */
+#include <sys/stat.h>           /* for mkdir(), stat() */
+#include <syslog.h>             /* for syslog() */
+#include <errno.h>              /* for errno */
+#include <algorithm>            /* for std::min(), std::max(), std::lower_bound(), std::fill() */
+#include <chrono>               /* for std::chrono::steady_clock */
+#include <climits>              /* for INT_MAX */
+#include <cmath>                /* for std::llround() */
+#include <cstdio>               /* for snprintf() */
+#include <cstring>              /* for strerror() */
+#include <iterator>             /* for std::make_move_iterator() */
+#include <memory>               /* for std::unique_ptr, std::make_shared() */
+#include <thread>               /* for std::thread::hardware_concurrency(), std::this_thread::sleep_for() */
+#include <utility>              /* for std::pair, std::swap() */
+
+#define log_facility LOG_LOCAL0
+
+using std::string;
+using std::vector;
+using std::int64_t;
+using std::uint64_t;
+using std::pair;
+
+
+/**
+ * What the detectors found in a frame of the video.
+ */
+struct Frame_result {
+    uint64_t frame;               // The index of the frame in the video.
+    int64_t time_us;              // Its time in the video.
+    bool detected;                // Did the human and face detectors run on it?
+    bool human;                   // What they found, when they ran.
+    bool face;
+    float confidence;
+    std::uint8_t motion;          // METADATA_MOTION_UNKNOWN, METADATA_MOTION_NONE or METADATA_MOTION_FOUND.
+    vector<Metadata_box> boxes;   // The people and faces they found, when they ran. The tracks are set later.
+};
+
+
+/**
+ * A part of the video that is analyzed on a thread of its own.
+ */
+struct Chunk {
+    uint64_t first_frame;         // The first frame of the chunk.
+    uint64_t end_frame;           // The frame after its last one, UINT64_MAX for the last chunk, which runs to the end.
+    vector<Frame_result> frames;  // What was found in its frames.
+    bool opened;                  // Could the video be opened?
+};
+
+
+/**
+ * This helper function returns the monotonic clock in microseconds.
+ */
+static int64_t steady_us()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+/**
+ * This helper function moves an open video to a frame.
+ *
+ * @param cv::VideoCapture& video - The video, opened on path.
+ *
+ * @param const string& path - The video file.
+ *
+ * @param uint64_t frame - The index of the next frame to read.
+ *
+ * @return bool - false if the video does not have that many frames.
+ */
+static bool seek_to(cv::VideoCapture& video, const string& path, uint64_t frame)
+{
+    if (video.set(cv::CAP_PROP_POS_FRAMES, (double) frame)
+        && (uint64_t) std::llround(video.get(cv::CAP_PROP_POS_FRAMES)) == frame) {
+        return true;
+    }
+    // A backend that cannot seek to a frame has the frames before it decoded and thrown away.
+    if (!video.open(path)) {
+        return false;
+    }
+    for (uint64_t skipped = 0; skipped < frame; ++skipped) {
+        if (!video.grab()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * This helper function adds the rectangles found by a detector to the boxes of a frame.
+ *
+ * @param const vector<cv::Rect>& found - The rectangles.
+ *
+ * @param int kind - METADATA_BOX_HUMAN or METADATA_BOX_FACE.
+ *
+ * @param vector<Metadata_box>& boxes - The boxes, without a track.
+ */
+static void add_boxes(const vector<cv::Rect>& found, int kind, vector<Metadata_box>& boxes)
+{
+    for (const cv::Rect& rect : found) {
+        cv::Rect inside = rect & cv::Rect(0, 0, UINT16_MAX, UINT16_MAX);
+        Metadata_box box = {};
+        box.x = inside.x;
+        box.y = inside.y;
+        box.width = inside.width;
+        box.height = inside.height;
+        box.kind = kind;
+        boxes.push_back(box);
+    }
+}
+
+
+/**
+ * This helper function runs the detectors over the frames of a chunk, on a thread of its own.
+ *
+ * @param const string& path - The video file.
+ *
+ * @param const Batch_options& options - How to analyze it.
+ *
+ * @param double fps - The frame rate of the video.
+ *
+ * @param Chunk& chunk - The chunk, its frames are set.
+ */
+static void analyze_chunk(const string& path, const Batch_options& options, double fps, Chunk& chunk)
+{
+    const Camera_config& config = options.config;
+
+    // The frame before the chunk only goes through the motion detector, to compare the first frame with.
+    uint64_t start_frame = chunk.first_frame > 0 ? chunk.first_frame - 1 : 0;
+    cv::VideoCapture video;
+    chunk.opened = video.open(path);
+    if (!chunk.opened || !seek_to(video, path, start_frame)) {
+        return;  // The frame count was too high, and the video ends before the chunk.
+    }
+
+    HumanFilter human_filter;
+    std::unique_ptr<FaceFilter> face_filter;
+    if (!options.cascade_path.empty()) {
+        face_filter.reset(new FaceFilter(options.cascade_path));
+    }
+    MotionFilter motion_filter;
+
+    cv::Mat frame;
+    for (uint64_t index = start_frame; index < chunk.end_frame; ++index) {
+        if (!video.read(frame) || frame.empty()) {
+            break;  // The end of the video.
+        }
+
+        Frame_result result = {};
+        result.frame = index;
+        result.motion = METADATA_MOTION_UNKNOWN;
+        if (config.enable_motion_detection) {
+            result.motion = motion_filter.runDetection(frame, config) ? METADATA_MOTION_FOUND : METADATA_MOTION_NONE;
+        }
+        if (index < chunk.first_frame) {
+            continue;
+        }
+        result.time_us = media_time_us(video, index, fps);
+
+        // The detectors run on the same frames as they would have without the chunks.
+        if (config.enable_human_detection && index % config.detection_stride == 0) {
+            result.detected = true;
+            result.human = human_filter.runRecognition(frame, config);
+            result.face = face_filter != nullptr && face_filter->runRecognition(frame, config);
+            result.confidence = (float) human_filter.getConfidence();
+            add_boxes(human_filter.getBoxes(), METADATA_BOX_HUMAN, result.boxes);
+            if (face_filter != nullptr) {
+                add_boxes(face_filter->getBoxes(), METADATA_BOX_FACE, result.boxes);
+            }
+        }
+        chunk.frames.push_back(std::move(result));
+    }
+}
+
+
+/**
+ * This helper function moves a video forward to a frame. It seeks when the frame is more than a second ahead,
+ * and otherwise decodes the frames in between, which is what a backend that cannot seek always does.
+ *
+ * @param cv::VideoCapture& video - The video.
+ *
+ * @param uint64_t& position - The index of the next frame the video reads, set to frame.
+ *
+ * @param uint64_t frame - The frame to move to, not before position.
+ *
+ * @param double fps - The frame rate of the video.
+ *
+ * @return bool - false if the video ends before the frame.
+ */
+static bool skip_to(cv::VideoCapture& video, uint64_t& position, uint64_t frame, double fps)
+{
+    if (frame > position + fps && video.set(cv::CAP_PROP_POS_FRAMES, (double) frame)) {
+        // A seek can land before the frame, the rest of the way is decoded.
+        uint64_t landed = (uint64_t) std::max<long long>(std::llround(video.get(cv::CAP_PROP_POS_FRAMES)), 0);
+        if (landed <= frame) {
+            position = landed;
+        }
+    }
+    for (; position < frame; ++position) {
+        if (!video.grab()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * This helper function shrinks a frame for skimming, to a small blurred gray picture.
+ *
+ * @param const cv::Mat& frame - The frame.
+ *
+ * @param cv::Mat& small - Set to the small picture.
+ */
+static void shrink_frame(const cv::Mat& frame, cv::Mat& small)
+{
+    int height = std::max(frame.rows * BATCH_SKIM_WIDTH / std::max(frame.cols, 1), 1);
+    cv::resize(frame, small, cv::Size(BATCH_SKIM_WIDTH, height), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, small, cv::COLOR_BGR2GRAY);
+    cv::GaussianBlur(small, small, cv::Size(5, 5), 0);
+}
+
+
+/**
+ * This helper function compares the samples of a part of the video with the samples before them, on a thread
+ * of its own. The sample before the first one is read too, to compare the first one with.
+ *
+ * @param const string& path - The video file.
+ *
+ * @param const Camera_config& config - The motion_threshold a pixel has to change by.
+ *
+ * @param double fps - The frame rate of the video.
+ *
+ * @param uint64_t step - How many frames apart the samples are.
+ *
+ * @param uint64_t first_sample, end_sample - The samples to compare.
+ *
+ * @param vector<char>& changed - Set to whether each of the samples changed from the one before it.
+ *                                The samples past the end of the video are left as they are.
+ */
+static void skim_samples(const string& path, const Camera_config& config, double fps, uint64_t step,
+                         uint64_t first_sample, uint64_t end_sample, vector<char>& changed)
+{
+    cv::VideoCapture video;
+    if (!video.open(path)) {
+        // What cannot be skimmed is analyzed.
+        std::fill(changed.begin() + first_sample, changed.begin() + end_sample, 1);
+        return;
+    }
+
+    uint64_t position = 0;
+    cv::Mat frame, previous, current, difference;
+    for (uint64_t sample = first_sample > 0 ? first_sample - 1 : 0; sample < end_sample; ++sample) {
+        if (!skip_to(video, position, sample * step, fps) || !video.read(frame) || frame.empty()) {
+            return;  // The end of the video.
+        }
+        ++position;
+        shrink_frame(frame, current);
+        if (sample >= first_sample && !previous.empty()) {
+            cv::absdiff(previous, current, difference);
+            cv::threshold(difference, difference, config.motion_threshold, 255.0, cv::THRESH_BINARY);
+            changed[sample] = cv::countNonZero(difference) >= BATCH_SKIM_MIN_CHANGE * difference.total();
+        }
+        std::swap(previous, current);
+    }
+}
+
+
+/**
+ * This helper function skims a video, comparing a sample every skim_seconds with the one before it, and finds
+ * the parts of the video around the samples that changed, which are then analyzed frame by frame. A part starts
+ * long enough before the change for the pre-roll of a detection in it, and ends long enough after the change
+ * for the whole video of a detection that starts at it.
+ *
+ * @param const string& path - The video file.
+ *
+ * @param const Batch_options& options - How far apart the samples are.
+ *
+ * @param double fps - The frame rate of the video.
+ *
+ * @param uint64_t frame_count - How many frames the video has.
+ *
+ * @param uint64_t chunk_frames - How many frames the samples compared by one task span.
+ *
+ * @param Thread_pool& pool - The threads the samples are compared on.
+ *
+ * @param vector<pair<uint64_t, uint64_t>>& ranges - Set to the parts to analyze, as their first frame and
+ *                                                   the frame after their last, in order.
+ *
+ * @param Batch_result& result - Its samples and active_samples are set.
+ */
+static void skim_video(const string& path, const Batch_options& options, double fps, uint64_t frame_count,
+                       uint64_t chunk_frames, Thread_pool& pool, vector<pair<uint64_t, uint64_t>>& ranges,
+                       Batch_result& result)
+{
+    uint64_t step = std::max<uint64_t>((uint64_t) std::llround(options.skim_seconds * fps), 1);
+    uint64_t samples = (frame_count + step - 1) / step;
+    uint64_t samples_per_task = std::max<uint64_t>(chunk_frames / step, 1);
+    vector<char> changed(samples, 0);
+    for (uint64_t first = 0; first < samples; first += samples_per_task) {
+        uint64_t end = std::min(samples, first + samples_per_task);
+        pool.submit([&path, &options, fps, step, first, end, &changed]() {
+            skim_samples(path, options.config, fps, step, first, end, changed);
+        });
+    }
+    pool.wait_idle(INT_MAX);
+
+    uint64_t before = (uint64_t) std::llround((CAMERA_PRE_ROLL_SECONDS + 1) * fps);
+    uint64_t after = (uint64_t) std::llround((CAMERA_RECORDING_SECONDS + 1) * fps);
+    result.samples = samples;
+    for (uint64_t sample = 1; sample < samples; ++sample) {
+        if (!changed[sample]) {
+            continue;
+        }
+        ++result.active_samples;
+        // The change happened somewhere since the sample before.
+        uint64_t first = (sample - 1) * step > before ? (sample - 1) * step - before : 0;
+        uint64_t end = sample * step + after;
+        if (!ranges.empty() && first <= ranges.back().second) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back(first, end);
+        }
+    }
+}
+
+
+/**
+ * This helper function finds the detections in the frames of the video, the way the camera finds them.
+ * It runs over all of the frames in order, on one thread, so the tracks and the detections do not depend
+ * on how the video was cut into chunks.
+ *
+ * @param vector<Frame_result>& frames - What was found in every frame, in order. Every frame is given the
+ *                                       boxes of the last run of the detectors, with their tracks.
+ *
+ * @param const Camera_config& config - The settings of the detectors.
+ *
+ * @param vector<Batch_event>& events - Set to the detections.
+ */
+static void find_events(vector<Frame_result>& frames, const Camera_config& config, vector<Batch_event>& events)
+{
+    Box_tracker tracker;
+    bool human = false;
+    bool face = false;
+    float confidence = 0;
+    vector<Metadata_box> boxes;
+
+    bool recording = false;
+    size_t history_start = 0;   // The oldest frame within the pre-roll, while nothing is recorded.
+    size_t first_unsaved = 0;   // The first frame that is not in the video of an earlier detection.
+    size_t first_recorded = 0;  // The first frame of the video of the current detection.
+    Batch_event event = {};
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        Frame_result& result = frames[i];
+        // Nothing carries over the frames that were skimmed over, a detection ends at the last frame before them.
+        if (i > 0 && result.frame != frames[i - 1].frame + 1) {
+            if (recording) {
+                recording = false;
+                event.end_us = frames[i - 1].time_us;
+                event.last_frame = frames[i - 1].frame;
+                events.push_back(event);
+                first_unsaved = i;
+            }
+            history_start = i;
+            tracker.reset();
+            human = false;
+            face = false;
+            confidence = 0;
+            boxes.clear();
+        }
+        if (!recording) {
+            while (history_start < i && (result.time_us - frames[history_start].time_us) / 1000000 > CAMERA_PRE_ROLL_SECONDS) {
+                ++history_start;
+            }
+        }
+
+        // Between the runs of the detectors, their last results are kept.
+        if (config.enable_human_detection) {
+            if (result.detected) {
+                human = result.human;
+                face = result.face;
+                confidence = result.confidence;
+                boxes = result.boxes;
+                tracker.update(boxes);
+            }
+        } else {
+            human = true;
+            face = true;
+        }
+        result.boxes = boxes;
+        bool motion = result.motion != METADATA_MOTION_NONE;
+
+        if ((human || face) && motion && !recording) {
+            recording = true;
+            first_recorded = std::max(history_start, first_unsaved);
+            event = {};
+            event.start_us = result.time_us;
+            event.clip_start_us = frames[first_recorded].time_us;
+            event.first_frame = frames[first_recorded].frame;
+        }
+        if (!recording) {
+            continue;
+        }
+
+        if ((result.time_us - event.start_us) / 1000000 > CAMERA_RECORDING_SECONDS) {
+            // This frame is the first one after the video, it is in the pre-roll of the next detection.
+            recording = false;
+            event.end_us = frames[i - 1].time_us;
+            event.last_frame = frames[i - 1].frame;
+            events.push_back(event);
+            first_unsaved = i;
+            history_start = i;
+            continue;
+        }
+        if (config.enable_human_detection) {
+            if (human) {
+                event.types |= DETECTION_HUMAN;
+                event.confidence = std::max(event.confidence, confidence);
+            }
+            if (face) {
+                event.types |= DETECTION_FACE;
+            }
+            event.box_count = (std::uint16_t) std::max<size_t>(event.box_count, std::min<size_t>(boxes.size(), UINT16_MAX));
+        }
+        if (config.enable_motion_detection && result.motion == METADATA_MOTION_FOUND) {
+            event.types |= DETECTION_MOTION;
+        }
+    }
+
+    // A detection that runs to the end of the video is saved with what there is of it.
+    if (recording) {
+        event.end_us = frames.back().time_us;
+        event.last_frame = frames.back().frame;
+        events.push_back(event);
+    }
+}
+
+
+/**
+ * This helper function decodes the frames of every detection again, and saves them as a video.
+ *
+ * @param const string& path - The video file.
+ *
+ * @param const Batch_options& options - Where to save the videos, and how.
+ *
+ * @param const vector<Frame_result>& frames - What was found in every frame, with the tracks.
+ *
+ * @param vector<Batch_event>& events - The detections, the videos that were saved are set in them.
+ */
+static void save_clips(const string& path, const Batch_options& options, const vector<Frame_result>& frames,
+                       vector<Batch_event>& events)
+{
+    const Camera_config& config = options.config;
+    Clip_encoder clip_encoder;
+    if (!clip_encoder.start()) {
+        return;
+    }
+
+    size_t slash = path.rfind('/');
+    string name = path.substr(slash == string::npos ? 0 : slash + 1);
+    name = name.substr(0, name.rfind('.'));
+
+    cv::VideoCapture video;
+    uint64_t next_frame = UINT64_MAX;  // The frame the video is at.
+    cv::Mat image;
+    for (Batch_event& event : events) {
+        // The next video is decoded while the ones before it are encoded, but only a few are kept in memory.
+        while (clip_encoder.pending() >= CLIP_ENCODER_THREADS) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        if (event.first_frame != next_frame) {
+            if (!(video.isOpened() || video.open(path)) || !seek_to(video, path, event.first_frame)) {
+                syslog(log_facility | LOG_ERR, "Could not decode %s at frame %llu", path.c_str(), (unsigned long long) event.first_frame);
+                video.release();
+                next_frame = UINT64_MAX;
+                continue;
+            }
+        }
+
+        Clip_job job;
+        // The frames are read in order from the first one, along with what was found in them.
+        auto result = std::lower_bound(frames.begin(), frames.end(), event.first_frame,
+                                       [](const Frame_result& frame, uint64_t index) { return frame.frame < index; });
+        for (next_frame = event.first_frame; next_frame <= event.last_frame; ++next_frame, ++result) {
+            if (result == frames.end() || result->frame != next_frame || !video.read(image) || image.empty()) {
+                next_frame = UINT64_MAX;
+                break;
+            }
+            Frame_metadata metadata;
+            metadata.motion = result->motion;
+            metadata.boxes = result->boxes;
+            job.frames.push_back(std::make_shared<Captured_frame>(image, result->frame, result->time_us, std::move(metadata)));
+            image.release();
+        }
+
+        if (job.frames.empty()) {
+            continue;
+        }
+        string time = format_media_time(event.start_us);
+        std::replace(time.begin(), time.end(), ':', '-');
+        string file_name = name + "_" + time + clip_encoder.extension(config.recording_codec);
+        job.jpeg_quality = config.recording_jpeg_quality;
+        job.path = options.clip_directory + file_name;
+        job.camera = -1;
+        job.codec = config.recording_codec;
+        job.preset = config.recording_preset;
+        job.bitrate_kbps = config.recording_bitrate_kbps;
+        if (clip_encoder.submit(std::move(job))) {
+            event.clip = options.clip_directory + file_name;
+        }
+    }
+    clip_encoder.wait(INT_MAX);
+
+    // A video that ffmpeg failed on is saved as MJPEG next to where it was to be, and a video that could not
+    // be encoded at all is not there, the reason is in the syslog.
+    for (Batch_event& event : events) {
+        struct stat file_status;
+        if (event.clip.empty() || stat(event.clip.c_str(), &file_status) == 0) {
+            continue;
+        }
+        string fallback = Clip_encoder::fallback_path(event.clip);
+        if (stat(fallback.c_str(), &file_status) == 0) {
+            event.clip = fallback;
+        } else {
+            event.clip.clear();
+        }
+    }
+}
+
+
+bool analyze_video(const string& path, const Batch_options& options, Batch_result& result, string& error)
+{
+    result = Batch_result();
+    int64_t start = steady_us();
+
+    cv::VideoCapture video;
+    if (!video.open(path)) {
+        error = "could not open " + path;
+        return false;
+    }
+    result.fps = media_fps(video);
+    result.width = (int) video.get(cv::CAP_PROP_FRAME_WIDTH);
+    result.height = (int) video.get(cv::CAP_PROP_FRAME_HEIGHT);
+    double frame_count = video.get(cv::CAP_PROP_FRAME_COUNT);
+    video.release();
+
+    if (!options.clip_directory.empty() && mkdir(options.clip_directory.c_str(), S_IRWXU) == -1 && errno != EEXIST) {
+        error = "could not create " + options.clip_directory + ": " + strerror(errno);
+        return false;
+    }
+
+    // The chunks are a whole number of detection strides long, so the detectors run on the same frames.
+    uint64_t stride = std::max(options.config.detection_stride, 1);
+    uint64_t chunk_frames = (uint64_t) (std::max(options.chunk_seconds, 1) * result.fps);
+    chunk_frames = std::max<uint64_t>((chunk_frames + stride - 1) / stride, 1) * stride;
+
+    int jobs = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    // The chunks are what runs in parallel, each of them runs the detectors on a single thread.
+    int opencv_threads = cv::getNumThreads();
+    if (jobs > 1) {
+        cv::setNumThreads(1);
+    }
+    Thread_pool pool;
+    if (!pool.start(jobs)) {
+        cv::setNumThreads(opencv_threads);
+        error = "could not start the threads";
+        return false;
+    }
+
+    // Skimming needs to know where the video ends, without a frame count every frame is analyzed.
+    vector<Chunk> chunks;
+    bool skimmed = options.skim_seconds > 0 && frame_count > 0;
+    if (skimmed) {
+        int64_t skim_start = steady_us();
+        vector<pair<uint64_t, uint64_t>> ranges;
+        skim_video(path, options, result.fps, (uint64_t) frame_count, chunk_frames, pool, ranges, result);
+        for (const pair<uint64_t, uint64_t>& range : ranges) {
+            uint64_t first = range.first / stride * stride;
+            for (uint64_t frame = first; frame < range.second; frame += chunk_frames) {
+                Chunk chunk;
+                chunk.first_frame = frame;
+                chunk.end_frame = std::min(range.second, frame + chunk_frames);
+                chunk.opened = false;
+                chunks.push_back(chunk);
+            }
+        }
+        result.skim_us = steady_us() - skim_start;
+    } else {
+        // Without a frame count, the video is analyzed as a single chunk.
+        uint64_t chunk_count = frame_count > 0 ? std::max<uint64_t>(((uint64_t) frame_count + chunk_frames - 1) / chunk_frames, 1) : 1;
+        chunks.resize(chunk_count);
+        for (uint64_t i = 0; i < chunk_count; ++i) {
+            chunks[i].first_frame = i * chunk_frames;
+            chunks[i].end_frame = (i + 1) * chunk_frames;
+            chunks[i].opened = false;
+        }
+    }
+    // The frame count is only an estimate for some formats, the chunk that is meant to end the video reads to its end.
+    if (!chunks.empty() && (frame_count <= 0 || chunks.back().end_frame >= (uint64_t) frame_count)) {
+        chunks.back().end_frame = UINT64_MAX;
+    }
+    result.chunks = chunks.size();
+    result.jobs = std::min<uint64_t>(jobs, std::max<uint64_t>(chunks.size(), 1));
+
+    int64_t scan_start = steady_us();
+    for (Chunk& chunk : chunks) {
+        pool.submit([&path, &options, &result, &chunk]() { analyze_chunk(path, options, result.fps, chunk); });
+    }
+    pool.wait_idle(INT_MAX);
+    pool.stop(0);
+    cv::setNumThreads(opencv_threads);
+    result.scan_us = steady_us() - scan_start;
+
+    vector<Frame_result> frames;
+    for (Chunk& chunk : chunks) {
+        if (!chunk.opened) {
+            error = "could not open " + path + " again";
+            return false;
+        }
+        frames.insert(frames.end(), std::make_move_iterator(chunk.frames.begin()), std::make_move_iterator(chunk.frames.end()));
+        vector<Frame_result>().swap(chunk.frames);
+    }
+    if (frames.empty() && !skimmed) {
+        error = path + " has no frames";
+        return false;
+    }
+    result.frames = frames.size();
+    result.total_frames = skimmed ? std::max<uint64_t>((uint64_t) frame_count, result.frames) : result.frames;
+    result.media_us = frames.empty() ? 0 : frames.back().time_us;
+    if (skimmed) {
+        result.media_us = std::max<int64_t>(result.media_us, std::llround(frame_count * 1000000.0 / result.fps));
+    }
+
+    find_events(frames, options.config, result.events);
+    result.analysis_us = steady_us() - start;
+
+    if (!options.clip_directory.empty() && !result.events.empty()) {
+        int64_t clips_start = steady_us();
+        save_clips(path, options, frames, result.events);
+        result.clips_us = steady_us() - clips_start;
+    }
+
+    syslog(log_facility | LOG_NOTICE, "Analyzed %s: %llu of %llu frames, %zu detections, %.1fx real time on %d threads",
+           path.c_str(), (unsigned long long) result.frames, (unsigned long long) result.total_frames, result.events.size(),
+           (double) result.media_us / std::max<int64_t>(result.analysis_us, 1), result.jobs);
+    if (skimmed) {
+        syslog(log_facility | LOG_NOTICE, "Skimmed %s: %llu of %llu samples %d s apart changed, about %.1fx faster than analyzing every frame",
+               path.c_str(), (unsigned long long) result.active_samples, (unsigned long long) result.samples,
+               options.skim_seconds, (double) estimated_exhaustive_us(result) / std::max<int64_t>(result.analysis_us, 1));
+    }
+    return true;
+}
+
+
+int64_t estimated_exhaustive_us(const Batch_result& result)
+{
+    if (result.frames == 0) {
+        return 0;
+    }
+    // The frames that were analyzed cost as much as the ones that were skimmed over would have.
+    return (int64_t) ((double) result.scan_us * result.total_frames / result.frames);
+}
+
+
+string format_media_time(int64_t time_us)
+{
+    int64_t ms = std::max<int64_t>(time_us, 0) / 1000;
+    char text[32];
+    snprintf(text, sizeof(text), "%02lld:%02lld:%02lld.%03lld", (long long) (ms / 3600000), (long long) (ms / 60000 % 60),
+             (long long) (ms / 1000 % 60), (long long) (ms % 1000));
+    return text;
+}
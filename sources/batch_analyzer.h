@@ -0,0 +1,138 @@
+/**
+ * File Name:   batch_analyzer.h
+ *
+ * Description:
+ * This file contains the declarations of the batch analysis of a video file, which runs the detectors of the
+ * camera daemon over an archived video as fast as the CPU allows, instead of at the rate it was recorded at.
+ *
+ * The video is analyzed in three passes:
+ *     1. It is cut into chunks of BATCH_CHUNK_SECONDS, which are decoded and run through the detectors in
+ *        parallel, one chunk per thread, each with its own detectors. A chunk starts decoding one frame early,
+ *        so the motion detector compares its first frame with the frame before it, as it would have without the
+ *        chunks, and the human and face detectors run on the same frames as they would have, every
+ *        detection_stride frames from the start of the video.
+ *     2. What was found in every frame is put back in order, the people and faces are tracked across the whole
+ *        video, and the detections are found the way the camera finds them, in the time of the video: a detection
+ *        is recorded for CAMERA_RECORDING_SECONDS, together with up to CAMERA_PRE_ROLL_SECONDS before it that are
+ *        not in an earlier video (see camera_clock.h).
+ *     3. The frames of every detection are decoded again and saved by a Clip_encoder, with their .meta files.
+ * All the times are those of the frames in the video, from its start, so analyzing a video twice finds the same
+ * detections, however fast it runs.
+ *
+ * Most of a long recording is usually of nothing happening. With skim_seconds set, the video is skimmed first:
+ * a sample every skim_seconds is shrunk to BATCH_SKIM_WIDTH, and compared with the sample before it, in parallel.
+ * Only the parts of the video around the samples that changed go through the passes above, so the detections
+ * are found at the same frames as without skimming. They start early enough for the pre-roll and end late
+ * enough for the whole video of a detection. What moves and is gone again between two samples is missed, so
+ * the samples have to be closer together than anything that has to be found stays in view.
+ *
+ * Nothing here needs the camera daemon, it is used by SmartCCTV_batch (see batch_tool.cpp).
+ */
+
+#ifndef BATCH_ANALYZER_H
+#define BATCH_ANALYZER_H
+
+#include "camera_config.h"
+
+#include <cstdint>  /* for std::uint16_t, std::uint64_t, std::int64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// How long a chunk of the video that is analyzed on its own thread is.
+#define BATCH_CHUNK_SECONDS 30
+// The width the samples are shrunk to when skimming.
+#define BATCH_SKIM_WIDTH 160
+// The part of the pixels of a sample that have to change by motion_threshold, for the video around it to be analyzed.
+#define BATCH_SKIM_MIN_CHANGE 0.0005
+
+
+/**
+ * How to analyze a video.
+ */
+struct Batch_options {
+    Camera_config config;           // The settings of the detectors and of the videos of the detections.
+    int jobs = 0;                   // How many chunks are analyzed at the same time, 0 for one per core.
+    int chunk_seconds = BATCH_CHUNK_SECONDS;  // How long a chunk is.
+    int skim_seconds = 0;           // How far apart the samples are when skimming, 0 to analyze every frame.
+    std::string cascade_path;       // The cascade of the face detector, faces are not detected if it is empty.
+    std::string clip_directory;     // Where the videos of the detections are saved, ending in '/', empty for none.
+};
+
+
+/**
+ * A detection found in a video.
+ */
+struct Batch_event {
+    std::int64_t start_us;          // When it was first found, in microseconds from the start of the video.
+    std::int64_t end_us;            // The time of the last frame that was recorded for it.
+    std::int64_t clip_start_us;     // The time of the first frame of its video, before start_us by the pre-roll.
+    std::uint64_t first_frame;      // The frames of its video, in the analyzed video.
+    std::uint64_t last_frame;
+    std::uint16_t types;            // What was found, DETECTION_HUMAN, DETECTION_FACE and DETECTION_MOTION.
+    std::uint16_t box_count;        // The most people and faces that were found in a frame.
+    float confidence;               // The highest HOG confidence of a person.
+    std::string clip;               // The video it was saved in, empty if it was not saved.
+};
+
+
+/**
+ * What analyze_video() found, and how long it took.
+ */
+struct Batch_result {
+    std::vector<Batch_event> events;  // The detections, in the order of the video.
+    std::uint64_t frames;             // The frames that were analyzed.
+    std::uint64_t total_frames;       // The frames of the video, including those that were skimmed over.
+    std::uint64_t samples;            // The samples that were compared when skimming.
+    std::uint64_t active_samples;     // How many of them changed.
+    std::int64_t media_us;            // How long the video is, up to its last frame.
+    double fps;                       // The frame rate of the video.
+    int width;                        // The size of its frames.
+    int height;
+    int chunks;                       // How many chunks it was cut into.
+    int jobs;                         // How many of them were analyzed at the same time.
+    std::int64_t analysis_us;         // How long finding the detections took, in wall clock time.
+    std::int64_t skim_us;             // How long of it was skimming, 0 without skimming.
+    std::int64_t scan_us;             // How long of it the detectors took.
+    std::int64_t clips_us;            // How long saving the videos of the detections took.
+};
+
+
+/**
+ * This function finds the detections in a video file, and saves a video of every one of them.
+ *
+ * @param const std::string& path - The video file.
+ *
+ * @param const Batch_options& options - How to analyze it.
+ *
+ * @param Batch_result& result - Set to the detections.
+ *
+ * @param std::string& error - Set to the reason when the video could not be analyzed.
+ *
+ * @return bool - false if the video could not be opened, or a chunk of it could not be decoded.
+ *                A video of a detection that could not be saved is left out of its event, and does not fail it.
+ */
+bool analyze_video(const std::string& path, const Batch_options& options, Batch_result& result, std::string& error);
+
+
+/**
+ * This function estimates how long analyzing every frame of a skimmed video would have taken, from how long the
+ * frames that were analyzed took.
+ *
+ * @param const Batch_result& result - What analyze_video() found.
+ *
+ * @return std::int64_t - The time, in microseconds.
+ */
+std::int64_t estimated_exhaustive_us(const Batch_result& result);
+
+
+/**
+ * This function formats a time in a video.
+ *
+ * @param std::int64_t time_us - The time, in microseconds from the start of the video.
+ *
+ * @return std::string - The time, as "HH:MM:SS.mmm".
+ */
+std::string format_media_time(std::int64_t time_us);
+
+
+#endif  /* BATCH_ANALYZER_H */
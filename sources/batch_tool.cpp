@@ -0,0 +1,236 @@
+/**
+ * File Name:   batch_tool.cpp
+ *
+ * Description:
+ * This file contains SmartCCTV_batch, the command line tool that finds the detections in archived video files
+ * as fast as the CPU allows, see batch_analyzer.h. It does not need the camera daemon to be running.
+ *
+ * Usage:
+ *     SmartCCTV_batch [--jobs N] [--chunk SECONDS] [--output DIRECTORY] [--no-clips] [--skim SECONDS [--compare]]
+ *                     [--set SETTING=VALUE]... FILE...
+ * The settings are those of the control socket, such as detection_stride or recording_codec. The faces are
+ * detected with $SmartCCTV_Project_dir/cascade.xml, when it is there.
+ *
+ * Every detection is printed on a line of its own, with the fields separated by tabs:
+ *     file, start, end, seconds recorded, what was found, most boxes in a frame, HOG confidence, first frame,
+ *     last frame, video
+ * The times are from the start of the file, as HH:MM:SS.mmm. The video of a detection is saved in the output
+ * directory, named after the file and the time of the detection, and starts up to 10 seconds before it.
+ *
+ * With --skim, only the parts of a file around a change between two samples that many seconds apart are analyzed,
+ * and how much faster that was than analyzing every frame is estimated. --compare analyzes every frame as well,
+ * to measure it, and counts the detections that skimming missed.
+ */
+
+#include "batch_analyzer.h"
+#include "detection_store.h"
+
+#include <getopt.h>     /* for getopt_long(), struct option */
+#include <syslog.h>     /* for openlog() */
+#include <algorithm>    /* for std::max() */
+#include <cstdio>       /* for printf(), fprintf(), fflush() */
+#include <cstdlib>      /* for getenv(), strtol(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <cstring>      /* for strchr(), strlen() */
+#include <string>       /* for std::string */
+
+using std::string;
+
+
+/**
+ * This helper function prints how to use the tool.
+ *
+ * @param const char* program - The name the tool was run as.
+ */
+static void print_usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--jobs N] [--chunk SECONDS] [--output DIRECTORY] [--no-clips] [--skim SECONDS [--compare]]\n"
+            "       %*s [--set SETTING=VALUE]... FILE...\n"
+            "The jobs are one per core by default, the chunks %d seconds, and the videos are saved in the current directory.\n",
+            program, (int) strlen(program), "", BATCH_CHUNK_SECONDS);
+}
+
+
+/**
+ * This helper function reads a whole number that is at least 1.
+ *
+ * @param const char* text - The number.
+ *
+ * @param int& number - Set to the number.
+ *
+ * @return bool - false if the text is not such a number.
+ */
+static bool parse_count(const char* text, int& number)
+{
+    char* end;
+    long value = strtol(text, &end, 10);
+    number = (int) value;
+    return *text != '\0' && *end == '\0' && value >= 1 && value <= 100000;
+}
+
+
+/**
+ * This helper function spells out what was found in a detection.
+ *
+ * @param std::uint16_t types - DETECTION_HUMAN, DETECTION_FACE and DETECTION_MOTION.
+ *
+ * @return string - Their names, separated by commas.
+ */
+static string type_names(std::uint16_t types)
+{
+    string names;
+    if (types & DETECTION_HUMAN) {
+        names += "human,";
+    }
+    if (types & DETECTION_FACE) {
+        names += "face,";
+    }
+    if (types & DETECTION_MOTION) {
+        names += "motion,";
+    }
+    if (names.empty()) {
+        return "-";
+    }
+    names.pop_back();
+    return names;
+}
+
+
+int main(int argc, char* argv[])
+{
+    openlog("SmartCCTV_batch", LOG_PERROR, LOG_USER);
+
+    Batch_options options;
+    options.clip_directory = "./";
+    const char* project_directory = getenv("SmartCCTV_Project_dir");
+    if (project_directory != nullptr) {
+        options.cascade_path = string(project_directory) + "/cascade.xml";
+    }
+
+    bool compare = false;
+
+    static const struct option long_options[] = {
+        { "jobs",     required_argument, nullptr, 'j' },
+        { "chunk",    required_argument, nullptr, 'c' },
+        { "output",   required_argument, nullptr, 'o' },
+        { "no-clips", no_argument,       nullptr, 'n' },
+        { "skim",     required_argument, nullptr, 'k' },
+        { "compare",  no_argument,       nullptr, 'C' },
+        { "set",      required_argument, nullptr, 's' },
+        { "help",     no_argument,       nullptr, 'h' },
+        { nullptr,    0,                 nullptr, 0 }
+    };
+    int option;
+    while ( (option = getopt_long(argc, argv, "j:c:o:nk:Cs:h", long_options, nullptr)) != -1) {
+        bool valid = true;
+        switch (option) {
+          case 'j':
+            valid = parse_count(optarg, options.jobs);
+            break;
+          case 'c':
+            valid = parse_count(optarg, options.chunk_seconds);
+            break;
+          case 'o':
+            options.clip_directory = optarg;
+            if (options.clip_directory.back() != '/') {
+                options.clip_directory += '/';
+            }
+            break;
+          case 'n':
+            options.clip_directory.clear();
+            break;
+          case 'k':
+            valid = parse_count(optarg, options.skim_seconds);
+            break;
+          case 'C':
+            compare = true;
+            break;
+          case 's': {
+            const char* equals = strchr(optarg, '=');
+            string error;
+            valid = equals != nullptr
+                    && set_camera_config_value(options.config, string(optarg, equals - optarg), equals + 1, error);
+            if (!valid && !error.empty()) {
+                fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+            }
+            break;
+          }
+          case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+          default:
+            valid = false;
+        }
+        if (!valid) {
+            if (option != '?') {
+                fprintf(stderr, "%s: invalid value: %s\n", argv[0], optarg);
+            }
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || (compare && options.skim_seconds == 0)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for (int i = optind; i < argc; ++i) {
+        Batch_result result;
+        string error;
+        if (!analyze_video(argv[i], options, result, error)) {
+            fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        for (const Batch_event& event : result.events) {
+            printf("%s\t%s\t%s\t%.1f\t%s\t%u\t%.2f\t%llu\t%llu\t%s\n", argv[i],
+                   format_media_time(event.start_us).c_str(), format_media_time(event.end_us).c_str(),
+                   (event.end_us - event.clip_start_us) / 1000000.0, type_names(event.types).c_str(),
+                   event.box_count, event.confidence, (unsigned long long) event.first_frame,
+                   (unsigned long long) event.last_frame, event.clip.empty() ? "-" : event.clip.c_str());
+        }
+        fflush(stdout);
+        fprintf(stderr, "%s: %llu frames (%s at %.2f fps, %dx%d), %zu detections, analyzed in %.1f s (%.1fx real time, "
+                "%d chunks on %d threads), videos saved in %.1f s\n",
+                argv[i], (unsigned long long) result.frames, format_media_time(result.media_us).c_str(), result.fps,
+                result.width, result.height, result.events.size(), result.analysis_us / 1000000.0,
+                (double) result.media_us / std::max<std::int64_t>(result.analysis_us, 1), result.chunks, result.jobs,
+                result.clips_us / 1000000.0);
+
+        if (options.skim_seconds > 0 && result.samples > 0) {
+            fprintf(stderr, "%s: skimmed %llu samples %d s apart in %.1f s, %llu changed, analyzed %llu of %llu frames (%.1f%%), "
+                    "about %.1fx faster than analyzing every frame\n",
+                    argv[i], (unsigned long long) result.samples, options.skim_seconds, result.skim_us / 1000000.0,
+                    (unsigned long long) result.active_samples, (unsigned long long) result.frames,
+                    (unsigned long long) result.total_frames, 100.0 * result.frames / std::max<std::uint64_t>(result.total_frames, 1),
+                    (double) estimated_exhaustive_us(result) / std::max<std::int64_t>(result.analysis_us, 1));
+        }
+        if (compare) {
+            // Every frame is analyzed for the comparison, the videos were already saved.
+            Batch_options exhaustive = options;
+            exhaustive.skim_seconds = 0;
+            exhaustive.clip_directory.clear();
+            Batch_result every_frame;
+            if (!analyze_video(argv[i], exhaustive, every_frame, error)) {
+                fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+                status = EXIT_FAILURE;
+                continue;
+            }
+            size_t found = 0;
+            for (const Batch_event& expected : every_frame.events) {
+                for (const Batch_event& event : result.events) {
+                    if (event.start_us == expected.start_us && event.last_frame == expected.last_frame) {
+                        ++found;
+                        break;
+                    }
+                }
+            }
+            fprintf(stderr, "%s: analyzing every frame took %.1f s, skimming was %.1fx faster and found %zu of its %zu detections\n",
+                    argv[i], every_frame.analysis_us / 1000000.0,
+                    (double) every_frame.analysis_us / std::max<std::int64_t>(result.analysis_us, 1), found, every_frame.events.size());
+        }
+    }
+    return status;
+}
@@ -0,0 +1,99 @@
+/**
+ * File Name:   box_tracker.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Box_tracker class's methods, which follow the people and
+ * faces found by the detectors from one run to the next.
+ */
+
+#include "box_tracker.h"
+
+#include <algorithm>  /* for std::sort(), std::max(), std::min(), std::remove_if() */
+#include <cstddef>    /* for std::size_t */
+
+using std::vector;
+using std::size_t;
+
+
+Box_tracker::Box_tracker()
+ : next_id(1)
+{
+    //
+}
+
+
+double Box_tracker::iou(const Metadata_box& first, const Metadata_box& second)
+{
+    int left = std::max<int>(first.x, second.x);
+    int top = std::max<int>(first.y, second.y);
+    int right = std::min<int>(first.x + first.width, second.x + second.width);
+    int bottom = std::min<int>(first.y + first.height, second.y + second.height);
+    if (right <= left || bottom <= top) {
+        return 0;
+    }
+    double intersection = (double) (right - left) * (bottom - top);
+    double both = (double) first.width * first.height + (double) second.width * second.height - intersection;
+    return both > 0 ? intersection / both : 0;
+}
+
+
+void Box_tracker::update(vector<Metadata_box>& boxes)
+{
+    /**
+     * A box and a track that could belong together.
+     */
+    struct Pair {
+        double overlap;
+        size_t box;
+        size_t track;
+    };
+
+    // There are only a handful of people in a picture, so every box is compared with every track.
+    vector<Pair> pairs;
+    for (size_t box = 0; box < boxes.size(); ++box) {
+        for (size_t track = 0; track < tracks.size(); ++track) {
+            if (boxes[box].kind != tracks[track].box.kind) {
+                continue;
+            }
+            double overlap = iou(boxes[box], tracks[track].box);
+            if (overlap >= TRACKER_MIN_IOU) {
+                pairs.push_back({ overlap, box, track });
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& first, const Pair& second) { return first.overlap > second.overlap; });
+
+    vector<bool> box_matched(boxes.size(), false);
+    vector<bool> track_matched(tracks.size(), false);
+    for (const Pair& pair : pairs) {
+        if (box_matched[pair.box] || track_matched[pair.track]) {
+            continue;
+        }
+        box_matched[pair.box] = true;
+        track_matched[pair.track] = true;
+        boxes[pair.box].track_id = tracks[pair.track].box.track_id;
+        tracks[pair.track].box = boxes[pair.box];
+        tracks[pair.track].missed = 0;
+    }
+
+    for (size_t track = 0; track < track_matched.size(); ++track) {
+        if (!track_matched[track]) {
+            ++tracks[track].missed;
+        }
+    }
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [](const Track& track) { return track.missed > TRACKER_MAX_MISSED; }),
+                 tracks.end());
+
+    for (size_t box = 0; box < boxes.size(); ++box) {
+        if (!box_matched[box]) {
+            boxes[box].track_id = next_id++;
+            tracks.push_back({ boxes[box], 0 });
+        }
+    }
+}
+
+
+void Box_tracker::reset()
+{
+    tracks.clear();
+}
@@ -0,0 +1,67 @@
+/**
+ * File Name:   box_tracker.h
+ *
+ * Description:
+ * This file contains the declaration of the Box_tracker class, which follows the people and faces found by
+ * the detectors from one run to the next, so each of them keeps the same track ID.
+ *
+ * A box belongs to the track of the same kind whose last box it overlaps most, as the intersection over
+ * union of the two, if that is at least TRACKER_MIN_IOU. The pairs are matched greedily, the pair that
+ * overlaps most first. A box that matches no track starts a new one, and a track that matches no box for
+ * TRACKER_MAX_MISSED runs in a row is dropped.
+ */
+
+#ifndef BOX_TRACKER_H
+#define BOX_TRACKER_H
+
+#include "frame_metadata.h"
+
+#include <cstdint>  /* for std::uint32_t */
+#include <vector>   /* for std::vector */
+
+// How much a box has to overlap the last box of a track to belong to it, as intersection over union.
+#define TRACKER_MIN_IOU 0.3
+// How many runs of the detectors in a row a track can go without a box before it is dropped.
+#define TRACKER_MAX_MISSED 3
+
+
+class Box_tracker {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     */
+    Box_tracker();
+
+    /**
+     * This function assigns the boxes found by a run of the detectors to the tracks.
+     *
+     * @param std::vector<Metadata_box>& boxes - The boxes, their track_id is set.
+     */
+    void update(std::vector<Metadata_box>& boxes);
+
+    /**
+     * This function drops all the tracks, for when the detectors are turned off.
+     * The track IDs are not reused.
+     */
+    void reset();
+
+    /**
+     * @return double - The intersection over union of two boxes, from 0 to 1.
+     */
+    static double iou(const Metadata_box& first, const Metadata_box& second);
+
+  private:
+    /**
+     * A person or face that is being followed.
+     */
+    struct Track {
+        Metadata_box box;   // Its box in the last run it was found in.
+        int missed;         // How many runs in a row it was not found in.
+    };
+
+    std::vector<Track> tracks;   // The tracks that are being followed.
+    std::uint32_t next_id;       // The ID of the next new track.
+};
+
+
+#endif  /* BOX_TRACKER_H */
@@ -12,14 +12,20 @@
  */
 
 #include "low_level_cctv_daemon_apis.h"
-#include "write_message.h"
+#include "event_bus.h"
 #include "camera.hpp"
+#include "livestream_protocol.h"
+#include "async_log.h"
 #include <opencv2/imgcodecs.hpp>
-#include <sys/stat.h>   /* for mkdir() */
+#include <opencv2/imgproc.hpp>
+#include <sys/stat.h>   /* for mkdir(), stat() */
 #include <sys/types.h>  /* for permissions constatnts */
+#include <unistd.h>     /* for access() */
+#include <cstdio>       /* for FILE, fopen(), fwrite(), fclose(), rename() */
 #include <syslog.h>     /* for syslog() */
 #include <string>       /* for std::string, std::to_string() */
-#include <cstring>      /* for strerror() */
+#include <cstring>      /* for strerror(), memcpy(), memset(), strncpy() */
+#include <algorithm>    /* for std::min(), std::max(), std::upper_bound(), std::find_if() */
 #include <errno.h>      /* for errno */
 
 using std::string;
@@ -66,14 +72,38 @@ Camera::Camera(int cameraID)
     this->cameraID = cameraID; 
 
     recording = false;
+    framesPublished = 0;
+    framesSkipped = 0;
+    streamRequestTime = 0;
+    streamTileSize = cv::Size(0, 0);
+    streamForceKeyframe = true;
+    streamKeyframeRequest = 0;
+    lastPublishedSequence = 0;
+    framesSinceKeyframe = 0;
+    keyframesPublished = 0;
+    bytesPublished = 0;
+    firstUnsavedSequence = 0;
+    streamTimeShiftRequest = 0;
+    timeShifting = false;
+    timeShiftPosition = 0;
+    timeShiftClock = 0;
+    timeShiftSpeed = 1;
+    humanFound = false;
+    faceFound = false;
+    framesSinceDetection = 0;
+    statsStartTime = 0;
+    statsFrames = 0;
+    statsDetectionTime = 0;
+    recordingCaptureTime = 0;
+    recordingTypes = 0;
+    recordingBoxes = 0;
+    recordingConfidence = 0;
     streamDir = "/tmp/SmartCCTV_livestream/camera" + std::to_string(cameraID) + "/";
     videoSaveDir = daemon_data.home_directory;
     videoSaveDir += "/SmartCCTV_recordings/camera" + std::to_string(cameraID) + "/";
 
     if (mkpath(videoSaveDir, 17, S_IRWXU) == -1) {
-        string message = "SmartCCTV could not create ";
-        message += videoSaveDir;
-        write_message(message);
+        post_error(ERROR_PERMISSION_DENIED, SOURCE_DAEMON, cameraID, videoSaveDir);
 
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
@@ -82,21 +112,20 @@ Camera::Camera(int cameraID)
     }
 
     if (mkpath(streamDir, 5, S_IRWXU) == -1) {
-        string message = "SmartCCTV could not create the live stream.";
-        write_message(message);
+        post_error(ERROR_PERMISSION_DENIED, SOURCE_DAEMON, cameraID, streamDir);
 
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
     } else {
         syslog(log_facility | LOG_NOTICE, "Creating %s", streamDir.c_str());
     }
+    // The LiveStream Viewer shows every camera directory that has an active marker.
+    mark_camera_active(streamDir);
 	
     cap.open(cameraID);
     if (!cap.isOpened())
    	{
-        string message = "SmartCCTV failed to open camera";
-        message += to_string(cameraID);
-        write_message(message);
+        post_error(ERROR_CAMERA_OPEN_FAILED, SOURCE_DAEMON, cameraID, "camera" + to_string(cameraID));
 
         syslog(log_facility | LOG_ERR, "Failed to open camera%d", cameraID);
 
@@ -105,6 +134,16 @@ Camera::Camera(int cameraID)
     } else {
         syslog(log_facility | LOG_NOTICE, "Creating camera%d", cameraID);
     }
+
+    // The detections are still recorded as videos if the store cannot be opened.
+    detectionStore.open(string(daemon_data.home_directory) + DETECTION_STORE_DIR);
+    // The continuous recording is off until it is turned on, it is not fatal if its directory cannot be created.
+    segmentRecorder.open(videoSaveDir + SEGMENT_DIR, cameraID);
+    clipEncoder.start();
+    set_snapshot_directory(videoSaveDir + SNAPSHOT_DIR);
+
+    // Any number of clients can watch the camera over HTTP, it is not fatal if that fails.
+    mjpegServer.start(MJPEG_BASE_PORT + cameraID);
 }
 
 
@@ -114,15 +153,40 @@ Camera::Camera(std::string readFilePath)
 
     cameraID = -1;
     recording = false;
-
-    streamDir = "/tmp/SmartCCTV_livestream/camera" + std::to_string(0) + "/";
+    framesPublished = 0;
+    framesSkipped = 0;
+    streamRequestTime = 0;
+    streamTileSize = cv::Size(0, 0);
+    streamForceKeyframe = true;
+    streamKeyframeRequest = 0;
+    lastPublishedSequence = 0;
+    framesSinceKeyframe = 0;
+    keyframesPublished = 0;
+    bytesPublished = 0;
+    firstUnsavedSequence = 0;
+    streamTimeShiftRequest = 0;
+    timeShifting = false;
+    timeShiftPosition = 0;
+    timeShiftClock = 0;
+    timeShiftSpeed = 1;
+    humanFound = false;
+    faceFound = false;
+    framesSinceDetection = 0;
+    statsStartTime = 0;
+    statsFrames = 0;
+    statsDetectionTime = 0;
+    recordingCaptureTime = 0;
+    recordingTypes = 0;
+    recordingBoxes = 0;
+    recordingConfidence = 0;
+
+    //A video file has directories of its own, so it never writes into those of a camera that is running
+    streamDir = "/tmp/SmartCCTV_livestream/" DETECTION_FILE_CAMERA_DIR "/";
     videoSaveDir = daemon_data.home_directory;
-    videoSaveDir += "/SmartCCTV_recordings/camera" + std::to_string(0) + "/";
+    videoSaveDir += "/SmartCCTV_recordings/" DETECTION_FILE_CAMERA_DIR "/";
 
     if (mkpath(videoSaveDir, 17, S_IRWXU) == -1) {
-        string message = "SmartCCTV could not create ";
-        message += videoSaveDir;
-        write_message(message);
+        post_error(ERROR_PERMISSION_DENIED, SOURCE_DAEMON, cameraID, videoSaveDir);
 
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
@@ -131,21 +195,19 @@ Camera::Camera(std::string readFilePath)
     }
 
     if (mkpath(streamDir, 5, S_IRWXU) == -1) {
-        string message = "SmartCCTV could not create the live stream.";
-        write_message(message);
+        post_error(ERROR_PERMISSION_DENIED, SOURCE_DAEMON, cameraID, streamDir);
 
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
     } else {
         syslog(log_facility | LOG_NOTICE, "Creating %s", streamDir.c_str());
     }
+    mark_camera_active(streamDir);
     
     cap.open(readFilePath);
     if (!cap.isOpened())
     {
-        string message = "SmartCCTV failed to open ";
-        message += readFilePath;
-        write_message(message);
+        post_error(ERROR_CAMERA_OPEN_FAILED, SOURCE_DAEMON, cameraID, readFilePath);
 
         syslog(log_facility | LOG_ERR, "Failed to open media file %s", readFilePath.c_str());
 
@@ -153,81 +215,453 @@ Camera::Camera(std::string readFilePath)
         terminate_daemon(0);
     } else {
         syslog(log_facility | LOG_NOTICE, "Opening media file %s", readFilePath.c_str());
+        clock.use_media_time(readFilePath, cap);
     }
+
+    detectionStore.open(string(daemon_data.home_directory) + DETECTION_STORE_DIR);
+    segmentRecorder.open(videoSaveDir + SEGMENT_DIR, cameraID);
+    clipEncoder.start();
+    set_snapshot_directory(videoSaveDir + SNAPSHOT_DIR);
+
+    // Any number of clients can watch the media file over HTTP, it is not fatal if that fails.
+    // It is served on any free port, the port of camera 0 may be taken. The port is written to the syslog.
+    mjpegServer.start(0);
 }
 
 
-void Camera::clearExpiredFrames()
+void Camera::clearExpiredFrames(std::int64_t now)
 {
-	auto now = std::chrono::high_resolution_clock::now();
-	for(size_t i = 0; i < frameBackCapture.size(); i++)
+	while(!frameBackCapture.empty())
 	{
-		auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - frameBackCapture[i].start);
-		if(duration.count() > 10)
+		//Whole seconds, the frames up to CAMERA_PRE_ROLL_SECONDS + 1 old are kept
+		if((now - frameBackCapture.front().captureTime) / 1000000 <= CAMERA_PRE_ROLL_SECONDS)
 		{
-			frameBackCapture.erase(frameBackCapture.begin() + i);
-			i--;
+			return;
 		}
-		else
+		frameBackCapture.pop_front();
+	}
+}
+
+
+void Camera::markStreamChanges(const cv::Mat* motionMask)
+{
+	// Without the pixels that changed, the next frame has to be a keyframe.
+	if(motionMask == nullptr || motionMask->empty())
+	{
+		streamForceKeyframe = true;
+		return;
+	}
+
+	// The mask is collected over every frame since the last published one, since frames are skipped
+	// while the viewer is busy.
+	if(streamDirtyMask.size() != motionMask->size())
+	{
+		motionMask->copyTo(streamDirtyMask);
+		streamForceKeyframe = true;
+	}
+	else
+	{
+		cv::bitwise_or(streamDirtyMask, *motionMask, streamDirtyMask);
+	}
+}
+
+
+bool Camera::isTileDirty(int column, int row, cv::Size frameSize)
+{
+	// The published frame may be downscaled, the mask is always at the captured resolution.
+	int left = column * LIVESTREAM_TILE_SIZE * streamDirtyMask.cols / frameSize.width;
+	int top = row * LIVESTREAM_TILE_SIZE * streamDirtyMask.rows / frameSize.height;
+	int right = std::min((column + 1) * LIVESTREAM_TILE_SIZE, frameSize.width) * streamDirtyMask.cols / frameSize.width;
+	int bottom = std::min((row + 1) * LIVESTREAM_TILE_SIZE, frameSize.height) * streamDirtyMask.rows / frameSize.height;
+	if(right <= left || bottom <= top)
+	{
+		return true;
+	}
+	return cv::countNonZero(streamDirtyMask(cv::Rect(left, top, right - left, bottom - top))) > 0;
+}
+
+
+void Camera::saveToStream(Resize_cache& frames, std::uint64_t x, std::int64_t captureTime, std::uint32_t timeShift, const Frame_metadata& metadata, const Camera_config& config)
+{
+	// The LiveStream Viewer deletes a frame as soon as it has read it.
+	// While the last published frame is still there the viewer is busy, so publishing now would
+	// only queue up a frame that is already stale by the time it gets shown.
+	// Skipping here paces the daemon to the viewer's actual presentation rate.
+	if(!lastPublishedFrame.empty() && access(lastPublishedFrame.c_str(), F_OK) == 0)
+	{
+		framesSkipped++;
+		return;
+	}
+
+	// The viewer shows this camera in a tile of its mosaic, so there is no point in publishing more pixels
+	// than the tile has. Downscaling here also makes writing, and then decoding, the frame much cheaper.
+	// The resize is shared with the MJPEG clients watching at the same resolution.
+	cv::Mat frame = frames.get(streamTileSize);
+	if(!frame.isContinuous() || frame.type() != CV_8UC3)
+	{
+		async_log(log_facility | LOG_ERR, "Error: Unexpected live stream frame format %d", frame.type());
+		return;
+	}
+
+	// Only the tiles that changed since the last published frame are sent.
+	// Nothing is known about what the viewer has after a resize, or when it asked for a keyframe.
+	bool keyframe = streamForceKeyframe || streamDirtyMask.empty() || frame.size() != lastPublishedSize
+	                || framesSinceKeyframe + 1 >= (std::uint64_t) config.stream_keyframe_interval;
+
+	int columns = (frame.cols + LIVESTREAM_TILE_SIZE - 1) / LIVESTREAM_TILE_SIZE;
+	int rows = (frame.rows + LIVESTREAM_TILE_SIZE - 1) / LIVESTREAM_TILE_SIZE;
+	std::vector<Livestream_tile_index> tiles;
+	tiles.reserve(columns * rows);
+	size_t pixelBytes = 0;
+	for(int row = 0; row < rows; row++)
+	{
+		for(int column = 0; column < columns; column++)
 		{
-			return;
+			if(keyframe || isTileDirty(column, row, frame.size()))
+			{
+				Livestream_tile_index tile = { (std::uint16_t) column, (std::uint16_t) row };
+				tiles.push_back(tile);
+				pixelBytes += (size_t) std::min(LIVESTREAM_TILE_SIZE, frame.cols - column * LIVESTREAM_TILE_SIZE)
+				              * std::min(LIVESTREAM_TILE_SIZE, frame.rows - row * LIVESTREAM_TILE_SIZE) * 3;
+			}
+		}
+	}
+
+	Livestream_frame_header header;
+	memcpy(header.magic, LIVESTREAM_FRAME_MAGIC, sizeof(header.magic));
+	header.version = LIVESTREAM_FRAME_VERSION;
+	header.sequence = x;
+	header.base_sequence = keyframe ? x : lastPublishedSequence;
+	header.capture_time_us = captureTime;
+	header.width = frame.cols;
+	header.height = frame.rows;
+	header.tile_size = LIVESTREAM_TILE_SIZE;
+	header.tile_count = tiles.size();
+	header.keyframe = keyframe ? 1 : 0;
+	header.time_shift_ms = timeShift;
+	// The outlines are drawn by the viewer, scaled to the frame it is sent.
+	streamBoxes.clear();
+	if(config.enable_outlines)
+	{
+		cv::Size capturedSize = frames.get(cv::Size()).size();
+		scale_metadata_boxes(metadata.boxes, capturedSize.width, capturedSize.height, frame.cols, frame.rows, streamBoxes);
+	}
+	header.box_count = streamBoxes.size();
+	header.motion = config.enable_outlines ? metadata.motion : METADATA_MOTION_UNKNOWN;
+
+	// The whole file is put together in a re-used buffer, and written with a single call.
+	size_t indexBytes = tiles.size() * sizeof(Livestream_tile_index);
+	size_t boxBytes = streamBoxes.size() * sizeof(Metadata_box);
+	streamBuffer.resize(sizeof(header) + indexBytes + pixelBytes + boxBytes);
+	char* output = streamBuffer.data();
+	memcpy(output, &header, sizeof(header));
+	output += sizeof(header);
+	if(indexBytes > 0)
+	{
+		memcpy(output, tiles.data(), indexBytes);
+		output += indexBytes;
+	}
+	for(const Livestream_tile_index& tile : tiles)
+	{
+		int tileWidth = 0;
+		int tileHeight = 0;
+		livestream_tile_size(header, tile, tileWidth, tileHeight);
+		for(int y = 0; y < tileHeight; y++)
+		{
+			const uchar* source = frame.ptr<uchar>(tile.row * LIVESTREAM_TILE_SIZE + y) + tile.column * LIVESTREAM_TILE_SIZE * 3;
+			memcpy(output, source, tileWidth * 3);
+			output += tileWidth * 3;
+		}
+	}
+	if(boxBytes > 0)
+	{
+		memcpy(output, streamBoxes.data(), boxBytes);
+	}
+
+	// Write under a hidden name and rename into place, so the viewer never opens a half written frame.
+	std::string temporaryFileName = streamDir + livestream_temporary_frame_name;
+	FILE* temporaryFile = fopen(temporaryFileName.c_str(), "w");
+	if(temporaryFile == nullptr)
+	{
+		async_log(log_facility | LOG_ERR, "Error: Could not write the live stream frame %s : %m", temporaryFileName.c_str());
+		return;
+	}
+	size_t written = fwrite(streamBuffer.data(), 1, streamBuffer.size(), temporaryFile);
+	if(fclose(temporaryFile) != 0 || written != streamBuffer.size())
+	{
+		async_log(log_facility | LOG_ERR, "Error: Could not write the live stream frame %s", temporaryFileName.c_str());
+		return;
+	}
+
+	std::string imageFileName = streamDir + make_frame_file_name(x, captureTime);
+	if(rename(temporaryFileName.c_str(), imageFileName.c_str()) == -1)
+	{
+		async_log(log_facility | LOG_ERR, "Error: Could not publish the live stream frame %s : %m", imageFileName.c_str());
+		return;
+	}
+
+	lastPublishedFrame = imageFileName;
+	lastPublishedSequence = x;
+	lastPublishedSize = frame.size();
+	streamForceKeyframe = false;
+	framesSinceKeyframe = keyframe ? 0 : framesSinceKeyframe + 1;
+	if(!streamDirtyMask.empty())
+	{
+		streamDirtyMask.setTo(0);
+	}
+
+	framesPublished++;
+	bytesPublished += streamBuffer.size();
+	if(keyframe)
+	{
+		keyframesPublished++;
+	}
+	if(framesPublished % 1000 == 0)
+	{
+		async_log(log_facility | LOG_NOTICE, "Live stream: %llu frames published (%llu keyframes), %llu bytes per frame on average, %llu skipped while the viewer was busy, %llu resizes",
+		       (unsigned long long) framesPublished, (unsigned long long) keyframesPublished,
+		       (unsigned long long) (bytesPublished / framesPublished), (unsigned long long) framesSkipped,
+		       (unsigned long long) streamFrames.resizes());
+	}
+}
+
+
+void Camera::updateStreamRequest()
+{
+	// The request file is only re-read when the viewer has written a new one.
+	struct stat requestStatus;
+	std::string requestFileName = streamDir + livestream_request_file_name;
+	if(stat(requestFileName.c_str(), &requestStatus) == -1)
+	{
+		streamRequestTime = 0;
+		streamTileSize = cv::Size(0, 0);
+		return;
+	}
+
+	std::int64_t modifiedTime = (std::int64_t) requestStatus.st_mtim.tv_sec * 1000000000 + requestStatus.st_mtim.tv_nsec;
+	if(modifiedTime == streamRequestTime)
+	{
+		return;
+	}
+	streamRequestTime = modifiedTime;
+
+	Livestream_request request;
+	if(read_livestream_request(streamDir, request))
+	{
+		if(streamTileSize != cv::Size(request.tile_width, request.tile_height))
+		{
+			streamTileSize = cv::Size(request.tile_width, request.tile_height);
+			async_log(log_facility | LOG_NOTICE, "Live stream tile size is now %dx%d", request.tile_width, request.tile_height);
 		}
+		// The viewer missed a frame, so the frames it gets next do not fit onto what it has.
+		if(request.keyframe_request != streamKeyframeRequest)
+		{
+			streamKeyframeRequest = request.keyframe_request;
+			streamForceKeyframe = true;
+		}
+		if(request.time_shift_speed >= 1 && request.time_shift_speed <= 4)
+		{
+			timeShiftSpeed = request.time_shift_speed;
+		}
+		// The viewer moved in time, replaying starts over from the new position.
+		if(request.time_shift_request != streamTimeShiftRequest)
+		{
+			streamTimeShiftRequest = request.time_shift_request;
+			//The replay moves on the clock the frames were captured on
+			std::int64_t now = frameBackCapture.empty() ? 0 : frameBackCapture.back().captureTime;
+			if(request.time_shift_offset_ms > 0)
+			{
+				timeShifting = true;
+				timeShiftPosition = now - (std::int64_t) request.time_shift_offset_ms * 1000;
+				timeShiftClock = now;
+				async_log(log_facility | LOG_NOTICE, "Live stream is replaying from %d ms ago at %dx", request.time_shift_offset_ms, timeShiftSpeed);
+			}
+			else if(timeShifting)
+			{
+				timeShifting = false;
+				// The viewer has a replayed frame, the live frames are not based on it.
+				streamForceKeyframe = true;
+				async_log(log_facility | LOG_NOTICE, "Live stream is back to the live picture");
+			}
+		}
+	}
+}
+
+
+const frameContainer* Camera::timeShiftFrame(std::int64_t now)
+{
+	if(!timeShifting)
+	{
+		return nullptr;
+	}
+
+	// The replay moves through the history timeShiftSpeed times faster than real time.
+	timeShiftPosition += (now - timeShiftClock) * timeShiftSpeed;
+	timeShiftClock = now;
+	if(frameBackCapture.empty() || timeShiftPosition >= frameBackCapture.back().captureTime)
+	{
+		// The replay caught up with the live picture.
+		timeShifting = false;
+		streamForceKeyframe = true;
+		async_log(log_facility | LOG_NOTICE, "Live stream replay caught up with the live picture");
+		return nullptr;
+	}
+
+	// The history is in the order the frames were captured, so the newest frame captured at or before the
+	// position is found with a binary search. The frame is published straight from the history.
+	auto next = std::upper_bound(frameBackCapture.begin(), frameBackCapture.end(), timeShiftPosition,
+	                             [](std::int64_t position, const frameContainer& container) { return position < container.captureTime; });
+	if(next == frameBackCapture.begin())
+	{
+		// The viewer asked for more than the history holds, so the replay starts at its oldest frame.
+		timeShiftPosition = next->captureTime;
+		return &*next;
 	}
+	return &*(next - 1);
 }
 
 
-void Camera::saveToStream(cv::Mat frame, int x)
+void Camera::postStats(std::uint64_t x, std::int64_t now)
 {
-	std::string imageFileName = streamDir + std::to_string(x) + ".bmp";
-	imwrite(imageFileName, frame);
+	//The first call only starts the interval
+	if(statsStartTime != 0 && statsFrames > 0)
+	{
+		Event stats = make_event(EVENT_CAMERA_STATS, SOURCE_DAEMON, cameraID);
+		stats.frames_per_second = statsFrames * 1000000.0f / (now - statsStartTime);
+		stats.detection_ms = statsDetectionTime / 1000.0f / statsFrames;
+		stats.frames_captured = (std::uint32_t) x;
+		stats.frames_streamed = (std::uint32_t) framesPublished;
+		stats.frames_skipped = (std::uint32_t) framesSkipped;
+		post_event(stats);
+	}
+	statsStartTime = now;
+	statsFrames = 0;
+	statsDetectionTime = 0;
 }
 
 
-void Camera::saveFrameToBuffer(cv::Mat frame)
+void Camera::saveFrameToBuffer(Shared_frame frame)
 {
 	frameContainer container;
-	container.frame = frame.clone();
-	container.start = std::chrono::high_resolution_clock::now();
-	frameBackCapture.push_back(container);
+	container.sequence = frame->sequence();
+	container.captureTime = frame->capture_time_us();
+	container.frame = std::move(frame);
+	frameBackCapture.push_back(std::move(container));
 }
 
 
 void Camera::saveVideo()
 {
-	if(frameBackCapture.size() < 1)
+	// The frames are kept after they are saved, so the LiveStream Viewer can still replay them.
+	// Only the frames that are not in an earlier video are saved.
+	auto firstUnsaved = std::find_if(frameBackCapture.begin(), frameBackCapture.end(),
+	                                 [this](const frameContainer& container) { return container.sequence >= firstUnsavedSequence; });
+	if(firstUnsaved == frameBackCapture.end())
 	{
 		//Trying to write an empty video, this is an error state
-        string message = "SmartCCTV: something has gone wrong with saving the video.";
-        write_message(message);
+        post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, cameraID);
 
-		syslog(log_facility | LOG_ERR, "Error: Attempting to save empty video");
+		async_log(log_facility | LOG_ERR, "Error: Attempting to save empty video");
         return;
 	}
 	
-	auto point = std::chrono::high_resolution_clock::now();
-	auto s = std::chrono::duration_cast<std::chrono::seconds>(point.time_since_epoch());
-	std::time_t t = s.count();
+	//The video is encoded on the threads of the clip encoder, the frames are handed over without copying them
+	//The video is named after the time of its last frame, on the clock of the camera
+	std::shared_ptr<const Camera_config> config = current_camera_config();
+	std::int64_t lastCaptureTime = frameBackCapture.back().captureTime;
+	std::time_t t = lastCaptureTime / 1000000;
 	std::string videoFileName = std::ctime(&t);
 	videoFileName.pop_back();
-	videoFileName.append(".avi");
-	std::string fullVideoString = videoSaveDir + videoFileName;
-	cv::VideoWriter video(fullVideoString, CV_FOURCC('M','J','P','G'), 10, cv::Size(frameBackCapture[0].frame.cols, frameBackCapture[0].frame.rows));
+	videoFileName.append(clipEncoder.extension(config->recording_codec));
 	
-	for(size_t i = 0; i < frameBackCapture.size(); i++)
+	//The tracks of the people and faces in the video are indexed, so they can be found without opening it
+	Clip_job job;
+	const cv::Mat& firstImage = firstUnsaved->frame->image();
+	Track_summarizer tracks(firstImage.cols, firstImage.rows);
+	for(auto i = firstUnsaved; i != frameBackCapture.end(); i++)
 	{
-		video.write(frameBackCapture[i].frame);
+		tracks.add_frame((std::uint32_t) job.frames.size(), i->captureTime, i->frame->metadata());
+		job.frames.push_back(i->frame);
+	}
+	job.jpeg_quality = config->recording_jpeg_quality;
+	job.path = videoSaveDir + videoFileName;
+	job.camera = cameraID;
+	job.codec = config->recording_codec;
+	job.preset = config->recording_preset;
+	job.bitrate_kbps = config->recording_bitrate_kbps;
+	if(!clipEncoder.submit(std::move(job)))
+	{
+        post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, cameraID, videoFileName);
+
+		async_log(log_facility | LOG_ERR, "Error: Could not queue the video %s", videoFileName.c_str());
+		return;
+	}
+	firstUnsavedSequence = frameBackCapture.back().sequence + 1;
+
+	Detection_record detection;
+	memset(&detection, 0, sizeof(detection));
+	detection.time_us = recordingCaptureTime;
+	detection.duration_ms = (std::int32_t) ((lastCaptureTime - recordingCaptureTime) / 1000);
+	detection.camera = (std::int16_t) cameraID;
+	detection.types = recordingTypes;
+	detection.box_count = recordingBoxes;
+	detection.confidence = recordingConfidence;
+	strncpy(detection.clip, videoFileName.c_str(), sizeof(detection.clip) - 1);
+	detectionStore.append(detection);
+	detectionStore.append_tracks(tracks.finish(cameraID, videoFileName));
+}
+
+
+void Camera::findBoxes()
+{
+	//The boxes of a run are kept for the frames until the next run, with the IDs of the tracks they belong to
+	detectedBoxes.clear();
+	for(int kind : { METADATA_BOX_HUMAN, METADATA_BOX_FACE })
+	{
+		const std::vector<cv::Rect>& found = kind == METADATA_BOX_HUMAN ? humanFilter.getBoxes() : faceFilter.getBoxes();
+		for(const cv::Rect& rect : found)
+		{
+			cv::Rect inside = rect & cv::Rect(0, 0, UINT16_MAX, UINT16_MAX);
+			Metadata_box box = {};
+			box.x = inside.x;
+			box.y = inside.y;
+			box.width = inside.width;
+			box.height = inside.height;
+			box.kind = kind;
+			detectedBoxes.push_back(box);
+		}
+	}
+	boxTracker.update(detectedBoxes);
+}
+
+
+void Camera::noteDetection(const Camera_config& config, bool motionDetected)
+{
+	//What the detectors found while recording, the last results are kept between the runs of the detectors
+	if(config.enable_human_detection)
+	{
+		if(humanFound)
+		{
+			recordingTypes |= DETECTION_HUMAN;
+			recordingConfidence = std::max(recordingConfidence, (float) humanFilter.getConfidence());
+		}
+		if(faceFound)
+		{
+			recordingTypes |= DETECTION_FACE;
+		}
+		std::uint16_t boxes = (std::uint16_t) std::min<size_t>(humanFilter.getBoxCount() + faceFilter.getBoxCount(), UINT16_MAX);
+		recordingBoxes = std::max(recordingBoxes, boxes);
+	}
+	if(config.enable_motion_detection && motionDetected)
+	{
+		recordingTypes |= DETECTION_MOTION;
 	}
-	
-	syslog(log_facility | LOG_NOTICE, "Saved a video %s", fullVideoString.c_str());
-	frameBackCapture.clear();
 }
 
 
-void Camera::checkRecordingLength()
+void Camera::checkRecordingLength(std::int64_t now)
 {
-	auto now = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - recordingStartTime);
-	if(duration.count() > 15)
+	if((now - recordingCaptureTime) / 1000000 > CAMERA_RECORDING_SECONDS)
 	{
 		recording = false;
 		saveVideo();
@@ -241,6 +675,11 @@ void Camera::finalize()
 	{
 		saveVideo();	
 	}
+	segmentRecorder.close();
+	//The videos that are still being encoded are finished before the daemon exits
+	clipEncoder.stop();
+	mjpegServer.stop();
+	unmark_camera_active(streamDir);
     	cap.release();
 	cv::destroyAllWindows();
 }
@@ -248,48 +687,128 @@ void Camera::finalize()
 
 void Camera::record()
 {
-	syslog(log_facility | LOG_NOTICE, "Camera recording.");
+	async_log(log_facility | LOG_NOTICE, "Camera recording.");
 
-	int x = 0;
+	std::uint64_t x = 0;
 	cv::Mat frame;
 	while(true)
 	{
-		if(!recording)
+		cap >> frame;
+		//A signal to terminate only sets a flag, the daemon is terminated after this returns, between two frames
+		if(termination_requested())
 		{
-			clearExpiredFrames();
+			async_log(log_facility | LOG_NOTICE, "Camera %d stops recording, the daemon is terminating.", cameraID);
+			return;
 		}
+		std::int64_t captureTime = clock.frame_time(cap, x);
 		
-		cap >> frame;
+		if(!recording)
+		{
+			clearExpiredFrames(captureTime);
+		}
 		
 		if(frame.empty())
 		{
-            string message = "SmartCCTV encountered an error.";
-            write_message(message);
+            post_error(ERROR_CORRUPT_FRAME, SOURCE_DAEMON, cameraID);
 
-			syslog(log_facility | LOG_ERR, "Error: Corrupt frame on camera %d", cameraID);
+			async_log(log_facility | LOG_ERR, "Error: Corrupt frame on camera %d", cameraID);
 
 			daemon_data.daemon_exit_status = EXIT_FAILURE;
     	    terminate_daemon(0);
 		}
 		
+		//The settings can be changed through the control socket at any time
+		//The config loaded here is used for the whole frame, and is never changed underneath it
+		std::shared_ptr<const Camera_config> config = current_camera_config();
+		
 		//syslog(log_facility | LOG_NOTICE, "Running Recognition and Detection.");
+		std::int64_t detectionStart = livestream_now_us();
 		bool motionDetected = true;
-		bool humanFound = true;
-		bool faceFound = true;
-		if(daemon_data.enable_human_detection)
+		const cv::Mat* motionMask = nullptr;
+		if(config->enable_human_detection)
+		{
+			//The detectors are the slowest part of the loop, between runs their last result is kept
+			if(framesSinceDetection % config->detection_stride == 0)
+			{
+				humanFound = humanFilter.runRecognition(frame, *config);
+				faceFound = faceFilter.runRecognition(frame, *config);
+				findBoxes();
+			}
+			framesSinceDetection++;
+		}
+		else
+		{
+			humanFound = true;
+			faceFound = true;
+			framesSinceDetection = 0;
+			detectedBoxes.clear();
+			boxTracker.reset();
+		}
+		if(config->enable_motion_detection)
+		{
+			motionDetected = motionFilter.runDetection(frame, *config);
+			motionMask = &motionFilter.getMotionMask();
+		}
+		std::int64_t detectionEnd = livestream_now_us();
+		statsDetectionTime += detectionEnd - detectionStart;
+		statsFrames++;
+		if(detectionEnd - statsStartTime >= CAMERA_STATS_INTERVAL_US)
 		{
-			humanFound = humanFilter.runRecognition(frame);
-			faceFound = faceFilter.runRecognition(frame);
+			postStats(x, detectionEnd);
 		}
-		if(daemon_data.enable_motion_detection)
+		
+		//Nothing is drawn into the frame, what the detectors found goes with it and is drawn when it is shown
+		Frame_metadata metadata;
+		metadata.boxes = detectedBoxes;
+		if(config->enable_motion_detection)
 		{
-			motionDetected = motionFilter.runDetection(frame);
+			metadata.motion = motionDetected ? METADATA_MOTION_FOUND : METADATA_MOTION_NONE;
 		}
 		
+		//The frame is shared from here on by the history, the live stream, the recordings and the snapshots
+		//Each of them that wants it as a JPEG gets the same encoding, made the first time it is asked for
+		//The next frame is captured into a new buffer, so this one is handed over without copying it
+		Shared_frame captured = std::make_shared<Captured_frame>(frame, x, captureTime, std::move(metadata));
+		frame.release();
+		publish_latest_frame(captured);
+		
+		// Every resolution the live stream is watched at is resized from this frame at most once.
+		streamFrames.set_frame(captured->image());
 		if(daemon_data.is_live_stream_running)
 		{
 			//syslog(log_facility | LOG_NOTICE, "Saving frame to livestream dir");
-			saveToStream(frame, x);
+			markStreamChanges(motionMask);
+			updateStreamRequest();
+			const frameContainer* replayed = timeShiftFrame(captureTime);
+			if(replayed != nullptr)
+			{
+				// The changes are only known between live frames, so every replayed frame is a keyframe.
+				timeShiftFrames.set_frame(replayed->frame->image());
+				streamForceKeyframe = true;
+				saveToStream(timeShiftFrames, x, replayed->captureTime, (std::uint32_t) ((captureTime - replayed->captureTime) / 1000), replayed->frame->metadata(), *config);
+			}
+			else
+			{
+				saveToStream(streamFrames, x, captureTime, 0, captured->metadata(), *config);
+			}
+		}
+		else
+		{
+			lastPublishedFrame.clear();
+			// A viewer that starts up later has nothing to put the tiles on.
+			streamForceKeyframe = true;
+			timeShifting = false;
+		}
+		mjpegServer.publish(streamFrames, *captured, config->stream_jpeg_quality);
+		
+		//The continuous recording does not depend on what was detected
+		if(config->segment_recording)
+		{
+			segmentRecorder.write(*captured, *config);
+		}
+		else
+		{
+			segmentRecorder.close();
 		}
 		 
 		if((humanFound || faceFound) && motionDetected)
@@ -297,18 +816,23 @@ void Camera::record()
 			if(!recording)
 			{
 				//DETECTION EVENT!!!
-				recordingStartTime = std::chrono::high_resolution_clock::now();
 				recording = true;
+				recordingCaptureTime = captureTime;
+				recordingTypes = 0;
+				recordingBoxes = 0;
+				recordingConfidence = 0;
+				post_event(make_event(EVENT_DETECTION_STARTED, SOURCE_DAEMON, cameraID));
 				//syslog(log_facility | LOG_NOTICE, "Human found!!!");
 			}
 		}
 		
 		if(recording)
 		{
-			checkRecordingLength();
+			noteDetection(*config, motionDetected);
+			checkRecordingLength(captureTime);
 		}
 		
-		saveFrameToBuffer(frame);
+		saveFrameToBuffer(std::move(captured));
 		x++;
 		//syslog(log_facility | LOG_NOTICE, "Through the loop...");
 	}
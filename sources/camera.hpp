@@ -15,11 +15,21 @@
 #define CAMERA_HPP
 
 #include <vector>
-#include <chrono>
+#include <deque>
+#include <cstdint>
 #include <syslog.h>  /* for syslog() */
 #include "humanFilter.hpp"
 #include "faceFilter.hpp"
 #include "motionFilter.hpp"
+#include "mjpeg_server.h"
+#include "resize_cache.h"
+#include "camera_config.h"
+#include "detection_store.h"
+#include "segment_recorder.h"
+#include "clip_encoder.h"
+#include "captured_frame.h"
+#include "box_tracker.h"
+#include "camera_clock.h"
 #define log_facility LOG_LOCAL0
 
 //using namespace std;
@@ -27,8 +37,9 @@
 
 struct frameContainer
 {
-	cv::Mat frame;
-	std::chrono::time_point<std::chrono::high_resolution_clock> start;
+	Shared_frame frame;
+	std::uint64_t sequence;
+	std::int64_t captureTime;
 };
 
 class Camera
@@ -42,20 +53,67 @@ class Camera
 	private:
 	int cameraID;
 	bool recording;
-	std::vector<frameContainer> frameBackCapture;
+	std::deque<frameContainer> frameBackCapture;
+	std::uint64_t firstUnsavedSequence;
 	std::string readFilePath;
 	std::string streamDir;
 	std::string videoSaveDir;
-	std::chrono::time_point<std::chrono::high_resolution_clock> recordingStartTime;
 	cv::VideoCapture cap;
-	void saveFrameToBuffer(cv::Mat frame);
-	void clearExpiredFrames();
-	void saveToStream(cv::Mat frame, int x);
+	//The time of every frame, from the wall clock for a camera and from the file for a video file
+	Camera_clock clock;
+	void saveFrameToBuffer(Shared_frame frame);
+	void clearExpiredFrames(std::int64_t now);
+	std::string lastPublishedFrame;
+	std::uint64_t framesPublished;
+	std::uint64_t framesSkipped;
+	std::int64_t streamRequestTime;
+	cv::Size streamTileSize;
+	Resize_cache streamFrames;
+	cv::Mat streamDirtyMask;
+	bool streamForceKeyframe;
+	int streamKeyframeRequest;
+	std::uint64_t lastPublishedSequence;
+	cv::Size lastPublishedSize;
+	std::uint64_t framesSinceKeyframe;
+	std::uint64_t keyframesPublished;
+	std::uint64_t bytesPublished;
+	std::vector<char> streamBuffer;
+	int streamTimeShiftRequest;
+	bool timeShifting;
+	std::int64_t timeShiftPosition;
+	std::int64_t timeShiftClock;
+	int timeShiftSpeed;
+	Resize_cache timeShiftFrames;
+	const frameContainer* timeShiftFrame(std::int64_t now);
+	void saveToStream(Resize_cache& frames, std::uint64_t x, std::int64_t captureTime, std::uint32_t timeShift, const Frame_metadata& metadata, const Camera_config& config);
+	bool humanFound;
+	bool faceFound;
+	std::uint64_t framesSinceDetection;
+	std::vector<Metadata_box> detectedBoxes;
+	Box_tracker boxTracker;
+	void findBoxes();
+	std::vector<Metadata_box> streamBoxes;
+	std::int64_t statsStartTime;
+	std::uint32_t statsFrames;
+	std::int64_t statsDetectionTime;
+	void postStats(std::uint64_t x, std::int64_t now);
+	Detection_store detectionStore;
+	std::int64_t recordingCaptureTime;
+	std::uint16_t recordingTypes;
+	std::uint16_t recordingBoxes;
+	float recordingConfidence;
+	void noteDetection(const Camera_config& config, bool motionDetected);
+	Segment_recorder segmentRecorder;
+	Clip_encoder clipEncoder;
+	void updateStreamRequest();
+	void markStreamChanges(const cv::Mat* motionMask);
+	bool isTileDirty(int column, int row, cv::Size frameSize);
 	void saveVideo();
-	void checkRecordingLength();
+	void checkRecordingLength(std::int64_t now);
 	HumanFilter humanFilter;
 	FaceFilter faceFilter;
 	MotionFilter motionFilter;
+	MJPEG_server mjpegServer;
 	const bool debug = false;
 };
 #endif
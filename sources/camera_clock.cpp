@@ -0,0 +1,79 @@
+/**
+ * File Name:   camera_clock.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Camera_clock class's methods.
+ */
+
+#include "camera_clock.h"
+#include "livestream_protocol.h"
+
+#include <sys/stat.h>  /* for stat() */
+#include <syslog.h>    /* for syslog() */
+#include <algorithm>   /* for std::max() */
+#include <cmath>       /* for std::llround() */
+
+#define log_facility LOG_LOCAL0
+
+using std::int64_t;
+using std::uint64_t;
+
+
+Camera_clock::Camera_clock()
+ : media(false), start_us(0), fps(CAMERA_DEFAULT_FPS), last_us(-1)
+{
+}
+
+
+void Camera_clock::use_media_time(const std::string& path, const cv::VideoCapture& video)
+{
+    media = true;
+    fps = media_fps(video);
+    last_us = -1;
+
+    // The file was last modified when it was done being recorded, so it starts its length before that.
+    // The frame count of some formats is an estimate, but it is the same every time the file is opened.
+    struct stat file_status;
+    int64_t modified_us = 0;
+    if (stat(path.c_str(), &file_status) == 0) {
+        modified_us = (int64_t) file_status.st_mtim.tv_sec * 1000000 + file_status.st_mtim.tv_nsec / 1000;
+    }
+    double frame_count = video.get(cv::CAP_PROP_FRAME_COUNT);
+    int64_t length_us = frame_count > 0 ? std::llround(frame_count * 1000000.0 / fps) : 0;
+    start_us = std::max<int64_t>(modified_us - length_us, 0);
+    syslog(log_facility | LOG_NOTICE, "The frames of %s are timed by the file, at %.2f fps", path.c_str(), fps);
+}
+
+
+bool Camera_clock::is_media_time() const
+{
+    return media;
+}
+
+
+int64_t Camera_clock::frame_time(const cv::VideoCapture& video, uint64_t frame)
+{
+    if (!media) {
+        return livestream_now_us();
+    }
+    // A frame the container put before the one before it, keeps the order the frames were read in.
+    last_us = std::max(start_us + media_time_us(video, frame, fps), last_us + 1);
+    return last_us;
+}
+
+
+int64_t media_time_us(const cv::VideoCapture& video, uint64_t frame, double fps)
+{
+    double position_ms = video.get(cv::CAP_PROP_POS_MSEC);
+    if (position_ms > 0) {
+        return std::llround(position_ms * 1000);
+    }
+    return std::llround(frame * 1000000.0 / fps);
+}
+
+
+double media_fps(const cv::VideoCapture& video)
+{
+    double fps = video.get(cv::CAP_PROP_FPS);
+    return fps > 0 && fps <= 1000 ? fps : CAMERA_DEFAULT_FPS;
+}
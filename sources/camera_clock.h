@@ -0,0 +1,95 @@
+/**
+ * File Name:   camera_clock.h
+ *
+ * Description:
+ * This file contains the declaration of the Camera_clock class, which gives the time of every frame the camera
+ * captures. The pre-roll and the length of the videos of the detections, their names and the times in the
+ * detection store are all measured on it.
+ *
+ * A camera is timed by the wall clock, see livestream_now_us(). A video file is timed by its frames instead:
+ * a frame is at the time the container gives it (CAP_PROP_POS_MSEC), or where the frame rate puts it when the
+ * backend does not give one, counted from the time the file starts at, its modification time less its length.
+ * A video file is read as fast as the frames can be analyzed, which is faster or slower than it was recorded,
+ * but the times of its frames are always the same, so every replay of it finds the same detections at the same
+ * times, and cuts the same frames into their videos.
+ */
+
+#ifndef CAMERA_CLOCK_H
+#define CAMERA_CLOCK_H
+
+#include <opencv2/videoio.hpp>  /* for cv::VideoCapture */
+#include <cstdint>              /* for std::uint64_t, std::int64_t */
+#include <string>               /* for std::string */
+
+// How long a detection is recorded for, in seconds of the camera clock.
+#define CAMERA_RECORDING_SECONDS 15
+// How much of the history before a detection is saved with it.
+#define CAMERA_PRE_ROLL_SECONDS 10
+// The frame rate assumed for a video file that does not have one.
+#define CAMERA_DEFAULT_FPS 25.0
+
+
+class Camera_clock {
+  public:
+    /**
+     * The constructor makes a clock that times the frames by the wall clock.
+     */
+    Camera_clock();
+
+    /**
+     * This function makes the clock time the frames by where they are in a video file.
+     *
+     * @param const std::string& path - The video file.
+     *
+     * @param const cv::VideoCapture& video - The video file, opened and not read from yet.
+     */
+    void use_media_time(const std::string& path, const cv::VideoCapture& video);
+
+    /**
+     * @return bool - true if the frames are timed by where they are in a video file.
+     */
+    bool is_media_time() const;
+
+    /**
+     * This function gives the time of the frame that was just read.
+     * The times of the frames of a video file never go backwards.
+     *
+     * @param const cv::VideoCapture& video - What the frame was read from.
+     *
+     * @param std::uint64_t frame - The index of the frame, counted from 0.
+     *
+     * @return std::int64_t - The time of the frame, in microseconds since the epoch.
+     */
+    std::int64_t frame_time(const cv::VideoCapture& video, std::uint64_t frame);
+
+  private:
+    bool media;                // Are the frames timed by where they are in a video file?
+    std::int64_t start_us;     // The time of the first frame of the file.
+    double fps;                // The frame rate of the file.
+    std::int64_t last_us;      // The time of the last frame, -1 before the first one.
+};
+
+
+/**
+ * This function gives the time of the frame that was just read from a video file, in the file.
+ *
+ * @param const cv::VideoCapture& video - The video file.
+ *
+ * @param std::uint64_t frame - The index of the frame, counted from 0.
+ *
+ * @param double fps - The frame rate of the file, for a backend that does not give the time of a frame.
+ *
+ * @return std::int64_t - The time of the frame, in microseconds from the start of the file.
+ */
+std::int64_t media_time_us(const cv::VideoCapture& video, std::uint64_t frame, double fps);
+
+
+/**
+ * @param const cv::VideoCapture& video - A video file.
+ *
+ * @return double - Its frame rate, or CAMERA_DEFAULT_FPS if it does not have one.
+ */
+double media_fps(const cv::VideoCapture& video);
+
+
+#endif  /* CAMERA_CLOCK_H */
@@ -0,0 +1,160 @@
+/**
+ * File Name:   camera_config.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions that hand out and change the Camera_config,
+ * the settings of the camera daemon that can be changed while it is running.
+ */
+
+#include "camera_config.h"
+
+#include <atomic>   /* for std::atomic_load(), std::atomic_store() */
+#include <cerrno>   /* for errno */
+#include <cmath>    /* for std::isfinite(), std::trunc() */
+#include <cstdlib>  /* for strtod(), strtol() */
+#include <cstdio>   /* for snprintf() */
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+
+/**
+ * A setting of the Camera_config that can be read and changed by name.
+ * Exactly one of the member pointers is set, depending on the type of the setting.
+ */
+struct Config_field {
+    const char* name;
+    bool Camera_config::* flag;      // An on/off setting, written as 1 or 0.
+    int Camera_config::* integer;    // A whole number setting.
+    double Camera_config::* number;  // A decimal number setting.
+    double minimum;                  // The smallest value allowed.
+    double maximum;                  // The largest value allowed.
+};
+
+
+static const Config_field config_fields[] = {
+    { "human_detection",          &Camera_config::enable_human_detection,  nullptr, nullptr, 0, 1 },
+    { "motion_detection",         &Camera_config::enable_motion_detection, nullptr, nullptr, 0, 1 },
+    { "outlines",                 &Camera_config::enable_outlines,         nullptr, nullptr, 0, 1 },
+    { "detection_stride",         nullptr, &Camera_config::detection_stride,         nullptr, 1, 1000 },
+    { "hog_threshold",            nullptr, nullptr, &Camera_config::hog_threshold,            -10, 10 },
+    { "hog_scale",                nullptr, nullptr, &Camera_config::hog_scale,                1.01, 2 },
+    { "face_scale",               nullptr, nullptr, &Camera_config::face_scale,               1.01, 2 },
+    { "face_min_neighbors",       nullptr, &Camera_config::face_min_neighbors,       nullptr, 0, 100 },
+    { "face_min_size",            nullptr, &Camera_config::face_min_size,            nullptr, 1, 4096 },
+    { "motion_threshold",         nullptr, nullptr, &Camera_config::motion_threshold,         0, 255 },
+    { "motion_min_area",          nullptr, nullptr, &Camera_config::motion_min_area,          0, 1e8 },
+    { "stream_jpeg_quality",      nullptr, &Camera_config::stream_jpeg_quality,      nullptr, 1, 100 },
+    { "stream_keyframe_interval", nullptr, &Camera_config::stream_keyframe_interval, nullptr, 1, 10000 },
+    { "segment_recording",        &Camera_config::segment_recording,       nullptr, nullptr, 0, 1 },
+    { "segment_seconds",          nullptr, &Camera_config::segment_seconds,          nullptr, 5, 3600 },
+    { "segment_quota_mb",         nullptr, &Camera_config::segment_quota_mb,         nullptr, 16, 16777216 },
+    { "segment_jpeg_quality",     nullptr, &Camera_config::segment_jpeg_quality,     nullptr, 1, 100 },
+    { "recording_codec",          nullptr, &Camera_config::recording_codec,          nullptr, 0, 2 },
+    { "recording_preset",         nullptr, &Camera_config::recording_preset,         nullptr, 0, 8 },
+    { "recording_bitrate_kbps",   nullptr, &Camera_config::recording_bitrate_kbps,   nullptr, 50, 100000 },
+    { "recording_jpeg_quality",   nullptr, &Camera_config::recording_jpeg_quality,   nullptr, 1, 100 },
+};
+
+
+// The newest published config. It is only ever accessed through std::atomic_load() and std::atomic_store().
+static shared_ptr<const Camera_config> newest_config = std::make_shared<const Camera_config>();
+
+
+/**
+ * This helper function finds a setting by name.
+ *
+ * @return const Config_field* - The setting, or nullptr if there is no such setting.
+ */
+static const Config_field* find_config_field(const string& key)
+{
+    for (const Config_field& field : config_fields) {
+        if (key == field.name) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+
+shared_ptr<const Camera_config> current_camera_config()
+{
+    return std::atomic_load(&newest_config);
+}
+
+
+void publish_camera_config(shared_ptr<const Camera_config> config)
+{
+    std::atomic_store(&newest_config, std::move(config));
+}
+
+
+vector<string> camera_config_keys()
+{
+    vector<string> keys;
+    for (const Config_field& field : config_fields) {
+        keys.push_back(field.name);
+    }
+    return keys;
+}
+
+
+bool set_camera_config_value(Camera_config& config, const string& key, const string& value, string& error)
+{
+    const Config_field* field = find_config_field(key);
+    if (field == nullptr) {
+        error = "unknown setting " + key;
+        return false;
+    }
+
+    // The whole value has to be a number, "12abc" is not taken as 12.
+    const char* text = value.c_str();
+    char* end = nullptr;
+    errno = 0;
+    double parsed = strtod(text, &end);
+    if (value.empty() || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)) {
+        error = key + " must be a number";
+        return false;
+    }
+    // The range is checked first, so the value is known to fit in an int before it is converted to one.
+    if (parsed < field->minimum || parsed > field->maximum) {
+        char range[96];
+        snprintf(range, sizeof(range), " must be between %g and %g", field->minimum, field->maximum);
+        error = key + range;
+        return false;
+    }
+    if ((field->flag != nullptr || field->integer != nullptr) && std::trunc(parsed) != parsed) {
+        error = key + " must be a whole number";
+        return false;
+    }
+
+    if (field->flag != nullptr) {
+        config.*(field->flag) = parsed != 0;
+    } else if (field->integer != nullptr) {
+        config.*(field->integer) = (int) parsed;
+    } else {
+        config.*(field->number) = parsed;
+    }
+    return true;
+}
+
+
+bool get_camera_config_value(const Camera_config& config, const string& key, string& value)
+{
+    const Config_field* field = find_config_field(key);
+    if (field == nullptr) {
+        return false;
+    }
+
+    char text[64];
+    if (field->flag != nullptr) {
+        snprintf(text, sizeof(text), "%d", config.*(field->flag) ? 1 : 0);
+    } else if (field->integer != nullptr) {
+        snprintf(text, sizeof(text), "%d", config.*(field->integer));
+    } else {
+        snprintf(text, sizeof(text), "%g", config.*(field->number));
+    }
+    value = text;
+    return true;
+}
@@ -0,0 +1,117 @@
+/**
+ * File Name:   camera_config.h
+ *
+ * Description:
+ * This file contains the declaration of the Camera_config struct, the settings of the camera daemon that can
+ * be changed while it is running, and of the functions that hand them out.
+ *
+ * A Camera_config is never changed once it has been published. To change a setting, a copy of the current
+ * config is changed and then published in its place. The hot loop of the camera picks up the newest config
+ * once per frame with a single atomic load, and keeps using the config it loaded for the whole frame, so it
+ * never sees a half changed config, and never waits on a lock.
+ */
+
+#ifndef CAMERA_CONFIG_H
+#define CAMERA_CONFIG_H
+
+#include "livestream_protocol.h"
+
+#include <memory>  /* for std::shared_ptr */
+#include <string>  /* for std::string */
+#include <vector>  /* for std::vector */
+
+// The values of the recording_codec setting, see clip_encoder.h
+#define RECORDING_CODEC_MJPEG 0
+#define RECORDING_CODEC_H264  1
+#define RECORDING_CODEC_HEVC  2
+
+// The JPEG quality of the MJPEG stream and of the MJPEG videos until it is changed, from 1 to 100.
+#define MJPEG_JPEG_QUALITY 80
+
+
+/**
+ * The settings of the camera daemon that can be changed while it is running.
+ */
+struct Camera_config {
+    bool enable_human_detection = true;   // whether to enable human detection
+    bool enable_motion_detection = true;  // whether to enable motion detection
+    bool enable_outlines = true;          // whether to draw outlines
+    int detection_stride = 1;             // The human and face detectors only run on every Nth frame.
+    double hog_threshold = 1.7;           // The hit threshold of the human detector, higher means fewer false positives.
+    double hog_scale = 1.05;              // How much the human detector scales the image between passes.
+    double face_scale = 1.1;              // How much the face detector scales the image between passes.
+    int face_min_neighbors = 2;           // How many overlapping detections make a face.
+    int face_min_size = 30;               // The smallest face that is detected, in pixels.
+    double motion_threshold = 25.0;       // How much a pixel has to change to count as motion, from 0 to 255.
+    double motion_min_area = 10.0;        // The smallest area of changed pixels that counts as motion.
+    int stream_jpeg_quality = MJPEG_JPEG_QUALITY;                  // The JPEG quality of the MJPEG stream, from 1 to 100.
+    int stream_keyframe_interval = LIVESTREAM_KEYFRAME_INTERVAL;   // Every this many live stream frames, a keyframe is published.
+    bool segment_recording = false;       // whether to record every frame into segments, see segment_recorder.h
+    int segment_seconds = 60;             // How long a segment is.
+    int segment_quota_mb = 2048;          // The most megabytes the segments of a camera may take up.
+    int segment_jpeg_quality = 80;        // The JPEG quality of the segments, from 1 to 100.
+    int recording_codec = RECORDING_CODEC_H264;   // The codec of the videos of the detections, see clip_encoder.h
+    int recording_preset = 2;             // The x264 / x265 preset, from 0 (ultrafast) to 8 (veryslow).
+    int recording_bitrate_kbps = 1000;    // The average bitrate of an H.264 or HEVC video.
+    int recording_jpeg_quality = MJPEG_JPEG_QUALITY;  // The JPEG quality of an MJPEG video, from 1 to 100.
+};
+
+
+/**
+ * This function hands out the newest published config.
+ * It is safe to call from any thread.
+ *
+ * @return std::shared_ptr<const Camera_config> - The newest config. It stays valid, and unchanged, for as
+ *                                                long as the caller holds on to it.
+ */
+std::shared_ptr<const Camera_config> current_camera_config();
+
+
+/**
+ * This function makes a config the newest config, in place of the one published before it.
+ * It is safe to call from any thread.
+ *
+ * @param std::shared_ptr<const Camera_config> config - The config to publish. It must not be changed afterwards.
+ */
+void publish_camera_config(std::shared_ptr<const Camera_config> config);
+
+
+/**
+ * @return std::vector<std::string> - The names of all the settings, in the order they are listed in.
+ */
+std::vector<std::string> camera_config_keys();
+
+
+/**
+ * This function changes one setting of a config.
+ *
+ * @param Camera_config& config - The config to change.
+ *
+ * @param const std::string& key - The name of the setting.
+ *
+ * @param const std::string& value - The new value, as text.
+ *
+ * @param std::string& error - Set to the reason if the setting could not be changed.
+ *
+ * @return bool - true  if the setting was changed.
+ *                false if there is no such setting, or the value is not valid for it.
+ */
+bool set_camera_config_value(Camera_config& config, const std::string& key, const std::string& value, std::string& error);
+
+
+/**
+ * This function reads one setting of a config.
+ *
+ * @param const Camera_config& config - The config to read.
+ *
+ * @param const std::string& key - The name of the setting.
+ *
+ * @param std::string& value - Set to the value, as text.
+ *
+ * @return bool - true  if the setting was read.
+ *                false if there is no such setting.
+ */
+bool get_camera_config_value(const Camera_config& config, const std::string& key, std::string& value);
+
+
+#endif  /* CAMERA_CONFIG_H */
@@ -17,12 +17,17 @@
 #include "camera_daemon.h"
 #include "low_level_cctv_daemon_apis.h"
 #include "camera.hpp"
-#include "write_message.h"
+#include "event_bus.h"
+#include "camera_config.h"
+#include "control_server.h"
+#include "async_log.h"
 
 #include <sys/types.h>
 #include <signal.h>  /* for sigemptyset(), kill(), signal constants */
 #include <syslog.h>  /* for syslog() */
 #include <unistd.h>  /* for sleep() */
+#include <memory>    /* for std::make_shared(), std::unique_ptr */
+#include <string>    /* for std::string */
 #include <vector>    /* for std::vector */
 
 using std::vector;
@@ -33,15 +38,29 @@ using std::vector;
 
 extern Daemon_data daemon_data;
 extern vector<Camera*> cameras;
+extern Control_server control_server;
 
 void camera_daemon()
 {
     syslog(log_facility | LOG_NOTICE, "The camera daemon has started running.");
+    // From here on the cameras log through the asynchronous logger, so a slow syslog() does not hold up
+    // the capture. It falls back to calling syslog() directly if it cannot start.
+    start_async_log(ASYNC_LOG_TO_SYSLOG);
 
     syslog(log_facility | LOG_NOTICE, "enable human detection: %d", daemon_data.enable_human_detection);
     syslog(log_facility | LOG_NOTICE, "enable motion detection: %d", daemon_data.enable_motion_detection);
     syslog(log_facility | LOG_NOTICE, "enable outlines: %d", daemon_data.enable_outlines);
 
+    // The settings chosen in the GUI are only the starting point, they can be changed through the
+    // control socket while the daemon is running.
+    auto config = std::make_shared<Camera_config>();
+    config->enable_human_detection = daemon_data.enable_human_detection;
+    config->enable_motion_detection = daemon_data.enable_motion_detection;
+    config->enable_outlines = daemon_data.enable_outlines;
+    publish_camera_config(std::move(config));
+    // The daemon still works without the control socket, its settings just cannot be changed.
+    control_server.start();
+
     daemon_data.is_live_stream_running = check_live_stream();
     //syslog(log_facility | LOG_NOTICE, "daemon_data.is_live_stream_running = %d", daemon_data.is_live_stream_running);
     //syslog(log_facility | LOG_NOTICE, "daemon_data.live_stream_viewer_pid = %d", daemon_data.live_stream_viewer_pid);
@@ -72,15 +91,21 @@ void camera_daemon()
     action3.sa_flags = 0;
     sigaction(SIGUSR2, &action3, nullptr);
 
-    syslog(log_facility | LOG_NOTICE, "The camera%d is being used.", daemon_data.cameraNumber);
-
-    Camera cam(daemon_data.cameraNumber);
-    cameras.push_back(&cam);
+    // A video file is read in place of the camera when one was given, see Daemon_facade::run_daemon().
+    std::unique_ptr<Camera> cam;
+    if (daemon_data.video_file_path != nullptr) {
+        syslog(log_facility | LOG_NOTICE, "The video file %s is being used.", daemon_data.video_file_path);
+        cam.reset(new Camera(std::string(daemon_data.video_file_path)));
+    } else {
+        syslog(log_facility | LOG_NOTICE, "The camera%d is being used.", daemon_data.cameraNumber);
+        cam.reset(new Camera(daemon_data.cameraNumber));
+    }
+    cameras.push_back(cam.get());
     // The LiveStream process recieves SIGUSR1 when the daemon starts up.
     if (daemon_data.live_stream_viewer_pid) {
         kill(daemon_data.live_stream_viewer_pid, SIGUSR1);
     }
-    cam.record();
+    cam->record();
 	
     syslog(log_facility | LOG_NOTICE, "The camera daemon has completed running.");
 
@@ -0,0 +1,197 @@
+/**
+ * File Name:   captured_frame.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Captured_frame class's methods, and of the snapshots of
+ * the newest frame of the camera.
+ */
+
+#include "captured_frame.h"
+#include "async_log.h"
+
+#include <opencv2/imgcodecs.hpp>  /* for cv::imencode() */
+#include <sys/types.h>
+#include <sys/stat.h>   /* for mkdir(), mode permissions constants */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for write(), close(), unlink() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <cstdio>       /* for snprintf(), rename() */
+#include <cstring>      /* for strerror() */
+#include <ctime>        /* for time_t, struct tm, localtime_r(), strftime() */
+
+using std::string;
+using std::int64_t;
+using std::uint64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+// The newest frame of the camera, only accessed with std::atomic_load() and std::atomic_store().
+static Shared_frame newest_frame;
+// Guards snapshot_directory.
+static std::mutex snapshot_mutex;
+// Where the snapshots are saved, empty until set_snapshot_directory() is called.
+static string snapshot_directory;
+
+
+Shared_jpeg encode_jpeg(const cv::Mat& frame, int quality)
+{
+    std::vector<int> parameters = { cv::IMWRITE_JPEG_QUALITY, quality };
+    auto encoded = std::make_shared<Encoded_jpeg>();
+    encoded->quality = quality;
+    if (!cv::imencode(".jpg", frame, encoded->bytes, parameters)) {
+        return nullptr;
+    }
+    return encoded;
+}
+
+
+Captured_frame::Captured_frame(cv::Mat image, uint64_t sequence, int64_t capture_time_us, Frame_metadata metadata)
+ : frame(std::move(image)), frame_sequence(sequence), frame_capture_time_us(capture_time_us), frame_metadata(std::move(metadata))
+{
+    //
+}
+
+
+const cv::Mat& Captured_frame::image() const
+{
+    return frame;
+}
+
+
+uint64_t Captured_frame::sequence() const
+{
+    return frame_sequence;
+}
+
+
+int64_t Captured_frame::capture_time_us() const
+{
+    return frame_capture_time_us;
+}
+
+
+const Frame_metadata& Captured_frame::metadata() const
+{
+    return frame_metadata;
+}
+
+
+Shared_jpeg Captured_frame::cached_jpeg(int quality) const
+{
+    std::lock_guard<std::mutex> lock(jpegs_mutex);
+    for (const Shared_jpeg& jpeg : jpegs) {
+        if (jpeg->quality == quality) {
+            return jpeg;
+        }
+    }
+    return nullptr;
+}
+
+
+Shared_jpeg Captured_frame::jpeg(int quality) const
+{
+    Shared_jpeg jpeg = cached_jpeg(quality);
+    if (jpeg != nullptr) {
+        return jpeg;
+    }
+
+    // The frame is encoded without holding the lock, so a thread that wants another quality does not wait for it.
+    // When two threads encode the same quality at once, both get the one that was kept first.
+    if ( (jpeg = encode_jpeg(frame, quality)) == nullptr) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(jpegs_mutex);
+    for (const Shared_jpeg& kept : jpegs) {
+        if (kept->quality == quality) {
+            return kept;
+        }
+    }
+    jpegs.push_back(jpeg);
+    return jpeg;
+}
+
+
+void set_snapshot_directory(const string& directory)
+{
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    snapshot_directory = directory;
+}
+
+
+void publish_latest_frame(Shared_frame frame)
+{
+    std::atomic_store(&newest_frame, std::move(frame));
+}
+
+
+Shared_frame latest_frame()
+{
+    return std::atomic_load(&newest_frame);
+}
+
+
+bool save_snapshot(int quality, string& path, string& error)
+{
+    Shared_frame frame = latest_frame();
+    string directory;
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        directory = snapshot_directory;
+    }
+    if (frame == nullptr || directory.empty()) {
+        error = "no frame was captured yet";
+        return false;
+    }
+
+    Shared_jpeg jpeg = frame->jpeg(quality);
+    if (jpeg == nullptr) {
+        error = "the frame could not be encoded";
+        return false;
+    }
+
+    if (mkdir(directory.c_str(), S_IRWXU) == -1 && errno != EEXIST) {
+        error = "could not create " + directory + " : " + strerror(errno);
+        return false;
+    }
+    time_t seconds = frame->capture_time_us() / 1000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char stamp[24];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d_%H-%M-%S", &local);
+    char file[40];
+    snprintf(file, sizeof(file), "%s.%03d.jpg", stamp, (int) (frame->capture_time_us() / 1000 % 1000));
+    path = directory + file;
+
+    // Written under a hidden name and renamed into place, so nothing ever opens a half written snapshot.
+    string temporary_path = directory + "." + file;
+    int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        error = "could not create " + temporary_path + " : " + strerror(errno);
+        return false;
+    }
+    const uchar* bytes = jpeg->bytes.data();
+    size_t remaining = jpeg->bytes.size();
+    while (remaining > 0) {
+        ssize_t written = write(fd, bytes, remaining);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    bool ok = (close(fd) == 0) && remaining == 0;
+    if (!ok || rename(temporary_path.c_str(), path.c_str()) == -1) {
+        error = "could not write " + path + " : " + strerror(errno);
+        unlink(temporary_path.c_str());
+        return false;
+    }
+
+    async_log(log_facility | LOG_NOTICE, "Saved the snapshot %s of frame %llu", path.c_str(), (unsigned long long) frame->sequence());
+    return true;
+}
@@ -0,0 +1,158 @@
+/**
+ * File Name:   captured_frame.h
+ *
+ * Description:
+ * This file contains the declaration of the Captured_frame class, a frame of the camera that is shared by
+ * reference between everything that uses it after it was captured: the history the videos of the detections
+ * are cut from, the MJPEG stream, the continuous recording, and the snapshots of the control socket.
+ *
+ * The pixels of a Captured_frame, and what the detectors found in it, never change after it is made, so it
+ * can be read from any thread without copying it. Its JPEG encodings are made the first time one is asked for, once per quality, and kept with
+ * the frame, so however many consumers want the frame as a JPEG of the same quality, it is encoded once.
+ * A frame that nobody asks a JPEG of is never encoded.
+ *
+ * The newest frame of the camera is published with publish_latest_frame(), for save_snapshot() to save it
+ * from the thread of the control socket.
+ */
+
+#ifndef CAPTURED_FRAME_H
+#define CAPTURED_FRAME_H
+
+#include "frame_metadata.h"
+
+#include <opencv2/core.hpp>  /* for cv::Mat, uchar */
+#include <cstdint>           /* for std::uint64_t, std::int64_t */
+#include <memory>            /* for std::shared_ptr */
+#include <mutex>             /* for std::mutex */
+#include <string>            /* for std::string */
+#include <vector>            /* for std::vector */
+
+// The directory of the snapshots, under the recordings directory of a camera.
+#define SNAPSHOT_DIR "snapshots/"
+
+
+/**
+ * A frame encoded as a JPEG at the resolution it was captured at.
+ */
+struct Encoded_jpeg {
+    int quality;               // The JPEG quality it was encoded at.
+    std::vector<uchar> bytes;  // The JPEG file.
+};
+
+typedef std::shared_ptr<const Encoded_jpeg> Shared_jpeg;
+
+
+/**
+ * This function encodes a frame as a JPEG.
+ *
+ * @param const cv::Mat& frame - The frame.
+ *
+ * @param int quality - The JPEG quality, from 1 to 100.
+ *
+ * @return Shared_jpeg - The JPEG, or nullptr if the frame could not be encoded.
+ */
+Shared_jpeg encode_jpeg(const cv::Mat& frame, int quality);
+
+
+class Captured_frame {
+  public:
+    /**
+     * The constructor takes over a frame.
+     *
+     * @param cv::Mat image - The pixels of the frame. Nothing else may change them afterwards, a frame that
+     *                        the camera captures into again must be cloned first.
+     *
+     * @param std::uint64_t sequence - The sequence number of the frame.
+     *
+     * @param std::int64_t capture_time_us - The time the frame was captured, in microseconds since the epoch.
+     *
+     * @param Frame_metadata metadata - What the detectors found in the frame.
+     */
+    Captured_frame(cv::Mat image, std::uint64_t sequence, std::int64_t capture_time_us, Frame_metadata metadata);
+
+    /**
+     * @return const cv::Mat& - The pixels of the frame.
+     */
+    const cv::Mat& image() const;
+
+    /**
+     * @return std::uint64_t - The sequence number of the frame.
+     */
+    std::uint64_t sequence() const;
+
+    /**
+     * @return std::int64_t - The time the frame was captured, in microseconds since the epoch.
+     */
+    std::int64_t capture_time_us() const;
+
+    /**
+     * @return const Frame_metadata& - What the detectors found in the frame, in pixels of image().
+     */
+    const Frame_metadata& metadata() const;
+
+    /**
+     * This function returns the frame encoded as a JPEG, encoding it if it was not encoded at that quality yet.
+     * It can be called from any thread.
+     *
+     * @param int quality - The JPEG quality, from 1 to 100.
+     *
+     * @return Shared_jpeg - The JPEG, or nullptr if the frame could not be encoded.
+     */
+    Shared_jpeg jpeg(int quality) const;
+
+    /**
+     * @param int quality - The JPEG quality, from 1 to 100.
+     *
+     * @return Shared_jpeg - The JPEG of that quality, or nullptr if it was not encoded yet.
+     */
+    Shared_jpeg cached_jpeg(int quality) const;
+
+  private:
+    cv::Mat frame;                            // The pixels.
+    std::uint64_t frame_sequence;             // The sequence number.
+    std::int64_t frame_capture_time_us;       // The capture time.
+    Frame_metadata frame_metadata;            // The boxes and the motion.
+    mutable std::mutex jpegs_mutex;           // Guards jpegs.
+    mutable std::vector<Shared_jpeg> jpegs;   // The encodings made so far, one per quality.
+};
+
+typedef std::shared_ptr<const Captured_frame> Shared_frame;
+
+
+/**
+ * This function sets where save_snapshot() saves the snapshots.
+ *
+ * @param const std::string& directory - The directory of the snapshots, ending in '/'. It is created
+ *                                       when the first snapshot is saved.
+ */
+void set_snapshot_directory(const std::string& directory);
+
+/**
+ * This function makes a frame the newest frame of the camera. It is called by the camera for every frame.
+ *
+ * @param Shared_frame frame - The frame.
+ */
+void publish_latest_frame(Shared_frame frame);
+
+/**
+ * @return Shared_frame - The newest frame of the camera, or nullptr if nothing was captured yet.
+ */
+Shared_frame latest_frame();
+
+/**
+ * This function saves the newest frame of the camera as a JPEG file in the directory of the snapshots,
+ * named after its capture time. The JPEG is shared with the MJPEG stream and the recordings when they
+ * already encoded the frame at the same quality.
+ *
+ * @param int quality - The JPEG quality, from 1 to 100.
+ *
+ * @param std::string& path - Set to the path of the snapshot.
+ *
+ * @param std::string& error - Set to the reason when the snapshot could not be saved.
+ *
+ * @return bool - true if the snapshot was saved.
+ */
+bool save_snapshot(int quality, std::string& path, std::string& error);
+
+
+#endif  /* CAPTURED_FRAME_H */
@@ -0,0 +1,433 @@
+/**
+ * File Name:   clip_encoder.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Clip_encoder class's methods, which save the videos of the
+ * detections as MJPEG, H.264 or HEVC on a pool of threads.
+ */
+
+#include "clip_encoder.h"
+#include "event_bus.h"
+#include "async_log.h"
+#include "avi_writer.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for stat() */
+#include <sys/wait.h>   /* for waitpid(), WIFEXITED(), WEXITSTATUS() */
+#include <fcntl.h>      /* for O_CLOEXEC */
+#include <unistd.h>     /* for pipe2(), write(), close(), access(), unlink() */
+#include <spawn.h>      /* for posix_spawn(), posix_spawn_file_actions_t */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <signal.h>     /* for sigset_t, sigemptyset() */
+#include <algorithm>    /* for std::min(), std::max() */
+#include <chrono>       /* for std::chrono */
+#include <condition_variable>  /* for std::condition_variable */
+#include <cstdint>      /* for UINT32_MAX */
+#include <cstdio>       /* for rename() */
+#include <cstdlib>      /* for getenv() */
+#include <cstring>      /* for strncpy() */
+#include <memory>       /* for std::make_shared() */
+#include <mutex>        /* for std::mutex, std::lock_guard */
+#include <string>       /* for std::string, std::to_string() */
+#include <thread>       /* for std::thread::hardware_concurrency() */
+
+using std::string;
+using std::to_string;
+using std::vector;
+using std::int64_t;
+using std::uint64_t;
+
+extern char** environ;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// The presets of x264 and x265, from the fastest to the smallest videos. recording_preset is an index into this.
+static const char* const encoder_presets[] = {
+    "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow",
+};
+
+
+/**
+ * This helper function finds a program in the directories of the PATH.
+ *
+ * @return std::string - The path of the program, or an empty string if it is not there.
+ */
+static string find_program(const char* name)
+{
+    const char* path = getenv("PATH");
+    string directories = path != nullptr ? path : "/usr/local/bin:/usr/bin:/bin";
+    size_t start = 0;
+    while (start <= directories.size()) {
+        size_t end = directories.find(':', start);
+        if (end == string::npos) {
+            end = directories.size();
+        }
+        string candidate = directories.substr(start, end - start);
+        candidate += candidate.empty() ? "./" : "/";
+        candidate += name;
+        if (access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+
+/**
+ * This helper function gives the hidden name a video is written under, in the same directory.
+ * The Recordings tab does not list the files that start with a '.', so it never shows half a video.
+ */
+static string temporary_path_of(const string& path)
+{
+    size_t slash = path.rfind('/');
+    return path.substr(0, slash + 1) + "." + path.substr(slash + 1);
+}
+
+
+/**
+ * This helper function returns the monotonic clock in microseconds.
+ */
+static int64_t steady_us()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+Clip_encoder::Clip_encoder()
+ : clips(0), clip_bytes(0), clip_us(0), encode_us(0)
+{
+    //
+}
+
+
+Clip_encoder::~Clip_encoder()
+{
+    stop();
+}
+
+
+bool Clip_encoder::start()
+{
+    ffmpeg_path = find_program(CLIP_ENCODER_FFMPEG);
+    if (ffmpeg_path.empty()) {
+        syslog(log_facility | LOG_WARNING, "%s is not installed, the videos are saved as MJPEG", CLIP_ENCODER_FFMPEG);
+    }
+    int jpeg_threads = CLIP_ENCODER_JPEG_THREADS;
+    if (jpeg_threads <= 0) {
+        jpeg_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Without the JPEG threads, the frames are encoded on the thread saving the video.
+    jpeg_pool.start(jpeg_threads);
+    return pool.start(CLIP_ENCODER_THREADS);
+}
+
+
+void Clip_encoder::stop()
+{
+    pool.stop(CLIP_ENCODER_STOP_TIMEOUT_MS);
+    jpeg_pool.stop(0);
+}
+
+
+int Clip_encoder::effective_codec(int codec) const
+{
+    return ffmpeg_path.empty() ? RECORDING_CODEC_MJPEG : codec;
+}
+
+
+const char* Clip_encoder::extension(int codec) const
+{
+    return effective_codec(codec) == RECORDING_CODEC_MJPEG ? ".avi" : ".mp4";
+}
+
+
+string Clip_encoder::fallback_path(const string& path)
+{
+    size_t slash = path.rfind('/');
+    size_t dot = path.rfind('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        return path + ".avi";
+    }
+    return path.substr(0, dot) + ".avi";
+}
+
+
+bool Clip_encoder::submit(Clip_job job)
+{
+    if (job.frames.empty()) {
+        return false;
+    }
+    // Without ffmpeg the video is saved as MJPEG, under the name extension() gave for it.
+    job.codec = effective_codec(job.codec);
+    // The frames are shared with the history of the camera, not copied. It never changes a frame it captured.
+    auto shared_job = std::make_shared<Clip_job>(std::move(job));
+    return pool.submit([this, shared_job]() { encode(*shared_job); });
+}
+
+
+size_t Clip_encoder::pending() const
+{
+    return pool.unfinished();
+}
+
+
+bool Clip_encoder::wait(int timeout_ms)
+{
+    return pool.wait_idle(timeout_ms);
+}
+
+
+void Clip_encoder::encode(const Clip_job& job)
+{
+    int64_t start = steady_us();
+
+    // The videos play back at the rate the frames were captured at.
+    int64_t first_capture_us = job.frames.front()->capture_time_us();
+    int64_t last_capture_us = job.frames.back()->capture_time_us();
+    double fps = 10;
+    if (job.frames.size() > 1 && last_capture_us > first_capture_us) {
+        fps = (job.frames.size() - 1) * 1000000.0 / (last_capture_us - first_capture_us);
+    }
+
+    // The video is written under a hidden name, and renamed into place once it is whole.
+    bool saved = false;
+    string path = job.path;
+    string temporary_path = temporary_path_of(path);
+    const char* format = "MJPEG";
+    if (job.codec != RECORDING_CODEC_MJPEG) {
+        saved = write_ffmpeg(job, temporary_path, fps);
+        format = job.codec == RECORDING_CODEC_HEVC ? "HEVC" : "H.264";
+        if (!saved) {
+            // What ffmpeg wrote before it failed is not a video, and an AVI is not given the name of an MP4.
+            if (unlink(temporary_path.c_str()) == -1 && errno != ENOENT) {
+                async_log(log_facility | LOG_ERR, "Error: Could not remove %s : %m", temporary_path.c_str());
+            }
+            path = fallback_path(job.path);
+            temporary_path = temporary_path_of(path);
+            async_log(log_facility | LOG_WARNING, "%s could not encode %s, saving it as MJPEG in %s", CLIP_ENCODER_FFMPEG,
+                      job.path.c_str(), path.c_str());
+        }
+    }
+    if (!saved) {
+        saved = write_mjpeg(job, temporary_path, fps);
+        format = "MJPEG";
+    }
+
+    string file_name = path.substr(path.rfind('/') + 1);
+    struct stat file_status;
+    if (!saved || stat(temporary_path.c_str(), &file_status) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not save the video %s", path.c_str());
+        unlink(temporary_path.c_str());
+        post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, job.camera, file_name);
+        return;
+    }
+
+    // What the detectors found goes next to the video, the outlines are drawn from it when the video is shown.
+    // It is there before the video is, so the video is never shown without its outlines.
+    vector<char> records;
+    for (size_t i = 0; i < job.frames.size(); ++i) {
+        append_metadata_record(records, i, job.frames[i]->capture_time_us(), job.frames[i]->metadata());
+    }
+    const cv::Mat& first = job.frames.front()->image();
+    write_metadata_file(path + METADATA_EXTENSION, first.cols, first.rows, records);
+
+    if (rename(temporary_path.c_str(), path.c_str()) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not rename %s to %s : %m", temporary_path.c_str(), path.c_str());
+        unlink(temporary_path.c_str());
+        post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, job.camera, file_name);
+        return;
+    }
+
+    int64_t took_us = steady_us() - start;
+    int64_t length_us = std::max<int64_t>(last_capture_us - first_capture_us, 1);
+    uint64_t total_clips = ++clips;
+    uint64_t total_bytes = (clip_bytes += file_status.st_size);
+    int64_t total_length_us = (clip_us += length_us);
+    int64_t total_encode_us = (encode_us += took_us);
+    async_log(log_facility | LOG_NOTICE, "Saved a video %s: %s, %zu frames, %lld bytes (%.0f kbit/s), encoded in %.0f ms (%.1fx real time)",
+              path.c_str(), format, job.frames.size(), (long long) file_status.st_size,
+              file_status.st_size * 8000.0 / length_us, took_us / 1000.0, (double) length_us / std::max<int64_t>(took_us, 1));
+    async_log(log_facility | LOG_NOTICE, "Videos saved so far: %llu, %.0f kbit/s and %.1fx real time on average",
+              (unsigned long long) total_clips, total_bytes * 8000.0 / total_length_us,
+              (double) total_length_us / std::max<int64_t>(total_encode_us, 1));
+
+    Event event = make_event(EVENT_RECORDING_SAVED, SOURCE_DAEMON, job.camera);
+    strncpy(event.detail, file_name.c_str(), sizeof(event.detail) - 1);
+    event.clip_bytes = (std::uint32_t) std::min<uint64_t>(file_status.st_size, UINT32_MAX);
+    event.encode_ms = took_us / 1000.0f;
+    post_event(event);
+}
+
+
+bool Clip_encoder::write_mjpeg(const Clip_job& job, const string& path, double fps)
+{
+    const cv::Mat& first = job.frames.front()->image();
+    Avi_writer video;
+    if (!video.open(path, first.cols, first.rows, fps)) {
+        return false;
+    }
+
+    // The frames are encoded a window at a time, in parallel, and then written out in order.
+    // The window keeps a long video from holding all of its JPEGs in memory at once.
+    size_t window = std::max<size_t>(jpeg_pool.size(), 1) * CLIP_ENCODER_FRAMES_PER_THREAD;
+    vector<Shared_jpeg> encoded(window);
+    size_t reused = 0;
+    for (size_t start = 0; start < job.frames.size(); start += window) {
+        size_t count = std::min(window, job.frames.size() - start);
+
+        std::mutex done_mutex;
+        std::condition_variable done;
+        size_t remaining = 0;
+        for (size_t i = 0; i < count; ++i) {
+            size_t frame = start + i;
+            if ( (encoded[i] = job.frames[frame]->cached_jpeg(job.jpeg_quality)) != nullptr) {
+                ++reused;
+                continue;
+            }
+
+            // The JPEG is kept with the frame, a snapshot or a later video of the same frame use it too.
+            Shared_jpeg* result = &encoded[i];
+            const Captured_frame* source = job.frames[frame].get();
+            int quality = job.jpeg_quality;
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                ++remaining;
+            }
+            bool queued = jpeg_pool.submit([result, source, quality, &done_mutex, &done, &remaining]() {
+                Shared_jpeg jpeg = source->jpeg(quality);
+                std::lock_guard<std::mutex> lock(done_mutex);
+                *result = std::move(jpeg);
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+            if (!queued) {
+                *result = source->jpeg(quality);
+                std::lock_guard<std::mutex> lock(done_mutex);
+                --remaining;
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(done_mutex);
+            done.wait(lock, [&remaining]() { return remaining == 0; });
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            if (encoded[i] == nullptr) {
+                async_log(log_facility | LOG_ERR, "Error: Could not encode frame %zu of %s", start + i, path.c_str());
+                continue;
+            }
+            if (!video.write_frame(encoded[i]->bytes.data(), encoded[i]->bytes.size())) {
+                async_log(log_facility | LOG_ERR, "Error: %s was cut short at %u frames", path.c_str(), video.frame_count());
+                start = job.frames.size();
+                break;
+            }
+            encoded[i] = nullptr;
+        }
+    }
+
+    if (reused > 0) {
+        async_log(log_facility | LOG_NOTICE, "%zu of the %zu frames of %s were already encoded", reused, job.frames.size(), path.c_str());
+    }
+    return video.close() && video.frame_count() > 0;
+}
+
+
+bool Clip_encoder::write_ffmpeg(const Clip_job& job, const string& path, double fps)
+{
+    const cv::Mat& first = job.frames.front()->image();
+    if (first.type() != CV_8UC3) {
+        return false;
+    }
+
+    int preset = std::min<int>(std::max(job.preset, 0), sizeof(encoder_presets) / sizeof(encoder_presets[0]) - 1);
+    string size = to_string(first.cols) + "x" + to_string(first.rows);
+    string rate = to_string(fps);
+    string bitrate = to_string(job.bitrate_kbps) + "k";
+    string buffer = to_string(2 * job.bitrate_kbps) + "k";
+    // A keyframe every 2 seconds, which is also where the MP4 is fragmented.
+    string keyframes = to_string(std::max(1, (int) (2 * fps + 0.5)));
+    vector<string> arguments = {
+        ffmpeg_path, "-hide_banner", "-loglevel", "error", "-y",
+        "-f", "rawvideo", "-pix_fmt", "bgr24", "-s", size, "-r", rate, "-i", "pipe:0",
+        "-c:v", job.codec == RECORDING_CODEC_HEVC ? "libx265" : "libx264",
+        "-preset", encoder_presets[preset], "-b:v", bitrate, "-maxrate", bitrate, "-bufsize", buffer,
+        "-g", keyframes, "-pix_fmt", "yuv420p",
+    };
+    if (job.codec == RECORDING_CODEC_HEVC) {
+        // Without the hvc1 tag, QuickTime and browsers do not play the video.
+        arguments.insert(arguments.end(), { "-tag:v", "hvc1", "-x265-params", "log-level=error" });
+    }
+    arguments.insert(arguments.end(), { "-movflags", "+frag_keyframe+empty_moov+default_base_moof", "-f", "mp4", path });
+
+    vector<char*> argv;
+    for (string& argument : arguments) {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    // Both ends are closed on exec, so an ffmpeg started by another thread does not keep this pipe open.
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not create a pipe to %s : %m", CLIP_ENCODER_FFMPEG);
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[0], STDIN_FILENO);
+    // ffmpeg would otherwise inherit the signal mask of the worker thread, which blocks every signal.
+    posix_spawnattr_t attributes;
+    sigset_t no_signals;
+    sigemptyset(&no_signals);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &no_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+    pid_t pid = -1;
+    int error = posix_spawn(&pid, ffmpeg_path.c_str(), &actions, &attributes, argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fds[0]);
+    if (error != 0) {
+        errno = error;
+        async_log(log_facility | LOG_ERR, "Error: Could not start %s : %m", ffmpeg_path.c_str());
+        close(pipe_fds[1]);
+        return false;
+    }
+
+    // The worker threads block SIGPIPE, so a write to an ffmpeg that died fails with EPIPE instead of killing the daemon.
+    bool written = true;
+    for (auto frame = job.frames.begin(); written && frame != job.frames.end(); ++frame) {
+        const cv::Mat& image = (*frame)->image();
+        if (image.size() != first.size() || image.type() != first.type()) {
+            continue;
+        }
+        cv::Mat continuous = image.isContinuous() ? image : image.clone();
+        const char* data = reinterpret_cast<const char*>(continuous.data);
+        size_t remaining = continuous.total() * continuous.elemSize();
+        while (remaining > 0) {
+            ssize_t sent = write(pipe_fds[1], data, remaining);
+            if (sent == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                written = false;
+                break;
+            }
+            data += sent;
+            remaining -= sent;
+        }
+    }
+    close(pipe_fds[1]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return written && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
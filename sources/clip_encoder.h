@@ -0,0 +1,172 @@
+/**
+ * File Name:   clip_encoder.h
+ *
+ * Description:
+ * This file contains the declaration of the Clip_encoder class, which saves the videos of the detections
+ * on a Thread_pool, so the camera keeps capturing while a video is being encoded.
+ *
+ * A video is saved in one of these formats, chosen with the recording_codec setting:
+ *     RECORDING_CODEC_MJPEG  An AVI of JPEG frames. The frames are encoded in parallel on a pool of their own,
+ *                            one thread per core, and the AVI is written by an Avi_writer. A frame that was
+ *                            already encoded at recording_jpeg_quality, for the MJPEG stream, the continuous
+ *                            recording or a snapshot, is not encoded again.
+ *     RECORDING_CODEC_H264   A fragmented MP4 of H.264, encoded by an ffmpeg process with libx264.
+ *     RECORDING_CODEC_HEVC   A fragmented MP4 of HEVC, encoded by an ffmpeg process with libx265.
+ * The inter-frame codecs only store what changed between frames, which on a still CCTV picture is a small
+ * part of the size of an MJPEG video. Their speed and size are traded off with recording_preset and
+ * recording_bitrate_kbps. The MP4 is fragmented, so a video cut short when the daemon is killed still plays.
+ * When ffmpeg is not installed, the videos are saved as MJPEG, and extension() gives the extension they are
+ * saved with. When ffmpeg fails on a video, what it wrote is removed and the video is saved as MJPEG next to
+ * it, see fallback_path().
+ *
+ * A video is written under a hidden name, starting with a '.', and renamed into place once it is whole, so the
+ * Recordings tab never lists half a video. What the detectors found in every frame is saved next to it, see
+ * frame_metadata.h.
+ *
+ * The size of every video and how long it took to encode are written to the syslog, and sent to the GUI
+ * with the EVENT_RECORDING_SAVED.
+ */
+
+#ifndef CLIP_ENCODER_H
+#define CLIP_ENCODER_H
+
+#include "thread_pool.h"
+#include "captured_frame.h"
+#include "camera_config.h"
+
+#include <opencv2/core.hpp>  /* for cv::Mat */
+#include <atomic>            /* for std::atomic */
+#include <cstddef>           /* for std::size_t */
+#include <cstdint>           /* for std::uint64_t, std::int64_t */
+#include <string>            /* for std::string */
+#include <vector>            /* for std::vector */
+
+// The number of videos that are encoded at the same time.
+#define CLIP_ENCODER_THREADS 2
+// The program that encodes H.264 and HEVC, looked up in the PATH.
+#define CLIP_ENCODER_FFMPEG "ffmpeg"
+// The number of threads that encode the JPEGs of the MJPEG videos, 0 for one per core.
+#define CLIP_ENCODER_JPEG_THREADS 0
+// How many frames of an MJPEG video are encoded at the same time, per JPEG thread.
+#define CLIP_ENCODER_FRAMES_PER_THREAD 4
+// How long terminate_daemon() waits for the videos that are still being encoded.
+#define CLIP_ENCODER_STOP_TIMEOUT_MS 10000
+
+
+/**
+ * A video to save.
+ */
+struct Clip_job {
+    std::vector<Shared_frame> frames;  // The frames, all of the same size, shared with the history of the camera.
+    int jpeg_quality;                  // The JPEG quality of an MJPEG video.
+    std::string path;                  // Where to save the video.
+    int camera;                        // The camera number, -1 for a video file.
+    int codec;                         // RECORDING_CODEC_MJPEG, RECORDING_CODEC_H264 or RECORDING_CODEC_HEVC.
+    int preset;                        // The index of the x264 / x265 preset, from 0 (ultrafast) to 8 (veryslow).
+    int bitrate_kbps;                  // The average bitrate of an H.264 or HEVC video.
+};
+
+
+class Clip_encoder {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * No video is saved until start() is called.
+     */
+    Clip_encoder();
+
+    /**
+     * The destructor calls Clip_encoder::stop().
+     */
+    ~Clip_encoder();
+
+    /**
+     * This function starts the threads that save the videos, and looks for ffmpeg.
+     *
+     * @return bool - true  if videos can be saved.
+     *                false if no thread could be started, the reason is written to the syslog.
+     */
+    bool start();
+
+    /**
+     * This function waits for the videos that are still being saved, up to CLIP_ENCODER_STOP_TIMEOUT_MS.
+     */
+    void stop();
+
+    /**
+     * @param int codec - The recording_codec setting.
+     *
+     * @return int - The codec the videos are saved with, RECORDING_CODEC_MJPEG if ffmpeg is not installed.
+     *               It is only known once start() was called.
+     */
+    int effective_codec(int codec) const;
+
+    /**
+     * @param int codec - The recording_codec setting.
+     *
+     * @return const char* - The file extension of the videos saved with that codec, including the '.'.
+     *                       It is only known once start() was called.
+     */
+    const char* extension(int codec) const;
+
+    /**
+     * @param const std::string& path - Where an H.264 or HEVC video was to be saved.
+     *
+     * @return std::string - Where it is saved instead when ffmpeg fails on it: the same name, as an MJPEG AVI.
+     */
+    static std::string fallback_path(const std::string& path);
+
+    /**
+     * This function queues a video to be saved. It returns right away.
+     *
+     * @param Clip_job job - The video.
+     *
+     * @return bool - false if the video cannot be saved, because start() was not called or failed.
+     */
+    bool submit(Clip_job job);
+
+    /**
+     * @return std::size_t - The number of videos that were submitted and are not saved yet.
+     */
+    std::size_t pending() const;
+
+    /**
+     * This function waits until every video that was submitted is saved.
+     *
+     * @param int timeout_ms - The longest to wait.
+     *
+     * @return bool - true if every video is saved, false if the time ran out.
+     */
+    bool wait(int timeout_ms);
+
+  private:
+    /**
+     * This function saves a video, on a thread of the pool.
+     */
+    void encode(const Clip_job& job);
+
+    /**
+     * This function saves a video as MJPEG to path, encoding the frames that are not encoded yet on jpeg_pool.
+     *
+     * @return bool - true if the video was written.
+     */
+    bool write_mjpeg(const Clip_job& job, const std::string& path, double fps);
+
+    /**
+     * This function saves a video as H.264 or HEVC to path, by piping its frames into an ffmpeg process.
+     *
+     * @return bool - true if ffmpeg encoded the video.
+     */
+    bool write_ffmpeg(const Clip_job& job, const std::string& path, double fps);
+
+    Thread_pool pool;                       // The threads the videos are saved on.
+    Thread_pool jpeg_pool;                  // The threads the frames of the MJPEG videos are encoded on.
+    std::string ffmpeg_path;                // The ffmpeg program, empty if it is not installed.
+    std::atomic<std::uint64_t> clips;       // The videos saved since the daemon started.
+    std::atomic<std::uint64_t> clip_bytes;  // Their total size.
+    std::atomic<std::int64_t> clip_us;      // Their total length.
+    std::atomic<std::int64_t> encode_us;    // The total time it took to save them.
+};
+
+
+#endif  /* CLIP_ENCODER_H */
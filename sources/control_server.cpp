@@ -0,0 +1,305 @@
+/**
+ * File Name:   control_server.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Control_server class's methods.
+ * An instance of this class serves the control socket of the camera daemon, through which the settings
+ * of the running daemon are read and changed.
+ */
+
+#include "control_server.h"
+#include "camera_config.h"
+#include "captured_frame.h"
+#include "signal_free_thread.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>  /* for socket(), bind(), listen(), accept4(), send(), recv() */
+#include <sys/stat.h>    /* for chmod(), mode permissions constants */
+#include <sys/eventfd.h> /* for eventfd() */
+#include <sys/un.h>      /* for sockaddr_un */
+#include <poll.h>        /* for poll() */
+#include <unistd.h>      /* for close(), read(), write(), unlink() */
+#include <errno.h>       /* for errno */
+#include <syslog.h>      /* for syslog() */
+#include <cstdint>       /* for std::uint64_t */
+#include <cstring>       /* for memset(), strncpy() */
+#include <memory>        /* for std::make_shared() */
+#include <sstream>       /* for std::istringstream */
+#include <string>        /* for std::string */
+#include <thread>        /* for std::thread */
+
+using std::string;
+using std::size_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+Control_server::Control_server()
+ : listen_fd(-1), wake_fd(-1), running(false)
+{
+    //
+}
+
+
+Control_server::~Control_server()
+{
+    stop();
+}
+
+
+bool Control_server::start()
+{
+    if ( (listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the control socket : %m");
+        return false;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, CONTROL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+
+    // Only one camera daemon runs at a time (see the PID file), so a socket that is already there was
+    // left behind by one that crashed.
+    unlink(CONTROL_SOCKET_PATH);
+    if (bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the control socket %s : %m", CONTROL_SOCKET_PATH);
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    // The daemon runs with a umask of 0, only the user running SmartCCTV may change its settings.
+    if (chmod(CONTROL_SOCKET_PATH, S_IRUSR | S_IWUSR) == -1 || listen(listen_fd, CONTROL_MAX_CLIENTS) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not listen on the control socket %s : %m", CONTROL_SOCKET_PATH);
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(CONTROL_SOCKET_PATH);
+        return false;
+    }
+
+    if ( (wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the control eventfd : %m");
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(CONTROL_SOCKET_PATH);
+        return false;
+    }
+
+    running = true;
+    serve_thread = start_signal_free_thread(&Control_server::serve, this);
+
+    syslog(log_facility | LOG_NOTICE, "Listening for control requests on %s", CONTROL_SOCKET_PATH);
+    return true;
+}
+
+
+void Control_server::stop()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    unlink(CONTROL_SOCKET_PATH);
+
+    // Wake up the serving thread so it notices that it should stop.
+    std::uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not wake up the control server : %m");
+    }
+    serve_thread.join();
+
+    // The sockets are closed once the serving thread is gone, nothing else uses them.
+    for (Client& client : clients) {
+        close(client.socket_fd);
+    }
+    clients.clear();
+    close(listen_fd);
+    listen_fd = -1;
+    close(wake_fd);
+    wake_fd = -1;
+}
+
+
+void Control_server::serve()
+{
+    std::vector<struct pollfd> poll_fds;
+
+    while (running) {
+        poll_fds.clear();
+        poll_fds.push_back({wake_fd, POLLIN, 0});
+        poll_fds.push_back({listen_fd, POLLIN, 0});
+        for (Client& client : clients) {
+            poll_fds.push_back({client.socket_fd, POLLIN, 0});
+        }
+
+        if (poll(poll_fds.data(), poll_fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(log_facility | LOG_ERR, "Error: Control server poll() failed : %m");
+            break;
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            std::uint64_t counter = 0;
+            if (read(wake_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN) {
+                syslog(log_facility | LOG_ERR, "Error: Could not read the control eventfd : %m");
+            }
+        }
+
+        if (poll_fds[1].revents & POLLIN) {
+            accept_clients();
+        }
+
+        // Walk the clients that were polled, the newly accepted ones are polled on the next iteration.
+        size_t polled_clients = poll_fds.size() - 2;
+        for (size_t i = polled_clients; i-- > 0; ) {
+            short revents = poll_fds[i + 2].revents;
+            bool keep = true;
+            if (revents & POLLIN) {
+                keep = read_requests(clients[i]);
+            } else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                keep = false;
+            }
+
+            if (!keep) {
+                close(clients[i].socket_fd);
+                clients.erase(clients.begin() + i);
+            }
+        }
+    }
+}
+
+
+void Control_server::accept_clients()
+{
+    while (true) {
+        int socket_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                syslog(log_facility | LOG_ERR, "Error: Control server could not accept a client : %m");
+            }
+            return;
+        }
+
+        if (clients.size() >= CONTROL_MAX_CLIENTS) {
+            syslog(log_facility | LOG_WARNING, "Control server is full, refusing a client");
+            close(socket_fd);
+            continue;
+        }
+
+        Client client;
+        client.socket_fd = socket_fd;
+        clients.push_back(std::move(client));
+    }
+}
+
+
+bool Control_server::read_requests(Client& client)
+{
+    char buffer[1024];
+    ssize_t total_read = recv(client.socket_fd, buffer, sizeof(buffer), 0);
+    if (total_read == 0) {
+        return false;  // the client hung up
+    } else if (total_read < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.input.append(buffer, total_read);
+
+    size_t line_end = 0;
+    while ( (line_end = client.input.find('\n')) != string::npos) {
+        string request = client.input.substr(0, line_end);
+        client.input.erase(0, line_end + 1);
+        if (!request.empty() && request.back() == '\r') {
+            request.pop_back();
+        }
+        if (request.empty()) {
+            continue;
+        }
+
+        // The responses are a few short lines, so they fit into the socket buffer of a client that
+        // reads them. A client that does not read them is disconnected.
+        string response = handle_request(request);
+        if (send(client.socket_fd, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t) response.size()) {
+            syslog(log_facility | LOG_WARNING, "Control server is disconnecting a client that is not reading its responses");
+            return false;
+        }
+    }
+
+    if (client.input.size() > CONTROL_MAX_LINE_LENGTH) {
+        syslog(log_facility | LOG_WARNING, "Control server is disconnecting a client that sent a request that is too long");
+        return false;
+    }
+    return true;
+}
+
+
+string Control_server::handle_request(const string& request)
+{
+    std::istringstream words(request);
+    string command;
+    words >> command;
+
+    std::shared_ptr<const Camera_config> config = current_camera_config();
+
+    if (command == "GET") {
+        string key;
+        string value;
+        string response;
+        if (words >> key) {
+            if (!get_camera_config_value(*config, key, value)) {
+                return "ERR unknown setting " + key + "\n";
+            }
+            response = key + "=" + value + "\n";
+        } else {
+            for (const string& each_key : camera_config_keys()) {
+                get_camera_config_value(*config, each_key, value);
+                response += each_key + "=" + value + "\n";
+            }
+        }
+        return response + "OK\n";
+    }
+
+    if (command == "SET") {
+        // The changes are made on a copy, which only replaces the current config once every change is valid.
+        auto new_config = std::make_shared<Camera_config>(*config);
+        string assignment;
+        string error;
+        bool any = false;
+        while (words >> assignment) {
+            size_t equals = assignment.find('=');
+            if (equals == string::npos) {
+                return "ERR expected key=value, got " + assignment + "\n";
+            }
+            if (!set_camera_config_value(*new_config, assignment.substr(0, equals), assignment.substr(equals + 1), error)) {
+                return "ERR " + error + "\n";
+            }
+            any = true;
+        }
+        if (!any) {
+            return "ERR expected key=value\n";
+        }
+
+        publish_camera_config(std::move(new_config));
+        syslog(log_facility | LOG_NOTICE, "Control request: %s", request.c_str());
+        return "OK\n";
+    }
+
+    if (command == "SNAPSHOT") {
+        // The quality is checked the same way as stream_jpeg_quality, on a copy that is thrown away.
+        Camera_config snapshot_config = *config;
+        string quality;
+        string path;
+        string error;
+        if ((words >> quality) && !set_camera_config_value(snapshot_config, "stream_jpeg_quality", quality, error)) {
+            return "ERR " + error + "\n";
+        }
+        if (!save_snapshot(snapshot_config.stream_jpeg_quality, path, error)) {
+            return "ERR " + error + "\n";
+        }
+        return "path=" + path + "\nOK\n";
+    }
+
+    return "ERR unknown command " + command + "\n";
+}
@@ -0,0 +1,108 @@
+/**
+ * File Name:   control_server.h
+ *
+ * Description:
+ * This file contains the declaration of the Control_server class.
+ * An instance of this class serves the control socket of the camera daemon, a Unix domain socket through
+ * which the settings of the running daemon (see camera_config.h) are read and changed, without restarting it.
+ *
+ * The protocol is line based. Every request is one line, and every response ends with a line that is
+ * either "OK" or "ERR <reason>":
+ *     GET                      Lists every setting as "key=value", one per line.
+ *     GET <key>                Lists one setting as "key=value".
+ *     SET <key>=<value> ...    Changes one or more settings at once. If any of them is not valid,
+ *                              none of them are changed.
+ *     SNAPSHOT [<quality>]     Saves the newest frame of the camera as a JPEG, and answers with its path
+ *                              as "path=<path>". The quality is stream_jpeg_quality if it is not given,
+ *                              so the JPEG the MJPEG stream already has is saved without encoding it again.
+ * A client can send any number of requests over the same connection.
+ */
+
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <atomic>  /* for std::atomic */
+#include <string>  /* for std::string */
+#include <thread>  /* for std::thread */
+#include <vector>  /* for std::vector */
+
+// The path of the control socket of the camera daemon.
+#define CONTROL_SOCKET_PATH "/tmp/SmartCCTV_control"
+// The most clients that can be connected to the control socket at the same time.
+#define CONTROL_MAX_CLIENTS 8
+// The longest request line that is accepted.
+#define CONTROL_MAX_LINE_LENGTH 1024
+
+
+class Control_server {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * The server does not listen for connections until start() is called.
+     */
+    Control_server();
+
+    /**
+     * The destructor calls Control_server::stop().
+     */
+    ~Control_server();
+
+    /**
+     * This function creates the control socket and starts the thread serving the clients.
+     *
+     * @return bool - true  if the server is now listening.
+     *                false if the socket could not be created, the reason is written to the syslog.
+     */
+    bool start();
+
+    /**
+     * This function stops serving clients and removes the control socket.
+     * It waits for the serving thread to finish the request it is answering, if any.
+     */
+    void stop();
+
+  private:
+    /**
+     * The state of a single connected client.
+     */
+    struct Client {
+        int socket_fd;      // The connected socket.
+        std::string input;  // What was read so far of the request that is not complete yet.
+    };
+
+    /**
+     * This function is the body of the thread serving the clients.
+     * It multiplexes the listening socket and all client sockets with poll().
+     */
+    void serve();
+
+    /**
+     * This function accepts all pending connections on the listening socket.
+     */
+    void accept_clients();
+
+    /**
+     * This function reads what a client sent, and answers every complete request in it.
+     *
+     * @return bool - false if the client should be disconnected.
+     */
+    bool read_requests(Client& client);
+
+    /**
+     * This function carries out a single request.
+     *
+     * @param const std::string& request - The request line, without the line ending.
+     *
+     * @return std::string - The response, ending in an "OK" or an "ERR" line.
+     */
+    std::string handle_request(const std::string& request);
+
+    int listen_fd;                 // The listening socket, -1 if not listening.
+    int wake_fd;                   // An eventfd that wakes up the serving thread.
+    std::atomic<bool> running;     // Is the serving thread supposed to keep running?
+    std::thread serve_thread;      // The thread serving the clients, joined by stop().
+    std::vector<Client> clients;   // Only accessed by the serving thread.
+};
+
+
+#endif  /* CONTROL_SERVER_H */
@@ -0,0 +1,281 @@
+/**
+ * File Name:   detection_query.cpp
+ *
+ * Description:
+ * This file contains SmartCCTV_query, the command line tool that finds the videos a person or face was
+ * recorded in, by time, camera, kind, region of the frame and how long it stayed, from the tracks in the
+ * detection store. No video is opened, so a week of recordings is searched in milliseconds.
+ *
+ * Usage:
+ *     SmartCCTV_query [--from TIME] [--to TIME] [--camera N] [--type human|face]
+ *                     [--region X,Y,W,H] [--min-dwell SECONDS] [--store DIRECTORY]
+ *     SmartCCTV_query --segments [--from TIME] [--to TIME] [--camera N]
+ * A TIME is "YYYY-MM-DD", "YYYY-MM-DD HH:MM" or "YYYY-MM-DD HH:MM:SS" in local time. The range is the last
+ * 7 days by default. The region is a rectangle of the frame, as fractions of its width and height, a track
+ * matches when its boxes covered any of it.
+ *
+ * Every track that matches is printed on a line of its own, with the fields separated by tabs:
+ *     first seen, camera, type, track ID, seconds it stayed, first frame, last frame, seconds into the video, video
+ *
+ * With --segments, the segments of the continuous recording that have frames within --from and --to are
+ * printed instead, of the camera given with --camera or of every camera, from their indexes (see
+ * segment_index.h):
+ *     first frame, camera, seconds long, frames, bytes, segment
+ */
+
+#include "detection_store.h"
+#include "segment_index.h"
+
+#include <sys/stat.h>   /* for stat() */
+#include <dirent.h>     /* for opendir(), readdir(), closedir() */
+#include <getopt.h>     /* for getopt_long(), struct option */
+#include <syslog.h>     /* for openlog(), syslog() */
+#include <chrono>       /* for std::chrono::steady_clock, std::chrono::system_clock */
+#include <cstdio>       /* for printf(), fprintf(), sscanf() */
+#include <cstdlib>      /* for getenv(), strtol(), strtod(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <cstring>      /* for strcmp(), strncmp(), strlen(), memset() */
+#include <algorithm>    /* for std::sort() */
+#include <ctime>        /* for time_t, struct tm, localtime_r(), mktime(), strftime() */
+#include <string>       /* for std::string, std::to_string() */
+#include <vector>       /* for std::vector */
+
+using std::string;
+using std::vector;
+using std::int64_t;
+
+// The range that is searched when --from is not given.
+#define QUERY_DEFAULT_DAYS 7
+
+
+/**
+ * This helper function prints how to use the tool.
+ *
+ * @param const char* program - The name the tool was run as.
+ */
+static void print_usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--from TIME] [--to TIME] [--camera N] [--type human|face]\n"
+            "       %*s [--region X,Y,W,H] [--min-dwell SECONDS] [--store DIRECTORY]\n"
+            "       %s --segments [--from TIME] [--to TIME] [--camera N]\n"
+            "TIME is YYYY-MM-DD, YYYY-MM-DD HH:MM or YYYY-MM-DD HH:MM:SS in local time, the last %d days by default.\n"
+            "The region is a rectangle of the frame, as fractions of its width and height, from 0 to 1.\n",
+            program, (int) strlen(program), "", program, QUERY_DEFAULT_DAYS);
+}
+
+
+/**
+ * This helper function reads a local time.
+ *
+ * @param const char* text - The time, as "YYYY-MM-DD", "YYYY-MM-DD HH:MM" or "YYYY-MM-DD HH:MM:SS".
+ *
+ * @param int64_t& time_us - Set to the time, in microseconds since the epoch.
+ *
+ * @return bool - false if the text is not a time.
+ */
+static bool parse_time(const char* text, int64_t& time_us)
+{
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    int fields = sscanf(text, "%d-%d-%d %d:%d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+                        &local.tm_hour, &local.tm_min, &local.tm_sec);
+    if (fields != 3 && fields != 5 && fields != 6) {
+        return false;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    time_t seconds = mktime(&local);
+    if (seconds == (time_t) -1) {
+        return false;
+    }
+    time_us = (int64_t) seconds * 1000000;
+    return true;
+}
+
+
+/**
+ * This helper function prints the segments of the continuous recording that have frames within a time range.
+ *
+ * @param const string& recordings_directory - The directory of the recordings of every camera, ending in '/'.
+ *
+ * @param const Track_query& query - The time range, and the camera or DETECTION_ANY_CAMERA.
+ *
+ * @return bool - false if an index could not be read, the reason is written to the syslog.
+ */
+static bool print_segments(const string& recordings_directory, const Track_query& query)
+{
+    // The camera directories are listed when no camera was asked for.
+    vector<string> camera_directories;
+    if (query.camera == DETECTION_ANY_CAMERA) {
+        DIR* directory = opendir(recordings_directory.c_str());
+        if (directory == nullptr) {
+            syslog(LOG_ERR, "Error: Could not list %s : %m", recordings_directory.c_str());
+            return false;
+        }
+        while (struct dirent* entry = readdir(directory)) {
+            if (strncmp(entry->d_name, "camera", 6) == 0) {
+                camera_directories.push_back(entry->d_name);
+            }
+        }
+        closedir(directory);
+        std::sort(camera_directories.begin(), camera_directories.end());
+    } else {
+        camera_directories.push_back(query.camera < 0 ? DETECTION_FILE_CAMERA_DIR : "camera" + std::to_string(query.camera));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+    size_t count = 0;
+    for (const string& camera_directory : camera_directories) {
+        int camera = -1;
+        if (camera_directory != DETECTION_FILE_CAMERA_DIR && sscanf(camera_directory.c_str(), "camera%d", &camera) != 1) {
+            continue;
+        }
+        string directory = recordings_directory + camera_directory + "/" SEGMENT_DIR;
+        vector<Segment_entry> segments;
+        ok = query_segments(directory, query.from_us, query.to_us, segments) && ok;
+
+        for (const Segment_entry& segment : segments) {
+            time_t seconds = segment.start_us / 1000000;
+            struct tm local;
+            localtime_r(&seconds, &local);
+            char first_frame[24];
+            strftime(first_frame, sizeof(first_frame), "%Y-%m-%d %H:%M:%S", &local);
+            printf("%s\t%d\t%.1f\t%u\t%llu\t%s%s\n", first_frame, camera, (segment.end_us - segment.start_us) / 1000000.0,
+                   segment.frames, (unsigned long long) segment.bytes, directory.c_str(), segment.file);
+        }
+        count += segments.size();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    fprintf(stderr, "%zu segments found in %.3f ms\n", count, elapsed.count() / 1000.0);
+    return ok;
+}
+
+
+int main(int argc, char* argv[])
+{
+    openlog("SmartCCTV_query", LOG_PERROR, LOG_USER);
+
+    const char* home_directory = getenv("HOME");
+    string directory = string(home_directory != nullptr ? home_directory : "") + DETECTION_STORE_DIR;
+    string recordings_directory = string(home_directory != nullptr ? home_directory : "") + "/SmartCCTV_recordings/";
+
+    Track_query query;
+    query.to_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::system_clock::now().time_since_epoch()).count();
+    query.from_us = query.to_us - QUERY_DEFAULT_DAYS * 24 * 3600 * (int64_t) 1000000;
+
+    static const struct option options[] = {
+        { "from",      required_argument, nullptr, 'f' },
+        { "to",        required_argument, nullptr, 't' },
+        { "camera",    required_argument, nullptr, 'c' },
+        { "type",      required_argument, nullptr, 'k' },
+        { "region",    required_argument, nullptr, 'r' },
+        { "min-dwell", required_argument, nullptr, 'd' },
+        { "store",     required_argument, nullptr, 's' },
+        { "segments",  no_argument,       nullptr, 'g' },
+        { "help",      no_argument,       nullptr, 'h' },
+        { nullptr,     0,                 nullptr, 0 }
+    };
+    bool segments = false;
+    int option;
+    while ( (option = getopt_long(argc, argv, "f:t:c:k:r:d:s:h", options, nullptr)) != -1) {
+        bool valid = true;
+        switch (option) {
+          case 'f':
+            valid = parse_time(optarg, query.from_us);
+            break;
+          case 't':
+            valid = parse_time(optarg, query.to_us);
+            break;
+          case 'c': {
+            char* end;
+            query.camera = (int) strtol(optarg, &end, 10);
+            valid = *optarg != '\0' && *end == '\0' && query.camera >= -1;
+            break;
+          }
+          case 'k':
+            if (strcmp(optarg, "human") == 0) {
+                query.types = DETECTION_HUMAN;
+            } else if (strcmp(optarg, "face") == 0) {
+                query.types = DETECTION_FACE;
+            } else {
+                valid = false;
+            }
+            break;
+          case 'r': {
+            double x, y, width, height;
+            valid = sscanf(optarg, "%lf,%lf,%lf,%lf", &x, &y, &width, &height) == 4
+                    && (query.cells = detection_grid_cells(x, y, x + width, y + height)) != 0;
+            break;
+          }
+          case 'd': {
+            char* end;
+            double seconds = strtod(optarg, &end);
+            valid = *optarg != '\0' && *end == '\0' && seconds >= 0;
+            query.min_dwell_ms = (std::int32_t) (seconds * 1000);
+            break;
+          }
+          case 's':
+            directory = optarg;
+            if (directory.back() != '/') {
+                directory += '/';
+            }
+            break;
+          case 'g':
+            segments = true;
+            break;
+          case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+          default:
+            valid = false;
+        }
+        if (!valid) {
+            if (option != '?') {
+                fprintf(stderr, "%s: invalid value: %s\n", argv[0], optarg);
+            }
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc || query.from_us >= query.to_us) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (segments) {
+        return print_segments(recordings_directory, query) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    vector<Track_record> tracks;
+    bool ok = query_tracks(directory, query, tracks);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    for (const Track_record& track : tracks) {
+        time_t seconds = track.time_us / 1000000;
+        struct tm local;
+        localtime_r(&seconds, &local);
+        char first_seen[24];
+        strftime(first_seen, sizeof(first_seen), "%Y-%m-%d %H:%M:%S", &local);
+        // The videos of a video file are saved in a directory of their own.
+        string camera_directory = track.camera < 0 ? DETECTION_FILE_CAMERA_DIR : "camera" + std::to_string(track.camera);
+        string video = recordings_directory + camera_directory + "/" + track.clip;
+        // A video that ffmpeg failed on was saved as an MJPEG AVI of the same name, see Clip_encoder::fallback_path().
+        struct stat video_status;
+        size_t dot = video.rfind('.');
+        if (stat(video.c_str(), &video_status) == -1 && dot != string::npos && video.compare(dot, string::npos, ".avi") != 0) {
+            string fallback = video.substr(0, dot) + ".avi";
+            if (stat(fallback.c_str(), &video_status) == 0) {
+                video = fallback;
+            }
+        }
+        printf("%s\t%d\t%s\t%u\t%.1f\t%u\t%u\t%.1f\t%s\n", first_seen, track.camera,
+               (track.types & DETECTION_FACE) ? "face" : "human", track.track_id, track.dwell_ms / 1000.0,
+               track.first_frame, track.last_frame, track.offset_ms / 1000.0, video.c_str());
+    }
+    fprintf(stderr, "%zu tracks found in %.3f ms\n", tracks.size(), elapsed.count() / 1000.0);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,495 @@
+/**
+ * File Name:   detection_store.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Detection_store class's methods, and of the functions
+ * that query the store, the append-only binary log of the detections recorded by the camera daemon.
+ */
+
+#include "detection_store.h"
+#include "async_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for mkdir(), fstat(), mode permissions constants */
+#include <sys/mman.h>   /* for mmap(), munmap() */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for close(), write(), pread(), ftruncate() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <algorithm>    /* for std::lower_bound(), std::max(), std::min(), std::stable_sort() */
+#include <cmath>        /* for std::ceil() */
+#include <cstring>      /* for memcmp(), memcpy(), memset() */
+#include <ctime>        /* for time_t, struct tm, localtime_r(), mktime(), strftime() */
+#include <memory>       /* for std::unique_ptr */
+
+using std::string;
+using std::vector;
+using std::int64_t;
+using std::uint64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+static const char events_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'E', 'V', '1' };
+static const char rollup_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'R', 'U', '1' };
+static const char tracks_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'T', 'R', '1' };
+static const size_t rollup_file_size = sizeof(Store_header) + DETECTION_MINUTES_PER_DAY * sizeof(Minute_rollup);
+static const int64_t minute_us = 60 * (int64_t) 1000000;
+
+
+/**
+ * This helper function finds the local day and time of a moment.
+ *
+ * @param int64_t time_us - The moment, in microseconds since the epoch.
+ *
+ * @param struct tm& local - Set to the local time of the moment.
+ *
+ * @return std::string - The day, as "dd.MM.yyyy", which is the name of its files without the extension.
+ */
+static string local_day(int64_t time_us, struct tm& local)
+{
+    time_t seconds = time_us / 1000000;
+    localtime_r(&seconds, &local);
+    char name[16];
+    strftime(name, sizeof(name), "%d.%m.%Y", &local);
+    return name;
+}
+
+
+/**
+ * This helper function finds the local midnight that ends a day. Days are not always 24 hours long.
+ *
+ * @param const struct tm& local - A local time within the day.
+ *
+ * @return int64_t - The midnight, in microseconds since the epoch.
+ */
+static int64_t next_local_midnight(const struct tm& local)
+{
+    struct tm midnight = local;
+    midnight.tm_mday += 1;
+    midnight.tm_hour = 0;
+    midnight.tm_min = 0;
+    midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;
+    return (int64_t) mktime(&midnight) * 1000000;
+}
+
+
+/**
+ * This helper function opens, or creates, an append-only file of a day, whose records all start with their time.
+ *
+ * @param const string& path - The file.
+ *
+ * @param const char magic[8] - The magic of its Store_header.
+ *
+ * @param size_t item_size - The size of its records.
+ *
+ * @param int64_t& last_time_us - Set to the time of its last record, 0 if it has none.
+ *
+ * @return int - The file, opened for appending, or -1 if it could not be opened, the reason is written to the syslog.
+ */
+static int open_log_file(const string& path, const char magic[8], size_t item_size, int64_t& last_time_us)
+{
+    last_time_us = 0;
+    int fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not open %s : %m", path.c_str());
+        return -1;
+    }
+
+    struct stat file_status;
+    if (fstat(fd, &file_status) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not read %s : %m", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+
+    size_t size = file_status.st_size;
+    if (size < sizeof(Store_header)) {
+        // A new day, or one whose header was cut short when the daemon was killed.
+        Store_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.item_size = item_size;
+        if (ftruncate(fd, 0) == -1 || write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+            async_log(log_facility | LOG_ERR, "Error: Could not write %s : %m", path.c_str());
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    Store_header header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+        || memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.item_size != item_size) {
+        async_log(log_facility | LOG_ERR, "Error: %s is not a file of the detection store", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+
+    // A record cut short when the daemon was killed is removed, so every record starts at a multiple of its size.
+    size_t records = (size - sizeof(Store_header)) / item_size;
+    size_t whole = sizeof(Store_header) + records * item_size;
+    if (whole != size && ftruncate(fd, whole) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not repair %s : %m", path.c_str());
+        ::close(fd);
+        return -1;
+    }
+
+    int64_t last;
+    if (records > 0 && pread(fd, &last, sizeof(last), whole - item_size) == (ssize_t) sizeof(last)) {
+        last_time_us = last;
+    }
+    return fd;
+}
+
+
+/**
+ * A file of the store mapped read-only, for the queries. It is unmapped when it goes out of scope.
+ */
+struct Mapped_file {
+    const char* data;   // The mapped file, nullptr if there is no such file or it could not be mapped.
+    size_t size;        // The size of the file.
+    bool failed;        // Could the file not be read, for a reason other than that it is not there?
+
+    Mapped_file(const string& path, const char magic[8], size_t item_size)
+     : data(nullptr), size(0), failed(false)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            if (errno != ENOENT) {
+                syslog(log_facility | LOG_ERR, "Error: Could not open %s : %m", path.c_str());
+                failed = true;
+            }
+            return;
+        }
+
+        struct stat file_status;
+        if (fstat(fd, &file_status) == -1 || (size_t) file_status.st_size < sizeof(Store_header)) {
+            // A day that was created but never written to.
+            ::close(fd);
+            return;
+        }
+        size = file_status.st_size;
+
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            syslog(log_facility | LOG_ERR, "Error: Could not map %s : %m", path.c_str());
+            failed = true;
+            return;
+        }
+        data = static_cast<const char*>(mapped);
+
+        const Store_header* header = reinterpret_cast<const Store_header*>(data);
+        if (memcmp(header->magic, magic, sizeof(header->magic)) != 0 || header->item_size != item_size) {
+            syslog(log_facility | LOG_ERR, "Error: %s is not a file of the detection store", path.c_str());
+            munmap(const_cast<char*>(data), size);
+            data = nullptr;
+            failed = true;
+        }
+    }
+
+    ~Mapped_file()
+    {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+};
+
+
+Detection_store::Detection_store()
+ : events_fd(-1), tracks_fd(-1), rollup(nullptr), last_time_us(0), last_track_time_us(0)
+{
+    //
+}
+
+
+Detection_store::~Detection_store()
+{
+    close();
+}
+
+
+bool Detection_store::open(const string& directory)
+{
+    if (mkdir(directory.c_str(), S_IRWXU) == -1 && errno != EEXIST) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the detection store %s : %m", directory.c_str());
+        return false;
+    }
+    this->directory = directory;
+    syslog(log_facility | LOG_NOTICE, "Recording the detections in %s", directory.c_str());
+    return true;
+}
+
+
+void Detection_store::close()
+{
+    if (rollup != nullptr) {
+        munmap(rollup, rollup_file_size);
+        rollup = nullptr;
+    }
+    if (events_fd != -1) {
+        ::close(events_fd);
+        events_fd = -1;
+    }
+    if (tracks_fd != -1) {
+        ::close(tracks_fd);
+        tracks_fd = -1;
+    }
+    day.clear();
+    last_time_us = 0;
+    last_track_time_us = 0;
+}
+
+
+bool Detection_store::open_day(const string& new_day)
+{
+    close();
+
+    string events_path = directory + new_day + ".events";
+    if ( (events_fd = open_log_file(events_path, events_magic, sizeof(Detection_record), last_time_us)) == -1) {
+        close();
+        return false;
+    }
+    string tracks_path = directory + new_day + ".tracks";
+    if ( (tracks_fd = open_log_file(tracks_path, tracks_magic, sizeof(Track_record), last_track_time_us)) == -1) {
+        close();
+        return false;
+    }
+
+    string rollup_path = directory + new_day + ".rollup";
+    int rollup_fd = ::open(rollup_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (rollup_fd == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not open %s : %m", rollup_path.c_str());
+        close();
+        return false;
+    }
+    // A new rollup file is all zeros, which is a day without detections.
+    struct stat file_status;
+    if (fstat(rollup_fd, &file_status) == -1
+        || ((size_t) file_status.st_size < rollup_file_size && ftruncate(rollup_fd, rollup_file_size) == -1)) {
+        async_log(log_facility | LOG_ERR, "Error: Could not size %s : %m", rollup_path.c_str());
+        ::close(rollup_fd);
+        close();
+        return false;
+    }
+    void* mapped = mmap(nullptr, rollup_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, rollup_fd, 0);
+    ::close(rollup_fd);
+    if (mapped == MAP_FAILED) {
+        async_log(log_facility | LOG_ERR, "Error: Could not map %s : %m", rollup_path.c_str());
+        close();
+        return false;
+    }
+
+    Store_header* header = static_cast<Store_header*>(mapped);
+    if (header->item_size == 0) {
+        memcpy(header->magic, rollup_magic, sizeof(header->magic));
+        header->item_size = sizeof(Minute_rollup);
+    } else if (memcmp(header->magic, rollup_magic, sizeof(header->magic)) != 0 || header->item_size != sizeof(Minute_rollup)) {
+        async_log(log_facility | LOG_ERR, "Error: %s is not a file of the detection store", rollup_path.c_str());
+        munmap(mapped, rollup_file_size);
+        close();
+        return false;
+    }
+    rollup = reinterpret_cast<Minute_rollup*>(static_cast<char*>(mapped) + sizeof(Store_header));
+
+    day = new_day;
+    return true;
+}
+
+
+bool Detection_store::append(const Detection_record& record)
+{
+    if (directory.empty()) {
+        return false;
+    }
+
+    struct tm local;
+    string record_day = local_day(record.time_us, local);
+    if (record_day != day && !open_day(record_day)) {
+        return false;
+    }
+
+    Detection_record stored = record;
+    stored.clip[sizeof(stored.clip) - 1] = '\0';
+    if (stored.time_us < last_time_us) {
+        stored.time_us = last_time_us;
+        local_day(stored.time_us, local);
+    }
+
+    // The file is opened with O_APPEND, a single write() of a record is never interleaved with another.
+    if (write(events_fd, &stored, sizeof(stored)) != (ssize_t) sizeof(stored)) {
+        async_log(log_facility | LOG_ERR, "Error: Could not append a detection to %s%s.events : %m", directory.c_str(), day.c_str());
+        return false;
+    }
+    last_time_us = stored.time_us;
+
+    int minute = std::min(local.tm_hour * 60 + local.tm_min, DETECTION_MINUTES_PER_DAY - 1);
+    Minute_rollup& totals = rollup[minute];
+    ++totals.detections;
+    totals.humans += (stored.types & DETECTION_HUMAN) ? 1 : 0;
+    totals.faces += (stored.types & DETECTION_FACE) ? 1 : 0;
+    totals.motions += (stored.types & DETECTION_MOTION) ? 1 : 0;
+    totals.max_boxes = std::max(totals.max_boxes, stored.box_count);
+    totals.max_confidence = std::max(totals.max_confidence, stored.confidence);
+    return true;
+}
+
+
+bool Detection_store::append_tracks(vector<Track_record> tracks)
+{
+    if (directory.empty()) {
+        return false;
+    }
+
+    std::stable_sort(tracks.begin(), tracks.end(),
+                     [](const Track_record& first, const Track_record& second) { return first.time_us < second.time_us; });
+    bool ok = true;
+    for (Track_record& track : tracks) {
+        struct tm local;
+        string track_day = local_day(track.time_us, local);
+        if (track_day != day && !open_day(track_day)) {
+            return false;
+        }
+
+        track.clip[sizeof(track.clip) - 1] = '\0';
+        track.time_us = std::max(track.time_us, last_track_time_us);
+        if (write(tracks_fd, &track, sizeof(track)) != (ssize_t) sizeof(track)) {
+            async_log(log_facility | LOG_ERR, "Error: Could not append a track to %s%s.tracks : %m", directory.c_str(), day.c_str());
+            ok = false;
+            continue;
+        }
+        last_track_time_us = track.time_us;
+    }
+    return ok;
+}
+
+
+bool query_detections(const string& directory, int64_t from_us, int64_t to_us, vector<Detection_record>& records)
+{
+    bool ok = true;
+    int64_t day_start = from_us;
+    while (day_start < to_us) {
+        struct tm local;
+        string day = local_day(day_start, local);
+        int64_t day_end = next_local_midnight(local);
+
+        Mapped_file file(directory + day + ".events", events_magic, sizeof(Detection_record));
+        ok = ok && !file.failed;
+        if (file.data != nullptr) {
+            const Detection_record* first = reinterpret_cast<const Detection_record*>(file.data + sizeof(Store_header));
+            const Detection_record* last = first + (file.size - sizeof(Store_header)) / sizeof(Detection_record);
+            auto earlier = [](const Detection_record& record, int64_t time_us) { return record.time_us < time_us; };
+            const Detection_record* begin = std::lower_bound(first, last, day_start, earlier);
+            const Detection_record* end = std::lower_bound(begin, last, to_us, earlier);
+            records.insert(records.end(), begin, end);
+        }
+
+        day_start = day_end;
+    }
+    return ok;
+}
+
+
+bool query_rollup(const string& directory, int64_t from_us, int64_t to_us, vector<Minute_rollup>& minutes)
+{
+    minutes.clear();
+    Minute_rollup empty;
+    memset(&empty, 0, sizeof(empty));
+
+    bool ok = true;
+    string mapped_day;
+    std::unique_ptr<Mapped_file> file;
+    int64_t minute_start = from_us - from_us % minute_us;
+    while (minute_start < to_us) {
+        // The local time is looked up once per hour, which is as often as the clocks can change.
+        struct tm local;
+        string day = local_day(minute_start, local);
+        int64_t hour_end = minute_start + (60 - local.tm_min) * minute_us;
+        int64_t chunk_end = std::min(std::min(hour_end, next_local_midnight(local)), to_us);
+        int64_t count = (chunk_end - minute_start + minute_us - 1) / minute_us;
+        int first_minute = local.tm_hour * 60 + local.tm_min;
+
+        if (day != mapped_day) {
+            file.reset(new Mapped_file(directory + day + ".rollup", rollup_magic, sizeof(Minute_rollup)));
+            mapped_day = day;
+            ok = ok && !file->failed;
+        }
+        const Minute_rollup* day_minutes = nullptr;
+        if (file->data != nullptr && file->size >= rollup_file_size) {
+            day_minutes = reinterpret_cast<const Minute_rollup*>(file->data + sizeof(Store_header));
+        }
+
+        for (int64_t i = 0; i < count; ++i) {
+            // When the clocks are set back, the repeated hour shares the rollups of the first one.
+            int64_t minute = std::min<int64_t>(first_minute + i, DETECTION_MINUTES_PER_DAY - 1);
+            minutes.push_back(day_minutes != nullptr ? day_minutes[minute] : empty);
+        }
+
+        minute_start += count * minute_us;
+    }
+    return ok;
+}
+
+
+bool query_tracks(const string& directory, const Track_query& query, vector<Track_record>& tracks)
+{
+    bool ok = true;
+    int64_t day_start = query.from_us;
+    while (day_start < query.to_us) {
+        struct tm local;
+        string day = local_day(day_start, local);
+        int64_t day_end = next_local_midnight(local);
+
+        Mapped_file file(directory + day + ".tracks", tracks_magic, sizeof(Track_record));
+        ok = ok && !file.failed;
+        if (file.data != nullptr) {
+            const Track_record* first = reinterpret_cast<const Track_record*>(file.data + sizeof(Store_header));
+            const Track_record* last = first + (file.size - sizeof(Store_header)) / sizeof(Track_record);
+            auto earlier = [](const Track_record& track, int64_t time_us) { return track.time_us < time_us; };
+            const Track_record* begin = std::lower_bound(first, last, day_start, earlier);
+            const Track_record* end = std::lower_bound(begin, last, query.to_us, earlier);
+            for (const Track_record* track = begin; track != end; ++track) {
+                if ((query.camera == DETECTION_ANY_CAMERA || track->camera == query.camera)
+                    && (track->types & query.types) != 0
+                    && (track->cells & query.cells) != 0
+                    && track->dwell_ms >= query.min_dwell_ms) {
+                    tracks.push_back(*track);
+                }
+            }
+        }
+
+        day_start = day_end;
+    }
+    return ok;
+}
+
+
+uint64_t detection_grid_cells(double left, double top, double right, double bottom)
+{
+    left = std::max(left, 0.0);
+    top = std::max(top, 0.0);
+    right = std::min(right, 1.0);
+    bottom = std::min(bottom, 1.0);
+    if (right <= left || bottom <= top) {
+        return 0;
+    }
+
+    // A cell is covered when any part of it is, so a small box near the edge of a cell still finds it.
+    int first_column = std::min((int) (left * DETECTION_GRID_SIZE), DETECTION_GRID_SIZE - 1);
+    int first_row = std::min((int) (top * DETECTION_GRID_SIZE), DETECTION_GRID_SIZE - 1);
+    int last_column = std::min((int) std::ceil(right * DETECTION_GRID_SIZE) - 1, DETECTION_GRID_SIZE - 1);
+    int last_row = std::min((int) std::ceil(bottom * DETECTION_GRID_SIZE) - 1, DETECTION_GRID_SIZE - 1);
+    uint64_t cells = 0;
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int column = first_column; column <= last_column; ++column) {
+            cells |= (uint64_t) 1 << (row * DETECTION_GRID_SIZE + column);
+        }
+    }
+    return cells;
+}
@@ -0,0 +1,255 @@
+/**
+ * File Name:   detection_store.h
+ *
+ * Description:
+ * This file contains the declarations of the detection store, an append-only binary log of every
+ * detection the camera daemon recorded, which can be queried over months of history without reading
+ * it line by line, the way the syslog copies are.
+ *
+ * The store is a directory, $HOME/SmartCCTV_events/, with two files per day:
+ *     dd.MM.yyyy.events    A Store_header followed by one fixed size Detection_record per detection,
+ *                          in the order they were appended, which is also the order of their time.
+ *                          Since every record has the same size, the file is its own time index:
+ *                          a time range is found with a binary search over the mapped file.
+ *     dd.MM.yyyy.rollup    A Store_header followed by DETECTION_MINUTES_PER_DAY Minute_rollup, the
+ *                          totals of every minute of the day, updated in place as records are appended.
+ *                          Counting detections over a range reads one entry per minute, however many
+ *                          detections there were.
+ *     dd.MM.yyyy.tracks    A Store_header followed by one fixed size Track_record per person or face that
+ *                          was followed through a video, in the order of the time it first appeared.
+ *                          Like the events file, it is searched by time with a binary search, and the
+ *                          rest of a query (camera, kind, region of the frame, how long it stayed) is
+ *                          answered from the records themselves, without opening any video.
+ * The day and the minute of a record are those of the local time when the detection started.
+ */
+
+#ifndef DETECTION_STORE_H
+#define DETECTION_STORE_H
+
+#include <cstdint>  /* for std::uint16_t, std::int16_t, std::uint32_t, std::int32_t, std::int64_t, std::uint64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// The directory of the store, under the home directory.
+#define DETECTION_STORE_DIR "/SmartCCTV_events/"
+// The directory of the live stream and of the recordings of a video file (camera -1), in place of cameraN.
+#define DETECTION_FILE_CAMERA_DIR "camera_file"
+// The number of Minute_rollup in a rollup file.
+#define DETECTION_MINUTES_PER_DAY 1440
+
+// What was detected, these are combined with | in Detection_record::types.
+#define DETECTION_HUMAN  1
+#define DETECTION_FACE   2
+#define DETECTION_MOTION 4
+
+// The region of the frame a track was in is kept as the cells of a grid of this many by this many cells.
+#define DETECTION_GRID_SIZE 8
+// Track_query::camera for the tracks of every camera.
+#define DETECTION_ANY_CAMERA -2
+
+
+/**
+ * The header at the start of both files of a day.
+ */
+struct Store_header {
+    char magic[8];             // "SCCTVEV1" for an events file, "SCCTVRU1" for a rollup file.
+    std::uint32_t item_size;   // sizeof(Detection_record) or sizeof(Minute_rollup).
+    std::uint32_t reserved;
+};
+
+
+/**
+ * A single detection, from the moment it started a recording until the recording was saved.
+ */
+struct Detection_record {
+    std::int64_t time_us;       // When the detection started, in microseconds since the epoch.
+    std::int32_t duration_ms;   // How long the recording is.
+    std::int16_t camera;        // The camera number, -1 for a video file.
+    std::uint16_t types;        // DETECTION_HUMAN, DETECTION_FACE and DETECTION_MOTION, combined.
+    std::uint16_t box_count;    // The most people and faces found in a single frame.
+    std::uint16_t reserved;
+    float confidence;           // The highest HOG weight of a person found, 0 if none was.
+    char clip[40];              // The name of the video file in the recordings directory, '\0' terminated.
+};
+
+
+/**
+ * A person or face that was followed through a video, from the first frame it was found in to the last.
+ */
+struct Track_record {
+    std::int64_t time_us;       // When it first appeared, in microseconds since the epoch.
+    std::int32_t dwell_ms;      // How long from the first frame it was found in to the last.
+    std::int16_t camera;        // The camera number, -1 for a video file.
+    std::uint16_t types;        // DETECTION_HUMAN or DETECTION_FACE.
+    std::uint32_t track_id;     // The ID of its track, see box_tracker.h.
+    std::uint32_t first_frame;  // The index of the first frame of the video it was found in.
+    std::uint32_t last_frame;   // The index of the last frame of the video it was found in.
+    std::uint32_t offset_ms;    // When it first appeared, from the start of the video.
+    std::uint64_t cells;        // The cells of the grid its boxes covered, bit row * DETECTION_GRID_SIZE + column.
+    char clip[40];              // The name of the video file in the recordings directory, '\0' terminated.
+};
+
+
+/**
+ * What query_tracks() looks for.
+ */
+struct Track_query {
+    std::int64_t from_us = 0;                                // The first time a track may have appeared at.
+    std::int64_t to_us = 0;                                  // The end of that range, not included.
+    int camera = DETECTION_ANY_CAMERA;                       // The camera, or DETECTION_ANY_CAMERA.
+    std::uint16_t types = DETECTION_HUMAN | DETECTION_FACE;  // The kinds of tracks.
+    std::uint64_t cells = ~(std::uint64_t) 0;                // A track must have been in one of these cells.
+    std::int32_t min_dwell_ms = 0;                           // A track must have stayed at least this long.
+};
+
+
+/**
+ * The totals of the detections that started within one minute.
+ */
+struct Minute_rollup {
+    std::uint32_t detections;   // The number of detections.
+    std::uint16_t humans;       // How many of them found a person.
+    std::uint16_t faces;        // How many of them found a face.
+    std::uint16_t motions;      // How many of them found motion.
+    std::uint16_t max_boxes;    // The highest box_count.
+    float max_confidence;       // The highest confidence.
+};
+
+static_assert(sizeof(Store_header) == 16, "The store files are read and written as is");
+static_assert(sizeof(Detection_record) == 64, "The store files are read and written as is");
+static_assert(sizeof(Minute_rollup) == 16, "The store files are read and written as is");
+static_assert(sizeof(Track_record) == 80, "The store files are read and written as is");
+static_assert(DETECTION_GRID_SIZE * DETECTION_GRID_SIZE <= 64, "The cells of the grid are the bits of a std::uint64_t");
+
+
+class Detection_store {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * Nothing is written until open() is called.
+     */
+    Detection_store();
+
+    /**
+     * The destructor calls Detection_store::close().
+     */
+    ~Detection_store();
+
+    /**
+     * This function creates the directory of the store, if it is not there yet.
+     *
+     * @param const std::string& directory - The directory, ending in '/'.
+     *
+     * @return bool - true  if records can be appended.
+     *                false if the directory could not be created, the reason is written to the syslog.
+     */
+    bool open(const std::string& directory);
+
+    /**
+     * This function appends a record to the file of its day, and adds it to the rollup of its minute.
+     * A record older than the last one appended is stored at the time of the last one, which keeps
+     * the file in order when the wall clock steps backwards.
+     *
+     * @param const Detection_record& record - The record.
+     *
+     * @return bool - true if the record was written.
+     */
+    bool append(const Detection_record& record);
+
+    /**
+     * This function appends the tracks of a video to the files of their days.
+     * Like append(), a track older than the last one appended is stored at the time of the last one.
+     *
+     * @param std::vector<Track_record> tracks - The tracks, in any order.
+     *
+     * @return bool - true if every track was written.
+     */
+    bool append_tracks(std::vector<Track_record> tracks);
+
+    /**
+     * This function closes the files of the current day.
+     */
+    void close();
+
+  private:
+    /**
+     * This function closes the files of the current day and opens, or creates, those of the given day.
+     *
+     * @param const std::string& new_day - The day, as "dd.MM.yyyy".
+     *
+     * @return bool - true if both files are open.
+     */
+    bool open_day(const std::string& new_day);
+
+    std::string directory;     // The directory of the store, empty until open() is called.
+    std::string day;           // The day of the open files, as "dd.MM.yyyy".
+    int events_fd;             // The events file of the day, -1 if not open.
+    int tracks_fd;             // The tracks file of the day, -1 if not open.
+    Minute_rollup* rollup;     // The rollups of the day, mapped from the rollup file, nullptr if not open.
+    std::int64_t last_time_us; // The time of the last record in the events file.
+    std::int64_t last_track_time_us;  // The time of the last record in the tracks file.
+};
+
+
+/**
+ * This function reads every record whose time is within a range.
+ *
+ * @param const std::string& directory - The directory of the store, ending in '/'.
+ *
+ * @param std::int64_t from_us - The start of the range, in microseconds since the epoch.
+ *
+ * @param std::int64_t to_us - The end of the range, not included.
+ *
+ * @param std::vector<Detection_record>& records - The records are appended here, oldest first.
+ *
+ * @return bool - false if a file of the store could not be read, the reason is written to the syslog.
+ *                A day without detections has no file, which is not an error.
+ */
+bool query_detections(const std::string& directory, std::int64_t from_us, std::int64_t to_us,
+                      std::vector<Detection_record>& records);
+
+
+/**
+ * This function reads the rollups of every minute within a range.
+ *
+ * @param const std::string& directory - The directory of the store, ending in '/'.
+ *
+ * @param std::int64_t from_us - The start of the range, in microseconds since the epoch.
+ *
+ * @param std::int64_t to_us - The end of the range, not included.
+ *
+ * @param std::vector<Minute_rollup>& minutes - Set to one rollup per minute of the range, starting with
+ *                                              the minute from_us is in. Minutes of days without a file are zero.
+ *
+ * @return bool - false if a file of the store could not be read, the reason is written to the syslog.
+ */
+bool query_rollup(const std::string& directory, std::int64_t from_us, std::int64_t to_us,
+                  std::vector<Minute_rollup>& minutes);
+
+
+/**
+ * This function reads every track that matches a query.
+ *
+ * @param const std::string& directory - The directory of the store, ending in '/'.
+ *
+ * @param const Track_query& query - What to look for.
+ *
+ * @param std::vector<Track_record>& tracks - The tracks are appended here, in the order they appeared.
+ *
+ * @return bool - false if a file of the store could not be read, the reason is written to the syslog.
+ */
+bool query_tracks(const std::string& directory, const Track_query& query, std::vector<Track_record>& tracks);
+
+
+/**
+ * This function finds the cells of the grid a rectangle of the frame covers.
+ *
+ * @param double left, top, right, bottom - The rectangle, as fractions of the width and height of the frame,
+ *                                          from 0 to 1.
+ *
+ * @return std::uint64_t - The cells, bit row * DETECTION_GRID_SIZE + column, 0 if the rectangle is empty.
+ */
+std::uint64_t detection_grid_cells(double left, double top, double right, double bottom);
+
+
+#endif  /* DETECTION_STORE_H */
@@ -0,0 +1,169 @@
+/**
+ * File Name:   event_bus.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions of the event bus, through which the camera daemon
+ * and the LiveStream Viewer tell the GUI process what is happening.
+ */
+
+#include "event_bus.h"
+#include "async_log.h"
+
+#include <sys/stat.h>  /* for mode permissions constants */
+#include <fcntl.h>     /* for O_* constants */
+#include <mqueue.h>    /* for mqd_t, mq_open(), mq_send(), mq_receive(), mq_close(), mq_unlink() */
+#include <syslog.h>    /* for syslog() */
+#include <errno.h>     /* for errno */
+#include <atomic>      /* for std::atomic */
+#include <chrono>      /* for std::chrono::system_clock */
+#include <cstring>     /* for memset(), strncpy() */
+#include <mutex>       /* for std::mutex */
+
+using std::string;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+// The queue this process sends its events to, opened on the first event and kept open.
+// It is inherited by the daemon and the LiveStream Viewer when they are forked, which is fine,
+// since they send to the same queue.
+static mqd_t event_writer = (mqd_t) -1;
+// Guards event_writer, events are sent from more than one thread.
+static std::mutex event_writer_mutex;
+// The events this process dropped because the queue was full.
+static std::atomic<std::uint32_t> events_dropped(0);
+
+
+/**
+ * This helper function opens the queue for sending.
+ * It is called with event_writer_mutex locked.
+ *
+ * @return bool - true if the queue is open.
+ */
+static bool open_event_writer()
+{
+    if (event_writer != (mqd_t) -1) {
+        mq_close(event_writer);
+    }
+    event_writer = mq_open(EVENT_BUS_NAME, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    return event_writer != (mqd_t) -1;
+}
+
+
+Event make_event(Event_type type, Event_source source, int camera)
+{
+    Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.source = source;
+    event.camera = (std::int16_t) camera;
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    event.time_us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    return event;
+}
+
+
+bool post_event(const Event& event)
+{
+    Event sent = event;
+    sent.events_dropped = events_dropped;
+
+    std::lock_guard<std::mutex> lock(event_writer_mutex);
+    if (event_writer == (mqd_t) -1 && !open_event_writer()) {
+        async_log(log_facility | LOG_ERR, "Failed to open %s : %m", EVENT_BUS_NAME);
+        return false;
+    }
+
+    // Two tries: a queue that is full may be one that the GUI process has since removed and created anew
+    // (when it was restarted), so it is opened again before giving up on the event.
+    for (int tries = 0; tries < 2; ++tries) {
+        if (mq_send(event_writer, reinterpret_cast<const char*>(&sent), sizeof(sent), 0) == 0) {
+            return true;
+        }
+        if (errno != EAGAIN && errno != EBADF) {
+            break;
+        }
+        if (tries == 0 && !open_event_writer()) {
+            break;
+        }
+    }
+
+    ++events_dropped;
+    async_log(log_facility | LOG_ERR, "Failed to send event %d to %s : %m", (int) event.type, EVENT_BUS_NAME);
+    return false;
+}
+
+
+bool post_error(Error_code code, Event_source source, int camera, const string& detail)
+{
+    Event event = make_event(EVENT_ERROR, source, camera);
+    event.code = code;
+    strncpy(event.detail, detail.c_str(), sizeof(event.detail) - 1);
+    return post_event(event);
+}
+
+
+string describe_error(const Event& event)
+{
+    string process = (event.source == SOURCE_VIEWER) ? "LiveStream Viewer" : "SmartCCTV";
+    switch (event.code) {
+        case ERROR_UNEXPECTED_FAILURE: return process + " unexpected failure.";
+        case ERROR_PERMISSION_DENIED:  return process + " could not create " + event.detail;
+        case ERROR_CAMERA_OPEN_FAILED: return "SmartCCTV failed to open " + string(event.detail);
+        case ERROR_CORRUPT_FRAME:      return "SmartCCTV encountered an error.";
+        case ERROR_VIDEO_SAVE_FAILED:  return "SmartCCTV: something has gone wrong with saving the video.";
+        case ERROR_CONFIG_MISSING:     return "Cannot find project configuration files.";
+        case ERROR_TAMPERED:           return process + " has been tampered.";
+        case ERROR_DAEMON_TAMPERED:    return "Can't open LiveStream Viewer: SmartCCTV has been tampered.";
+        default:                       return process + " encountered an error.";
+    }
+}
+
+
+int open_event_bus()
+{
+    struct mq_attr mq_attributes;
+    memset(&mq_attributes, 0, sizeof(mq_attributes));
+    mq_attributes.mq_maxmsg = EVENT_BUS_CAPACITY;
+    mq_attributes.mq_msgsize = sizeof(Event);
+
+    // A queue left behind by a GUI process that crashed may have a different size of message.
+    mq_unlink(EVENT_BUS_NAME);
+    mqd_t event_bus = mq_open(EVENT_BUS_NAME, O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK, S_IRUSR | S_IWUSR, &mq_attributes);
+    if (event_bus == (mqd_t) -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the event bus %s : %m", EVENT_BUS_NAME);
+        return -1;
+    }
+
+    syslog(log_facility | LOG_NOTICE, "Creating %s", EVENT_BUS_NAME);
+    // On Linux a message queue descriptor is a file descriptor, so it can be waited on like a socket.
+    return (int) event_bus;
+}
+
+
+bool read_event(int event_bus, Event& event)
+{
+    // The buffer has to be as large as the largest message the queue allows, which is an Event.
+    ssize_t total_read = mq_receive((mqd_t) event_bus, reinterpret_cast<char*>(&event), sizeof(event), nullptr);
+    if (total_read == -1) {
+        if (errno != EAGAIN) {
+            syslog(log_facility | LOG_ERR, "Error: Could not read the event bus : %m");
+        }
+        return false;
+    }
+    if (total_read != (ssize_t) sizeof(event)) {
+        syslog(log_facility | LOG_ERR, "Error: Dropping a malformed event of %zd bytes", total_read);
+        return read_event(event_bus, event);
+    }
+    event.detail[sizeof(event.detail) - 1] = '\0';
+    return true;
+}
+
+
+void close_event_bus(int event_bus)
+{
+    syslog(log_facility | LOG_NOTICE, "Closing %s", EVENT_BUS_NAME);
+    mq_close((mqd_t) event_bus);
+    mq_unlink(EVENT_BUS_NAME);
+}
@@ -0,0 +1,173 @@
+/**
+ * File Name:   event_bus.h
+ *
+ * Description:
+ * This file contains the declarations of the event bus, through which the camera daemon and the LiveStream
+ * Viewer tell the GUI process what is happening: errors, detections, saved recordings and the statistics
+ * of every camera.
+ *
+ * Every event is a fixed size binary Event sent over a POSIX message queue created by the GUI process.
+ * The sending processes open the queue once and keep it open, and never block on it: if the GUI falls
+ * behind and the queue is full, the event is dropped and counted. The GUI process waits on the queue
+ * descriptor in its own event loop, so no signal handler is involved on either side.
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <cstdint>  /* for std::uint16_t, std::int16_t, std::uint32_t, std::int64_t, std::uint64_t */
+#include <string>   /* for std::string */
+
+// The name of the message queue of the event bus.
+#define EVENT_BUS_NAME "/SmartCCTV_Event_bus"
+// How many events the queue holds before events are dropped.
+#define EVENT_BUS_CAPACITY 10
+// How often the camera daemon sends the statistics of a camera.
+#define CAMERA_STATS_INTERVAL_US 1000000
+
+
+/**
+ * What an Event is about.
+ */
+enum Event_type : std::uint16_t {
+    EVENT_ERROR = 1,          // Something went wrong, see the Error_code.
+    EVENT_DETECTION_STARTED,  // A detection started a recording.
+    EVENT_RECORDING_SAVED,    // A recording was saved, the detail is the name of the video file.
+    EVENT_CAMERA_STATS,       // The statistics of a camera, sent once per CAMERA_STATS_INTERVAL_US.
+    EVENT_VIEWER_CLOSED,      // The LiveStream Viewer window was closed.
+};
+
+
+/**
+ * Which process sent an Event.
+ */
+enum Event_source : std::uint16_t {
+    SOURCE_GUI = 1,      // The GUI process, through the Daemon_facade.
+    SOURCE_DAEMON,       // The camera daemon.
+    SOURCE_VIEWER,       // The LiveStream Viewer.
+};
+
+
+/**
+ * What went wrong, for an EVENT_ERROR.
+ */
+enum Error_code : std::uint16_t {
+    ERROR_NONE = 0,
+    ERROR_UNEXPECTED_FAILURE,  // The process failed to set itself up, and stopped.
+    ERROR_PERMISSION_DENIED,   // A directory could not be created, the detail is its name.
+    ERROR_CAMERA_OPEN_FAILED,  // The camera or the video file could not be opened, the detail is the file name.
+    ERROR_CORRUPT_FRAME,       // The camera returned an empty frame, and the daemon stopped.
+    ERROR_VIDEO_SAVE_FAILED,   // A recording could not be saved, the daemon keeps running.
+    ERROR_CONFIG_MISSING,      // The project configuration files could not be found.
+    ERROR_TAMPERED,            // The PID file of the sending process was tampered with.
+    ERROR_DAEMON_TAMPERED,     // The LiveStream Viewer found the PID file of the daemon tampered with.
+};
+
+
+/**
+ * A single event. It is sent as is, so it only holds plain data of a fixed size.
+ */
+struct Event {
+    std::uint16_t type;              // Event_type
+    std::uint16_t source;            // Event_source
+    std::uint16_t code;              // Error_code, for an EVENT_ERROR.
+    std::int16_t camera;             // The camera number, -1 for a video file or when it does not apply.
+    std::int64_t time_us;            // When the event happened, in microseconds since the epoch.
+    float frames_per_second;         // EVENT_CAMERA_STATS: the frames captured per second.
+    float detection_ms;              // EVENT_CAMERA_STATS: the average time the detectors took per frame.
+    std::uint32_t frames_captured;   // EVENT_CAMERA_STATS: the frames captured since the daemon started.
+    std::uint32_t frames_streamed;   // EVENT_CAMERA_STATS: the frames published to the LiveStream Viewer.
+    std::uint32_t frames_skipped;    // EVENT_CAMERA_STATS: the frames skipped while the viewer was busy.
+    std::uint32_t events_dropped;    // The events this process dropped because the queue was full.
+    std::uint32_t clip_bytes;        // EVENT_RECORDING_SAVED: the size of the video.
+    float encode_ms;                 // EVENT_RECORDING_SAVED: how long it took to encode the video.
+    char detail[80];                 // A file name or a similar detail, always '\0' terminated.
+};
+
+static_assert(sizeof(Event) == 128, "An Event is sent as is, its layout must not change by accident");
+
+
+/**
+ * This function makes an Event of the given type, with the time and the source filled in.
+ *
+ * @param Event_type type - What the event is about.
+ *
+ * @param Event_source source - Which process is sending it.
+ *
+ * @param int camera - The camera number, -1 if it does not apply.
+ *
+ * @return Event - The event, with every other field zeroed.
+ */
+Event make_event(Event_type type, Event_source source, int camera);
+
+
+/**
+ * This function sends an event to the GUI process.
+ * The queue is opened on the first call and then kept open. It never blocks.
+ *
+ * @param const Event& event - The event.
+ *
+ * @return bool - true  if the event was sent.
+ *                false if the GUI is not running, or is not keeping up, the reason is written to the syslog.
+ */
+bool post_event(const Event& event);
+
+
+/**
+ * This function sends an EVENT_ERROR to the GUI process, which shows it to the user.
+ *
+ * @param Error_code code - What went wrong.
+ *
+ * @param Event_source source - Which process is sending it.
+ *
+ * @param int camera - The camera number, -1 if it does not apply.
+ *
+ * @param const std::string& detail - A file name or similar, cut to fit into Event::detail.
+ *
+ * @return bool - true if the event was sent.
+ */
+bool post_error(Error_code code, Event_source source, int camera = -1, const std::string& detail = "");
+
+
+/**
+ * This function makes the text shown to the user for an EVENT_ERROR.
+ *
+ * @param const Event& event - The event.
+ *
+ * @return std::string - The text, in English.
+ */
+std::string describe_error(const Event& event);
+
+
+/**
+ * This function creates the queue of the event bus. It is called by the GUI process once, at start up.
+ * A queue left behind by a GUI process that crashed is removed first.
+ *
+ * @return int - The descriptor of the queue, which becomes readable when an event arrives,
+ *               or -1 if it could not be created, the reason is written to the syslog.
+ */
+int open_event_bus();
+
+
+/**
+ * This function reads the next event from the queue, without blocking.
+ *
+ * @param int event_bus - The descriptor returned by open_event_bus().
+ *
+ * @param Event& event - Set to the event that was read.
+ *
+ * @return bool - true  if an event was read.
+ *                false if the queue is empty.
+ */
+bool read_event(int event_bus, Event& event);
+
+
+/**
+ * This function closes and removes the queue of the event bus. It is called by the GUI process when it exits.
+ *
+ * @param int event_bus - The descriptor returned by open_event_bus().
+ */
+void close_event_bus(int event_bus);
+
+
+#endif  /* EVENT_BUS_H */
@@ -11,7 +11,7 @@
  * Each instance of this class is to correspond to a single camera or video file.
  */
  
-#include "write_message.h"
+#include "event_bus.h"
 #include "low_level_cctv_daemon_apis.h"
 #include "faceFilter.hpp"
 #include <syslog.h>  /* for syslog() */
@@ -34,7 +34,7 @@ FaceFilter::FaceFilter()
         //Error state! Exit the daemon
         syslog(log_facility | LOG_ERR, "Error: $SmartCCTV_Project_dir environmental varaible not set : failed to identify project directory");
         syslog(log_facility | LOG_CRIT, "%s", error_message.c_str());
-        write_message("Cannot find project configuration files.");
+        post_error(ERROR_CONFIG_MISSING, SOURCE_DAEMON);
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
     }
@@ -46,38 +46,63 @@ FaceFilter::FaceFilter()
         //Error state! Exit the daemon
         syslog(log_facility | LOG_ERR, "Could not open %s", fullPath.c_str());
         syslog(log_facility | LOG_CRIT, "%s", error_message.c_str());
-        write_message("Cannot find project configuration files.");
+        post_error(ERROR_CONFIG_MISSING, SOURCE_DAEMON);
         daemon_data.daemon_exit_status = EXIT_FAILURE;
         terminate_daemon(0);
     }
 }
 
-bool FaceFilter::runRecognition(cv::Mat &frame)
+FaceFilter::FaceFilter(const std::string &cascadePath)
+{
+	//Outside of the daemon a missing cascade is not fatal, the faces are just not searched for
+	if (!cascade.load(cascadePath))
+	{
+		syslog(log_facility | LOG_WARNING, "Could not open %s, faces are not detected", cascadePath.c_str());
+	}
+}
+
+bool FaceFilter::isLoaded() const
+{
+	return !cascade.empty();
+}
+
+bool FaceFilter::runRecognition(const cv::Mat &frame, const Camera_config &config)
 {
     boxes.clear();
+    if(cascade.empty())
+    {
+		return false;
+	}
     cv::Mat gray, smallImg;
 
     cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
     equalizeHist(gray, gray);
-    cascade.detectMultiScale(gray, boxes, 1.1, 2, 0 | cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30));
+    cascade.detectMultiScale(gray, boxes, config.face_scale, config.face_min_neighbors, 0 | cv::CASCADE_SCALE_IMAGE,
+                             cv::Size(config.face_min_size, config.face_min_size));
     
     if(boxes.size() < 1)
     {
 		return false;
 	}
     
-    if(daemon_data.enable_outlines)
-    {
-		for(size_t i = 0; i < boxes.size(); i++)
-		{
-			cv::Rect &rect = boxes[i];        
-			rect.x += cvRound(rect.width*0.1);
-			rect.width = cvRound(rect.width*0.8);
-			rect.y += cvRound(rect.height*0.07);
-			rect.height = cvRound(rect.height*0.8);
-			rectangle(frame, rect.tl(), rect.br(), cv::Scalar(255, 0, 0), 2);
-		}
+	for(size_t i = 0; i < boxes.size(); i++)
+	{
+		cv::Rect &rect = boxes[i];        
+		rect.x += cvRound(rect.width*0.1);
+		rect.width = cvRound(rect.width*0.8);
+		rect.y += cvRound(rect.height*0.07);
+		rect.height = cvRound(rect.height*0.8);
 	}
     
     return true;
 }
+
+size_t FaceFilter::getBoxCount() const
+{
+	return boxes.size();
+}
+
+const std::vector<cv::Rect>& FaceFilter::getBoxes() const
+{
+	return boxes;
+}
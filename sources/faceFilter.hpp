@@ -21,12 +21,21 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include "camera_config.h"
 
 class FaceFilter
 {
 public:
 	FaceFilter();
-	bool runRecognition(cv::Mat &frame);
+	//Loads the cascade from a file instead of $SmartCCTV_Project_dir, for use outside of the daemon
+	//If it cannot be loaded, runRecognition() never finds a face
+	FaceFilter(const std::string &cascadePath);
+	bool isLoaded() const;
+	bool runRecognition(const cv::Mat &frame, const Camera_config &config);
+	//The number of faces found by the last runRecognition()
+	size_t getBoxCount() const;
+	//The faces found by the last runRecognition(), nothing is drawn into the frame
+	const std::vector<cv::Rect>& getBoxes() const;
     
 private:
 	cv::CascadeClassifier cascade;
@@ -0,0 +1,660 @@
+/**
+ * File Name:   filter_benchmark.cpp
+ *
+ * Description:
+ * This file contains SmartCCTV_bench, the microbenchmarks of the detection filters. It times the three filters of
+ * the camera daemon, and every step of them on its own, at a fixed set of resolutions, so a change to a filter or
+ * to its settings can be measured, and the runs before and after it compared.
+ *
+ * Usage:
+ *     SmartCCTV_bench [--only NAME,...] [--resolutions WxH,...] [--frames N] [--min-time MILLISECONDS]
+ *                     [--threads N] [--video FILE] [--no-synthetic] [--set SETTING=VALUE]...
+ *
+ * The benchmarks are:
+ *     human      HumanFilter::runRecognition()
+ *     face       FaceFilter::runRecognition(), with $SmartCCTV_Project_dir/cascade.xml
+ *     motion     MotionFilter::runDetection()
+ *     gray       the conversion to gray of the face and motion filters
+ *     blur       the blur of the motion filter, of a gray frame
+ *     absdiff    the difference of two blurred frames
+ *     threshold  the threshold and the dilation of the difference
+ *     contours   the contours of the thresholded difference
+ *     equalize   the histogram equalization of the face filter, of a gray frame
+ *     hog        the HOG people detector at the size of the frame only, without the smaller scales
+ *     cascade    the face cascade, of an equalized frame
+ * A step runs the same OpenCV call, with the same settings, as its filter, on inputs that were prepared before the
+ * timing starts. Its output is a new cv::Mat every time, as in the filter, so its allocations add up to the filter's.
+ *
+ * The frames are synthetic: a textured background with a figure that moves across it and sensor noise, which are
+ * the same in every run. With --video, the first frames of a recorded video are run as well, scaled to every
+ * resolution. A benchmark runs over all the frames once without being timed, then until --min-time has passed and
+ * it ran over them at least BENCH_MIN_PASSES times. OpenCV runs on one thread unless --threads says otherwise, so
+ * the runs of different machines and loads are comparable.
+ *
+ * The results are printed as tab separated values, one line per benchmark, source and resolution, after a header
+ * line, and the lines starting with '#' describe the run:
+ *     benchmark, source, width, height, frames, passes, ns_per_frame (the median of the passes), min_ns_per_frame,
+ *     frames_per_second, megapixels_per_second, allocations_per_frame, bytes_per_frame
+ * The allocations are those of operator new, and of the buffers of every cv::Mat, in OpenCV as well.
+ */
+
+#include "humanFilter.hpp"
+#include "faceFilter.hpp"
+#include "motionFilter.hpp"
+#include "camera_config.h"
+
+#include <opencv2/core.hpp>     /* for cv::Mat, cv::MatAllocator, cv::RNG, cv::setNumThreads() */
+#include <opencv2/imgproc.hpp>  /* for cv::cvtColor(), cv::GaussianBlur(), cv::threshold(), cv::findContours() */
+#include <opencv2/objdetect.hpp>  /* for cv::HOGDescriptor, cv::CascadeClassifier */
+#include <opencv2/videoio.hpp>  /* for cv::VideoCapture */
+#include <getopt.h>     /* for getopt_long(), struct option */
+#include <syslog.h>     /* for openlog() */
+#include <algorithm>    /* for std::sort(), std::max(), std::find(), std::remove_if() */
+#include <atomic>       /* for std::atomic */
+#include <chrono>       /* for std::chrono::steady_clock */
+#include <cstdint>      /* for std::uint64_t */
+#include <cstdio>       /* for printf(), fprintf() */
+#include <cstdlib>      /* for getenv(), strtol(), malloc(), free(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <cstring>      /* for strchr(), strlen() */
+#include <functional>   /* for std::function */
+#include <new>          /* for std::bad_alloc */
+#include <string>       /* for std::string */
+#include <vector>       /* for std::vector */
+
+// How many times a benchmark runs over all its frames at least, after the untimed pass.
+#define BENCH_MIN_PASSES 3
+// How long a benchmark runs at least, by default.
+#define BENCH_MIN_TIME_MS 1000
+// How many frames of every source and resolution are run, by default.
+#define BENCH_FRAMES 8
+
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+
+/*
+ * The allocations made while a benchmark runs.
+ */
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<uint64_t> allocated_bytes(0);
+
+
+/**
+ * This helper function counts an allocation.
+ *
+ * @param std::size_t size - How many bytes were allocated.
+ */
+static void count_allocation(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+
+/*
+ * Every operator new of the program, including those of OpenCV, is counted. The array and nothrow versions call
+ * this one.
+ */
+void* operator new(std::size_t size)
+{
+    count_allocation(size);
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    free(memory);
+}
+
+
+#if CV_VERSION_MAJOR >= 4
+typedef cv::AccessFlag Access_flags;
+#else
+typedef int Access_flags;
+#endif
+
+
+/**
+ * The buffers of cv::Mat are not allocated by operator new, so this allocator counts them before it leaves them to
+ * the standard one. The buffers it allocates are freed by the standard allocator as well.
+ */
+class Counting_allocator : public cv::MatAllocator {
+  public:
+    Counting_allocator()
+     : standard(cv::Mat::getStdAllocator())
+    {
+    }
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, Access_flags flags,
+                           cv::UMatUsageFlags usage) const override
+    {
+        cv::UMatData* buffer = standard->allocate(dims, sizes, type, data, step, flags, usage);
+        if (buffer != nullptr && data == nullptr) {
+            count_allocation(buffer->size);
+        }
+        return buffer;
+    }
+
+    bool allocate(cv::UMatData* buffer, Access_flags flags, cv::UMatUsageFlags usage) const override
+    {
+        return standard->allocate(buffer, flags, usage);
+    }
+
+    void deallocate(cv::UMatData* buffer) const override
+    {
+        standard->deallocate(buffer);
+    }
+
+  private:
+    cv::MatAllocator* standard;
+};
+
+
+/**
+ * The frames of a source at a resolution, and the inputs of the steps, prepared from them.
+ */
+struct Bench_input {
+    string source;            // "synthetic" or "recorded".
+    cv::Size size;
+    vector<cv::Mat> frames;   // In BGR, as they are captured.
+    vector<cv::Mat> gray;     // The frames in gray.
+    vector<cv::Mat> blurred;  // The gray frames blurred, as the motion filter compares them.
+    vector<cv::Mat> differences;  // Every blurred frame less the one before it.
+    vector<cv::Mat> masks;    // The differences thresholded and dilated.
+    vector<cv::Mat> equalized;  // The gray frames equalized, as the face filter searches them.
+};
+
+
+/**
+ * A benchmark: what it runs on one frame.
+ */
+struct Bench_case {
+    string name;
+    std::function<void(const Bench_input&, size_t)> run;
+};
+
+
+/**
+ * How long a benchmark took.
+ */
+struct Bench_result {
+    int passes;                   // How many times it ran over the frames, after the untimed pass.
+    double ns_per_frame;          // The median of the passes.
+    double min_ns_per_frame;      // The fastest pass.
+    double allocations_per_frame;
+    double bytes_per_frame;
+};
+
+
+/**
+ * This helper function prints how to use the tool.
+ *
+ * @param const char* program - The name the tool was run as.
+ */
+static void print_usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--only NAME,...] [--resolutions WxH,...] [--frames N] [--min-time MILLISECONDS]\n"
+            "       %*s [--threads N] [--video FILE] [--no-synthetic] [--set SETTING=VALUE]...\n"
+            "The benchmarks are human, face, motion, gray, blur, absdiff, threshold, contours, equalize, hog and cascade.\n"
+            "They run on %d frames at 640x360, 1280x720 and 1920x1080 for at least %d ms each, on 1 thread, by default.\n",
+            program, (int) strlen(program), "", BENCH_FRAMES, BENCH_MIN_TIME_MS);
+}
+
+
+/**
+ * This helper function reads a whole number.
+ *
+ * @param const char* text - The number.
+ *
+ * @param int& number - Set to the number.
+ *
+ * @param int minimum - The smallest number that is allowed.
+ *
+ * @return bool - false if the text is not such a number.
+ */
+static bool parse_number(const char* text, int& number, int minimum)
+{
+    char* end;
+    long value = strtol(text, &end, 10);
+    number = (int) value;
+    return *text != '\0' && *end == '\0' && value >= minimum && value <= 1000000;
+}
+
+
+/**
+ * This helper function splits a list separated by commas.
+ *
+ * @param const string& list - The list.
+ *
+ * @return vector<string> - Its items, without the empty ones.
+ */
+static vector<string> split_list(const string& list)
+{
+    vector<string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) {
+            comma = list.size();
+        }
+        if (comma > start) {
+            items.push_back(list.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return items;
+}
+
+
+/**
+ * This helper function reads a list of resolutions, such as "640x360,1280x720".
+ *
+ * @param const char* text - The list.
+ *
+ * @param vector<cv::Size>& sizes - Set to the resolutions.
+ *
+ * @return bool - false if one of them is not a resolution.
+ */
+static bool parse_resolutions(const char* text, vector<cv::Size>& sizes)
+{
+    sizes.clear();
+    for (const string& item : split_list(text)) {
+        size_t x = item.find('x');
+        int width, height;
+        if (x == string::npos || !parse_number(item.substr(0, x).c_str(), width, 64)
+            || !parse_number(item.substr(x + 1).c_str(), height, 128)) {
+            return false;
+        }
+        sizes.push_back(cv::Size(width, height));
+    }
+    return !sizes.empty();
+}
+
+
+/**
+ * This helper function makes the synthetic frames: a textured background, a figure walking across it, and noise.
+ * They are the same in every run, at the same size.
+ *
+ * @param cv::Size size - Their resolution.
+ *
+ * @param int count - How many frames to make.
+ *
+ * @return vector<cv::Mat> - The frames, in BGR.
+ */
+static vector<cv::Mat> make_synthetic_frames(cv::Size size, int count)
+{
+    cv::RNG rng(0x5CC7);
+
+    // Large blotches of color, like the objects of a scene, so the detectors have edges to look at.
+    cv::Mat blotches(std::max(size.height / 16, 2), std::max(size.width / 16, 2), CV_8UC3);
+    rng.fill(blotches, cv::RNG::UNIFORM, cv::Scalar::all(30), cv::Scalar::all(220));
+    cv::Mat background;
+    cv::resize(blotches, background, size, 0, 0, cv::INTER_LINEAR);
+
+    vector<cv::Mat> frames;
+    int height = size.height / 3;
+    int width = height / 3;
+    for (int i = 0; i < count; ++i) {
+        cv::Mat frame = background.clone();
+
+        // The figure moves by a tenth of its width every frame, as a person walking past at 25 fps would. Less than
+        // that is lost in the blur of the motion filter at 640x360, which would leave it nothing to find contours in.
+        int x = size.width / 8 + i * std::max(width / 10, 1);
+        int y = size.height / 2 - height / 2;
+        cv::Scalar clothes(60, 50, 140);
+        cv::circle(frame, cv::Point(x + width / 2, y + height / 10), height / 10, cv::Scalar(120, 150, 200), cv::FILLED);
+        cv::rectangle(frame, cv::Rect(x, y + height / 5, width, height * 2 / 5), clothes, cv::FILLED);
+        cv::rectangle(frame, cv::Rect(x + width / 8, y + height * 3 / 5, width / 3, height * 2 / 5), clothes, cv::FILLED);
+        cv::rectangle(frame, cv::Rect(x + width * 13 / 24, y + height * 3 / 5, width / 3, height * 2 / 5), clothes, cv::FILLED);
+
+        cv::Mat noise(size, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(3));
+        cv::add(frame, noise, frame, cv::noArray(), CV_8U);
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+
+/**
+ * This helper function reads the first frames of a video.
+ *
+ * @param const string& path - The video.
+ *
+ * @param int count - How many frames to read.
+ *
+ * @param vector<cv::Mat>& frames - Set to the frames, at the size of the video.
+ *
+ * @return bool - false if the video could not be opened, or does not have any frames.
+ */
+static bool read_recorded_frames(const string& path, int count, vector<cv::Mat>& frames)
+{
+    cv::VideoCapture video(path);
+    if (!video.isOpened()) {
+        return false;
+    }
+    cv::Mat frame;
+    while ((int) frames.size() < count && video.read(frame)) {
+        frames.push_back(frame.clone());
+    }
+    return !frames.empty();
+}
+
+
+/**
+ * This helper function prepares the inputs of the steps from the frames, the way the filters make them.
+ *
+ * @param Bench_input& input - Its frames are set, the rest is set from them.
+ *
+ * @param const Camera_config& config - The settings of the filters.
+ */
+static void prepare_input(Bench_input& input, const Camera_config& config)
+{
+    size_t count = input.frames.size();
+    input.gray.resize(count);
+    input.blurred.resize(count);
+    input.differences.resize(count);
+    input.masks.resize(count);
+    input.equalized.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        cv::cvtColor(input.frames[i], input.gray[i], cv::COLOR_BGR2GRAY);
+        cv::GaussianBlur(input.gray[i], input.blurred[i], cv::Size(21, 21), 0);
+        cv::equalizeHist(input.gray[i], input.equalized[i]);
+    }
+    // The first frame is compared with the last one, as the benchmarks go around the frames.
+    for (size_t i = 0; i < count; ++i) {
+        cv::absdiff(input.blurred[(i + count - 1) % count], input.blurred[i], input.differences[i]);
+        cv::threshold(input.differences[i], input.masks[i], config.motion_threshold, 255.0, cv::THRESH_BINARY);
+        cv::dilate(input.masks[i], input.masks[i], cv::Mat(), cv::Point(-1, -1), 2);
+    }
+}
+
+
+/**
+ * This helper function runs a benchmark over the frames of an input.
+ *
+ * @param const Bench_case& bench - The benchmark.
+ *
+ * @param const Bench_input& input - The frames.
+ *
+ * @param int min_time_ms - How long to run for at least.
+ *
+ * @return Bench_result - How long it took.
+ */
+static Bench_result run_benchmark(const Bench_case& bench, const Bench_input& input, int min_time_ms)
+{
+    typedef std::chrono::steady_clock Clock;
+    size_t count = input.frames.size();
+
+    // The first pass fills the caches and lets the filters allocate what they keep.
+    for (size_t i = 0; i < count; ++i) {
+        bench.run(input, i);
+    }
+
+    vector<double> pass_ns;
+    uint64_t allocations_before = allocation_count.load();
+    uint64_t bytes_before = allocated_bytes.load();
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::milliseconds(min_time_ms);
+    Clock::time_point pass_start = start;
+    do {
+        for (size_t i = 0; i < count; ++i) {
+            bench.run(input, i);
+        }
+        Clock::time_point pass_end = Clock::now();
+        pass_ns.push_back(std::chrono::duration<double, std::nano>(pass_end - pass_start).count());
+        pass_start = pass_end;
+    } while (pass_ns.size() < BENCH_MIN_PASSES || pass_start < end);
+    uint64_t allocations = allocation_count.load() - allocations_before;
+    uint64_t bytes = allocated_bytes.load() - bytes_before;
+
+    Bench_result result;
+    result.passes = (int) pass_ns.size();
+    double frames = (double) result.passes * count;
+    result.allocations_per_frame = allocations / frames;
+    result.bytes_per_frame = bytes / frames;
+    std::sort(pass_ns.begin(), pass_ns.end());
+    size_t middle = pass_ns.size() / 2;
+    double median_ns = pass_ns.size() % 2 == 1 ? pass_ns[middle] : (pass_ns[middle - 1] + pass_ns[middle]) / 2;
+    result.ns_per_frame = median_ns / count;
+    result.min_ns_per_frame = pass_ns.front() / count;
+    return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+    openlog("SmartCCTV_bench", LOG_PERROR, LOG_USER);
+
+    Camera_config config;
+    vector<cv::Size> sizes = { cv::Size(640, 360), cv::Size(1280, 720), cv::Size(1920, 1080) };
+    vector<string> only;
+    int frame_count = BENCH_FRAMES;
+    int min_time_ms = BENCH_MIN_TIME_MS;
+    int threads = 1;
+    string video_path;
+    bool synthetic = true;
+
+    static const struct option long_options[] = {
+        { "only",         required_argument, nullptr, 'o' },
+        { "resolutions",  required_argument, nullptr, 'r' },
+        { "frames",       required_argument, nullptr, 'f' },
+        { "min-time",     required_argument, nullptr, 'm' },
+        { "threads",      required_argument, nullptr, 't' },
+        { "video",        required_argument, nullptr, 'v' },
+        { "no-synthetic", no_argument,       nullptr, 'n' },
+        { "set",          required_argument, nullptr, 's' },
+        { "help",         no_argument,       nullptr, 'h' },
+        { nullptr,        0,                 nullptr, 0 }
+    };
+    int option;
+    while ( (option = getopt_long(argc, argv, "o:r:f:m:t:v:ns:h", long_options, nullptr)) != -1) {
+        bool valid = true;
+        switch (option) {
+          case 'o':
+            only = split_list(optarg);
+            valid = !only.empty();
+            break;
+          case 'r':
+            valid = parse_resolutions(optarg, sizes);
+            break;
+          case 'f':
+            valid = parse_number(optarg, frame_count, 1);
+            break;
+          case 'm':
+            valid = parse_number(optarg, min_time_ms, 0);
+            break;
+          case 't':
+            valid = parse_number(optarg, threads, 0);
+            break;
+          case 'v':
+            video_path = optarg;
+            break;
+          case 'n':
+            synthetic = false;
+            break;
+          case 's': {
+            const char* equals = strchr(optarg, '=');
+            string error;
+            valid = equals != nullptr
+                    && set_camera_config_value(config, string(optarg, equals - optarg), equals + 1, error);
+            if (!valid && !error.empty()) {
+                fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+            }
+            break;
+          }
+          case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+          default:
+            valid = false;
+        }
+        if (!valid) {
+            if (option != '?') {
+                fprintf(stderr, "%s: invalid value: %s\n", argv[0], optarg);
+            }
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc || (!synthetic && video_path.empty())) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // 0 leaves OpenCV on its default number of threads.
+    if (threads > 0) {
+        cv::setNumThreads(threads);
+    }
+    static Counting_allocator counting_allocator;
+    cv::Mat::setDefaultAllocator(&counting_allocator);
+
+    vector<cv::Mat> recorded;
+    if (!video_path.empty() && !read_recorded_frames(video_path, frame_count, recorded)) {
+        fprintf(stderr, "%s: could not read the frames of %s\n", argv[0], video_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    string cascade_path;
+    const char* project_directory = getenv("SmartCCTV_Project_dir");
+    if (project_directory != nullptr) {
+        cascade_path = string(project_directory) + "/cascade.xml";
+    }
+
+    // The filters and the detectors of the steps are made once, as the camera daemon makes them.
+    HumanFilter human_filter;
+    FaceFilter face_filter(cascade_path);
+    MotionFilter motion_filter;
+    cv::HOGDescriptor hog;
+    hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+    cv::CascadeClassifier cascade;
+    bool have_cascade = face_filter.isLoaded() && cascade.load(cascade_path);
+    cv::Mat contour_mask;
+
+    vector<Bench_case> benches = {
+        { "human", [&](const Bench_input& input, size_t i) {
+            human_filter.runRecognition(input.frames[i], config);
+        } },
+        { "face", [&](const Bench_input& input, size_t i) {
+            face_filter.runRecognition(input.frames[i], config);
+        } },
+        { "motion", [&](const Bench_input& input, size_t i) {
+            motion_filter.runDetection(input.frames[i], config);
+        } },
+        { "gray", [](const Bench_input& input, size_t i) {
+            cv::Mat gray;
+            cv::cvtColor(input.frames[i], gray, cv::COLOR_BGR2GRAY);
+        } },
+        { "blur", [](const Bench_input& input, size_t i) {
+            cv::Mat blurred;
+            cv::GaussianBlur(input.gray[i], blurred, cv::Size(21, 21), 0);
+        } },
+        { "absdiff", [](const Bench_input& input, size_t i) {
+            cv::Mat difference;
+            cv::absdiff(input.blurred[(i + input.blurred.size() - 1) % input.blurred.size()], input.blurred[i], difference);
+        } },
+        { "threshold", [&](const Bench_input& input, size_t i) {
+            cv::Mat mask;
+            cv::threshold(input.differences[i], mask, config.motion_threshold, 255.0, cv::THRESH_BINARY);
+            cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+        } },
+        { "contours", [&](const Bench_input& input, size_t i) {
+            // The motion filter copies the mask into the one it keeps first as well, findContours() may modify it.
+            input.masks[i].copyTo(contour_mask);
+            vector<vector<cv::Point>> contours;
+            cv::findContours(contour_mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+        } },
+        { "equalize", [](const Bench_input& input, size_t i) {
+            cv::Mat equalized;
+            cv::equalizeHist(input.gray[i], equalized);
+        } },
+        { "hog", [&](const Bench_input& input, size_t i) {
+            vector<cv::Point> hits;
+            vector<double> weights;
+            hog.detect(input.frames[i], hits, weights, config.hog_threshold, cv::Size(8, 8), cv::Size());
+        } },
+        { "cascade", [&](const Bench_input& input, size_t i) {
+            vector<cv::Rect> faces;
+            cascade.detectMultiScale(input.equalized[i], faces, config.face_scale, config.face_min_neighbors,
+                                     0 | cv::CASCADE_SCALE_IMAGE, cv::Size(config.face_min_size, config.face_min_size));
+        } },
+    };
+
+    for (const string& name : only) {
+        bool known = false;
+        for (const Bench_case& bench : benches) {
+            known = known || bench.name == name;
+        }
+        if (!known) {
+            fprintf(stderr, "%s: there is no benchmark %s\n", argv[0], name.c_str());
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!have_cascade) {
+        fprintf(stderr, "%s: there is no cascade.xml in $SmartCCTV_Project_dir, skipping face and cascade\n", argv[0]);
+        benches.erase(std::remove_if(benches.begin(), benches.end(), [](const Bench_case& bench) {
+            return bench.name == "face" || bench.name == "cascade";
+        }), benches.end());
+    }
+
+    printf("# OpenCV %s, %d threads, %d frames, at least %d ms and %d passes\n", CV_VERSION, cv::getNumThreads(),
+           frame_count, min_time_ms, BENCH_MIN_PASSES);
+    printf("# %s\n", video_path.empty() ? "no recorded frames" : ("recorded frames from " + video_path).c_str());
+    printf("benchmark\tsource\twidth\theight\tframes\tpasses\tns_per_frame\tmin_ns_per_frame\tframes_per_second"
+           "\tmegapixels_per_second\tallocations_per_frame\tbytes_per_frame\n");
+    fflush(stdout);
+
+    for (const cv::Size& size : sizes) {
+        vector<Bench_input> inputs;
+        if (synthetic) {
+            Bench_input input;
+            input.source = "synthetic";
+            input.frames = make_synthetic_frames(size, frame_count);
+            inputs.push_back(input);
+        }
+        if (!recorded.empty()) {
+            Bench_input input;
+            input.source = "recorded";
+            for (const cv::Mat& frame : recorded) {
+                cv::Mat scaled;
+                cv::resize(frame, scaled, size, 0, 0, cv::INTER_AREA);
+                input.frames.push_back(scaled);
+            }
+            inputs.push_back(input);
+        }
+
+        for (Bench_input& input : inputs) {
+            input.size = size;
+            prepare_input(input, config);
+            // The motion filter compares every frame with the one before it, which has to be of the same size.
+            motion_filter = MotionFilter();
+            for (const Bench_case& bench : benches) {
+                if (!only.empty() && std::find(only.begin(), only.end(), bench.name) == only.end()) {
+                    continue;
+                }
+                Bench_result result = run_benchmark(bench, input, min_time_ms);
+                printf("%s\t%s\t%d\t%d\t%zu\t%d\t%.0f\t%.0f\t%.2f\t%.2f\t%.1f\t%.0f\n", bench.name.c_str(),
+                       input.source.c_str(), size.width, size.height, input.frames.size(), result.passes,
+                       result.ns_per_frame, result.min_ns_per_frame, 1e9 / result.ns_per_frame,
+                       size.area() / 1e6 * 1e9 / result.ns_per_frame, result.allocations_per_frame,
+                       result.bytes_per_frame);
+                fflush(stdout);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
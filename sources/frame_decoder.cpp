@@ -0,0 +1,332 @@
+/**
+ * File Name:   frame_decoder.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Frame_decoder class's methods.
+ * An instance of this class decodes the live stream frames on a separate thread, so that the render loop
+ * of the LiveStream Viewer Window only has to upload and present them.
+ */
+
+#include "frame_decoder.h"
+#include "livestream_protocol.h"
+
+#include <sys/eventfd.h>  /* for eventfd() */
+#include <sys/stat.h>     /* for fstat() */
+#include <fcntl.h>        /* for open() */
+#include <syslog.h>       /* for syslog() */
+#include <unistd.h>       /* for close(), read(), write(), unlink() */
+#include <errno.h>        /* for errno */
+#include <cstring>        /* for strerror(), memcpy(), memcmp() */
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+/**
+ * This helper function deletes a frame file that the viewer is done with.
+ */
+static void delete_frame_file(const string& image_file)
+{
+    if (unlink(image_file.c_str()) == -1) {
+        const char* const error_message = strerror(errno);
+        syslog(log_facility | LOG_ERR, "Error cannot delete %s : %s", image_file.c_str(), error_message);
+    }
+}
+
+
+Frame_decoder::Frame_decoder()
+ : running(false), has_request(false), requested_sequence(0), requested_capture_time(0),
+   back_ready(false), buffers(), front(0), notify_fd(-1), dropped(0), wants_keyframe(false),
+   canvas(), canvas_valid(false), handed_dirty(), handed_full(true)
+{
+    //
+}
+
+
+Frame_decoder::~Frame_decoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake_up.notify_all();
+    if (decoder_thread.joinable()) {
+        decoder_thread.join();
+    }
+    if (notify_fd != -1) {
+        close(notify_fd);
+    }
+}
+
+
+bool Frame_decoder::start()
+{
+    if ( (notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the decoder eventfd : %m");
+        return false;
+    }
+
+    running = true;
+    decoder_thread = std::thread(&Frame_decoder::decode_loop, this);
+    return true;
+}
+
+
+int Frame_decoder::notification_fd() const
+{
+    return notify_fd;
+}
+
+
+void Frame_decoder::request(const string& image_file, std::uint64_t sequence, std::int64_t capture_time_us)
+{
+    string superseded_file;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (has_request) {
+            superseded_file = requested_file;
+        }
+        requested_file = image_file;
+        requested_sequence = sequence;
+        requested_capture_time = capture_time_us;
+        has_request = true;
+    }
+    wake_up.notify_all();
+
+    // The decoder did not get to the earlier frame before a newer one arrived, so it is never shown.
+    if (!superseded_file.empty()) {
+        delete_frame_file(superseded_file);
+        ++dropped;
+    }
+}
+
+
+const Decoded_frame* Frame_decoder::acquire()
+{
+    // Reset the eventfd counter, the render loop is about to take what is ready.
+    std::uint64_t counter = 0;
+    if (read(notify_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN) {
+        syslog(log_facility | LOG_ERR, "Error: Could not read the decoder eventfd : %m");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!back_ready) {
+            return nullptr;
+        }
+        // Swap the buffers: the completed back buffer becomes the front buffer.
+        front = 1 - front;
+        back_ready = false;
+    }
+    // The decoder thread may be waiting for the back buffer to be free again.
+    wake_up.notify_all();
+
+    return &buffers[front];
+}
+
+
+std::uint64_t Frame_decoder::frames_dropped() const
+{
+    return dropped;
+}
+
+
+bool Frame_decoder::keyframe_needed()
+{
+    return wants_keyframe.exchange(false);
+}
+
+
+void Frame_decoder::decode_loop()
+{
+    while (true) {
+        string image_file;
+        Decoded_frame* back = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Wait until there is something to decode, and the back buffer is not still waiting to be acquired.
+            wake_up.wait(lock, [this] { return !running || (has_request && !back_ready); });
+            if (!running) {
+                return;
+            }
+            image_file = requested_file;
+            has_request = false;
+            back = &buffers[1 - front];
+            back->sequence = requested_sequence;
+            back->capture_time_us = requested_capture_time;
+        }
+
+        // The render loop only ever touches the front buffer, so the back buffer is decoded without the lock.
+        bool decoded = decode_tiles(image_file, *back);
+        // Delete the file as soon as it is read, so the camera daemon can publish the next frame while this
+        // one is being presented.
+        delete_frame_file(image_file);
+        if (!decoded) {
+            // The render loop is woken up all the same, so it can ask for a keyframe right away.
+            if (wants_keyframe) {
+                std::uint64_t one = 1;
+                if (write(notify_fd, &one, sizeof(one)) == -1) {
+                    syslog(log_facility | LOG_ERR, "Error: Could not signal the decoder eventfd : %m");
+                }
+            }
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            back_ready = true;
+        }
+        std::uint64_t one = 1;
+        if (write(notify_fd, &one, sizeof(one)) == -1) {
+            syslog(log_facility | LOG_ERR, "Error: Could not signal the decoder eventfd : %m");
+        }
+    }
+}
+
+
+bool Frame_decoder::decode_tiles(const string& frame_file, Decoded_frame& frame)
+{
+    int fd = open(frame_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        syslog(log_facility | LOG_ERR, "Error opening frame %s : %m", frame_file.c_str());
+        return false;
+    }
+    struct stat file_status;
+    bool read_whole_file = false;
+    if (fstat(fd, &file_status) == 0) {
+        file_buffer.resize(file_status.st_size);
+        read_whole_file = read(fd, file_buffer.data(), file_buffer.size()) == (ssize_t) file_buffer.size();
+    }
+    close(fd);
+
+    Livestream_frame_header header;
+    if (!read_whole_file || file_buffer.size() < sizeof(header)) {
+        syslog(log_facility | LOG_ERR, "Error reading frame %s", frame_file.c_str());
+        return false;
+    }
+    memcpy(&header, file_buffer.data(), sizeof(header));
+
+    size_t index_bytes = (size_t) header.tile_count * sizeof(Livestream_tile_index);
+    if (memcmp(header.magic, LIVESTREAM_FRAME_MAGIC, sizeof(header.magic)) != 0 || header.version != LIVESTREAM_FRAME_VERSION
+        || header.width == 0 || header.height == 0 || header.tile_size == 0
+        || sizeof(header) + index_bytes > file_buffer.size()) {
+        syslog(log_facility | LOG_ERR, "Error: %s is not a live stream frame", frame_file.c_str());
+        return false;
+    }
+
+    // A frame that is not a keyframe only makes sense on top of the frame it is based on.
+    if (!header.keyframe && (!canvas_valid || header.base_sequence != canvas.sequence
+                             || (int) header.width != canvas.width || (int) header.height != canvas.height)) {
+        wants_keyframe = true;
+        return false;
+    }
+
+    if (header.keyframe) {
+        canvas.width = header.width;
+        canvas.height = header.height;
+        canvas.pitch = header.width * 4;
+        canvas.pixels.resize((size_t) canvas.pitch * canvas.height);
+    }
+
+    const Livestream_tile_index* tiles = reinterpret_cast<const Livestream_tile_index*>(file_buffer.data() + sizeof(header));
+    const char* tile_pixels = file_buffer.data() + sizeof(header) + index_bytes;
+    const char* end = file_buffer.data() + file_buffer.size();
+
+    // The changes of this frame are collected here.
+    std::vector<Dirty_rect>& changed = frame.dirty;
+    changed.clear();
+    for (std::uint32_t i = 0; i < header.tile_count; ++i) {
+        // The index is copied out, since nothing keeps it aligned inside of the file.
+        Livestream_tile_index tile;
+        memcpy(&tile, &tiles[i], sizeof(tile));
+        int tile_width = 0;
+        int tile_height = 0;
+        if (!livestream_tile_size(header, tile, tile_width, tile_height)
+            || tile_pixels + (size_t) tile_width * tile_height * 3 > end) {
+            syslog(log_facility | LOG_ERR, "Error: %s is corrupt", frame_file.c_str());
+            canvas_valid = false;
+            wants_keyframe = true;
+            return false;
+        }
+
+        Dirty_rect rect = { (int) (tile.column * header.tile_size), (int) (tile.row * header.tile_size), tile_width, tile_height };
+        unsigned char* destination = canvas.pixels.data() + (size_t) rect.y * canvas.pitch + (size_t) rect.x * 4;
+        // The camera daemon sends the pixels the way OpenCV stores them, as blue, green, red bytes.
+        SDL_ConvertPixels(tile_width, tile_height, SDL_PIXELFORMAT_BGR24, tile_pixels, tile_width * 3,
+                          SDL_PIXELFORMAT_ARGB8888, destination, canvas.pitch);
+        tile_pixels += (size_t) tile_width * tile_height * 3;
+        changed.push_back(rect);
+    }
+
+    // The boxes are only drawn over the frame, a frame whose boxes are cut short is still shown without them.
+    frame.boxes.clear();
+    size_t box_bytes = (size_t) header.box_count * sizeof(Metadata_box);
+    if (box_bytes > 0 && tile_pixels + box_bytes <= end) {
+        frame.boxes.resize(header.box_count);
+        memcpy(frame.boxes.data(), tile_pixels, box_bytes);
+    }
+    frame.motion = header.motion;
+    canvas.sequence = header.sequence;
+    canvas_valid = true;
+
+    // The buffer was last handed over two frames ago, so it is also missing what changed in the frame
+    // handed over last. Those parts are copied from the canvas along with the parts that changed now.
+    bool full_update = header.keyframe || handed_full || frame.width != canvas.width || frame.height != canvas.height;
+    frame.width = canvas.width;
+    frame.height = canvas.height;
+    frame.pitch = canvas.pitch;
+    frame.pixels.resize(canvas.pixels.size());
+    if (full_update) {
+        memcpy(frame.pixels.data(), canvas.pixels.data(), canvas.pixels.size());
+    } else {
+        for (const std::vector<Dirty_rect>* rects : { &handed_dirty, &changed }) {
+            for (const Dirty_rect& rect : *rects) {
+                for (int row = rect.y; row < rect.y + rect.height; ++row) {
+                    size_t offset = (size_t) row * canvas.pitch + (size_t) rect.x * 4;
+                    memcpy(frame.pixels.data() + offset, canvas.pixels.data() + offset, (size_t) rect.width * 4);
+                }
+            }
+        }
+    }
+    handed_dirty = changed;
+    handed_full = header.keyframe;
+
+    frame.full_update = header.keyframe;
+    frame.encoded_bytes = file_buffer.size();
+    frame.time_shift_ms = header.time_shift_ms;
+    return true;
+}
+
+
+bool Frame_decoder::decode_image(const string& image_file, Decoded_frame& frame)
+{
+    SDL_Surface* surface = IMG_Load(image_file.c_str());
+    if (surface == nullptr) {
+        syslog(log_facility | LOG_ERR, "Error opening image %s : %s", image_file.c_str(), SDL_GetError());
+        return false;
+    }
+
+    frame.width = surface->w;
+    frame.height = surface->h;
+    frame.pitch = surface->w * 4;
+    // resize() only allocates when the resolution grows, so the buffers are re-used frame after frame.
+    frame.pixels.resize((size_t) frame.pitch * frame.height);
+
+    int result = SDL_ConvertPixels(surface->w, surface->h, surface->format->format, surface->pixels, surface->pitch,
+                                   SDL_PIXELFORMAT_ARGB8888, frame.pixels.data(), frame.pitch);
+    frame.full_update = true;
+    frame.dirty.clear();
+    frame.encoded_bytes = 0;
+    frame.time_shift_ms = 0;
+    frame.boxes.clear();
+    frame.motion = METADATA_MOTION_UNKNOWN;
+    SDL_FreeSurface(surface);
+    if (result != 0) {
+        syslog(log_facility | LOG_ERR, "Error converting image %s : %s", image_file.c_str(), SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
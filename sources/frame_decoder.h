@@ -0,0 +1,184 @@
+/**
+ * File Name:   frame_decoder.h
+ *
+ * Description:
+ * This file contains the declaration of the Frame_decoder class.
+ * An instance of this class decodes the live stream frames on a separate thread, so that the render loop
+ * of the LiveStream Viewer Window only has to upload and present them.
+ *
+ * Decoding is double buffered: the decoder thread fills the back buffer while the render loop owns the front
+ * buffer. When the back buffer is complete it is handed over, and the render loop is notified through
+ * notification_fd(), which can be polled together with other file descriptors.
+ *
+ * The published frames only carry the tiles that changed (see livestream_protocol.h), so the decoder thread
+ * keeps the whole picture of the camera in a canvas and patches the tiles onto it. A handed over frame lists
+ * the rectangles that changed since the frame handed over before it, so only those have to be uploaded.
+ * When a frame does not fit onto the canvas, because a frame before it was missed, the decoder waits for a
+ * keyframe and says so through keyframe_needed().
+ */
+
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include "frame_metadata.h"
+
+#include <atomic>               /* for std::atomic */
+#include <condition_variable>   /* for std::condition_variable */
+#include <cstdint>              /* for std::uint64_t, std::int64_t */
+#include <mutex>                /* for std::mutex */
+#include <string>               /* for std::string */
+#include <thread>               /* for std::thread */
+#include <vector>               /* for std::vector */
+
+using std::string;
+
+
+/**
+ * A rectangle of a frame, in pixels.
+ */
+struct Dirty_rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+
+/**
+ * A decoded image in SDL_PIXELFORMAT_ARGB8888, ready to be copied into a streaming texture.
+ */
+struct Decoded_frame {
+    std::vector<unsigned char> pixels;  // The pixel rows, pitch bytes apart.
+    int width;                          // The width of the image in pixels.
+    int height;                         // The height of the image in pixels.
+    int pitch;                          // The length of a row in bytes.
+    std::uint64_t sequence;             // The sequence number of the frame.
+    std::int64_t capture_time_us;       // When the frame was captured, in microseconds since the epoch.
+    bool full_update;                   // Did the whole image change? If so, dirty is not used.
+    std::vector<Dirty_rect> dirty;      // The only parts of the image that changed since the previous frame.
+    std::uint64_t encoded_bytes;        // The size of the file the frame was decoded from.
+    std::uint32_t time_shift_ms;        // How far behind the live picture the frame is replayed, 0 if live.
+    std::vector<Metadata_box> boxes;    // The people and faces found in the frame, in pixels of the frame.
+    std::uint32_t motion;               // METADATA_MOTION_UNKNOWN, METADATA_MOTION_NONE or METADATA_MOTION_FOUND.
+};
+
+
+class Frame_decoder {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * The decoder thread is not started until start() is called.
+     */
+    Frame_decoder();
+
+    /**
+     * The destructor stops and joins the decoder thread.
+     */
+    ~Frame_decoder();
+
+    /**
+     * This function starts the decoder thread.
+     *
+     * @return bool - true  if the decoder is running.
+     *                false if it could not be started, the reason is written to the syslog.
+     */
+    bool start();
+
+    /**
+     * @return int - A file descriptor that becomes readable when a decoded frame is ready to be acquired.
+     */
+    int notification_fd() const;
+
+    /**
+     * This function asks the decoder thread to decode a published frame.
+     * The frame file is deleted once it has been read, which tells the camera daemon that the viewer
+     * is ready for the next one.
+     * If an earlier request has not been started yet, it is dropped in favor of this one and its file
+     * is deleted without being decoded.
+     *
+     * @param const string& image_file - The full name of the frame file, including the absolute path to it.
+     *
+     * @param std::uint64_t sequence - The sequence number of the frame.
+     *
+     * @param std::int64_t capture_time_us - When the frame was captured.
+     */
+    void request(const string& image_file, std::uint64_t sequence, std::int64_t capture_time_us);
+
+    /**
+     * This function takes over the newest decoded frame.
+     * The returned frame stays valid, and is not touched by the decoder thread, until the next call.
+     *
+     * @return const Decoded_frame* - The newest decoded frame, or nullptr if no new frame is ready.
+     */
+    const Decoded_frame* acquire();
+
+    /**
+     * @return std::uint64_t - The number of frames that were dropped before being decoded.
+     */
+    std::uint64_t frames_dropped() const;
+
+    /**
+     * This function tells whether a frame was thrown away because it did not fit onto the canvas.
+     * It only says so once per such frame.
+     *
+     * @return bool - true if the camera daemon should be asked for a keyframe.
+     */
+    bool keyframe_needed();
+
+    /**
+     * This function decodes an image file into a Decoded_frame on the calling thread.
+     * The pixel buffer of the Decoded_frame is re-used if it is large enough.
+     *
+     * @param const string& image_file - The full name of the image file.
+     *
+     * @param Decoded_frame& frame - The frame to decode into.
+     *
+     * @return bool - true  if the image was decoded.
+     *                false otherwise, the reason is written to the syslog.
+     */
+    static bool decode_image(const string& image_file, Decoded_frame& frame);
+
+  private:
+    /**
+     * This function is the body of the decoder thread.
+     */
+    void decode_loop();
+
+    /**
+     * This function patches the tiles of a published frame onto the canvas, and then copies what changed
+     * into a Decoded_frame.
+     * It is only called on the decoder thread.
+     *
+     * @param const string& frame_file - The full name of the published frame.
+     *
+     * @param Decoded_frame& frame - The frame to copy the changes into. It must be the buffer that was
+     *                               handed over two frames ago, or a new one.
+     *
+     * @return bool - true  if the frame was decoded.
+     *                false otherwise, the reason is written to the syslog.
+     */
+    bool decode_tiles(const string& frame_file, Decoded_frame& frame);
+
+    std::thread decoder_thread;           // Decodes the requested frames.
+    std::mutex mutex;                     // Guards everything below it.
+    std::condition_variable wake_up;      // Signals a new request, a consumed buffer, or stopping.
+    bool running;                         // Is the decoder thread supposed to keep running?
+    bool has_request;                     // Is there a request waiting to be decoded?
+    string requested_file;                // The file of the waiting request.
+    std::uint64_t requested_sequence;     // The sequence number of the waiting request.
+    std::int64_t requested_capture_time;  // The capture time of the waiting request.
+    bool back_ready;                      // Is the back buffer complete and waiting to be acquired?
+    Decoded_frame buffers[2];             // The front and the back buffer.
+    int front;                            // The index of the front buffer, owned by the render loop.
+    int notify_fd;                        // An eventfd signalled whenever the back buffer becomes ready.
+    std::atomic<std::uint64_t> dropped;   // The number of frames dropped before being decoded.
+    std::atomic<bool> wants_keyframe;     // Was a frame thrown away because it did not fit onto the canvas?
+    Decoded_frame canvas;                 // The whole picture, only accessed by the decoder thread.
+    bool canvas_valid;                    // Has the canvas been filled by a keyframe?
+    std::vector<Dirty_rect> handed_dirty; // What changed in the frame handed over last.
+    bool handed_full;                     // Did the whole frame change in the frame handed over last?
+    std::vector<char> file_buffer;        // The contents of the frame being decoded, re-used for every frame.
+};
+
+
+#endif  /* FRAME_DECODER_H */
@@ -0,0 +1,213 @@
+/**
+ * File Name:   frame_metadata.cpp
+ *
+ * Description:
+ * This file contains the implementation of the functions that scale, write and read the metadata of the frames,
+ * and of the Track_summarizer class's methods.
+ */
+
+#include "frame_metadata.h"
+#include "async_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for fstat(), mode permissions constants */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for read(), write(), close(), unlink() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <algorithm>    /* for std::min() */
+#include <cstdio>       /* for rename() */
+#include <cstring>      /* for memcmp(), memcpy(), memset(), strncpy() */
+
+using std::string;
+using std::vector;
+using std::uint32_t;
+using std::int64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// The first 8 bytes of a metadata file.
+static const char metadata_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'M', 'D', '1' };
+
+
+void scale_metadata_boxes(const vector<Metadata_box>& boxes, int from_width, int from_height,
+                          int to_width, int to_height, vector<Metadata_box>& scaled)
+{
+    scaled = boxes;
+    if (from_width <= 0 || from_height <= 0 || (from_width == to_width && from_height == to_height)) {
+        return;
+    }
+    double x_scale = (double) to_width / from_width;
+    double y_scale = (double) to_height / from_height;
+    for (Metadata_box& box : scaled) {
+        box.x = (std::uint16_t) (box.x * x_scale);
+        box.y = (std::uint16_t) (box.y * y_scale);
+        box.width = (std::uint16_t) (box.width * x_scale + 0.5);
+        box.height = (std::uint16_t) (box.height * y_scale + 0.5);
+    }
+}
+
+
+void append_metadata_record(vector<char>& records, uint32_t frame, int64_t capture_time_us, const Frame_metadata& metadata)
+{
+    Metadata_frame_header header;
+    memset(&header, 0, sizeof(header));
+    header.capture_time_us = capture_time_us;
+    header.frame = frame;
+    header.motion = metadata.motion;
+    header.box_count = (std::uint16_t) std::min<size_t>(metadata.boxes.size(), UINT16_MAX);
+
+    const char* header_bytes = reinterpret_cast<const char*>(&header);
+    records.insert(records.end(), header_bytes, header_bytes + sizeof(header));
+    const char* box_bytes = reinterpret_cast<const char*>(metadata.boxes.data());
+    records.insert(records.end(), box_bytes, box_bytes + header.box_count * sizeof(Metadata_box));
+}
+
+
+bool write_metadata_file(const string& path, int width, int height, const vector<char>& records)
+{
+    Store_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, metadata_magic, sizeof(header.magic));
+    header.item_size = sizeof(Metadata_box);
+    header.reserved = ((uint32_t) height << 16) | ((uint32_t) width & 0xFFFF);
+
+    // Written under a hidden name and renamed into place, so a reader never sees a half written file.
+    string::size_type slash = path.rfind('/');
+    string temporary_path = path.substr(0, slash + 1) + "." + path.substr(slash + 1);
+    int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not create %s : %m", temporary_path.c_str());
+        return false;
+    }
+    vector<char> contents(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+    contents.insert(contents.end(), records.begin(), records.end());
+    const char* bytes = contents.data();
+    size_t remaining = contents.size();
+    while (remaining > 0) {
+        ssize_t written = write(fd, bytes, remaining);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    bool ok = (close(fd) == 0) && remaining == 0;
+    if (!ok || rename(temporary_path.c_str(), path.c_str()) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not write %s : %m", path.c_str());
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool read_metadata_file(const string& path, int& width, int& height, vector<Metadata_record>& records)
+{
+    records.clear();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat file_status;
+    vector<char> contents;
+    bool read_whole_file = false;
+    if (fstat(fd, &file_status) == 0) {
+        contents.resize(file_status.st_size);
+        read_whole_file = read(fd, contents.data(), contents.size()) == (ssize_t) contents.size();
+    }
+    close(fd);
+
+    Store_header header;
+    if (!read_whole_file || contents.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    if (memcmp(header.magic, metadata_magic, sizeof(header.magic)) != 0 || header.item_size != sizeof(Metadata_box)) {
+        syslog(log_facility | LOG_ERR, "Error: %s is not a metadata file", path.c_str());
+        return false;
+    }
+    width = header.reserved & 0xFFFF;
+    height = header.reserved >> 16;
+
+    // The fields are copied out, since nothing keeps them aligned inside of the file.
+    size_t offset = sizeof(header);
+    while (offset + sizeof(Metadata_frame_header) <= contents.size()) {
+        Metadata_record record;
+        memcpy(&record.header, contents.data() + offset, sizeof(record.header));
+        size_t box_bytes = (size_t) record.header.box_count * sizeof(Metadata_box);
+        if (offset + sizeof(record.header) + box_bytes > contents.size()) {
+            break;
+        }
+        record.boxes.resize(record.header.box_count);
+        if (box_bytes > 0) {
+            memcpy(record.boxes.data(), contents.data() + offset + sizeof(record.header), box_bytes);
+        }
+        records.push_back(std::move(record));
+        offset += sizeof(Metadata_frame_header) + box_bytes;
+    }
+    return true;
+}
+
+
+Track_summarizer::Track_summarizer(int width, int height)
+ : width(width), height(height), first_time_us(-1)
+{
+    //
+}
+
+
+void Track_summarizer::add_frame(uint32_t frame, int64_t capture_time_us, const Frame_metadata& metadata)
+{
+    if (first_time_us == -1) {
+        first_time_us = capture_time_us;
+    }
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    for (const Metadata_box& box : metadata.boxes) {
+        if (box.track_id == 0) {
+            continue;
+        }
+        std::uint16_t types = box.kind == METADATA_BOX_FACE ? DETECTION_FACE : DETECTION_HUMAN;
+        size_t index = 0;
+        while (index < tracks.size() && !(tracks[index].track_id == box.track_id && tracks[index].types == types)) {
+            ++index;
+        }
+        if (index == tracks.size()) {
+            Track_record track;
+            memset(&track, 0, sizeof(track));
+            track.time_us = capture_time_us;
+            track.types = types;
+            track.track_id = box.track_id;
+            track.first_frame = frame;
+            track.offset_ms = (uint32_t) ((capture_time_us - first_time_us) / 1000);
+            tracks.push_back(track);
+            last_times_us.push_back(capture_time_us);
+        }
+
+        Track_record& track = tracks[index];
+        track.last_frame = frame;
+        last_times_us[index] = capture_time_us;
+        track.cells |= detection_grid_cells((double) box.x / width, (double) box.y / height,
+                                            (double) (box.x + box.width) / width, (double) (box.y + box.height) / height);
+    }
+}
+
+
+vector<Track_record> Track_summarizer::finish(int camera, const string& clip) const
+{
+    vector<Track_record> finished = tracks;
+    for (size_t index = 0; index < finished.size(); ++index) {
+        Track_record& track = finished[index];
+        track.dwell_ms = (std::int32_t) ((last_times_us[index] - track.time_us) / 1000);
+        track.camera = (std::int16_t) camera;
+        strncpy(track.clip, clip.c_str(), sizeof(track.clip) - 1);
+    }
+    return finished;
+}
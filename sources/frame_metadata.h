@@ -0,0 +1,191 @@
+/**
+ * File Name:   frame_metadata.h
+ *
+ * Description:
+ * This file contains the declarations of what the detectors found in a frame: the boxes of the people and
+ * faces, with the track they belong to, and whether the frame moved. It is kept beside the pixels instead
+ * of being drawn into them, so the recordings stay untouched, and the outlines are only drawn when a frame
+ * is shown.
+ *
+ * The metadata of every video of a detection is saved next to it, in the video's name followed by
+ * METADATA_EXTENSION. The file is a Store_header (see detection_store.h) with the magic "SCCTVMD1", whose
+ * reserved field holds the width of the frames in its low 16 bits and their height in its high 16 bits,
+ * followed by one record per frame of the video, in order:
+ *     Metadata_frame_header, followed by box_count Metadata_box
+ * The boxes are in pixels of the frames of the video.
+ *
+ * A Track_summarizer turns the metadata of the frames of a video into one Track_record per track, for the
+ * index of the tracks in the detection store.
+ */
+
+#ifndef FRAME_METADATA_H
+#define FRAME_METADATA_H
+
+#include "detection_store.h"
+
+#include <cstdint>  /* for std::uint8_t, std::uint16_t, std::uint32_t, std::int64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// The metadata file of a video is named after the video, followed by this.
+#define METADATA_EXTENSION ".meta"
+
+// What a box is around.
+#define METADATA_BOX_HUMAN 0
+#define METADATA_BOX_FACE  1
+
+// Whether the frame moved.
+#define METADATA_MOTION_UNKNOWN 0  // The motion detector is turned off.
+#define METADATA_MOTION_NONE    1
+#define METADATA_MOTION_FOUND   2
+
+
+/**
+ * A person or a face found in a frame.
+ */
+struct Metadata_box {
+    std::uint16_t x;          // The left edge, in pixels.
+    std::uint16_t y;          // The top edge, in pixels.
+    std::uint16_t width;
+    std::uint16_t height;
+    std::uint32_t track_id;   // The same person or face keeps the same ID from frame to frame, 0 if not tracked.
+    std::uint8_t kind;        // METADATA_BOX_HUMAN or METADATA_BOX_FACE.
+    std::uint8_t reserved[3];
+};
+
+static_assert(sizeof(Metadata_box) == 16, "The boxes are read and written as is");
+
+
+/**
+ * The start of the record of a frame in a metadata file.
+ */
+struct Metadata_frame_header {
+    std::int64_t capture_time_us;  // The time the frame was captured, in microseconds since the epoch.
+    std::uint32_t frame;           // The index of the frame in the video.
+    std::uint8_t motion;           // METADATA_MOTION_UNKNOWN, METADATA_MOTION_NONE or METADATA_MOTION_FOUND.
+    std::uint8_t reserved;
+    std::uint16_t box_count;       // The number of Metadata_box that follow.
+};
+
+static_assert(sizeof(Metadata_frame_header) == 16, "The records are read and written as is");
+
+
+/**
+ * What the detectors found in a frame.
+ */
+struct Frame_metadata {
+    std::uint8_t motion = METADATA_MOTION_UNKNOWN;  // Whether the frame moved.
+    std::vector<Metadata_box> boxes;                 // The people and faces, in pixels of the captured frame.
+};
+
+
+/**
+ * The metadata of a frame of a video, as read from its metadata file.
+ */
+struct Metadata_record {
+    Metadata_frame_header header;
+    std::vector<Metadata_box> boxes;
+};
+
+
+/**
+ * This function scales boxes from one resolution of a frame to another.
+ *
+ * @param const std::vector<Metadata_box>& boxes - The boxes, in pixels of a frame of from_width x from_height.
+ *
+ * @param int from_width, from_height - The resolution the boxes are in.
+ *
+ * @param int to_width, to_height - The resolution to scale them to.
+ *
+ * @param std::vector<Metadata_box>& scaled - Set to the scaled boxes.
+ */
+void scale_metadata_boxes(const std::vector<Metadata_box>& boxes, int from_width, int from_height,
+                          int to_width, int to_height, std::vector<Metadata_box>& scaled);
+
+
+/**
+ * This function adds the record of a frame to the contents of a metadata file.
+ *
+ * @param std::vector<char>& records - The records of the frames so far.
+ *
+ * @param std::uint32_t frame - The index of the frame in the video.
+ *
+ * @param std::int64_t capture_time_us - The time the frame was captured.
+ *
+ * @param const Frame_metadata& metadata - What the detectors found in the frame.
+ */
+void append_metadata_record(std::vector<char>& records, std::uint32_t frame, std::int64_t capture_time_us,
+                            const Frame_metadata& metadata);
+
+
+/**
+ * This function writes a metadata file, in place of any file of the same name.
+ *
+ * @param const std::string& path - The file to write.
+ *
+ * @param int width, height - The resolution of the frames, which the boxes are in.
+ *
+ * @param const std::vector<char>& records - The records of the frames, see append_metadata_record().
+ *
+ * @return bool - true if the file was written, otherwise the reason is written to the syslog.
+ */
+bool write_metadata_file(const std::string& path, int width, int height, const std::vector<char>& records);
+
+
+/**
+ * This function reads a metadata file.
+ *
+ * @param const std::string& path - The file to read.
+ *
+ * @param int& width, height - Set to the resolution of the frames.
+ *
+ * @param std::vector<Metadata_record>& records - Set to the records of the frames, in order.
+ *
+ * @return bool - false if the file could not be read, or is not a metadata file.
+ *                The records up to a record that was cut short are kept.
+ */
+bool read_metadata_file(const std::string& path, int& width, int& height, std::vector<Metadata_record>& records);
+
+
+class Track_summarizer {
+  public:
+    /**
+     * The constructor starts the summary of a video.
+     *
+     * @param int width, height - The resolution of the frames, which the boxes are in.
+     */
+    Track_summarizer(int width, int height);
+
+    /**
+     * This function adds the boxes of the next frame of the video to the tracks they belong to.
+     * Boxes without a track are left out.
+     *
+     * @param std::uint32_t frame - The index of the frame in the video.
+     *
+     * @param std::int64_t capture_time_us - The time the frame was captured.
+     *
+     * @param const Frame_metadata& metadata - What the detectors found in the frame.
+     */
+    void add_frame(std::uint32_t frame, std::int64_t capture_time_us, const Frame_metadata& metadata);
+
+    /**
+     * This function finishes the summary.
+     *
+     * @param int camera - The camera number, -1 for a video file.
+     *
+     * @param const std::string& clip - The name of the video file in the recordings directory.
+     *
+     * @return std::vector<Track_record> - A record per track that was found in the video.
+     */
+    std::vector<Track_record> finish(int camera, const std::string& clip) const;
+
+  private:
+    int width;                                // The width of the frames.
+    int height;                               // The height of the frames.
+    std::int64_t first_time_us;               // When the first frame of the video was captured, -1 before it is added.
+    std::vector<Track_record> tracks;         // The tracks found so far, a video only ever has a few.
+    std::vector<std::int64_t> last_times_us;  // When each of the tracks was last found.
+};
+
+
+#endif  /* FRAME_METADATA_H */
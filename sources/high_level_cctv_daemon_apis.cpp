@@ -13,18 +13,26 @@
 
 #include "high_level_cctv_daemon_apis.h"
 #include "low_level_cctv_daemon_apis.h"
-#include "write_message.h"
+#include "event_bus.h"
+#include "control_server.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>   /* for umask(), mode permissions constants */
+#include <sys/socket.h> /* for socket(), connect(), send(), recv(), setsockopt() */
+#include <sys/time.h>   /* for struct timeval */
+#include <sys/un.h>     /* for sockaddr_un */
 #include <fcntl.h>      /* for O_* constants, open() */
 #include <signal.h>     /* for kill() */
-#include <unistd.h>     /* for fork() */
+#include <unistd.h>     /* for fork(), close() */
 #include <errno.h>      /* for errno */
 #include <syslog.h>     /* for syslog() */
-#include <cstdlib>      /* for exit(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <cstdlib>      /* for exit(), getenv(), realpath(), free(), EXIT_SUCCESS, EXIT_FAILURE */
 #include <cstdio>       /* for fopen(), fdopen(), fclose(), fseek(), fgetc(), fscanf(), FILE */
 #include <cctype>       /* for isdigit() */
+#include <cstring>      /* for memset(), strncpy() */
+#include <string>       /* for std::string */
+
+using std::string;
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-result"
@@ -32,6 +40,9 @@
 
 extern Daemon_data daemon_data;
 
+// The absolute path of the video file the daemon reads in place of the camera, see run_daemon().
+static string video_file_path;
+
 void Daemon_facade::set_daemon_info(const char* home_directory)
 {
     daemon_data.home_directory = home_directory;
@@ -46,6 +57,17 @@ int Daemon_facade::run_daemon(bool enable_human_detection, bool enable_motion_de
     daemon_data.enable_outlines = enable_outlines;
     daemon_data.cameraNumber = cameraNumber;
 
+    // When the GUI was started with SmartCCTV_video_file set, the daemon reads that video file in place of the camera.
+    // The path is made absolute here, since the daemon changes its working directory to /.
+    const char* video_file = getenv("SmartCCTV_video_file");
+    daemon_data.video_file_path = nullptr;
+    if (video_file != nullptr && *video_file != '\0') {
+        char* absolute_path = realpath(video_file, nullptr);
+        video_file_path = absolute_path != nullptr ? absolute_path : video_file;
+        free(absolute_path);
+        daemon_data.video_file_path = video_file_path.c_str();
+    }
+
     enum return_states { SUCCESS, DAEMON_ALREADY_RUNNING, PERMISSIONS_ERROR };
 
     if (!checkPidFile(true)) {
@@ -142,6 +164,66 @@ bool Daemon_facade::is_daemon_running()
 }
 
 
+bool Daemon_facade::send_control_request(const string& request, string& response)
+{
+    response.clear();
+
+    int socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create a socket : %m");
+        return false;
+    }
+
+    // The GUI must not hang if the daemon is stuck, so it only waits a little while for the answer.
+    struct timeval timeout = { 2, 0 };
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, CONTROL_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    if (connect(socket_fd, (struct sockaddr*) &address, sizeof(address)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not connect to the daemon control socket %s : %m", CONTROL_SOCKET_PATH);
+        close(socket_fd);
+        return false;
+    }
+
+    string line = request + "\n";
+    if (send(socket_fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t) line.size()) {
+        syslog(log_facility | LOG_ERR, "Error: Could not send a control request : %m");
+        close(socket_fd);
+        return false;
+    }
+
+    // The response is complete once its last line is "OK" or "ERR <reason>".
+    bool succeeded = false;
+    char buffer[1024];
+    while (true) {
+        ssize_t total_read = recv(socket_fd, buffer, sizeof(buffer), 0);
+        if (total_read <= 0) {
+            syslog(log_facility | LOG_ERR, "Error: The daemon did not answer the control request \"%s\"", request.c_str());
+            break;
+        }
+        response.append(buffer, total_read);
+
+        size_t last_line = response.rfind('\n', response.size() - 2);
+        last_line = (last_line == string::npos) ? 0 : last_line + 1;
+        if (response.back() == '\n' && response.compare(last_line, 3, "OK\n") == 0) {
+            succeeded = true;
+            break;
+        }
+        if (response.back() == '\n' && response.compare(last_line, 4, "ERR ") == 0) {
+            syslog(log_facility | LOG_ERR, "Error: The daemon refused the control request \"%s\" : %s", request.c_str(), response.c_str() + last_line);
+            break;
+        }
+    }
+
+    close(socket_fd);
+    return succeeded;
+}
+
+
 void Daemon_facade::remove_pid_file(FILE* pid_file_pointer)
 {
     if (fclose(pid_file_pointer) == EOF) {
@@ -185,7 +267,7 @@ bool Daemon_facade::checkPidFile(bool turn_on)
                 syslog(log_facility | LOG_WARNING, "Removing Invalid PID file %s", daemon_data.pid_file_name);
                 remove_pid_file(daemon_data.pid_file_pointer);
 
-                write_message("SmartCCTV has been tampered.");
+                post_error(ERROR_TAMPERED, SOURCE_GUI);
                 // Since the tampered PID file was already deleted, assume that it doesn't exist (state == false).
                 return false != turn_on;
             }
@@ -206,7 +288,7 @@ bool Daemon_facade::checkPidFile(bool turn_on)
             syslog(log_facility | LOG_WARNING, "Removing PID file for defunct process %d", daemon_pid);
             remove_pid_file(daemon_data.pid_file_pointer);
 
-            write_message("SmartCCTV has been tampered.");
+            post_error(ERROR_TAMPERED, SOURCE_GUI);
             // Since the tampered PID file was already deleted, assume that it doesn't exist (state == false).
             return false != turn_on;
 
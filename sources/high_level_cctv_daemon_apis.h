@@ -15,6 +15,7 @@
 #define HIGH_LEVEL_CCTV_DAEMON_APIS_H
 
 #include <cstdio>       /* for FILE */
+#include <string>       /* for std::string */
 
 // You can change this to make the syslog() output to a different file.
 #define log_facility LOG_LOCAL0
@@ -35,6 +36,7 @@ class Daemon_facade {
      * This function turns on the daemon if it is not already running.
      *
      * This function is called only in the GUI process.
+     * When the environment variable SmartCCTV_video_file is set, the daemon reads that video file in place of the camera.
      *
      * @param bool enable_human_detection - whether to enable human detection
      *
@@ -70,6 +72,22 @@ class Daemon_facade {
      */
     bool is_daemon_running();
 
+    /**
+     * This function sends a request to the control socket of the running daemon, and waits for the response.
+     * It is used to change the settings of the daemon without restarting it, see control_server.h for the
+     * requests that it understands.
+     *
+     * This function is called only in the GUI process.
+     *
+     * @param const std::string& request - The request, for example "SET outlines=0".
+     *
+     * @param std::string& response - Set to the response of the daemon, including the final "OK" or "ERR" line.
+     *
+     * @return bool - true  if the daemon carried out the request.
+     *                false if the daemon is not running, did not answer, or refused the request.
+     */
+    bool send_control_request(const std::string& request, std::string& response);
+
   private:
     /**
      * This function deletes the PID file.
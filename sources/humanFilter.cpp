@@ -11,27 +11,28 @@
  * Each instance of this class is to correspond to a single camera or video file.
  */
 
-#include "low_level_cctv_daemon_apis.h"
 #include "humanFilter.hpp"
+#include "async_log.h"
 #include <syslog.h>  /* for syslog() */
+#include <algorithm>  /* for std::max() */
 #define log_facility LOG_LOCAL0
 
-extern Daemon_data daemon_data;
-
 HumanFilter::HumanFilter()
 {
 	syslog(log_facility | LOG_NOTICE, "Build human detector");
 	hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
 }
 
-bool HumanFilter::runRecognition(cv::Mat &frame)
+bool HumanFilter::runRecognition(const cv::Mat &frame, const Camera_config &config)
 {
 	boxes.clear();
+	weights.clear();
 	//The third value is used to set detection threshold (higher = less false positives, more false negatives)
 	//Recommended value between 1.3 and 1.7
 	//syslog(log_facility | LOG_NOTICE, "Searching for humans...");
 
-	hog.detectMultiScale(frame, boxes, 1.7, cv::Size(8,8), cv::Size(), 1.05, 2, false);
+	//The weights are how far each box is past the SVM decision boundary, they are kept as the confidence
+	hog.detectMultiScale(frame, boxes, weights, config.hog_threshold, cv::Size(8,8), cv::Size(), config.hog_scale, 2, false);
 	
 	if(boxes.size() < 1)
 	{
@@ -47,13 +48,28 @@ bool HumanFilter::runRecognition(cv::Mat &frame)
         rect.width = cvRound(rect.width*0.8);
         rect.y += cvRound(rect.height*0.07);
         rect.height = cvRound(rect.height*0.8);
-        
-        if(daemon_data.enable_outlines)
-        {
-			rectangle(frame, rect.tl(), rect.br(), cv::Scalar(0, 255, 0), 2);
-		}
     }
-    syslog(log_facility | LOG_NOTICE, "Found humans");
+    async_log(log_facility | LOG_NOTICE, "Found humans");
 
 	return true;
 }
+
+size_t HumanFilter::getBoxCount() const
+{
+	return boxes.size();
+}
+
+const std::vector<cv::Rect>& HumanFilter::getBoxes() const
+{
+	return boxes;
+}
+
+double HumanFilter::getConfidence() const
+{
+	double confidence = 0;
+	for(double weight : weights)
+	{
+		confidence = std::max(confidence, weight);
+	}
+	return confidence;
+}
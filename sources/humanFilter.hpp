@@ -21,15 +21,23 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include "camera_config.h"
 
 class HumanFilter
 {
 public:
 	HumanFilter();
-	bool runRecognition(cv::Mat &frame);
+	bool runRecognition(const cv::Mat &frame, const Camera_config &config);
+	//The number of people found by the last runRecognition()
+	size_t getBoxCount() const;
+	//The people found by the last runRecognition(), nothing is drawn into the frame
+	const std::vector<cv::Rect>& getBoxes() const;
+	//The highest SVM weight of a person found by the last runRecognition(), 0 if none was found
+	double getConfidence() const;
     
 private:
 	cv::HOGDescriptor hog;
 	std::vector<cv::Rect> boxes;
+	std::vector<double> weights;
 };
 #endif
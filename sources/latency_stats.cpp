@@ -0,0 +1,104 @@
+/**
+ * File Name:   latency_stats.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Latency_stats class's methods.
+ * An instance of this class collects the capture-to-present latency of the live stream frames in a
+ * fixed histogram, and answers percentile queries about them.
+ */
+
+#include "latency_stats.h"
+
+#include <algorithm>  /* for std::fill() */
+
+
+Latency_stats::Latency_stats()
+ : buckets(LATENCY_BUCKETS, 0), frame_count(0), dropped_count(0), total_us(0), maximum_us(0)
+{
+    //
+}
+
+
+void Latency_stats::record(std::int64_t latency_us, std::uint64_t frames_dropped)
+{
+    // The clocks of the camera daemon and the viewer are the same wall clock, but it can still step backwards.
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+
+    std::int64_t bucket = latency_us / LATENCY_BUCKET_US;
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    ++buckets[bucket];
+
+    ++frame_count;
+    dropped_count += frames_dropped;
+    total_us += latency_us;
+    if (latency_us > maximum_us) {
+        maximum_us = latency_us;
+    }
+}
+
+
+void Latency_stats::reset()
+{
+    std::fill(buckets.begin(), buckets.end(), 0);
+    frame_count = 0;
+    dropped_count = 0;
+    total_us = 0;
+    maximum_us = 0;
+}
+
+
+std::uint64_t Latency_stats::frames() const
+{
+    return frame_count;
+}
+
+
+std::uint64_t Latency_stats::dropped() const
+{
+    return dropped_count;
+}
+
+
+std::int64_t Latency_stats::percentile_us(double percentile) const
+{
+    if (frame_count == 0) {
+        return 0;
+    }
+
+    // The rank of the frame that the percentile falls on, counting from 1.
+    std::uint64_t rank = (std::uint64_t) (percentile / 100.0 * frame_count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > frame_count) {
+        rank = frame_count;
+    }
+
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            // The last bucket is open ended, the maximum is the best upper bound for it.
+            if (bucket == LATENCY_BUCKETS - 1) {
+                return maximum_us;
+            }
+            return std::min((std::int64_t) (bucket + 1) * LATENCY_BUCKET_US, maximum_us);
+        }
+    }
+    return maximum_us;
+}
+
+
+std::int64_t Latency_stats::mean_us() const
+{
+    return (frame_count == 0) ? 0 : total_us / (std::int64_t) frame_count;
+}
+
+
+std::int64_t Latency_stats::max_us() const
+{
+    return maximum_us;
+}
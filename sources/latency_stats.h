@@ -0,0 +1,85 @@
+/**
+ * File Name:   latency_stats.h
+ *
+ * Description:
+ * This file contains the declaration of the Latency_stats class.
+ * An instance of this class collects the capture-to-present latency of the live stream frames in a
+ * fixed histogram, together with the number of frames that never made it to the screen, and answers
+ * percentile queries about them.
+ *
+ * The histogram has LATENCY_BUCKETS buckets of LATENCY_BUCKET_US each, anything slower falls into the
+ * last bucket. Recording a frame is a single increment, and nothing is allocated after construction.
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <cstdint>  /* for std::uint32_t, std::uint64_t, std::int64_t */
+#include <vector>   /* for std::vector */
+
+// The width of one histogram bucket in microseconds.
+#define LATENCY_BUCKET_US 1000
+// The number of histogram buckets, the last one also counts every latency above the range.
+#define LATENCY_BUCKETS 2000
+
+
+class Latency_stats {
+  public:
+    /**
+     * The constructor initializes an empty histogram.
+     */
+    Latency_stats();
+
+    /**
+     * This function records a presented frame.
+     *
+     * @param std::int64_t latency_us - How long it took from capturing the frame to presenting it.
+     *
+     * @param std::uint64_t frames_dropped - How many frames of the same camera were captured since the
+     *                                       last presented one, but never presented.
+     */
+    void record(std::int64_t latency_us, std::uint64_t frames_dropped);
+
+    /**
+     * This function forgets everything recorded so far.
+     */
+    void reset();
+
+    /**
+     * @return std::uint64_t - The number of frames recorded.
+     */
+    std::uint64_t frames() const;
+
+    /**
+     * @return std::uint64_t - The number of frames dropped.
+     */
+    std::uint64_t dropped() const;
+
+    /**
+     * @param double percentile - The percentile to look up, from 0 to 100.
+     *
+     * @return std::int64_t - The latency below which that percentage of the frames were presented,
+     *                        rounded up to the bucket width, or 0 if nothing was recorded.
+     */
+    std::int64_t percentile_us(double percentile) const;
+
+    /**
+     * @return std::int64_t - The average latency, or 0 if nothing was recorded.
+     */
+    std::int64_t mean_us() const;
+
+    /**
+     * @return std::int64_t - The highest latency recorded, or 0 if nothing was recorded.
+     */
+    std::int64_t max_us() const;
+
+  private:
+    std::vector<std::uint32_t> buckets;  // The number of frames per latency bucket.
+    std::uint64_t frame_count;           // The number of frames recorded.
+    std::uint64_t dropped_count;         // The number of frames dropped.
+    std::int64_t total_us;               // The sum of the latency of all the frames recorded.
+    std::int64_t maximum_us;             // The highest latency recorded.
+};
+
+
+#endif  /* LATENCY_STATS_H */
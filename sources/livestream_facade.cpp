@@ -8,8 +8,8 @@
  *
  * Description:
  * This file contains the definitions of member methods LiveStream_facade, as well as it's helper functions.
- * The helper functions are primarily signal handlers and other functions that are caled by the signal
- * handlers, since such functions cannot be member methods of a class.
+ * The helper functions are called by the event loop of the LiveStream_window when it reads a signal from its
+ * signalfd, and they are kept as stand alone functions since they work on the global liveStream_viewer_data.
  * LiveStream_facade is an implementation of both the facade and singleton design patterns.
  *
  * This file also contains the liveStream_viewer_data object, which is just the private data of the
@@ -19,17 +19,15 @@
 
 #include "livestream_facade.h"
 #include "livestream_window.h"
-#include "write_message.h"
+#include "event_bus.h"
 
 #include <fcntl.h>      /* for O_* constants, open() */
 #include <unistd.h>     /* for close(), unlink(), fork(), setsid(), chdir(), getpid(), sleep() */
-#include <signal.h>     /* for sigemptyset(), signal constants */
+#include <signal.h>     /* for sigemptyset(), sigprocmask(), signal constants */
 #include <errno.h>      /* for errno */
 #include <syslog.h>     /* for openlog(), syslog(), closelog() */
-#include <dirent.h>     /* for opendir(), readdir(), closedir() */
 #include <cstdlib>      /* for exit(), atexit(), EXIT_SUCCESS, EXIT_FAILURE */
 #include <cstdio>       /* for FILE, fclose(), fprintf() */
-#include <cstring>      /* for strncmp() */
 #include <string>       /* for std::string */
 
 using std::string;
@@ -47,7 +45,7 @@ int exit_code = EXIT_SUCCESS;
 // however it is inside a global struct instead because that data will be accessed by signal handler functions,
 // which are required to be stand alone global functions and cannot be member functions of a particular class.
 struct LiveStream_viewer_data {
-    string streamDir;                  // The parent directory into which live stream images are saved.
+    string streamDir;                  // The parent directory of the camera directories.
     string default_images_dir;          // The directory where default images are stored.
     const char* my_pid_file_name;      // The path to the LiveStream Viewer process's PID file.
     int pid_file_descriptor;           // A descriptor to this file.
@@ -83,7 +81,7 @@ int LiveStream_facade::run_livestream_viewer(const string& home_directory)
     if (SmartCCTV_Project_dir == nullptr) {
         //Error state! Exit the livestream viewer
         syslog(log_facility | LOG_ERR, "Error: $SmartCCTV_Project_dir environmental varaible not set : failed to identify project directory");
-        write_message("Cannot find project configuration files.");
+        post_error(ERROR_CONFIG_MISSING, SOURCE_VIEWER);
         return PERMISSIONS_ERROR;
     }
 
@@ -149,7 +147,7 @@ bool LiveStream_facade::is_livestream_running()
                 syslog(log_facility | LOG_WARNING, "Removing Invalid PID file %s", private_data->my_pid_file_name);
                 remove_my_pid_file();
 
-                write_message("LiveStream Viewer has been tampered.");
+                post_error(ERROR_TAMPERED, SOURCE_VIEWER);
 
                 if (fclose(private_data->pid_file_pointer) == EOF) {
                     syslog(log_facility | LOG_ERR, "Error: Could not close PID file %s : %m", private_data->my_pid_file_name);
@@ -173,7 +171,7 @@ bool LiveStream_facade::is_livestream_running()
             syslog(log_facility | LOG_WARNING, "Removing PID file for defunct process %d", my_pid);
             remove_my_pid_file();
 
-            write_message("LiveStream Viewer has been tampered.");
+            post_error(ERROR_TAMPERED, SOURCE_VIEWER);
 
             if (fclose(private_data->pid_file_pointer) == EOF) {
                 syslog(log_facility | LOG_ERR, "Error: Could not close PID file %s : %m", private_data->my_pid_file_name);
@@ -232,7 +230,7 @@ void LiveStream_facade::become_livestream_process()
     if (setsid() == -1) {
         syslog(log_facility | LOG_ERR, "Error: Could not change the session ID and process group ID : %m");
         syslog(log_facility | LOG_CRIT, "LiveStream Viewer unexpected failure.");
-        write_message("LiveStream Viewer unexpected failure.");
+        post_error(ERROR_UNEXPECTED_FAILURE, SOURCE_VIEWER);
         exit_code = EXIT_FAILURE;
         terminate_livestream(0);
     }
@@ -252,49 +250,17 @@ void LiveStream_facade::become_livestream_process()
     fclose(private_data->pid_file_pointer);
     close(private_data->pid_file_descriptor);
 
-    // This sets up the signal handler for when the process is terminated.
-    struct sigaction action1;
-    action1.sa_handler = terminate_livestream;
-    sigemptyset(&action1.sa_mask);
-    sigaddset(&action1.sa_mask, SIGINT);
-    sigaddset(&action1.sa_mask, SIGQUIT);
-    sigaddset(&action1.sa_mask, SIGTERM);
-    sigaddset(&action1.sa_mask, SIGTSTP);
-    sigaddset(&action1.sa_mask, SIGHUP);
-    sigaddset(&action1.sa_mask, SIGUSR1);
-    sigaddset(&action1.sa_mask, SIGUSR2);
-    sigaddset(&action1.sa_mask, SIGCONT);
-    sigaddset(&action1.sa_mask, SIGCHLD);
-    action1.sa_flags = 0;
-    sigaction(SIGINT, &action1, nullptr);
-    sigaction(SIGTERM, &action1, nullptr);
-    sigaction(SIGQUIT, &action1, nullptr);
-
-    // This sets up the signal handler for when the SmartCCTV camera daemon starts up.
-    struct sigaction action2;
-    action2.sa_handler = camera_daemon_starts_up;
-    sigemptyset(&action2.sa_mask);
-    sigaddset(&action2.sa_mask, SIGTSTP);
-    sigaddset(&action2.sa_mask, SIGHUP);
-    sigaddset(&action2.sa_mask, SIGUSR1);
-    sigaddset(&action2.sa_mask, SIGUSR2);
-    sigaddset(&action2.sa_mask, SIGCONT);
-    sigaddset(&action2.sa_mask, SIGCHLD);
-    action2.sa_flags = 0;
-    sigaction(SIGUSR1, &action2, nullptr);
-
-    // This sets up the signal handler for when the SmartCCTV camera daemon shuts down.
-    struct sigaction action3;
-    action3.sa_handler = camera_daemon_shuts_down;
-    sigemptyset(&action3.sa_mask);
-    sigaddset(&action3.sa_mask, SIGTSTP);
-    sigaddset(&action3.sa_mask, SIGHUP);
-    sigaddset(&action3.sa_mask, SIGUSR1);
-    sigaddset(&action3.sa_mask, SIGUSR2);
-    sigaddset(&action3.sa_mask, SIGCONT);
-    sigaddset(&action3.sa_mask, SIGCHLD);
-    action3.sa_flags = 0;
-    sigaction(SIGUSR2, &action3, nullptr);
+    // The terminate signals, and the signals of the SmartCCTV camera daemon starting up and shutting down,
+    // are blocked here, and read from a signalfd by the event loop of the LiveStream_window instead.
+    // They are blocked before anything else happens, so that one arriving early does not kill the process.
+    sigset_t signal_mask;
+    sigemptyset(&signal_mask);
+    sigaddset(&signal_mask, SIGINT);
+    sigaddset(&signal_mask, SIGTERM);
+    sigaddset(&signal_mask, SIGQUIT);
+    sigaddset(&signal_mask, SIGUSR1);
+    sigaddset(&signal_mask, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &signal_mask, nullptr);
 
     open_viewer_window();
 }
@@ -314,10 +280,9 @@ void LiveStream_facade::open_viewer_window()
         kill(liveStream_viewer_data.daemon_process_pid, SIGUSR1);
     }
 
-    // Check the LiveStream Viewer can:
-    // - get the daemon's PID to send it signals
-    // - find the camera directory to open images
-    liveStream_viewer_data.SmartCCTV_daemon_is_running = liveStream_viewer_data.daemon_process_pid && find_camera_directory();
+    // The LiveStream Viewer can get the daemon's PID to send it signals.
+    // The camera directories to open images from are found by the LiveStream_window itself.
+    liveStream_viewer_data.SmartCCTV_daemon_is_running = liveStream_viewer_data.daemon_process_pid != 0;
 
     LiveStream_window liveStream_window(private_data->streamDir, private_data->default_images_dir, private_data->SmartCCTV_daemon_is_running);
     liveStream_window_ptr = &liveStream_window;
@@ -366,11 +331,8 @@ void camera_daemon_starts_up(int)
     liveStream_viewer_data.daemon_process_pid = (daemon_pid != -1) ? daemon_pid : 0;
     // The SmartCCTV camera daemon already knows that the LiveStream Viewer process is up and running.
 
-    // Check the LiveStream Viewer can:
-    // - get the daemon's PID to send it signals
-    // - find the camera directory to open images
-    liveStream_viewer_data.SmartCCTV_daemon_is_running = liveStream_viewer_data.daemon_process_pid && find_camera_directory();
-    liveStream_window_ptr->set_streamDir(liveStream_viewer_data.streamDir);
+    // The LiveStream Viewer can get the daemon's PID to send it signals.
+    liveStream_viewer_data.SmartCCTV_daemon_is_running = liveStream_viewer_data.daemon_process_pid != 0;
 }
 
 
@@ -381,37 +343,6 @@ void camera_daemon_shuts_down(int)
 }
 
 
-bool find_camera_directory()
-{
-    // Try to find if the camera folder exists.
-    // If it exists, it can be opened by the LiveStream_window.
-
-    // Check if the streamDir already has the camera directory appended to the end.
-    const char* const streamDir_cstr = liveStream_viewer_data.streamDir.c_str();
-    size_t streamDir_len = liveStream_viewer_data.streamDir.length();
-    if (strncmp("camera", streamDir_cstr + (streamDir_len - 7), 6) == 0) {
-        return true;
-    }
-
-    bool camera_folder_found = false;
-
-    if (auto dir = opendir(liveStream_viewer_data.streamDir.c_str())) {
-        while (auto f = readdir(dir)) {
-            if (!f->d_name || f->d_name[0] == '.') {
-                continue;  // Skip everything that starts with a dot
-            } else if (strncmp("camera", f->d_name, 6) == 0) {
-                liveStream_viewer_data.streamDir += f->d_name;
-                camera_folder_found = true;
-                break;
-            }
-        }
-        closedir(dir);
-    }
-
-    return camera_folder_found;
-}
-
-
 int get_daemon_pid()
 {
     // The name of the SmartCCTV camera daemon's PID file.
@@ -439,7 +370,7 @@ int get_daemon_pid()
                 syslog(log_facility | LOG_ERR, "Error: Invalid PID file: text is not a process id");
                 syslog(log_facility | LOG_ERR, "Invalid PID file %s", daemon_pid_file_name);
 
-                write_message("Can't open LiveStream Viewer: SmartCCTV has been tampered.");
+                post_error(ERROR_DAEMON_TAMPERED, SOURCE_VIEWER);
 
                 if (fclose(daemon_pid_file_pointer) == EOF) {
                     syslog(log_facility | LOG_ERR, "Error: Could not close PID file %s : %m", daemon_pid_file_name);
@@ -463,7 +394,7 @@ int get_daemon_pid()
             syslog(log_facility | LOG_ERR, "Error: Invalid PID file %s : %m", daemon_pid_file_name);
             syslog(log_facility | LOG_WARNING, "Defunct process %d", daemon_pid);
 
-            write_message("Can't open LiveStream Viewer: SmartCCTV has been tampered.");
+            post_error(ERROR_DAEMON_TAMPERED, SOURCE_VIEWER);
 
             if (fclose(daemon_pid_file_pointer) == EOF) {
                 syslog(log_facility | LOG_ERR, "Error: Could not close PID file %s : %m", daemon_pid_file_name);
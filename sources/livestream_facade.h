@@ -68,7 +68,8 @@ class LiveStream_facade {
 
     /**
      * This function forks the LiveStream Viewer process off the GUI process and detatches it.
-     * It also writes the PID of the LiveStream process to the PID file and sets up the signal handlers.
+     * It also writes the PID of the LiveStream process to the PID file and blocks the signals that the
+     * LiveStream_window reads from its signalfd.
      */
     void become_livestream_process();
 
@@ -93,20 +94,15 @@ class LiveStream_facade {
 /* Helper functions */
 
 /**
- * This helper function is a signal handler.
- * The only reason why it's not a member method of the class is because C/C++ doesn't allow signal handlers
- * to be member methods.
- *
- * This function is called whenever LiveStream Viewer process recieves a terminate signal.
+ * This helper function is called whenever LiveStream Viewer process recieves a terminate signal,
+ * or runs into an unrecoverable error.
  * It first cleans up the resources of the process and lets the camera daemon process (if it's still running)
  * know that it is turning off.
  */
 void terminate_livestream(int);
 
 /**
- * This helper function is a signal handler.
- * The only reason why it's not a member method of the class is because C/C++ doesn't allow signal handlers
- * to be member methods.
+ * This helper function is called by the event loop of the LiveStream_window.
  *
  * The livestream viewer recieves SIGUSR1 when the camera daemon process starts up.
  * This function handles that signal by connecting to that proces.
@@ -114,35 +110,13 @@ void terminate_livestream(int);
 void camera_daemon_starts_up(int);
 
 /**
- * This helper function is a signal handler.
- * The only reason why it's not a member method of the class is because C/C++ doesn't allow signal handlers
- * to be member methods.
+ * This helper function is called by the event loop of the LiveStream_window.
  *
  * The livestream viewer recieves SIGUSR2 when the camera daemon process shuts down.
  * This function handles that signal by disconnecting from that proces.
  */
 void camera_daemon_shuts_down(int);
 
-/**
- * This function tries to find a camera? directory in the directory /tmp/SmartCCTV_livestream/
- * The ? stands for any single digit. This is because you can have camera0 or camera1, or camera2 opened
- * if you have multiple cameras to choose from.
- * This function automatically finds the camera that is currently in use by the SmartCCTV Camera Daemon,
- * and it sets that directory to be watched.
- *
- * This function modifies liveStream_viewer_data.streamDir to hold the directory of the active camera if
- * it detects one. If the directory of the active camera was already previously set, and this function is
- * called again, it doesn't to anything, and it exits without errors.
- *
- * This function is called by the LiveStream Viewer process only.
- * Although originally intended to be a member method, this is not the case because it is called by
- * signal handler functions, which cannot be member methods or call other member methods.
- *
- * @return bool - true if the directory of the active camera was found
- *                false otherwise
- */
-bool find_camera_directory();
-
 /**
  * This function gets and returns the PID of the SmartCCTV Camera Daemon process if it exists.
  * This function is called by the LiveStream Viewer process only.
@@ -0,0 +1,208 @@
+/**
+ * File Name:   livestream_protocol.cpp
+ *
+ * Description:
+ * This file contains the definitions of the helper functions shared by the SmartCCTV Camera Daemon
+ * and the LiveStream Viewer for exchanging live stream frames through the livestream directory.
+ */
+
+#include "livestream_protocol.h"
+
+#include <syslog.h>   /* for syslog() */
+#include <signal.h>   /* for kill() */
+#include <unistd.h>   /* for getpid(), unlink() */
+#include <dirent.h>   /* for opendir(), readdir(), closedir() */
+#include <algorithm>  /* for std::sort(), std::min() */
+#include <chrono>     /* for std::chrono::system_clock */
+#include <cstdio>     /* for FILE, fopen(), fprintf(), fscanf(), fclose(), rename() */
+#include <cstdlib>    /* for strtoull(), strtoll() */
+#include <cstring>    /* for strcmp(), strncmp() */
+#include <string>     /* for std::string, std::to_string() */
+#include <vector>     /* for std::vector */
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+
+const char* const livestream_temporary_frame_name = ".publishing.tiles";
+const char* const livestream_active_marker_name = ".active";
+const char* const livestream_request_file_name = ".viewer_request";
+
+
+std::int64_t livestream_now_us()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+string make_frame_file_name(std::uint64_t sequence, std::int64_t capture_time_us)
+{
+    string file_name = to_string(sequence);
+    file_name += '_';
+    file_name += to_string(capture_time_us);
+    file_name += ".tiles";
+    return file_name;
+}
+
+
+bool livestream_tile_size(const Livestream_frame_header& header, const Livestream_tile_index& tile, int& tile_width, int& tile_height)
+{
+    std::uint64_t left = (std::uint64_t) tile.column * header.tile_size;
+    std::uint64_t top = (std::uint64_t) tile.row * header.tile_size;
+    if (header.tile_size == 0 || left >= header.width || top >= header.height) {
+        return false;
+    }
+
+    tile_width = (int) std::min<std::uint64_t>(header.tile_size, header.width - left);
+    tile_height = (int) std::min<std::uint64_t>(header.tile_size, header.height - top);
+    return true;
+}
+
+
+bool parse_frame_file_name(const char* file_name, std::uint64_t& sequence, std::int64_t& capture_time_us)
+{
+    if (file_name == nullptr || file_name[0] < '0' || file_name[0] > '9') {
+        return false;
+    }
+
+    char* end = nullptr;
+    unsigned long long parsed_sequence = strtoull(file_name, &end, 10);
+    if (*end != '_') {
+        return false;
+    }
+
+    const char* time_start = end + 1;
+    long long parsed_time = strtoll(time_start, &end, 10);
+    if (end == time_start || strcmp(end, ".tiles") != 0) {
+        return false;
+    }
+
+    sequence = parsed_sequence;
+    capture_time_us = parsed_time;
+    return true;
+}
+
+
+bool mark_camera_active(const string& camera_directory)
+{
+    string marker_file = camera_directory + livestream_active_marker_name;
+    FILE* marker = fopen(marker_file.c_str(), "w");
+    if (marker == nullptr) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create %s : %m", marker_file.c_str());
+        return false;
+    }
+    fprintf(marker, "%d\n", (int) getpid());
+    fclose(marker);
+    return true;
+}
+
+
+void unmark_camera_active(const string& camera_directory)
+{
+    string marker_file = camera_directory + livestream_active_marker_name;
+    unlink(marker_file.c_str());
+}
+
+
+vector<string> find_active_camera_directories(const string& livestream_directory)
+{
+    vector<string> camera_directories;
+
+    string parent_directory = livestream_directory;
+    if (parent_directory.empty() || parent_directory.back() != '/') {
+        parent_directory += '/';
+    }
+
+    if (auto dir = opendir(parent_directory.c_str())) {
+        while (auto f = readdir(dir)) {
+            if (strncmp("camera", f->d_name, 6) != 0) {
+                continue;
+            }
+
+            string camera_directory = parent_directory + f->d_name + "/";
+            string marker_file = camera_directory + livestream_active_marker_name;
+            FILE* marker = fopen(marker_file.c_str(), "r");
+            if (marker == nullptr) {
+                continue;  // No camera daemon is publishing into this directory.
+            }
+            int daemon_pid = 0;
+            int total_read = fscanf(marker, "%d", &daemon_pid);
+            fclose(marker);
+
+            // kill() with a signal of 0 only checks if that process exists.
+            // A marker of a camera daemon that crashed is stale.
+            if (total_read == 1 && daemon_pid > 0 && kill(daemon_pid, 0) == 0) {
+                camera_directories.push_back(camera_directory);
+            }
+        }
+        closedir(dir);
+    }
+
+    std::sort(camera_directories.begin(), camera_directories.end());
+    return camera_directories;
+}
+
+
+bool write_livestream_request(const string& camera_directory, const Livestream_request& request)
+{
+    string temporary_file = camera_directory + livestream_request_file_name + ".tmp";
+    FILE* request_file = fopen(temporary_file.c_str(), "w");
+    if (request_file == nullptr) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create %s : %m", temporary_file.c_str());
+        return false;
+    }
+    fprintf(request_file, "tile_width=%d\n", request.tile_width);
+    fprintf(request_file, "tile_height=%d\n", request.tile_height);
+    fprintf(request_file, "keyframe_request=%d\n", request.keyframe_request);
+    fprintf(request_file, "time_shift_request=%d\n", request.time_shift_request);
+    fprintf(request_file, "time_shift_offset_ms=%d\n", request.time_shift_offset_ms);
+    fprintf(request_file, "time_shift_speed=%d\n", request.time_shift_speed);
+    fclose(request_file);
+
+    string final_file = camera_directory + livestream_request_file_name;
+    if (rename(temporary_file.c_str(), final_file.c_str()) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not write %s : %m", final_file.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool read_livestream_request(const string& camera_directory, Livestream_request& request)
+{
+    string request_file_name = camera_directory + livestream_request_file_name;
+    FILE* request_file = fopen(request_file_name.c_str(), "r");
+    if (request_file == nullptr) {
+        return false;
+    }
+
+    Livestream_request parsed_request = {};
+    char key[32];
+    int value = 0;
+    // Every line is "key=value". Unknown keys are skipped, so older camera daemons keep working with
+    // newer LiveStream Viewers.
+    while (fscanf(request_file, " %31[^=]=%d", key, &value) == 2) {
+        if (strcmp(key, "tile_width") == 0) {
+            parsed_request.tile_width = value;
+        } else if (strcmp(key, "tile_height") == 0) {
+            parsed_request.tile_height = value;
+        } else if (strcmp(key, "keyframe_request") == 0) {
+            parsed_request.keyframe_request = value;
+        } else if (strcmp(key, "time_shift_request") == 0) {
+            parsed_request.time_shift_request = value;
+        } else if (strcmp(key, "time_shift_offset_ms") == 0) {
+            parsed_request.time_shift_offset_ms = value;
+        } else if (strcmp(key, "time_shift_speed") == 0) {
+            parsed_request.time_shift_speed = value;
+        }
+    }
+    fclose(request_file);
+
+    request = parsed_request;
+    return true;
+}
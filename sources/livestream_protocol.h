@@ -0,0 +1,227 @@
+/**
+ * File Name:   livestream_protocol.h
+ *
+ * Description:
+ * This file contains the declarations of the helper functions shared by the SmartCCTV Camera Daemon
+ * and the LiveStream Viewer for exchanging live stream frames through the livestream directory.
+ *
+ * Each published frame is written under a temporary hidden name and then renamed into place, so the
+ * LiveStream Viewer only ever sees complete frames. The final name carries the sequence number of the
+ * frame and the time it was captured:
+ *     <sequence number>_<capture time in microseconds since the epoch>.tiles
+ *
+ * Most of the picture of a fixed camera does not change from frame to frame, so a frame only carries the
+ * tiles of LIVESTREAM_TILE_SIZE x LIVESTREAM_TILE_SIZE pixels that changed since the frame it is based on.
+ * The file is a Livestream_frame_header, followed by one Livestream_tile_index per tile, followed by the
+ * raw BGR pixels of every tile in the same order, row by row (the tiles on the right and bottom edges are
+ * cut to the size of the frame), followed by box_count Metadata_box (see frame_metadata.h), the people and
+ * faces found in the frame, in pixels of the published frame. A keyframe carries every tile, and is based on nothing.
+ * The boxes are only sent while the outlines are turned on. The LiveStream Viewer draws them over the frame,
+ * they are never drawn into the pixels.
+ * If the LiveStream Viewer misses a frame, the next one does not fit onto what it has, so it asks for a
+ * keyframe through the viewer request. Keyframes are also sent every LIVESTREAM_KEYFRAME_INTERVAL frames.
+ *
+ * The LiveStream Viewer shows every active camera at once, so each camera directory also holds two hidden
+ * files, which the LiveStream Viewer skips like the temporary frame:
+ *   - The active marker, written by the camera daemon while it publishes into the directory. It holds the
+ *     PID of the camera daemon, so a marker left behind by a daemon that crashed is recognized as stale.
+ *   - The viewer request, written by the LiveStream Viewer. It tells the camera daemon the size of the tile
+ *     the camera is shown in, so the daemon downscales the frames before publishing them.
+ *
+ * Through the viewer request the LiveStream Viewer can also go back in time: the camera daemon then
+ * publishes the frames it still holds in memory, starting that far back and played at 1x, 2x or 4x, until
+ * it catches up with the live picture. Such frames keep the time they were captured at, and say how far
+ * behind the live picture they are in time_shift_ms.
+ */
+
+#ifndef LIVESTREAM_PROTOCOL_H
+#define LIVESTREAM_PROTOCOL_H
+
+#include <cstdint>  /* for std::uint16_t, std::uint32_t, std::uint64_t, std::int64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+
+// The side of a square tile of a published frame, in pixels.
+#define LIVESTREAM_TILE_SIZE 32
+// Every this many published frames, a keyframe is published so the LiveStream Viewer can resynchronize.
+#define LIVESTREAM_KEYFRAME_INTERVAL 50
+// The first 4 bytes of every published frame.
+#define LIVESTREAM_FRAME_MAGIC "SCTF"
+// The version of the published frame format.
+#define LIVESTREAM_FRAME_VERSION 2
+
+
+/**
+ * The header at the start of a published frame.
+ */
+struct Livestream_frame_header {
+    char magic[4];                 // LIVESTREAM_FRAME_MAGIC, without the terminating '\0'.
+    std::uint32_t version;         // LIVESTREAM_FRAME_VERSION
+    std::uint64_t sequence;        // The sequence number of the frame.
+    std::uint64_t base_sequence;   // The sequence number of the frame the tiles go on top of.
+    std::int64_t capture_time_us;  // The time the frame was captured, see livestream_now_us().
+    std::uint32_t width;           // The width of the frame in pixels.
+    std::uint32_t height;          // The height of the frame in pixels.
+    std::uint32_t tile_size;       // The side of a tile in pixels, LIVESTREAM_TILE_SIZE.
+    std::uint32_t tile_count;      // The number of tiles in the file.
+    std::uint32_t keyframe;        // 1 if the file has every tile of the frame, 0 otherwise.
+    std::uint32_t time_shift_ms;   // How far behind the live picture the frame is replayed, 0 if live.
+    std::uint32_t box_count;       // The number of Metadata_box after the pixels of the tiles.
+    std::uint32_t motion;          // METADATA_MOTION_UNKNOWN, METADATA_MOTION_NONE or METADATA_MOTION_FOUND.
+};
+
+
+/**
+ * Where a tile of a published frame goes, in tiles from the top left corner.
+ */
+struct Livestream_tile_index {
+    std::uint16_t column;
+    std::uint16_t row;
+};
+
+
+/**
+ * The name of the temporary file that a frame is written into before being published.
+ * It starts with a dot so that the LiveStream Viewer skips it.
+ */
+extern const char* const livestream_temporary_frame_name;
+
+/**
+ * The name of the marker file that the camera daemon keeps in its camera directory while it is running.
+ */
+extern const char* const livestream_active_marker_name;
+
+/**
+ * The name of the file through which the LiveStream Viewer tells the camera daemon what it wants.
+ */
+extern const char* const livestream_request_file_name;
+
+
+/**
+ * What the LiveStream Viewer asks of the camera daemon of one camera directory.
+ */
+struct Livestream_request {
+    int tile_width;   // The width of the tile the camera is shown in, 0 for the full resolution.
+    int tile_height;  // The height of the tile the camera is shown in, 0 for the full resolution.
+    int keyframe_request;  // Incremented by the LiveStream Viewer whenever it needs a keyframe.
+    int time_shift_request;    // Incremented by the LiveStream Viewer whenever it moves in time.
+    int time_shift_offset_ms;  // How far back to start replaying from, 0 to go back to the live picture.
+    int time_shift_speed;      // How many times faster than real time to replay, 0 to leave it unchanged.
+};
+
+
+/**
+ * @return std::int64_t - The current wall clock time in microseconds since the epoch.
+ *                        The wall clock is used because the timestamps are compared across processes.
+ */
+std::int64_t livestream_now_us();
+
+
+/**
+ * This function builds the name under which a live stream frame is published.
+ *
+ * @param std::uint64_t sequence - The sequence number of the frame.
+ *
+ * @param std::int64_t capture_time_us - The time the frame was captured, see livestream_now_us().
+ *
+ * @return std::string - The file name, without the directory.
+ */
+std::string make_frame_file_name(std::uint64_t sequence, std::int64_t capture_time_us);
+
+
+/**
+ * This function works out the size of a tile of a published frame, which is smaller on the right and
+ * bottom edges of the frame.
+ *
+ * @param const Livestream_frame_header& header - The header of the frame.
+ *
+ * @param const Livestream_tile_index& tile - The tile.
+ *
+ * @param int& tile_width - Set to the width of the tile in pixels.
+ *
+ * @param int& tile_height - Set to the height of the tile in pixels.
+ *
+ * @return bool - true  if the tile lies inside of the frame.
+ *                false otherwise.
+ */
+bool livestream_tile_size(const Livestream_frame_header& header, const Livestream_tile_index& tile, int& tile_width, int& tile_height);
+
+
+/**
+ * This function extracts the sequence number and the capture time out of the name of a published frame.
+ *
+ * @param const char* file_name - The file name, without the directory.
+ *
+ * @param std::uint64_t& sequence - Set to the sequence number of the frame.
+ *
+ * @param std::int64_t& capture_time_us - Set to the time the frame was captured.
+ *
+ * @return bool - true  if file_name is the name of a published frame.
+ *                false otherwise, the output parameters are left unchanged.
+ */
+bool parse_frame_file_name(const char* file_name, std::uint64_t& sequence, std::int64_t& capture_time_us);
+
+
+
+/**
+ * This function writes the active marker into a camera directory.
+ * It is called by the camera daemon once the directory was created.
+ *
+ * @param const std::string& camera_directory - The camera directory, ending in a '/'.
+ *
+ * @return bool - true  if the marker was written.
+ *                false otherwise, the reason is written to the syslog.
+ */
+bool mark_camera_active(const std::string& camera_directory);
+
+
+/**
+ * This function removes the active marker from a camera directory.
+ * It is called by the camera daemon when it stops publishing into the directory.
+ *
+ * @param const std::string& camera_directory - The camera directory, ending in a '/'.
+ */
+void unmark_camera_active(const std::string& camera_directory);
+
+
+/**
+ * This function finds all the camera directories that a running camera daemon is publishing into.
+ *
+ * @param const std::string& livestream_directory - The parent directory of the camera directories.
+ *
+ * @return std::vector<std::string> - The full names of the active camera directories, ending in a '/',
+ *                                    sorted by name so every camera keeps its place in the grid.
+ */
+std::vector<std::string> find_active_camera_directories(const std::string& livestream_directory);
+
+
+/**
+ * This function writes a viewer request into a camera directory.
+ * The request is written under a temporary name and renamed into place, so it is never read half written.
+ *
+ * @param const std::string& camera_directory - The camera directory, ending in a '/'.
+ *
+ * @param const Livestream_request& request - The request.
+ *
+ * @return bool - true  if the request was written.
+ *                false otherwise, the reason is written to the syslog.
+ */
+bool write_livestream_request(const std::string& camera_directory, const Livestream_request& request);
+
+
+/**
+ * This function reads the viewer request of a camera directory.
+ * Missing fields are set to 0.
+ *
+ * @param const std::string& camera_directory - The camera directory, ending in a '/'.
+ *
+ * @param Livestream_request& request - Set to the request.
+ *
+ * @return bool - true  if there was a request to read.
+ *                false otherwise, the request is left unchanged.
+ */
+bool read_livestream_request(const std::string& camera_directory, Livestream_request& request);
+
+
+#endif  /* LIVESTREAM_PROTOCOL_H */
@@ -9,25 +9,35 @@
  * Description:
  * This file contains the implementation of the LiveStream_window class's methods.
  * An instance of this class represents a single viewer window that is responsible for displaying the
- * live stream from a single camera.
+ * live streams of all the active cameras, as a mosaic.
  */
 
 #include "livestream_window.h"
-#include "write_message.h"
+#include "livestream_protocol.h"
+#include "overlay_text.h"
+#include "event_bus.h"
 
 //#include <sys/types.h>
 //#include <sys/stat.h>
 #include <syslog.h>       /* for syslog() */
 #include <errno.h>        /* for errno() */
-#include <sys/inotify.h>  /* for inotify_init(), inotify_add_watch() */
-#include <unistd.h>       /* for pause(), sleep(), read() */
+#include <sys/inotify.h>  /* for inotify_init1(), inotify_add_watch(), inotify_rm_watch() */
+#include <sys/epoll.h>    /* for epoll_create1(), epoll_ctl(), epoll_wait() */
+#include <sys/signalfd.h> /* for signalfd() */
+#include <sys/timerfd.h>  /* for timerfd_create(), timerfd_settime() */
+#include <signal.h>       /* for sigemptyset(), sigaddset(), signal constants */
+#include <unistd.h>       /* for read(), access(), close(), unlink() */
 #include <dirent.h>       /* for opendir(), readdir(), closedir() */
-#include <cstring>        /* for strerror() */
+#include <cmath>          /* for std::sqrt(), std::ceil() */
+#include <cstdio>         /* for FILE, fopen(), fprintf(), fclose(), rename() */
+#include <cstring>        /* for strerror(), memcpy() */
 #include <string>         /* for std::string */
+#include <vector>         /* for std::vector */
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_syswm.h>
 
 using std::string;
+using std::vector;
 
 #define MAX_EVENT_MONITOR 2048
 // file name length
@@ -36,15 +46,42 @@ using std::string;
 #define MONITOR_EVENT_SIZE (sizeof(struct inotify_event))
 // buffer length
 #define BUFFER_LEN (MAX_EVENT_MONITOR * (MONITOR_EVENT_SIZE + NAME_LEN))
+// how many presented frames the latency written to the syslog is collected over
+#define LAG_REPORT_INTERVAL 300
+// how often the latency statistics file is re-written, and the overlay is refreshed
+#define STATS_EXPORT_INTERVAL_US 1000000
+// how many screen pixels each pixel of the overlay font takes
+#define OVERLAY_SCALE 2
+// how long to wait for a requested keyframe before asking for it again
+#define KEYFRAME_REQUEST_INTERVAL_US 200000
+// how often the redraw timer fires when SDL input can be waited on directly
+#define REDRAW_INTERVAL_MS 1000
+// how often the redraw timer fires when SDL input has to be polled for
+#define INPUT_POLL_INTERVAL_MS 50
+// how long a camera may go without publishing a frame before "NO SIGNAL" is displayed in its tile
+#define NO_SIGNAL_TIMEOUT_US 3000000
+// how far the arrow keys move back and forward in time
+#define TIME_SHIFT_STEP_MS 2000
 
 
 extern int exit_code;
 
 extern void terminate_livestream(int);
+extern void camera_daemon_starts_up(int);
+extern void camera_daemon_shuts_down(int);
 
 
-LiveStream_window::LiveStream_window(const string& streamDir, const string& default_images_directory, const bool& SmartCCTV_daemon_is_running)
- : streamDir(streamDir), default_images_directory(default_images_directory), event(), window(nullptr), renderer(nullptr), surface(nullptr), texture(nullptr), is_camera_daemon_running(SmartCCTV_daemon_is_running)
+// The data.u32 of every file descriptor registered with epoll says where the event came from.
+// The decoder of tile i is registered as DECODER_SOURCE + i, so it must stay the last one.
+enum event_sources { SIGNAL_SOURCE, TIMER_SOURCE, INOTIFY_SOURCE, INPUT_SOURCE, DECODER_SOURCE };
+
+
+LiveStream_window::LiveStream_window(const string& livestream_directory, const string& default_images_directory, const bool& SmartCCTV_daemon_is_running)
+ : livestream_directory(livestream_directory), default_images_directory(default_images_directory), event(), window(nullptr), renderer(nullptr),
+   not_running_texture(), no_signal_texture(), still_frame(), is_camera_daemon_running(SmartCCTV_daemon_is_running),
+   frames_presented(0), frames_dropped(0), stale_frames_skipped(0), report_stats(), interval_stats(), shown_stats(),
+   bytes_received(0), interval_bytes(0), shown_bytes_per_frame(0), last_export_time_us(0), show_overlay(false), show_detections(true), time_shift_speed(1),
+   epoll_fd(-1), inotify_fd(-1), signal_fd(-1), timer_fd(-1), input_fd(-1), needs_render(true)
 {
     // Attempt to initialize graphics and timer system
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
@@ -57,128 +94,574 @@ LiveStream_window::LiveStream_window(const string& streamDir, const string& defa
 
 void LiveStream_window::open()
 {
-    string not_running = default_images_directory + "not_running.bmp";
-    string no_signal   = default_images_directory + "no_signal.bmp";
+    // The window is as large as the default images, and the mosaic is laid out inside of it.
+    load_default_image(default_images_directory + "not_running.bmp", not_running_texture);
+    load_default_image(default_images_directory + "no_signal.bmp", no_signal_texture);
+
+    // The signals of the camera daemon starting up and shutting down, and the terminate signals,
+    // are read from a signalfd inside the event loop instead of interrupting it in a signal handler.
+    // The LiveStream_facade already blocked them, before any decoder thread is started, so that
+    // the decoder threads inherit the mask and never have them delivered to them.
+    sigset_t signal_mask;
+    sigemptyset(&signal_mask);
+    sigaddset(&signal_mask, SIGUSR1);
+    sigaddset(&signal_mask, SIGUSR2);
+    sigaddset(&signal_mask, SIGINT);
+    sigaddset(&signal_mask, SIGTERM);
+    sigaddset(&signal_mask, SIGQUIT);
+
+    if ( (epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error initializing epoll: %m");
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
+
+    if ( (signal_fd = signalfd(-1, &signal_mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error initializing signalfd: %m");
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
+
+    if ( (inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error initializing inotify: %m");
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
 
-    if (!is_camera_daemon_running) {
-        draw_image(not_running);
+    // SDL does not hand out a file descriptor for its events, but on X11 they arrive on the connection
+    // to the X server, which can be waited on. Otherwise the redraw timer has to poll for them.
+    input_fd = find_input_fd();
+    int timer_interval_ms = (input_fd != -1) ? REDRAW_INTERVAL_MS : INPUT_POLL_INTERVAL_MS;
+
+    if ( (timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error initializing timerfd: %m");
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
+    struct itimerspec timer_interval;
+    timer_interval.it_interval.tv_sec = timer_interval_ms / 1000;
+    timer_interval.it_interval.tv_nsec = (timer_interval_ms % 1000) * 1000000L;
+    timer_interval.it_value = timer_interval.it_interval;
+    timerfd_settime(timer_fd, 0, &timer_interval, nullptr);
+
+    add_to_epoll(signal_fd, SIGNAL_SOURCE);
+    add_to_epoll(timer_fd, TIMER_SOURCE);
+    add_to_epoll(inotify_fd, INOTIFY_SOURCE);
+    if (input_fd != -1) {
+        add_to_epoll(input_fd, INPUT_SOURCE);
     }
-    while (!is_camera_daemon_running) {
-        // draw the image to the window
-        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-        SDL_RenderPresent(renderer);
-        SDL_Delay(1000);
+
+    // The statistics are written next to the camera directories, where dashboards can pick them up.
+    stats_file_name = livestream_directory;
+    if (stats_file_name.empty() || stats_file_name.back() != '/') {
+        stats_file_name += '/';
+    }
+    stats_file_name += "latency_stats";
+    last_export_time_us = livestream_now_us();
+
+    scan_cameras();
+    render();
+
+    struct epoll_event ready_events[16];
+    while (true)
+    {
+        // epoll_wait() sleeps until something actually happens, so an idle window uses no CPU,
+        // yet it stays responsive whether or not the cameras are publishing frames.
+        int total_ready = epoll_wait(epoll_fd, ready_events, 16, -1);
+        if (total_ready == -1) {
+            if (errno != EINTR) {
+                syslog(log_facility | LOG_ERR, "epoll_wait() error : %m");
+            }
+            continue;
+        }
+
+        for (int i = 0; i < total_ready; ++i) {
+            std::uint32_t source = ready_events[i].data.u32;
+            switch (source) {
+              case SIGNAL_SOURCE:
+                handle_signals();
+                break;
+              case TIMER_SOURCE:
+                handle_timer();
+                break;
+              case INOTIFY_SOURCE:
+                handle_published_frames();
+                break;
+              case INPUT_SOURCE:
+                // handled by process_events() below
+                break;
+              default:
+                handle_decoded_frame(source - DECODER_SOURCE);
+            }
+        }
+
+        // SDL may have already pulled input off the X connection while presenting,
+        // so the event queue is drained after every wake up, not only when input_fd is readable.
         process_events();
-        // pause();  // prevents the window from appearing
+
+        // All the tiles that changed during this wake up are presented together, once.
+        if (needs_render) {
+            render();
+        }
+
+        // Presenting the frame can read input off the X connection into the queue of Xlib, which does not
+        // wake epoll_wait(), so that input is handled now instead of when the redraw timer next fires.
+        while (input_pending()) {
+            process_events();
+            if (needs_render) {
+                render();
+            }
+        }
+    }
+}
+
+
+void LiveStream_window::finalize()
+{
+    clear_tiles();
+    if (not_running_texture.texture != nullptr)  SDL_DestroyTexture(not_running_texture.texture);
+    if (no_signal_texture.texture != nullptr)    SDL_DestroyTexture(no_signal_texture.texture);
+    not_running_texture = Texture_slot();
+    no_signal_texture = Texture_slot();
+    if (renderer != nullptr)  SDL_DestroyRenderer(renderer);
+    if (epoll_fd != -1)       close(epoll_fd);
+    if (inotify_fd != -1)     close(inotify_fd);
+    if (signal_fd != -1)      close(signal_fd);
+    if (timer_fd != -1)       close(timer_fd);
+    epoll_fd = inotify_fd = signal_fd = timer_fd = -1;
+    renderer = nullptr;
+    if (window != nullptr)    SDL_DestroyWindow(window);
+    window = nullptr;
+    SDL_Quit();
+}
+
+
+void LiveStream_window::add_to_epoll(int fd, std::uint32_t source)
+{
+    struct epoll_event watched_event;
+    watched_event.events = EPOLLIN;
+    watched_event.data.u64 = 0;
+    watched_event.data.u32 = source;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &watched_event) == -1) {
+        syslog(log_facility | LOG_ERR, "Error adding a file descriptor to epoll : %m");
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
+}
+
+
+int LiveStream_window::find_input_fd()
+{
+#if defined(SDL_VIDEO_DRIVER_X11)
+    SDL_SysWMinfo info;
+    SDL_VERSION(&info.version);
+    if (window != nullptr && SDL_GetWindowWMInfo(window, &info) && info.subsystem == SDL_SYSWM_X11) {
+        return ConnectionNumber(info.info.x11.display);
+    }
+#endif
+    syslog(log_facility | LOG_NOTICE, "Polling for window events every %d ms", INPUT_POLL_INTERVAL_MS);
+    return -1;
+}
+
+
+bool LiveStream_window::input_pending()
+{
+    // SDL_PumpEvents() moves every event that is in the queue of Xlib into the queue of SDL.
+    SDL_PumpEvents();
+    return SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+}
+
+
+void LiveStream_window::scan_cameras()
+{
+    vector<string> camera_directories;
+    if (is_camera_daemon_running) {
+        camera_directories = find_active_camera_directories(livestream_directory);
+    }
+
+    // Nothing changed, keep the tiles and their decoders as they are.
+    bool same_cameras = camera_directories.size() == tiles.size();
+    for (size_t i = 0; same_cameras && i < tiles.size(); ++i) {
+        same_cameras = tiles[i]->directory == camera_directories[i];
+    }
+    if (same_cameras) {
+        return;
+    }
+
+    clear_tiles();
+
+    for (const string& camera_directory : camera_directories) {
+        Stream_tile* tile = new Stream_tile();
+        tiles.emplace_back(tile);
+        tile->directory = camera_directory;
+        tile->watch_desc = -1;
+        tile->last_present_time_us = 0;
+        tile->showing_frame = false;
+        tile->last_sequence = 0;
+        tile->has_sequence = false;
+        tile->last_latency_us = 0;
+        tile->time_shift_ms = 0;
+        tile->last_keyframe_request_us = 0;
+        tile->motion = METADATA_MOTION_UNKNOWN;
+        tile->frame_width = 0;
+        tile->frame_height = 0;
+        tile->request.time_shift_speed = time_shift_speed;
+        // The label of the tile in the overlay is the name of the camera directory.
+        tile->name = camera_directory.substr(0, camera_directory.length() - 1);
+        tile->name = tile->name.substr(tile->name.rfind('/') + 1);
+
+        if (!tile->decoder.start()) {
+            exit_code = EXIT_FAILURE;
+            terminate_livestream(0);
+        }
+        add_to_epoll(tile->decoder.notification_fd(), DECODER_SOURCE + (tiles.size() - 1));
+        watch_tile(*tile);
+    }
+
+    layout_tiles();
+    needs_render = true;
+    syslog(log_facility | LOG_NOTICE, "LiveStream Viewer is showing %zu camera(s)", tiles.size());
+}
+
+
+void LiveStream_window::clear_tiles()
+{
+    for (auto& tile : tiles) {
+        if (tile->watch_desc != -1) {
+            inotify_rm_watch(inotify_fd, tile->watch_desc);
+        }
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, tile->decoder.notification_fd(), nullptr);
+        // The camera daemon goes back to publishing full frames once nobody is looking at the tile.
+        unlink((tile->directory + livestream_request_file_name).c_str());
+        if (tile->texture.texture != nullptr) {
+            SDL_DestroyTexture(tile->texture.texture);
+        }
+    }
+    // Destroying the tiles also stops their decoder threads.
+    tiles.clear();
+    needs_render = true;
+}
+
+
+void LiveStream_window::layout_tiles()
+{
+    if (tiles.empty()) {
+        return;
     }
 
-    // If the camera daemon is not running, the above code will continue to sit the while loop until
-    // the camera daemon finally starts up, and sends a singal to this LiveStream Viewer process.
-    // Then the variable is_camera_daemon_running is set to true and streamDir becomes set to the directory
-    // that should be watched for camera images.
+    int window_width = 0;
+    int window_height = 0;
+    SDL_GetWindowSize(window, &window_width, &window_height);
+
+    // The smallest grid that is about as wide as it is tall.
+    int columns = (int) std::ceil(std::sqrt((double) tiles.size()));
+    int rows = ((int) tiles.size() + columns - 1) / columns;
+    int tile_width = window_width / columns;
+    int tile_height = window_height / rows;
+
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        Stream_tile& tile = *tiles[i];
+        tile.area.x = (int) (i % columns) * tile_width;
+        tile.area.y = (int) (i / columns) * tile_height;
+        tile.area.w = tile_width;
+        tile.area.h = tile_height;
+
+        // The camera daemon downscales the frames to the tile before publishing them.
+        tile.request.tile_width = tile_width;
+        tile.request.tile_height = tile_height;
+        write_livestream_request(tile.directory, tile.request);
+    }
+}
+
+
+void LiveStream_window::watch_tile(Stream_tile& tile)
+{
+    // The camera daemon renames every frame into place once it is completely written.
+    if ( (tile.watch_desc = inotify_add_watch(inotify_fd, tile.directory.c_str(), IN_MOVED_TO)) == -1) {
+        const char* const error_message = strerror(errno);
+        syslog(log_facility | LOG_ERR, "Could not add watch to folder %s : %s", tile.directory.c_str(), error_message);
+        return;
+    }
 
     // Get rid of any residue or glichy images.
     // Sometimes there may be left images from the last run in the directory that were not removed.
-    if (auto dir = opendir(streamDir.c_str())) {
+    // This is done after the watch is added, so that the camera daemon cannot publish a frame
+    // that the viewer never hears about, and then wait forever for it to be consumed.
+    if (auto dir = opendir(tile.directory.c_str())) {
         while (auto f = readdir(dir)) {
             if (!f->d_name || f->d_name[0] == '.') {
                 continue;  // Skip everything that starts with a dot
             } else if (f->d_name != nullptr) {
-                if (unlink(f->d_name) == -1) {
-                    const char* const error_message = strerror(errno);
-                    syslog(log_facility | LOG_ERR, "Error cannot delete %s : %s", f->d_name, error_message);
-                }
+                delete_frame(tile.directory + f->d_name);
             }
         }
         closedir(dir);
     }
 
-    int inotify_fd = 0;
-    char buffer[BUFFER_LEN];
+    // Give the camera the full timeout to publish its first frame.
+    tile.last_present_time_us = livestream_now_us();
+}
 
-    if ( (inotify_fd = inotify_init()) == -1) {
-        syslog(log_facility | LOG_ERR, "Error initializing inotify: %m");
-        exit_code = EXIT_FAILURE;
-        terminate_livestream(0);
+
+void LiveStream_window::handle_signals()
+{
+    struct signalfd_siginfo signal_info;
+    while (read(signal_fd, &signal_info, sizeof(signal_info)) == sizeof(signal_info)) {
+        switch (signal_info.ssi_signo) {
+          case SIGUSR1:
+            // The camera daemon started up.
+            camera_daemon_starts_up(SIGUSR1);
+            scan_cameras();
+            needs_render = true;
+            break;
+          case SIGUSR2:
+            // The camera daemon shut down.
+            camera_daemon_shuts_down(SIGUSR2);
+            clear_tiles();
+            break;
+          default:
+            exit_code = EXIT_SUCCESS;
+            terminate_livestream(signal_info.ssi_signo);
+        }
     }
+}
 
-    int watch_desc = inotify_add_watch(inotify_fd, streamDir.c_str(), IN_CREATE);
-    if (watch_desc == -1) {
-        const char* const error_message = strerror(errno);
-        syslog(log_facility | LOG_ERR, "Could not add watch to folder %s : %s", streamDir.c_str(), error_message);
-        exit_code = EXIT_FAILURE;
-        terminate_livestream(0);
+
+void LiveStream_window::handle_timer()
+{
+    std::uint64_t expirations = 0;
+    if (read(timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        syslog(log_facility | LOG_ERR, "timerfd read() error : %m");
     }
 
-    int i = 0;
-    while (true)
-    {
-        i = 0;
-        // read() blocks if there is no more data to read.
-        // This is the reason why the LiveStream Viewer window is blocking and it appears unresponsive
-        // if the camera daemon is not adding new image files to the directory of if it is not running at all.
-        int total_read = read(inotify_fd, buffer, BUFFER_LEN);
-        if (total_read < 0) {
-            // this could be due to interrupted system call
-            // if a signal is sent at the time, it prevents read() from completing
-            // so try to read() again after the signal handler returns
-            syslog(log_facility | LOG_ERR, "inotify read() error : %m");
-            if (is_camera_daemon_running) {
-                draw_image(no_signal);
-            } else {
-                draw_image(not_running);
-            }
-            process_events();
-            continue;
-        } else if (total_read == 0) {
-            if (is_camera_daemon_running) {
-                draw_image(no_signal);
-            } else {
-                draw_image(not_running);
-            }
-            process_events();
+    // The camera directories are created by the camera daemon after it has told the viewer that it started up,
+    // so they are looked for again until they show up.
+    scan_cameras();
+
+    // A camera that is running but has stopped publishing frames shows "NO SIGNAL" in its tile.
+    std::int64_t now = livestream_now_us();
+    for (auto& tile : tiles) {
+        if (tile->showing_frame && now - tile->last_present_time_us > NO_SIGNAL_TIMEOUT_US) {
+            tile->showing_frame = false;
+            needs_render = true;
         }
+    }
+
+    if (now - last_export_time_us >= STATS_EXPORT_INTERVAL_US) {
+        export_stats(now);
+    }
+}
+
 
+void LiveStream_window::handle_published_frames()
+{
+    alignas(struct inotify_event) char buffer[BUFFER_LEN];
+
+    // Only the newest frame that arrived for each tile is worth showing.
+    // Older frames that piled up while the last one was being drawn are deleted without being displayed,
+    // so a slow render never makes the viewer fall further and further behind.
+    struct Newest_frame {
+        string file_name;
+        std::uint64_t sequence;
+        std::int64_t capture_time;
+    };
+    vector<Newest_frame> newest_frames(tiles.size());
+
+    int total_read = 0;
+    while ( (total_read = read(inotify_fd, buffer, BUFFER_LEN)) > 0) {
+        int i = 0;
         while (i < total_read) {
             struct inotify_event* event = (struct inotify_event*) &buffer[i];
-            if (event->len > 0) {
-                // if ( file is created) && (it is not a directory) )
-                if ( (event->mask & IN_CREATE) && !(event->mask & IN_ISDIR) ) {
-                    string image_file = streamDir + "/";
-                    image_file += event->name;
-                    //syslog(log_facility | LOG_NOTICE, "file %s appeared", event->name);
-                    draw_image(image_file);
-                    // delete the image file from the directory as soon as it is displayed to the screen
-                    if (unlink(image_file.c_str()) == -1) {
-                        const char* const error_message = strerror(errno);
-                        syslog(log_facility | LOG_ERR, "Error cannot delete %s : %s", image_file.c_str(), error_message);
+            std::uint64_t sequence = 0;
+            std::int64_t capture_time = 0;
+            // if ( (file is moved in) && (it is not a directory) && (it is a published frame) )
+            if ( event->len > 0 && (event->mask & IN_MOVED_TO) && !(event->mask & IN_ISDIR)
+                 && parse_frame_file_name(event->name, sequence, capture_time) ) {
+                size_t tile_index = 0;
+                while (tile_index < tiles.size() && tiles[tile_index]->watch_desc != event->wd) {
+                    ++tile_index;
+                }
+                if (tile_index < tiles.size()) {
+                    Newest_frame& newest = newest_frames[tile_index];
+                    const string& directory = tiles[tile_index]->directory;
+                    if (newest.file_name.empty() || sequence > newest.sequence) {
+                        if (!newest.file_name.empty()) {
+                            delete_frame(directory + newest.file_name);
+                            ++stale_frames_skipped;
+                        }
+                        newest.file_name = event->name;
+                        newest.sequence = sequence;
+                        newest.capture_time = capture_time;
+                    } else {
+                        delete_frame(directory + event->name);
+                        ++stale_frames_skipped;
                     }
-                    process_events();
                 }
-                 // move onto the next event
-                i += event->len + MONITOR_EVENT_SIZE;
             }
+            // move onto the next event
+            i += event->len + MONITOR_EVENT_SIZE;
         }
+    }
+    if (total_read == -1 && errno != EAGAIN) {
+        syslog(log_facility | LOG_ERR, "inotify read() error : %m");
+    }
 
-        process_events();
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const Newest_frame& newest = newest_frames[i];
+        string image_file = tiles[i]->directory + newest.file_name;
+        // The newest frame may already be gone if it was cleaned up as residue.
+        // The decoder thread deletes the image file as soon as it has read it,
+        // which also tells the camera daemon that the viewer is ready for the next frame.
+        if (!newest.file_name.empty() && access(image_file.c_str(), F_OK) == 0) {
+            tiles[i]->decoder.request(image_file, newest.sequence, newest.capture_time);
+        }
+    }
+}
+
+
+void LiveStream_window::handle_decoded_frame(size_t tile_index)
+{
+    if (tile_index >= tiles.size()) {
+        return;
+    }
+    Stream_tile& tile = *tiles[tile_index];
+
+    // The decoder thread has finished a frame, the render loop only uploads and presents it.
+    const Decoded_frame* frame = tile.decoder.acquire();
+
+    // A frame was missed, so the ones that follow do not fit onto the picture until the next keyframe.
+    std::int64_t now = livestream_now_us();
+    if (tile.decoder.keyframe_needed() && now - tile.last_keyframe_request_us > KEYFRAME_REQUEST_INTERVAL_US) {
+        ++tile.request.keyframe_request;
+        write_livestream_request(tile.directory, tile.request);
+        tile.last_keyframe_request_us = now;
     }
 
+    if (frame == nullptr || !upload_frame(tile.texture, *frame)) {
+        return;
+    }
+    bytes_received += frame->encoded_bytes;
+    interval_bytes += frame->encoded_bytes;
+
+    tile.showing_frame = true;
+    tile.last_present_time_us = livestream_now_us();
+    tile.boxes = frame->boxes;
+    tile.motion = frame->motion;
+    tile.frame_width = frame->width;
+    tile.frame_height = frame->height;
+    needs_render = true;
+
+    // Every frame the camera captured has the next sequence number, so a gap between two presented frames
+    // is the number of frames that never made it to the screen, no matter where they were dropped.
+    std::uint64_t gap = 0;
+    if (tile.has_sequence && frame->sequence > tile.last_sequence) {
+        gap = frame->sequence - tile.last_sequence - 1;
+    }
+    tile.last_sequence = frame->sequence;
+    tile.has_sequence = true;
+    // A replayed frame was captured long ago, but it was published as late as a live frame would have been.
+    tile.time_shift_ms = frame->time_shift_ms;
+    tile.last_latency_us = tile.last_present_time_us - frame->capture_time_us - (std::int64_t) frame->time_shift_ms * 1000;
+    record_latency(tile.last_latency_us, gap);
 }
 
 
-void LiveStream_window::finalize()
+void LiveStream_window::delete_frame(const string& image_file)
 {
-    if (surface != nullptr)   SDL_FreeSurface(surface);
-    if (texture != nullptr)   SDL_DestroyTexture(texture);
-    if (renderer != nullptr)  SDL_DestroyRenderer(renderer);
-    if (window != nullptr)    SDL_DestroyWindow(window);
-    SDL_Quit();
+    if (unlink(image_file.c_str()) == -1) {
+        const char* const error_message = strerror(errno);
+        syslog(log_facility | LOG_ERR, "Error cannot delete %s : %s", image_file.c_str(), error_message);
+    }
+}
+
+
+void LiveStream_window::record_latency(std::int64_t latency_us, std::uint64_t gap)
+{
+    report_stats.record(latency_us, gap);
+    interval_stats.record(latency_us, gap);
+    ++frames_presented;
+    frames_dropped += gap;
+
+    if (report_stats.frames() == LAG_REPORT_INTERVAL) {
+        std::uint64_t decoder_drops = 0;
+        for (auto& tile : tiles) {
+            decoder_drops += tile->decoder.frames_dropped();
+        }
+        syslog(log_facility | LOG_NOTICE, "LiveStream latency over the last %d frames: p50 %lld ms, p95 %lld ms, p99 %lld ms, maximum %lld ms, "
+                                          "%llu frames dropped, %llu stale frames skipped by the viewer",
+               LAG_REPORT_INTERVAL, (long long) (report_stats.percentile_us(50) / 1000), (long long) (report_stats.percentile_us(95) / 1000),
+               (long long) (report_stats.percentile_us(99) / 1000), (long long) (report_stats.max_us() / 1000),
+               (unsigned long long) report_stats.dropped(), (unsigned long long) (stale_frames_skipped + decoder_drops));
+        report_stats.reset();
+    }
 }
 
 
-void LiveStream_window::set_streamDir(const string& streamDir)
+void LiveStream_window::export_stats(std::int64_t now)
 {
-    this->streamDir = streamDir;
+    // The overlay shows the statistics of the last interval, so it does not flicker on every frame.
+    shown_stats = interval_stats;
+    shown_bytes_per_frame = (shown_stats.frames() == 0) ? 0 : interval_bytes / shown_stats.frames();
+    interval_stats.reset();
+    interval_bytes = 0;
+    std::int64_t interval_us = now - last_export_time_us;
+    last_export_time_us = now;
+    if (show_overlay) {
+        needs_render = true;
+    }
+
+    // Written under a temporary name and renamed into place, so a reader never sees a half written file.
+    string temporary_file_name = stats_file_name + ".tmp";
+    FILE* stats_file = fopen(temporary_file_name.c_str(), "w");
+    if (stats_file == nullptr) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create %s : %m", temporary_file_name.c_str());
+        return;
+    }
+    fprintf(stats_file, "timestamp_us=%lld\n", (long long) now);
+    fprintf(stats_file, "interval_us=%lld\n", (long long) interval_us);
+    fprintf(stats_file, "cameras=%zu\n", tiles.size());
+    fprintf(stats_file, "frames_presented_total=%llu\n", (unsigned long long) frames_presented);
+    fprintf(stats_file, "frames_dropped_total=%llu\n", (unsigned long long) frames_dropped);
+    fprintf(stats_file, "stale_frames_skipped_total=%llu\n", (unsigned long long) stale_frames_skipped);
+    fprintf(stats_file, "frames_presented=%llu\n", (unsigned long long) shown_stats.frames());
+    fprintf(stats_file, "frames_dropped=%llu\n", (unsigned long long) shown_stats.dropped());
+    fprintf(stats_file, "latency_mean_us=%lld\n", (long long) shown_stats.mean_us());
+    fprintf(stats_file, "latency_p50_us=%lld\n", (long long) shown_stats.percentile_us(50));
+    fprintf(stats_file, "latency_p90_us=%lld\n", (long long) shown_stats.percentile_us(90));
+    fprintf(stats_file, "latency_p95_us=%lld\n", (long long) shown_stats.percentile_us(95));
+    fprintf(stats_file, "latency_p99_us=%lld\n", (long long) shown_stats.percentile_us(99));
+    fprintf(stats_file, "latency_max_us=%lld\n", (long long) shown_stats.max_us());
+    fprintf(stats_file, "bytes_received_total=%llu\n", (unsigned long long) bytes_received);
+    fprintf(stats_file, "bytes_per_frame=%llu\n", (unsigned long long) shown_bytes_per_frame);
+    fclose(stats_file);
+
+    if (rename(temporary_file_name.c_str(), stats_file_name.c_str()) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not write %s : %m", stats_file_name.c_str());
+    }
+}
+
+
+void LiveStream_window::draw_overlay()
+{
+    // The latency of the last interval, over all the cameras.
+    string summary = "P50 " + std::to_string(shown_stats.percentile_us(50) / 1000)
+                   + " P95 " + std::to_string(shown_stats.percentile_us(95) / 1000)
+                   + " P99 " + std::to_string(shown_stats.percentile_us(99) / 1000)
+                   + " MAX " + std::to_string(shown_stats.max_us() / 1000)
+                   + " MS  DROP " + std::to_string(shown_stats.dropped())
+                   + "/" + std::to_string(shown_stats.frames() + shown_stats.dropped())
+                   + "  KB/F " + std::to_string(shown_bytes_per_frame / 1024);
+    draw_overlay_text(renderer, 0, 0, OVERLAY_SCALE, summary);
+
+    // The newest frame of every camera, in the corner of its tile.
+    for (auto& tile : tiles) {
+        if (!tile->showing_frame) {
+            continue;
+        }
+        string label = tile->name + " #" + std::to_string(tile->last_sequence)
+                     + " " + std::to_string(tile->last_latency_us / 1000) + "MS";
+        draw_overlay_text(renderer, tile->area.x, tile->area.y + tile->area.h - overlay_text_height(OVERLAY_SCALE), OVERLAY_SCALE, label);
+    }
 }
 
 
@@ -187,52 +670,126 @@ void LiveStream_window::process_events()
     while (SDL_PollEvent(&event))
     {
         if (event.type == SDL_QUIT) {
-            write_message("LiveStream Viewer window was closed.");
+            post_event(make_event(EVENT_VIEWER_CLOSED, SOURCE_VIEWER, -1));
             exit_code = EXIT_SUCCESS;
             terminate_livestream(0);
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_l) {
+            // The L key shows and hides the latency overlay.
+            show_overlay = !show_overlay;
+            needs_render = true;
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_o) {
+            // The O key shows and hides the outlines of the detections.
+            show_detections = !show_detections;
+            needs_render = true;
+        } else if (event.type == SDL_KEYDOWN) {
+            switch (event.key.keysym.sym) {
+                case SDLK_LEFT:  time_shift(-TIME_SHIFT_STEP_MS); break;
+                case SDLK_RIGHT: time_shift(TIME_SHIFT_STEP_MS); break;
+                case SDLK_END:   time_shift(0); break;
+                case SDLK_1:     set_time_shift_speed(1); break;
+                case SDLK_2:     set_time_shift_speed(2); break;
+                case SDLK_4:     set_time_shift_speed(4); break;
+                default:         break;
+            }
+        } else if (event.type == SDL_WINDOWEVENT) {
+            if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                // The tiles follow the window, and the camera daemons are told the new tile size, so they
+                // publish frames that are already the size they are shown at.
+                layout_tiles();
+                needs_render = true;
+            } else if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                needs_render = true;
+            }
         }
     }
 }
 
 
-void LiveStream_window::draw_image(const string& image_name)
+void LiveStream_window::time_shift(int step_ms)
 {
-    static bool window_initialized = false;
+    for (auto& tile : tiles) {
+        // The step is taken from where the tile is now, which moves on while it is replaying.
+        int offset_ms = 0;
+        if (step_ms != 0) {
+            offset_ms = (int) tile->time_shift_ms - step_ms;
+        }
+        tile->request.time_shift_offset_ms = (offset_ms > 0) ? offset_ms : 0;
+        ++tile->request.time_shift_request;
+        write_livestream_request(tile->directory, tile->request);
+    }
+}
 
-    int window_width = 0, window_height = 0;
 
-    if (surface != nullptr) {
-        SDL_FreeSurface(surface);
-        surface = nullptr;
+void LiveStream_window::set_time_shift_speed(int speed)
+{
+    time_shift_speed = speed;
+    for (auto& tile : tiles) {
+        tile->request.time_shift_speed = speed;
+        write_livestream_request(tile->directory, tile->request);
     }
+}
 
-    // while (true) is needed because it might fail to open the image file the first time
-    while (true) {
-        surface = IMG_Load(image_name.c_str());
-        if (surface != nullptr)  // success
-            break;
-        const char* const error_message = SDL_GetError();
-        // Trying to open the image file while SmartCCTV is writing it.
-        if (strcmp("Error reading from datastream", error_message) == 0) {
-            SDL_Delay(5);
+
+void LiveStream_window::draw_time_shift_labels()
+{
+    for (auto& tile : tiles) {
+        if (!tile->showing_frame || tile->time_shift_ms == 0) {
             continue;
-        // This is a bug that sometimes happens.
-        // It just failed to open the image for some reason.
-        } else if (strcmp("Unsupported image format", error_message) == 0) {
-            SDL_Delay(5);
+        }
+        string label = "REPLAY -" + std::to_string(tile->time_shift_ms / 1000) + "." + std::to_string(tile->time_shift_ms / 100 % 10)
+                     + "S " + std::to_string(time_shift_speed) + "X";
+        int y = tile->area.y + (show_overlay ? overlay_text_height(OVERLAY_SCALE) : 0);
+        draw_overlay_text(renderer, tile->area.x, y, OVERLAY_SCALE, label);
+    }
+}
+
+
+void LiveStream_window::draw_detections()
+{
+    for (auto& tile : tiles) {
+        if (!tile->showing_frame || tile->frame_width <= 0 || tile->frame_height <= 0) {
             continue;
-        } else {
-            syslog(log_facility | LOG_ERR, "Error opening image %s : %s", image_name.c_str(), error_message);
-            exit_code = EXIT_FAILURE;
-            terminate_livestream(0);
         }
+        // The frame is stretched over the tile, and so are its boxes.
+        double x_scale = (double) tile->area.w / tile->frame_width;
+        double y_scale = (double) tile->area.h / tile->frame_height;
+        for (const Metadata_box& box : tile->boxes) {
+            // The people are outlined in green and the faces in blue, the way they used to be drawn into the frames.
+            if (box.kind == METADATA_BOX_FACE) {
+                SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+            } else {
+                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+            }
+            SDL_Rect outline = { tile->area.x + (int) (box.x * x_scale), tile->area.y + (int) (box.y * y_scale),
+                                 (int) (box.width * x_scale), (int) (box.height * y_scale) };
+            SDL_RenderDrawRect(renderer, &outline);
+            SDL_Rect inner = { outline.x + 1, outline.y + 1, outline.w - 2, outline.h - 2 };
+            SDL_RenderDrawRect(renderer, &inner);
+            if (box.track_id != 0) {
+                draw_overlay_text(renderer, outline.x, outline.y, OVERLAY_SCALE, "#" + std::to_string(box.track_id));
+            }
+        }
+        if (tile->motion != METADATA_MOTION_UNKNOWN) {
+            // In the top right corner, out of the way of the labels on the left.
+            int y = tile->area.y + (show_overlay ? overlay_text_height(OVERLAY_SCALE) : 0);
+            draw_overlay_text(renderer, tile->area.x + tile->area.w - overlay_text_width("+", OVERLAY_SCALE), y, OVERLAY_SCALE,
+                              tile->motion == METADATA_MOTION_FOUND ? "+" : "-");
+        }
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+
+
+void LiveStream_window::load_default_image(const string& image_name, Texture_slot& slot)
+{
+    if (!Frame_decoder::decode_image(image_name, still_frame)) {
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
     }
-    window_width = surface->w;
-    window_height = surface->h;
 
-    // Initialize the SDL window (this is only run once).
-    if (!window_initialized) {
-        window = SDL_CreateWindow("SmartCCTV LiveStream Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_width, window_height, 0);
+    // Initialize the SDL window to the size of the first default image (this is only run once).
+    if (window == nullptr) {
+        window = SDL_CreateWindow("SmartCCTV LiveStream Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, still_frame.width, still_frame.height, SDL_WINDOW_RESIZABLE);
         if (window == nullptr) {
             syslog(log_facility | LOG_CRIT, "Error creating window: %s", SDL_GetError());
             exit_code = EXIT_FAILURE;
@@ -246,31 +803,98 @@ void LiveStream_window::draw_image(const string& image_name)
             exit_code = EXIT_FAILURE;
             terminate_livestream(0);
         }
+    }
+
+    if (!upload_frame(slot, still_frame)) {
+        exit_code = EXIT_FAILURE;
+        terminate_livestream(0);
+    }
+}
+
 
-        window_initialized = true;
+bool LiveStream_window::upload_frame(Texture_slot& slot, const Decoded_frame& frame)
+{
+    // The streaming texture is only re-created when the resolution of the frames changes,
+    // every other frame is copied into it in place.
+    bool full_update = frame.full_update;
+    if (slot.texture == nullptr || slot.width != frame.width || slot.height != frame.height) {
+        if (slot.texture != nullptr) {
+            SDL_DestroyTexture(slot.texture);
+        }
+        slot.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, frame.width, frame.height);
+        if (slot.texture == nullptr) {
+            syslog(log_facility | LOG_CRIT, "Error creating texture: %s", SDL_GetError());
+            slot.width = slot.height = 0;
+            return false;
+        }
+        slot.width = frame.width;
+        slot.height = frame.height;
+        full_update = true;
     }
 
-    // Create a new texture for each surface (image).
-    if (texture != nullptr) {
-        SDL_DestroyTexture(texture);
-        texture = nullptr;
+    // Only the tiles that changed are copied, the rest of the texture still holds the previous frame.
+    if (!full_update) {
+        for (const Dirty_rect& rect : frame.dirty) {
+            SDL_Rect area = { rect.x, rect.y, rect.width, rect.height };
+            const unsigned char* source = frame.pixels.data() + (size_t) rect.y * frame.pitch + (size_t) rect.x * 4;
+            if (SDL_UpdateTexture(slot.texture, &area, source, frame.pitch) != 0) {
+                syslog(log_facility | LOG_ERR, "Error updating texture: %s", SDL_GetError());
+                return false;
+            }
+        }
+        return true;
     }
 
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface);
-    surface = nullptr;
-    if (texture == nullptr) {
-        syslog(log_facility | LOG_CRIT, "Error creating texture: %s", SDL_GetError());
-        exit_code = EXIT_FAILURE;
-        terminate_livestream(0);
+    void* texture_pixels = nullptr;
+    int texture_pitch = 0;
+    if (SDL_LockTexture(slot.texture, nullptr, &texture_pixels, &texture_pitch) == 0) {
+        const unsigned char* source = frame.pixels.data();
+        unsigned char* destination = static_cast<unsigned char*>(texture_pixels);
+        if (texture_pitch == frame.pitch) {
+            memcpy(destination, source, (size_t) frame.pitch * frame.height);
+        } else {
+            for (int row = 0; row < frame.height; ++row) {
+                memcpy(destination + (size_t) row * texture_pitch, source + (size_t) row * frame.pitch, frame.width * 4);
+            }
+        }
+        SDL_UnlockTexture(slot.texture);
+    } else if (SDL_UpdateTexture(slot.texture, nullptr, frame.pixels.data(), frame.pitch) != 0) {
+        syslog(log_facility | LOG_ERR, "Error updating texture: %s", SDL_GetError());
+        return false;
     }
 
+    return true;
+}
+
+
+void LiveStream_window::render()
+{
     // clear the window
     SDL_RenderClear(renderer);
 
-    // draw the image to the window
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    if (tiles.empty()) {
+        // If the camera daemon is not running, "SmartCCTV is not running" is displayed.
+        // If it is running but has no active camera yet, "NO SIGNAL" is displayed.
+        SDL_Texture* default_image = is_camera_daemon_running ? no_signal_texture.texture : not_running_texture.texture;
+        SDL_RenderCopy(renderer, default_image, nullptr, nullptr);
+    } else {
+        // draw every camera into its tile of the mosaic
+        for (auto& tile : tiles) {
+            SDL_Texture* image = tile->showing_frame ? tile->texture.texture : no_signal_texture.texture;
+            SDL_RenderCopy(renderer, image, nullptr, &tile->area);
+        }
+    }
+
+    if (show_detections) {
+        draw_detections();
+    }
+    if (show_overlay) {
+        draw_overlay();
+    }
+    draw_time_shift_labels();
+
     SDL_RenderPresent(renderer);
+    needs_render = false;
 }
 
 
@@ -278,4 +902,3 @@ LiveStream_window::~LiveStream_window()
 {
     finalize();
 }
-
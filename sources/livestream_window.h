@@ -9,13 +9,20 @@
  * Description:
  * This file contains the declaration of the LiveStream_window class.
  * An instance of this class represents a single viewer window that is responsible for displaying the
- * live stream from a single camera.
+ * live streams of all the active cameras, as a mosaic.
  */
 
 #ifndef LIVESTREAM_WINDOW_H
 #define LIVESTREAM_WINDOW_H
 
+#include "frame_decoder.h"
+#include "latency_stats.h"
+#include "livestream_protocol.h"
+
 #include <string>      /* for std::string */
+#include <cstdint>     /* for std::uint32_t, std::uint64_t, std::int64_t */
+#include <memory>      /* for std::unique_ptr */
+#include <vector>      /* for std::vector */
 #include <SDL2/SDL.h>  /* for SDL_Window */
 
 using std::string;
@@ -28,8 +35,10 @@ class LiveStream_window {
   public:
     /**
      * The consturctor initializes all the private variables to their initial values.
+     *
+     * @param const string& livestream_directory - The parent directory of the camera directories.
      */
-    LiveStream_window(const string& streamDir, const string& default_images_directory, const bool& SmartCCTV_daemon_is_running);
+    LiveStream_window(const string& livestream_directory, const string& default_images_directory, const bool& SmartCCTV_daemon_is_running);
 
     /**
      * The destructor calls LiveStream_window::finalize().
@@ -42,12 +51,26 @@ class LiveStream_window {
      * Short for "open window of the livestream viewer"
      * this function contains the main functionality of the LiveStream Viewer Window.
      * If the camera daemon is not running, it displays a default image.
-     * otherwise is uses inotify to watch the directory streamDir and display images on the screen as they
-     * are created by the the camera daemon, and after it displays the images it immediatley deletes them
-     * to keep from overloading the file system with frames of images.
+     * otherwise it shows every active camera directory in a tile of a grid, and it uses inotify to watch
+     * those directories and display images on the screen as they are published by the the camera daemon,
+     * and after it displays the images it immediatley deletes them to keep from overloading the file system
+     * with frames of images.
+     * If several frames of a camera were published while the last one was being drawn, only the newest is
+     * displayed.
+     * Each camera is told the size of its tile, so it publishes frames that are already downscaled to it.
      *
      * If the camera daemon is not running, "SmartCCTV is not running" is displayed.
-     * If the camera daemon is running but is not producing images, "NO SIGNAL" is displayed.
+     * If a camera is running but is not producing images, "NO SIGNAL" is displayed in its tile.
+     *
+     * Everything the window reacts to is a file descriptor waited on by a single epoll loop:
+     * frames published into the camera directories (inotify), frames finished by the decoder threads (eventfd),
+     * the camera daemon starting up and shutting down and the terminate signals (signalfd),
+     * user input (the connection to the X server) and a redraw timer (timerfd).
+     * The window therefore sleeps until something happens, and uses next to no CPU while idle.
+     *
+     * The capture-to-present latency and the dropped frames are measured from the capture time and the
+     * sequence number in the name of every frame. The percentiles are exported to the file latency_stats
+     * in the livestream directory every second, and the L key shows them in an overlay.
      */
     void open();
 
@@ -56,14 +79,119 @@ class LiveStream_window {
      */
     void finalize();
 
+  private:
+    /**
+     * A streaming texture, re-used for every frame of the same resolution.
+     */
+    struct Texture_slot {
+        SDL_Texture* texture = nullptr;  // The texture, nullptr if nothing was uploaded yet.
+        int width = 0;                   // The width of the texture in pixels.
+        int height = 0;                  // The height of the texture in pixels.
+    };
+
+    /**
+     * The live stream of one camera, shown in one tile of the mosaic.
+     */
+    struct Stream_tile {
+        string directory;                   // The camera directory, ending in a '/'.
+        int watch_desc;                     // The inotify watch of the directory, -1 if not watching.
+        Frame_decoder decoder;              // Decodes the frames of this camera off the render loop.
+        Texture_slot texture;               // The newest frame of this camera.
+        SDL_Rect area;                      // Where the tile is drawn in the window.
+        std::int64_t last_present_time_us;  // When the last frame of this camera was presented.
+        bool showing_frame;                 // Is a live frame, rather than "NO SIGNAL", being displayed?
+        string name;                        // The name of the camera directory, shown in the overlay.
+        std::uint64_t last_sequence;        // The sequence number of the last presented frame.
+        bool has_sequence;                  // Was a frame of this camera presented yet?
+        std::int64_t last_latency_us;       // The capture-to-present latency of the last presented frame.
+        std::uint32_t time_shift_ms;        // How far behind the live picture the last presented frame is.
+        Livestream_request request;         // What was last asked of the camera daemon.
+        std::int64_t last_keyframe_request_us;  // When a keyframe was last asked for.
+        std::vector<Metadata_box> boxes;    // The people and faces found in the presented frame.
+        std::uint32_t motion;               // Whether the presented frame moved, see frame_metadata.h.
+        int frame_width;                    // The resolution of the presented frame, which the boxes are in.
+        int frame_height;
+    };
+
     /**
-     * Setter method for streamDir.
+     * This function adds a file descriptor to the epoll set of the event loop.
+     * This function terminates the program if it runs into an unrecoverable error.
      *
-     * @param const string& streamDir - The new value.
+     * @param int fd - The file descriptor to wait on for input.
+     *
+     * @param std::uint32_t source - Which of the event sources the file descriptor is.
      */
-    void set_streamDir(const string& streamDir);
+    void add_to_epoll(int fd, std::uint32_t source);
+
+    /**
+     * This function finds the file descriptor on which SDL receives the input events of the window.
+     *
+     * @return int - The file descriptor of the connection to the X server,
+     *               or -1 if the video driver has none, in which case input is polled by the redraw timer.
+     */
+    int find_input_fd();
+
+    /**
+     * This function checks for input that was read off the connection to the X server while rendering.
+     * Xlib keeps such events in its own queue, so they no longer make input_fd readable.
+     *
+     * @return bool - true if Xlib or SDL holds events that process_events() has not handled yet.
+     *                SDL_PumpEvents() drains the queue of Xlib into the queue of SDL, so only SDL's is checked.
+     */
+    bool input_pending();
+
+    /**
+     * This function looks for the active camera directories, and re-builds the mosaic if they changed.
+     * This function terminates the program if it runs into an unrecoverable error.
+     */
+    void scan_cameras();
+
+    /**
+     * This function removes all the tiles of the mosaic, and stops their decoder threads.
+     */
+    void clear_tiles();
+
+    /**
+     * This function arranges the tiles in a grid that fills the window, and tells every camera the size
+     * of its tile.
+     */
+    void layout_tiles();
+
+    /**
+     * This function adds the inotify watch of the directory of a tile, and deletes any frames left in it
+     * from the last run.
+     *
+     * @param Stream_tile& tile - The tile to watch.
+     */
+    void watch_tile(Stream_tile& tile);
+
+    /**
+     * This function reads the pending signals from the signalfd and handles them.
+     * SIGUSR1 means that the camera daemon started up, SIGUSR2 that it shut down, and anything else
+     * terminates the LiveStream Viewer.
+     */
+    void handle_signals();
+
+    /**
+     * This function handles the redraw timer.
+     * It looks for cameras that started or stopped, and displays "NO SIGNAL" in the tile of every camera
+     * that has not published a frame for NO_SIGNAL_TIMEOUT_US.
+     */
+    void handle_timer();
+
+    /**
+     * This function reads the pending inotify events and hands the newest published frame of every camera
+     * to its decoder. Any older frames are deleted without being displayed.
+     */
+    void handle_published_frames();
+
+    /**
+     * This function takes over the frame that the decoder thread of a tile has just finished.
+     *
+     * @param size_t tile_index - The index of the tile in tiles.
+     */
+    void handle_decoded_frame(size_t tile_index);
 
-  private:
     /**
      * This helper function is used to process events.
      * It is used for user interactions, such as allowing the user to terminate the program by clicking
@@ -72,28 +200,132 @@ class LiveStream_window {
     void process_events();
 
     /**
-     * This function draws an image on the screen.
+     * This function moves every camera back or forward in time, within the history the camera daemons keep
+     * in memory. Moving forward past the live picture goes back to the live picture.
+     * It is called with the left and right arrow keys, the End key goes straight back to the live picture.
+     *
+     * @param int step_ms - How far to move, negative to go back in time, 0 to go back to the live picture.
+     */
+    void time_shift(int step_ms);
+
+    /**
+     * This function sets how fast the cameras replay their history, with the 1, 2 and 4 keys.
+     *
+     * @param int speed - How many times faster than real time to replay.
+     */
+    void set_time_shift_speed(int speed);
+
+    /**
+     * This function loads one of the default images into a texture.
      * The first time this function is called, it initializes the window and the renderer to match the
-     * dimentions of the passed in image.
-     * Any subsequent times the window and the renderer and re-used.
+     * dimentions of the image.
      *
      * This function terminates the program if it runs into an unrecoverable error.
      *
-     * @param const string& image_name - The full name of the image file to be displayed on the screen,
-     *                                   including the absolute path to it.
+     * @param const string& image_name - The full name of the image file, including the absolute path to it.
+     *
+     * @param Texture_slot& slot - The texture to load the image into.
      */
-    void draw_image(const string& image_name);
+    void load_default_image(const string& image_name, Texture_slot& slot);
 
-    string streamDir;
+    /**
+     * This function copies a decoded frame into a streaming texture.
+     * The texture is only created the first time, and whenever the resolution changes, so uploading a
+     * frame does not allocate anything.
+     * Unless the whole frame changed, only its dirty rectangles are copied, the texture keeps the rest.
+     *
+     * @param Texture_slot& slot - The texture to copy the frame into.
+     *
+     * @param const Decoded_frame& frame - The frame.
+     *
+     * @return bool - true  if the frame was uploaded.
+     *                false otherwise, the reason is written to the syslog.
+     */
+    bool upload_frame(Texture_slot& slot, const Decoded_frame& frame);
+
+    /**
+     * This function draws every tile of the mosaic, or a default image if there are none, and presents
+     * the window.
+     */
+    void render();
+
+    /**
+     * This function deletes a frame from one of the camera directories.
+     * Deleting the frame also tells the camera daemon that the viewer is ready for the next one.
+     *
+     * @param const string& image_file - The full name of the frame file.
+     */
+    void delete_frame(const string& image_file);
+
+    /**
+     * This function records how long it took from capturing a frame to presenting it on the screen,
+     * and how many frames of the same camera were dropped before it.
+     * The percentiles are written to the syslog every LAG_REPORT_INTERVAL frames.
+     *
+     * @param std::int64_t latency_us - The capture-to-present latency of the presented frame in microseconds.
+     *
+     * @param std::uint64_t gap - The number of frames missing between this frame and the last one presented.
+     */
+    void record_latency(std::int64_t latency_us, std::uint64_t gap);
+
+    /**
+     * This function writes the latency statistics of the last interval into the file latency_stats in the
+     * livestream directory, one "key=value" per line, and hands them to the overlay.
+     *
+     * @param std::int64_t now - The current time, see livestream_now_us().
+     */
+    void export_stats(std::int64_t now);
+
+    /**
+     * This function draws the latency overlay on top of the mosaic.
+     * It is shown and hidden with the L key.
+     */
+    void draw_overlay();
+
+    /**
+     * This function labels every tile that is replaying the history of its camera, rather than showing the
+     * live picture, with how far back it is and how fast it is replaying.
+     */
+    void draw_time_shift_labels();
+
+    /**
+     * This function draws the outlines of the people and faces found in the presented frame of every tile,
+     * with the IDs of their tracks, and whether the frame moved.
+     * The camera daemon only sends them while the outlines are turned on, and they are hidden with the O key.
+     */
+    void draw_detections();
+
+    string livestream_directory;
     string default_images_directory;
     SDL_Event event;
     SDL_Window* window;
     SDL_Renderer* renderer;
-    SDL_Surface* surface;
-    SDL_Texture* texture;
+    std::vector<std::unique_ptr<Stream_tile>> tiles;  // One tile per active camera, sorted by directory.
+    Texture_slot not_running_texture;                 // The "SmartCCTV is not running" image.
+    Texture_slot no_signal_texture;                   // The "NO SIGNAL" image.
+    Decoded_frame still_frame;                        // The decoded default image.
     const bool& is_camera_daemon_running;
+    std::uint64_t frames_presented;      // The number of live stream frames presented so far.
+    std::uint64_t frames_dropped;        // The number of frames that were captured but never presented.
+    std::uint64_t stale_frames_skipped;  // The number of frames the viewer deleted without presenting.
+    Latency_stats report_stats;          // The latency since the last syslog report.
+    Latency_stats interval_stats;        // The latency since the last export.
+    Latency_stats shown_stats;           // The latency of the last exported interval.
+    std::uint64_t bytes_received;        // The size of all the frames presented so far.
+    std::uint64_t interval_bytes;        // The size of the frames presented since the last export.
+    std::uint64_t shown_bytes_per_frame; // The average size of a frame in the last exported interval.
+    std::int64_t last_export_time_us;    // When the statistics were last exported.
+    string stats_file_name;              // The full name of the exported statistics file.
+    bool show_overlay;                   // Is the latency overlay shown?
+    bool show_detections;                // Are the outlines of the detections shown?
+    int time_shift_speed;                // How many times faster than real time the history is replayed.
+    int epoll_fd;                        // Waits on all the file descriptors below.
+    int inotify_fd;                      // Reports the frames published into the camera directories.
+    int signal_fd;                       // Receives SIGUSR1, SIGUSR2 and the terminate signals.
+    int timer_fd;                        // The redraw timer.
+    int input_fd;                        // The connection to the X server, -1 if there is none.
+    bool needs_render;                   // Has anything changed since the window was last presented?
 };
 
 
 #endif  /* LIVESTREAM_WINDOW_H */
-
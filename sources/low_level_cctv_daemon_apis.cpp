@@ -13,14 +13,16 @@
 
 #include "low_level_cctv_daemon_apis.h"
 #include "camera_daemon.h"
-#include "write_message.h"
+#include "event_bus.h"
+#include "async_log.h"
 #include "camera.hpp"
+#include "control_server.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>   /* for umask(), mode permissions constants */
 #include <fcntl.h>      /* for O_* constants, open() */
 #include <unistd.h>     /* for close(), unlink(), fork(), setsid(), sysconf(), chdir(), getpid() */
-#include <signal.h>     /* for sigemptyset(), kill(), signal constants */
+#include <signal.h>     /* for sigemptyset(), kill(), sig_atomic_t, signal constants */
 #include <errno.h>      /* for errno */
 #include <syslog.h>     /* for openlog(), syslog(), closelog() */
 #include <cstdlib>      /* for exit(), atexit(), EXIT_SUCCESS, EXIT_FAILURE */
@@ -34,6 +36,10 @@ using std::vector;
 #pragma GCC diagnostic ignored "-Wunused-result"
 
 
+// Set by request_termination(), when the daemon recieves a signal to terminate.
+static volatile sig_atomic_t termination_signal = 0;
+
+
 /**
  * This struct contains all the data of the daemon that might need to be accessed globally.
  * It is done like this because signal handler functions maybe called, which do not accept
@@ -54,6 +60,7 @@ volatile Daemon_data daemon_data = {
     .is_live_stream_running = false,               // is live stream viewer process currently running
     .live_stream_viewer_pid = 0,                   // The PID of the LiveStreamViewer
     .cameraNumber = 0,                             // An integer identifying which camera to use
+    .video_file_path = nullptr,                    // The video file to read in place of the camera, nullptr to use the camera.
     .daemon_exit_status = EXIT_SUCCESS  // The exit status of the daemon, to use in terminate_daemon(), assumed EXIT_SUCCESS.
 };
 
@@ -62,6 +69,9 @@ volatile Daemon_data daemon_data = {
 // When the daemon is terminated, it calls all the finalize() method of all the Cameras.
 vector<Camera*> cameras;
 
+// Serves the control socket, through which the settings of the running daemon are changed.
+Control_server control_server;
+
 
 void becomeDaemon()
 {
@@ -94,7 +104,7 @@ void becomeDaemon()
     if (setsid() == -1) {
         syslog(log_facility | LOG_ERR, "Error: Could not change the session ID and process group ID : %m");
         syslog(log_facility | LOG_CRIT, "SmartCCTV Daemon unexpected failure.");
-        write_message("SmartCCTV unexpected failure.");
+        post_error(ERROR_UNEXPECTED_FAILURE, SOURCE_DAEMON);
         // This time, it is actually the daemon process which gets killed,
         // if it can't change the session ID and process group ID.
         daemon_data.daemon_exit_status = EXIT_FAILURE;
@@ -145,7 +155,7 @@ void becomeDaemon()
 
     // This sets up the signal handler for when the process is terminated.
     struct sigaction action1;
-    action1.sa_handler = terminate_daemon;
+    action1.sa_handler = request_termination;
     sigemptyset(&action1.sa_mask);
     sigaddset(&action1.sa_mask, SIGINT);
     sigaddset(&action1.sa_mask, SIGQUIT);
@@ -165,11 +175,26 @@ void becomeDaemon()
 }
 
 
+void request_termination(int signal_number)
+{
+    termination_signal = signal_number;
+}
+
+
+bool termination_requested()
+{
+    return termination_signal != 0;
+}
+
+
 void terminate_daemon(int)
 {
     for (Camera* camera : cameras) {
         camera->finalize();
     }
+    control_server.stop();
+    // Write out what the cameras logged while finishing, before the logger's thread goes away with the process.
+    stop_async_log();
 
     // The LiveStream process recieves SIGUSR2 when the daemon shuts down.
     if (daemon_data.live_stream_viewer_pid) {
@@ -36,6 +36,7 @@ struct Daemon_data {
     bool is_live_stream_running;   // is live stream viewer process currently running
     int live_stream_viewer_pid;    // The PID of the LiveStreamViewer
     int cameraNumber;              // An integer identifying which camera to use
+    const char* video_file_path;   // The video file to read in place of the camera, nullptr to use the camera.
     int daemon_exit_status;        // The exit status of the daemon, to use in terminate_daemon(), assumed EXIT_SUCCESS.
 };
 
@@ -54,7 +55,7 @@ struct Daemon_data {
  * - reset the environmental variables to a known value.
  * - write the PID of the daemon process into the PID file.
  * - setup the logging for communication with the outside world.
- * - setup the signal handler for when the process is terminated.
+ * - setup the signal handler for when the process is terminated, see request_termination().
  * - call camera_daemon() function inside of which the daemon will be in it's entire lifetime.
  */
 void becomeDaemon();
@@ -66,11 +67,28 @@ void becomeDaemon();
  * - SIGTERM
  * - SIGQUIT
  *
- * This function closes and removes the PID file.
- * Then it terminates the camera daemon.
+ * It only asks the daemon to terminate. The capture loop sees it after the frame it is capturing, and returns,
+ * and the daemon is then terminated by terminate_daemon() on the capture thread. The videos are saved there,
+ * never from inside the signal handler, where they could be in the middle of being recorded.
  *
  * This function is called only in the daemon process.
  */
+void request_termination(int);
+
+
+/**
+ * @return bool - true if the daemon was asked to terminate by a signal.
+ */
+bool termination_requested();
+
+
+/**
+ * This function finishes the cameras, stops the servers and the logger, closes and removes the PID file.
+ * Then it terminates the camera daemon.
+ *
+ * This function is called only in the daemon process, on the capture thread.
+ * It is not a signal handler, see request_termination().
+ */
 void terminate_daemon(int);
 
 
@@ -15,13 +15,15 @@
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "event_bus.h"
+#include "activity_chart.h"
+#include "detection_store.h"
+#include "thumbnail_cache.h"
 
 #include <string>       /* for std::string */
 #include <syslog.h>     /* for openlog(), syslog(), closelog() */
 #include <cstdlib>      /* for getenv(), atexit(), exit(), EXIT_FAILURE */
-#include <cstring>      /* for memset(), strcmp(), strncmp() */
-#include <signal.h>     /* for sigaction(), sigemptyset(), SIGCONT */
-#include <mqueue.h>     /* for mq_notify(), mq_receive(), mq_open(), mq_close(), mq_unlink() */
+#include <algorithm>    /* for std::max(), std::min_element() */
 #include <unistd.h>     /* for sleep() */
 #include <stdio.h>      /* for sprintf() */
 #include<iostream>      /* for is_open(), close(), ifstream */
@@ -30,133 +32,25 @@
 #include <QtDebug>
 #include <QLabel>
 #include <QCheckBox>
+#include <QSocketNotifier>
+#include <QStatusBar>
+#include <QPainter>
+#include <QPainterPath>
+#include <QDesktopServices>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrentRun>
+#include <memory>       /* for std::make_shared() */
 
 using namespace std;
 
-mqd_t message_handler;  // message queue file descriptor
-string message_handler_name = "/SmartCCTV_Message_handler";
-QLabel* message_label = nullptr;
-QLabel* daemon_label = nullptr;
-QCheckBox* checkBox_1 = nullptr;
-QCheckBox* checkBox_2 = nullptr;
-QCheckBox* checkBox_3 = nullptr;
-Daemon_facade* daemon_facade_ptr = nullptr;
-
-
-void close_message_handler()
-{
-    syslog(log_facility | LOG_NOTICE, "Closing %s", message_handler_name.c_str());
-    mq_close(message_handler);
-    mq_unlink(message_handler_name.c_str());
-}
-
-
-void read_message(int)
-{
-    // Set up the message handler to recieve signal whenever a message comes in.
-    // This is being done inside of the handler function because it has to be "reset" each time it is used.
-    struct sigevent message_recieved;
-    message_recieved.sigev_notify = SIGEV_SIGNAL;
-    message_recieved.sigev_signo  = SIGCONT;
-    mq_notify(message_handler, &message_recieved);
-
-    // read a message
-    int err;
-    char message[151];
-    memset(message, 0, 151);  // zero out the buffer
-    // This is a while loop to handle when there are multiple messages queued up,
-    // waiting to be read.
-    while ( (err = mq_receive(message_handler, message, 150, nullptr)) != -1) {
-        syslog(log_facility | LOG_NOTICE, "%s", message);
-        // set the message into the label.
-        if (message_label != nullptr) {
-            message_label->setText(message);
-        }
-
-        if (strcmp("SmartCCTV encountered an error.", message) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("SmartCCTV have stopped running.");
-            }
-            //outline checkbox
-            checkBox_1->setEnabled(true);
-            //human detection checkbox
-            checkBox_2->setEnabled(true);
-            //motion detection checkbox
-            checkBox_3->setEnabled(true);
-        } else if (strcmp("SmartCCTV unexpected failure.", message) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("SmartCCTV have stopped running.");
-            }
-            //outline checkbox
-            checkBox_1->setEnabled(true);
-            //human detection checkbox
-            checkBox_2->setEnabled(true);
-            //motion detection checkbox
-            checkBox_3->setEnabled(true);
-        } else if (strncmp("SmartCCTV failed to open ", message, 25) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("SmartCCTV have stopped running.");
-            }
-            //outline checkbox
-            checkBox_1->setEnabled(true);
-            //human detection checkbox
-            checkBox_2->setEnabled(true);
-            //motion detection checkbox
-            checkBox_3->setEnabled(true);
-        } else if (strncmp("SmartCCTV could not create ", message, 27) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("Can not run SmartCCTV due to permission error.");
-            }
-            //outline checkbox
-            checkBox_1->setEnabled(true);
-            //human detection checkbox
-            checkBox_2->setEnabled(true);
-            //motion detection checkbox
-            checkBox_3->setEnabled(true);
-        } else if (strcmp("LiveStream Viewer unexpected failure.", message) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("LiveStream Viewer have stopped running.");
-            }
-        } else if (strcmp("Can't open LiveStream Viewer: SmartCCTV has been tampered.", message) == 0) {
-            if (daemon_facade_ptr != nullptr) {
-                bool daemon = daemon_facade_ptr->kill_daemon();
-                if(daemon == false){
-                    if (daemon_label != nullptr) {
-                        daemon_label->setText("SmartCCTV is currently not running.");
-                    }
-                } else {
-                    if (daemon_label != nullptr) {
-                        daemon_label->setText("SmartCCTV have stopped running.");
-                    }
-                }
-
-                //outline checkbox
-                checkBox_1->setEnabled(true);
-                //human detection checkbox
-                checkBox_2->setEnabled(true);
-                //motion detection checkbox
-                checkBox_3->setEnabled(true);
-            }
-        } else if (strcmp("LiveStream Viewer window was closed.", message) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("LiveStream Viewer have stopped running.");
-            }
-        } else if (strcmp("Cannot find project configuration files.", message) == 0) {
-            if (daemon_label != nullptr) {
-                daemon_label->setText("SmartCCTV have stopped running.");
-            }
-            //outline checkbox
-            checkBox_1->setEnabled(true);
-            //human detection checkbox
-            checkBox_2->setEnabled(true);
-            //motion detection checkbox
-            checkBox_3->setEnabled(true);
-        }
-
-        memset(message, 0, 151);  // zero out the buffer
-    }
-}
-
+// The daily log files are looked for in the working directory, where document.R looked for them.
+#define CHART_LOG_DIR ""
+// How many charts are kept, so showing a range again does not compute it again.
+#define CHART_CACHE_SIZE 32
+// How long a chart of a range that includes today is kept, the daemon keeps adding to today.
+#define CHART_CACHE_TODAY_SECONDS 60
+// How often the thumbnails are shown again while they are being made, in milliseconds.
+#define THUMBNAIL_RELOAD_MS 2000
 
 bool chkList(string str, int dayAmt) 
 {
@@ -186,9 +80,108 @@ bool chkList(string str, int dayAmt)
 }
 
 
+/**
+ * This function draws the activity chart: how the detections of every day are spread over the hours
+ * of the day, and the peak hour of every day.
+ *
+ * @param const Activity_chart& chart - The chart computed by compute_activity_chart().
+ *
+ * @param QSize size - The size of the picture.
+ *
+ * @return QPixmap - The picture.
+ */
+static QPixmap draw_activity_chart(const Activity_chart& chart, QSize size)
+{
+    // The colors of the days, one color per day of a week.
+    static const QColor day_colors[] = {
+        QColor(251, 180, 174), QColor(179, 205, 227), QColor(204, 235, 197), QColor(222, 203, 228),
+        QColor(254, 217, 166), QColor(255, 255, 204), QColor(229, 216, 189),
+    };
+    const int color_count = sizeof(day_colors) / sizeof(day_colors[0]);
+
+    QPixmap pixmap(size);
+    pixmap.fill(Qt::white);
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    int day_count = chart.days.size();
+    QString first_day = day_count > 0 ? QString::fromStdString(chart.days.front().day) : QString();
+    QString last_day = day_count > 0 ? QString::fromStdString(chart.days.back().day) : QString();
+    painter.drawText(QRectF(0, 2, size.width(), 16), Qt::AlignHCenter,
+                     QString("Activity in the last %1 hours, from %2 to %3").arg(day_count * 24).arg(first_day).arg(last_day));
+
+    // Every day is drawn as the share of its detections in each bin, so a busy day does not flatten the others.
+    double highest = 0;
+    for (const Day_activity& day : chart.days) {
+        for (size_t bin = 0; day.total > 0 && bin < day.bins.size(); ++bin) {
+            highest = std::max(highest, (double) day.bins[bin] / day.total);
+        }
+    }
+    if (highest == 0) {
+        painter.drawText(QRectF(QPointF(0, 0), QSizeF(size)), Qt::AlignCenter, "There were no detections in these days.");
+        return pixmap;
+    }
+
+    QRectF plot(20, 22, size.width() - 40, size.height() - 22 - 36);
+
+    // The hours of the day.
+    painter.setPen(Qt::gray);
+    painter.drawLine(plot.bottomLeft(), plot.bottomRight());
+    for (int hour = 0; hour <= 24; hour += 2) {
+        double x = plot.left() + plot.width() * hour / 24;
+        painter.drawLine(QPointF(x, plot.bottom()), QPointF(x, plot.bottom() + 3));
+        painter.drawText(QRectF(x - 15, plot.bottom() + 3, 30, 14), Qt::AlignHCenter, QString::number(hour));
+    }
+
+    QFontMetrics metrics = painter.fontMetrics();
+    double legend_x = plot.left();
+    for (int i = 0; i < day_count; ++i) {
+        const Day_activity& day = chart.days[i];
+        QColor color = day_colors[i % color_count];
+
+        if (day.total > 0) {
+            QPainterPath path(plot.bottomLeft());
+            for (int bin = 0; bin < ACTIVITY_BINS; ++bin) {
+                double x = plot.left() + plot.width() * (bin + 0.5) / ACTIVITY_BINS;
+                double y = plot.bottom() - plot.height() * day.bins[bin] / day.total / highest;
+                path.lineTo(x, y);
+            }
+            path.lineTo(plot.bottomRight());
+            path.closeSubpath();
+            QColor fill = color;
+            fill.setAlpha(170);
+            painter.fillPath(path, fill);
+            painter.strokePath(path, QPen(color.darker(150), 1));
+
+            // The peak hour of the day, as document.R called the average time of its detections.
+            double x = plot.left() + plot.width() * day.mean_hour / 24;
+            painter.setPen(QPen(color.darker(150), 1, Qt::DashLine));
+            painter.drawLine(QPointF(x, plot.top()), QPointF(x, plot.bottom()));
+        }
+
+        // The legend.
+        QString label = QString::fromStdString(day.day);
+        if (!day.has_data) {
+            label += " (no data)";
+        } else if (day.total > 0) {
+            label += QString(" peak %1:00").arg((int) day.mean_hour);
+        }
+        painter.fillRect(QRectF(legend_x, size.height() - 14, 10, 10), color);
+        painter.setPen(Qt::black);
+        painter.drawText(QPointF(legend_x + 13, size.height() - 4), label);
+        legend_x += 13 + metrics.boundingRect(label).width() + 12;
+    }
+
+    painter.drawText(QRectF(0, 2, size.width() - 4, 16), Qt::AlignRight,
+                     QString("Overall peak %1:00").arg((int) chart.mean_hour));
+    return pixmap;
+}
+
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
-    , ui(new Ui::MainWindow), home_directory(nullptr)
+    , ui(new Ui::MainWindow), home_directory(nullptr), event_bus(-1), event_notifier(nullptr)
+    , recordings_listed(false), recordings_outdated(false), thumbnails_cancel(false), thumbnails_outdated(false)
 {
     ui->setupUi(this);
     // The SmartCCTv GUI also writes messages to the syslog, so we need to open that as well.
@@ -202,50 +195,29 @@ MainWindow::MainWindow(QWidget *parent)
         exit(EXIT_FAILURE);
     }
 
-    // Set the QLabel to display the message that the daemon sends it.
-    message_label = ui->label_3;
-    daemon_label = ui->daemon_label;
-
-    // Set the QCheckBox pointers.
-    checkBox_1 = ui->checkBox;
-    checkBox_2 = ui->checkBox_2;
-    checkBox_3 = ui->checkBox_3;
-
-    // Set the daemon_facade_ptr.
-    daemon_facade_ptr = &daemon_facade;
-
-    // Setup the message handler to recieve error messages from the daemon and dispaly them onto the GUI.
-    // Make sure we can handle the SIGCONT message when the message queue notification sens the signal.
-    struct sigaction action_to_take;
-    // handle with this function
-    action_to_take.sa_handler = read_message;
-    // zero out the mask (allow any signal to interrupt)
-    sigemptyset(&action_to_take.sa_mask);
-    action_to_take.sa_flags = 0;
-    // Setup the handler for SIGCONT.
-    sigaction(SIGCONT, &action_to_take, nullptr);
-
-    struct mq_attr mq_attributes;
-    mq_attributes.mq_flags = 0;
-    mq_attributes.mq_maxmsg = 5;
-    mq_attributes.mq_msgsize = 120;
-
-    if ( (message_handler = mq_open(message_handler_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK, S_IRUSR | S_IWUSR, &mq_attributes)) == -1)
-    {
-        syslog(log_facility | LOG_ERR, "Error: Could not create the message handler %s %m", message_handler_name.c_str());
+    // The daemon and the LiveStream Viewer send their events to the event bus, which is waited on
+    // in the Qt event loop like any other descriptor.
+    if ( (event_bus = open_event_bus()) == -1) {
         syslog(log_facility | LOG_CRIT, "Failure starting the SmartCCTV application.");
         exit(EXIT_FAILURE);
     }
+    event_notifier = new QSocketNotifier(event_bus, QSocketNotifier::Read, this);
+    // activated() is overloaded from Qt 5.15 on, the string form connects the same way in every Qt 5.
+    connect(event_notifier, SIGNAL(activated(int)), this, SLOT(read_event_bus()));
 
-    // Set up the message handler to recieve signal whenever a message comes in.
-    struct sigevent message_recieved;
-    message_recieved.sigev_notify = SIGEV_SIGNAL;
-    message_recieved.sigev_signo  = SIGCONT;
-    mq_notify(message_handler, &message_recieved);
-
-    syslog(log_facility | LOG_NOTICE, "Creating %s", message_handler_name.c_str());
+    // The charts are computed in a background thread, so the GUI never waits for the files to be read.
+    connect(&chart_watcher, &QFutureWatcher<Activity_chart>::finished, this, &MainWindow::activity_chart_ready);
 
     daemon_facade.set_daemon_info(home_directory);
+
+    // The recordings are listed in a background thread, and their thumbnails are made in a thread of its own
+    // at idle priority, so the GUI never waits for the disk.
+    recordings_directory = string(home_directory) + RECORDINGS_DIR;
+    thumbnail_pool.setMaxThreadCount(1);
+    ui->recordingsView->setModel(&recordings_model);
+    connect(&recordings_watcher, &QFutureWatcher<Recordings_scan>::finished, this, &MainWindow::recordings_scanned);
+    connect(&thumbnails_watcher, &QFutureWatcher<int>::finished, this, &MainWindow::thumbnails_made);
+    connect(&thumbnails_timer, &QTimer::timeout, this, &MainWindow::reload_thumbnails);
     QDate date = QDate::currentDate();
     ui->dateEdit->setDate(date);
     ui->dateEdit->setMaximumDate(date);
@@ -258,7 +230,12 @@ MainWindow::MainWindow(QWidget *parent)
 MainWindow::~MainWindow()
 {
     syslog(log_facility | LOG_NOTICE, "The GUI window was closed.");
-    close_message_handler();
+    event_notifier->setEnabled(false);
+    close_event_bus(event_bus);
+    chart_watcher.waitForFinished();
+    recordings_watcher.waitForFinished();
+    thumbnails_cancel = true;
+    thumbnails_watcher.waitForFinished();
 
     delete ui;
 }
@@ -266,29 +243,175 @@ MainWindow::~MainWindow()
 //Display Chart
 void MainWindow::on_pushButton_clicked()
 {
-//    qDebug() << ui->dateEdit->date().addDays(-1).toString("ddMMyyyy");
-    int position = ui->horizontalSlider->value();
-    qDebug() << position;
-    QString command = "Rscript document.R ";
-    for(int i = position; i >= 0; i--){
-        command.append(ui->dateEdit->date().addDays(-i).toString("dd.MM.yyyy") + ".out ");
-    }
-    qDebug() << command;
-    std::system(qPrintable(command));
-    QString imgPath = home_directory;
-    imgPath.append("/Desktop/SmartCCTV/Charts/Overview.pdf");
-
-    QPixmap img(imgPath);
-    ui->statChartLabel->setPixmap(img.scaled(ui->statChartLabel->width(),ui->statChartLabel->height(),Qt::KeepAspectRatio));
+    request_activity_chart(ui->dateEdit->date(), ui->horizontalSlider->value());
+}
+
+
+void MainWindow::request_activity_chart(QDate last_day, int additional_days)
+{
+    chart_wanted = std::make_pair(last_day.toJulianDay(), additional_days);
+
+    auto cached = chart_cache.find(chart_wanted);
+    if (cached != chart_cache.end()) {
+        bool includes_today = last_day >= QDate::currentDate();
+        if (!includes_today || cached->second.computed.secsTo(QDateTime::currentDateTime()) < CHART_CACHE_TODAY_SECONDS) {
+            show_activity_chart(cached->second.chart);
+            return;
+        }
+    }
+
+    // Only one chart is computed at a time, the newest range asked for is computed once it is done.
+    if (chart_watcher.isRunning()) {
+        return;
+    }
+
+    vector<string> days;
+    for (int i = additional_days; i >= 0; --i) {
+        days.push_back(last_day.addDays(-i).toString("dd.MM.yyyy").toStdString());
+    }
+    string store_directory = string(home_directory) + DETECTION_STORE_DIR;
+
+    chart_running = chart_wanted;
+    ui->statChartLabel->setText("Computing the chart...");
+    chart_watcher.setFuture(QtConcurrent::run(compute_activity_chart, store_directory, string(CHART_LOG_DIR), days));
+}
+
+
+void MainWindow::activity_chart_ready()
+{
+    Activity_chart chart = chart_watcher.result();
+    syslog(log_facility | LOG_NOTICE, "Computed the activity chart of %zu days in %lld us",
+           chart.days.size(), (long long) chart.compute_us);
+
+    if (chart_cache.size() >= CHART_CACHE_SIZE && chart_cache.find(chart_running) == chart_cache.end()) {
+        auto oldest = std::min_element(chart_cache.begin(), chart_cache.end(),
+                                       [](const decltype(chart_cache)::value_type& a, const decltype(chart_cache)::value_type& b) {
+                                           return a.second.computed < b.second.computed;
+                                       });
+        chart_cache.erase(oldest);
+    }
+    Cached_chart& cached = chart_cache[chart_running];
+    cached.chart = chart;
+    cached.computed = QDateTime::currentDateTime();
+
+    if (chart_wanted != chart_running) {
+        request_activity_chart(QDate::fromJulianDay(chart_wanted.first), chart_wanted.second);
+        return;
+    }
+    show_activity_chart(chart);
+}
+
+
+void MainWindow::show_activity_chart(const Activity_chart& chart)
+{
+    QSize size = ui->statChartLabel->size().expandedTo(QSize(400, 200));
+    ui->statChartLabel->setPixmap(draw_activity_chart(chart, size));
+}
+
+
+void MainWindow::on_tabWidget_currentChanged(int index)
+{
+    // The recordings are listed the first time their tab is opened, and after that when Refresh is clicked.
+    if (ui->tabWidget->widget(index) == ui->tab_3 && !recordings_listed) {
+        request_recordings();
+    }
+}
+
+
+void MainWindow::on_recordingsRefreshButton_clicked()
+{
+    request_recordings();
+}
+
+
+void MainWindow::request_recordings()
+{
+    // Only one listing runs at a time, the recordings are listed again once it is done.
+    if (recordings_watcher.isRunning()) {
+        recordings_outdated = true;
+        return;
+    }
+    recordings_listed = true;
+    recordings_outdated = false;
+    ui->recordingsLabel->setText("Listing the recordings...");
+    recordings_watcher.setFuture(QtConcurrent::run(scan_recordings, recordings_directory));
+}
+
+
+void MainWindow::recordings_scanned()
+{
+    Recordings_scan scan = recordings_watcher.result();
+    syslog(log_facility | LOG_NOTICE, "Listed %zu recordings in %lld us, %zu of them without a thumbnail",
+           scan.recordings.size(), (long long) scan.scan_us, scan.missing);
+    recordings_model.set_recordings(scan);
+
+    QString text = QString("%1 recordings").arg(scan.recordings.size());
+    // The thumbnail file is also written again when it has the thumbnails of videos that were removed.
+    bool stale = scan.thumbnails->size() > scan.recordings.size() - scan.missing;
+    if (scan.missing > 0 || stale) {
+        if (thumbnails_watcher.isRunning()) {
+            // The running update only makes the thumbnails of the videos it was given, the rest are made after it.
+            thumbnails_outdated = true;
+        } else {
+            if (scan.missing > 0) {
+                text += QString(", making %1 thumbnails...").arg(scan.missing);
+            }
+            thumbnails_watcher.setFuture(QtConcurrent::run(&thumbnail_pool, update_thumbnails, recordings_directory,
+                                                           scan.recordings, &thumbnails_cancel));
+            thumbnails_timer.start(THUMBNAIL_RELOAD_MS);
+        }
+    }
+    ui->recordingsLabel->setText(text);
+
+    if (recordings_outdated) {
+        request_recordings();
+    }
+}
+
+
+void MainWindow::thumbnails_made()
+{
+    thumbnails_timer.stop();
+    reload_thumbnails();
+
+    int made = thumbnails_watcher.result();
+    syslog(log_facility | LOG_NOTICE, "Made %d thumbnails of the recordings", made);
+    ui->recordingsLabel->setText(QString("%1 recordings").arg(recordings_model.rowCount()));
+
+    if (thumbnails_outdated && !thumbnails_cancel) {
+        thumbnails_outdated = false;
+        request_recordings();
+    }
+}
+
+
+void MainWindow::reload_thumbnails()
+{
+    auto thumbnails = std::make_shared<Thumbnail_cache>();
+    thumbnails->load(recordings_directory + THUMBNAIL_FILE);
+    recordings_model.set_thumbnails(thumbnails);
+}
+
+
+void MainWindow::on_recordingsView_doubleClicked(const QModelIndex& index)
+{
+    const Recording* recording = recordings_model.recording(index);
+    if (recording == nullptr) {
+        return;
+    }
+
+    // The video is opened in the video player of the desktop.
+    QString path = QString::fromStdString(recordings_directory + recording->clip);
+    if (!QDesktopServices::openUrl(QUrl::fromLocalFile(path))) {
+        ui->recordingsLabel->setText("Could not open " + path);
+    }
 }
 
 
 void MainWindow::on_pushButton_Run_clicked()
 {
     // Making a command to run or kill the daemon should reset the dispalyed error message.
-    if (message_label != nullptr) {
-        message_label->setText("");
-    }
+    ui->label_3->setText("");
 
     //This returns the value of the selected camera.
     int cameraNumber = ui->cameraSpinBox->value() - 1;
@@ -301,12 +424,7 @@ void MainWindow::on_pushButton_Run_clicked()
     int daemon = daemon_facade.run_daemon(human_det, motion_det, outline, cameraNumber);
     if(daemon == 0){
         ui->daemon_label->setText("SmartCCTV is now running.");
-        //outline checkbox
-        ui->checkBox->setEnabled(false);
-        //human detection checkbox
-        ui->checkBox_2->setEnabled(false);
-        //motion detection checkbox
-        ui->checkBox_3->setEnabled(false);
+        // The checkboxes stay enabled, changing them changes the settings of the running daemon.
     }
     else if(daemon == 1){
         ui->daemon_label->setText("SmartCCTV is already running.");
@@ -320,9 +438,7 @@ void MainWindow::on_pushButton_Run_clicked()
 void MainWindow::on_pushButton_Kill_clicked()
 {
     // Making a command to run or kill the daemon should reset the dispalyed error message.
-    if (message_label != nullptr) {
-        message_label->setText("");
-    }
+    ui->label_3->setText("");
 
     bool daemon = daemon_facade.kill_daemon();
     if(daemon == false){
@@ -341,6 +457,40 @@ void MainWindow::on_pushButton_Kill_clicked()
 }
 
 
+void MainWindow::on_checkBox_toggled(bool checked)
+{
+    change_daemon_setting("outlines", checked);
+}
+
+
+void MainWindow::on_checkBox_2_toggled(bool checked)
+{
+    change_daemon_setting("human_detection", checked);
+}
+
+
+void MainWindow::on_checkBox_3_toggled(bool checked)
+{
+    change_daemon_setting("motion_detection", checked);
+}
+
+
+void MainWindow::change_daemon_setting(const char* key, bool enabled)
+{
+    if (!daemon_facade.is_daemon_running()) {
+        return;
+    }
+
+    string request = "SET ";
+    request += key;
+    request += enabled ? "=1" : "=0";
+    string response;
+    if (!daemon_facade.send_control_request(request, response)) {
+        ui->daemon_label->setText("Could not change the setting of SmartCCTV while it is running.");
+    }
+}
+
+
 void MainWindow::on_horizontalSlider_sliderMoved(int position)
 {
     if (position > 1){
@@ -367,3 +517,85 @@ void MainWindow::on_pushButton_2_clicked()
     }
 }
 
+
+
+void MainWindow::read_event_bus()
+{
+    // More than one event may have arrived since the notifier fired, so the queue is drained.
+    Event event;
+    while (read_event(event_bus, event)) {
+        handle_event(event);
+    }
+}
+
+
+void MainWindow::handle_event(const Event& event)
+{
+    switch (event.type) {
+        case EVENT_ERROR: {
+            string text = describe_error(event);
+            syslog(log_facility | LOG_NOTICE, "%s", text.c_str());
+            ui->label_3->setText(QString::fromStdString(text));
+
+            if (event.code == ERROR_DAEMON_TAMPERED) {
+                bool daemon = daemon_facade.kill_daemon();
+                if (daemon == false) {
+                    ui->daemon_label->setText("SmartCCTV is currently not running.");
+                } else {
+                    ui->daemon_label->setText("SmartCCTV have stopped running.");
+                }
+                ui->checkBox->setEnabled(true);
+                ui->checkBox_2->setEnabled(true);
+                ui->checkBox_3->setEnabled(true);
+            } else if (event.source == SOURCE_VIEWER) {
+                ui->daemon_label->setText("LiveStream Viewer have stopped running.");
+            } else if (event.code != ERROR_VIDEO_SAVE_FAILED) {
+                // Every other error from the daemon stops it.
+                if (event.code == ERROR_PERMISSION_DENIED) {
+                    ui->daemon_label->setText("Can not run SmartCCTV due to permission error.");
+                } else {
+                    ui->daemon_label->setText("SmartCCTV have stopped running.");
+                }
+                ui->checkBox->setEnabled(true);
+                ui->checkBox_2->setEnabled(true);
+                ui->checkBox_3->setEnabled(true);
+            }
+            break;
+        }
+
+        case EVENT_VIEWER_CLOSED:
+            ui->daemon_label->setText("LiveStream Viewer have stopped running.");
+            break;
+
+        case EVENT_DETECTION_STARTED:
+            ui->label_3->setText(QString("Camera %1 is recording a detection.").arg(event.camera));
+            break;
+
+        case EVENT_RECORDING_SAVED:
+            ui->label_3->setText(QString("Saved %1 (%2 MB, encoded in %3 s)").arg(event.detail)
+                                 .arg(event.clip_bytes / 1048576.0, 0, 'f', 1).arg(event.encode_ms / 1000.0, 0, 'f', 1));
+            // Once the Recordings tab was opened, it is kept up to date.
+            if (recordings_listed) {
+                request_recordings();
+            }
+            break;
+
+        case EVENT_CAMERA_STATS:
+            statusBar()->showMessage(QString("Camera %1: %2 fps, detection %3 ms, %4 frames, %5 streamed, %6 skipped")
+                                     .arg(event.camera)
+                                     .arg(event.frames_per_second, 0, 'f', 1)
+                                     .arg(event.detection_ms, 0, 'f', 1)
+                                     .arg(event.frames_captured)
+                                     .arg(event.frames_streamed)
+                                     .arg(event.frames_skipped));
+            break;
+
+        default:
+            syslog(log_facility | LOG_WARNING, "Ignoring an event of unknown type %d", (int) event.type);
+            break;
+    }
+
+    if (event.events_dropped > 0) {
+        syslog(log_facility | LOG_WARNING, "%u events were dropped by the sender", (unsigned) event.events_dropped);
+    }
+}
@@ -16,7 +16,22 @@
 
 #include "high_level_cctv_daemon_apis.h"
 #include "livestream_facade.h"
+#include "event_bus.h"
+#include "activity_chart.h"
+#include "recordings_model.h"
+#include "thumbnail_cache.h"
 #include <QMainWindow>
+#include <QDate>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>    /* for std::atomic */
+#include <map>       /* for std::map */
+#include <string>    /* for std::string */
+#include <utility>   /* for std::pair */
+
+class QSocketNotifier;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -41,11 +56,100 @@ private slots:
 
     void on_pushButton_2_clicked();
 
+    void on_checkBox_toggled(bool checked);
+
+    void on_checkBox_2_toggled(bool checked);
+
+    void on_checkBox_3_toggled(bool checked);
+
+    void read_event_bus();
+
+    void activity_chart_ready();
+
+    void on_tabWidget_currentChanged(int index);
+
+    void on_recordingsRefreshButton_clicked();
+
+    void on_recordingsView_doubleClicked(const QModelIndex& index);
+
+    void recordings_scanned();
+
+    void thumbnails_made();
+
+    void reload_thumbnails();
+
 private:
+    /**
+     * This function changes a setting of the running daemon through its control socket.
+     * If the daemon is not running, nothing is done, the setting is passed to it when it is started.
+     *
+     * @param const char* key - The name of the setting, see camera_config.h.
+     *
+     * @param bool enabled - The new value of the setting.
+     */
+    void change_daemon_setting(const char* key, bool enabled);
+
+    /**
+     * This function shows an event sent by the daemon or the LiveStream Viewer on the GUI.
+     *
+     * @param const Event& event - The event read from the event bus.
+     */
+    void handle_event(const Event& event);
+
+    /**
+     * This function shows the activity chart of a range of days, from the cache if it was computed before,
+     * and otherwise computes it in a background thread and shows it when activity_chart_ready() is called.
+     *
+     * @param QDate last_day - The last day of the range.
+     *
+     * @param int additional_days - How many days before it are in the range.
+     */
+    void request_activity_chart(QDate last_day, int additional_days);
+
+    /**
+     * This function draws a chart onto the statistics tab.
+     *
+     * @param const Activity_chart& chart - The chart.
+     */
+    void show_activity_chart(const Activity_chart& chart);
+
+    /**
+     * This function lists the recordings in a background thread, and shows them when recordings_scanned()
+     * is called. The thumbnails that are missing are then made in the thumbnail thread.
+     */
+    void request_recordings();
+
+    /**
+     * A chart that was computed, and when.
+     */
+    struct Cached_chart {
+        Activity_chart chart;
+        QDateTime computed;
+    };
+
     Ui::MainWindow *ui;
     Daemon_facade daemon_facade;
     LiveStream_facade liveStream_facade;
     const char* home_directory;
+    int event_bus;                     // The descriptor of the event bus, see event_bus.h.
+    QSocketNotifier* event_notifier;   // Tells the event loop when the event bus is readable.
+
+    // The ranges of days are keyed by the julian day of their last day, and the number of days before it.
+    std::map<std::pair<qint64, int>, Cached_chart> chart_cache;
+    QFutureWatcher<Activity_chart> chart_watcher;   // The chart being computed.
+    std::pair<qint64, int> chart_running;           // The range of the chart being computed.
+    std::pair<qint64, int> chart_wanted;            // The range the user asked for last.
+
+    std::string recordings_directory;                    // $HOME/SmartCCTV_recordings/
+    Recordings_model recordings_model;                   // The videos shown in the Recordings tab.
+    QFutureWatcher<Recordings_scan> recordings_watcher;  // The recordings being listed.
+    bool recordings_listed;                              // Were the recordings listed since the GUI was started?
+    bool recordings_outdated;                            // Was a video saved while the recordings were being listed?
+    QThreadPool thumbnail_pool;                          // The thread that makes the thumbnails, at idle priority.
+    QFutureWatcher<int> thumbnails_watcher;              // The thumbnails being made.
+    std::atomic<bool> thumbnails_cancel;                 // Stops making the thumbnails when the GUI is closed.
+    bool thumbnails_outdated;                            // Were videos listed that the running update does not make?
+    QTimer thumbnails_timer;                             // Shows the thumbnails as they are made.
 };
 
 #endif // MAINWINDOW_H
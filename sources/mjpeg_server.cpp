@@ -0,0 +1,443 @@
+/**
+ * File Name:   mjpeg_server.cpp
+ *
+ * Description:
+ * This file contains the implementation of the MJPEG_server class's methods.
+ * An instance of this class serves the live stream of a single camera as a multipart/x-mixed-replace
+ * MJPEG stream over HTTP on the loopback interface.
+ */
+
+#include "mjpeg_server.h"
+#include "async_log.h"
+#include "signal_free_thread.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>  /* for socket(), bind(), listen(), getsockname(), accept4(), send(), sendmsg(), recv() */
+#include <sys/uio.h>     /* for struct iovec */
+#include <sys/eventfd.h> /* for eventfd() */
+#include <netinet/in.h>  /* for sockaddr_in, htons(), htonl(), ntohs() */
+#include <poll.h>        /* for poll() */
+#include <unistd.h>      /* for close(), read(), write() */
+#include <fcntl.h>       /* for O_* constants */
+#include <errno.h>       /* for errno */
+#include <syslog.h>      /* for syslog() */
+#include <algorithm>     /* for std::find(), std::min() */
+#include <cstdio>        /* for sscanf() */
+#include <cstring>       /* for memset(), strncmp() */
+#include <string>        /* for std::string, std::to_string() */
+#include <thread>        /* for std::thread */
+
+using std::string;
+using std::to_string;
+using std::shared_ptr;
+using std::size_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// The boundary between the parts of the multipart stream.
+#define MJPEG_BOUNDARY "smartcctvframe"
+// The longest HTTP request that is accepted.
+#define MAX_REQUEST_LENGTH 4096
+
+
+MJPEG_server::MJPEG_server()
+ : listen_fd(-1), wake_fd(-1), port(0), running(false), client_count(0)
+{
+    //
+}
+
+
+MJPEG_server::~MJPEG_server()
+{
+    stop();
+}
+
+
+bool MJPEG_server::start(int port)
+{
+    this->port = port;
+
+    if ( (listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the MJPEG socket : %m");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Only listen on the loopback interface, the live stream is never exposed to the network.
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) == -1 || listen(listen_fd, MJPEG_MAX_CLIENTS) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not listen on 127.0.0.1:%d for the MJPEG stream : %m", port);
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    // With port 0 the kernel picked a free port.
+    socklen_t address_length = sizeof(address);
+    if (port == 0 && getsockname(listen_fd, (struct sockaddr*) &address, &address_length) == 0) {
+        this->port = ntohs(address.sin_port);
+    }
+
+    if ( (wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the MJPEG eventfd : %m");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    running = true;
+    serve_thread = start_signal_free_thread(&MJPEG_server::serve, this);
+
+    syslog(log_facility | LOG_NOTICE, "Serving the MJPEG live stream on http://127.0.0.1:%d/", this->port);
+    return true;
+}
+
+
+void MJPEG_server::stop()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+
+    // Wake up the serving thread so it notices that it should stop.
+    std::uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not wake up the MJPEG server : %m");
+    }
+    serve_thread.join();
+
+    // The sockets are closed once the serving thread is gone, nothing else uses them.
+    for (Client& client : clients) {
+        close(client.socket_fd);
+    }
+    clients.clear();
+    client_count = 0;
+    close(listen_fd);
+    listen_fd = -1;
+    close(wake_fd);
+    wake_fd = -1;
+}
+
+
+void MJPEG_server::publish(Resize_cache& frames, const Captured_frame& captured, int jpeg_quality)
+{
+    // Nobody is watching, don't waste time encoding.
+    if (client_count == 0) {
+        return;
+    }
+    std::uint64_t sequence = captured.sequence();
+    std::int64_t capture_time_us = captured.capture_time_us();
+
+    {
+        std::lock_guard<std::mutex> lock(newest_mutex);
+        publish_sizes = wanted_sizes;
+    }
+
+    published.clear();
+    for (const cv::Size& size : publish_sizes) {
+        // The resize is shared with the LiveStream Viewer and every other client of the same size.
+        const cv::Mat& frame = frames.get(size);
+        // The captured resolution is encoded once, for the stream, the recordings and the snapshots alike.
+        Shared_jpeg jpeg = frame.size() == captured.image().size() ? captured.jpeg(jpeg_quality) : encode_jpeg(frame, jpeg_quality);
+        if (jpeg == nullptr) {
+            async_log(log_facility | LOG_ERR, "Error: Could not encode frame %llu for the MJPEG stream", (unsigned long long) sequence);
+            continue;
+        }
+        string part_header = "--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: ";
+        part_header += to_string(jpeg->bytes.size());
+        part_header += "\r\nX-Frame-Sequence: ";
+        part_header += to_string(sequence);
+        part_header += "\r\nX-Capture-Timestamp-Us: ";
+        part_header += to_string(capture_time_us);
+        part_header += "\r\n\r\n";
+
+        // The JPEG is not copied, the clients send it straight from where the camera encoded it.
+        auto encoded_frame = std::make_shared<Encoded_frame>();
+        encoded_frame->size = size;
+        encoded_frame->sequence = sequence;
+        encoded_frame->part_header = std::move(part_header);
+        encoded_frame->jpeg = std::move(jpeg);
+        published.push_back(std::move(encoded_frame));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(newest_mutex);
+        newest.swap(published);
+    }
+    // The frames replaced are released here, outside of the lock.
+    published.clear();
+
+    // Let the serving thread hand the new frame to the idle clients.
+    std::uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        async_log(log_facility | LOG_ERR, "Error: Could not wake up the MJPEG server : %m");
+    }
+}
+
+
+shared_ptr<const MJPEG_server::Encoded_frame> MJPEG_server::newest_frame(cv::Size size)
+{
+    std::lock_guard<std::mutex> lock(newest_mutex);
+    for (const shared_ptr<const Encoded_frame>& frame : newest) {
+        if (frame->size == size) {
+            return frame;
+        }
+    }
+    return nullptr;
+}
+
+
+void MJPEG_server::update_wanted_sizes()
+{
+    std::vector<cv::Size> sizes;
+    for (const Client& client : clients) {
+        if (client.streaming && std::find(sizes.begin(), sizes.end(), client.size) == sizes.end()) {
+            sizes.push_back(client.size);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(newest_mutex);
+    wanted_sizes.swap(sizes);
+}
+
+
+cv::Size MJPEG_server::parse_size(const string& request)
+{
+    // Only the request line is looked at, for example  GET /?size=640x360 HTTP/1.1
+    size_t line_end = request.find("\r\n");
+    size_t query = request.find("size=");
+    if (query == string::npos || query > line_end) {
+        return cv::Size();
+    }
+
+    int width = 0;
+    int height = 0;
+    if (sscanf(request.c_str() + query, "size=%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        return cv::Size();
+    }
+    return cv::Size(width, height);
+}
+
+
+void MJPEG_server::serve()
+{
+    std::vector<struct pollfd> poll_fds;
+
+    while (running) {
+        poll_fds.clear();
+        poll_fds.push_back({wake_fd, POLLIN, 0});
+        poll_fds.push_back({listen_fd, POLLIN, 0});
+
+        for (Client& client : clients) {
+            short events = 0;
+            shared_ptr<const Encoded_frame> newest_frame_now;
+            if (client.streaming && client.current == nullptr) {
+                newest_frame_now = newest_frame(client.size);
+            }
+            if (!client.streaming) {
+                events = POLLIN;
+            } else if (client.header_sent < client.response_header.size() || client.current != nullptr
+                       || (newest_frame_now != nullptr && newest_frame_now->sequence >= client.next_sequence)) {
+                // Only ask for POLLOUT when there is something to send, otherwise an idle client
+                // would make poll() return immediately forever.
+                events = POLLOUT;
+            }
+            poll_fds.push_back({client.socket_fd, events, 0});
+        }
+
+        if (poll(poll_fds.data(), poll_fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(log_facility | LOG_ERR, "Error: MJPEG server poll() failed : %m");
+            break;
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            std::uint64_t counter = 0;
+            if (read(wake_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN) {
+                syslog(log_facility | LOG_ERR, "Error: Could not read the MJPEG eventfd : %m");
+            }
+        }
+
+        if (poll_fds[1].revents & POLLIN) {
+            accept_clients();
+        }
+
+        // Walk the clients that were polled, the newly accepted ones are polled on the next iteration.
+        size_t polled_clients = poll_fds.size() - 2;
+        for (size_t i = polled_clients; i-- > 0; ) {
+            Client& client = clients[i];
+            short revents = poll_fds[i + 2].revents;
+            bool keep = true;
+
+            if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                keep = false;
+            } else if (!client.streaming && (revents & POLLIN)) {
+                keep = read_request(client);
+            } else if (client.streaming && (revents & POLLOUT)) {
+                keep = send_pending(client);
+            }
+
+            if (!keep) {
+                bool was_streaming = client.streaming;
+                close(client.socket_fd);
+                clients.erase(clients.begin() + i);
+                if (was_streaming) {
+                    --client_count;
+                    update_wanted_sizes();
+                }
+            }
+        }
+    }
+}
+
+
+void MJPEG_server::accept_clients()
+{
+    while (true) {
+        int socket_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                syslog(log_facility | LOG_ERR, "Error: MJPEG server could not accept a client : %m");
+            }
+            return;
+        }
+
+        if (clients.size() >= MJPEG_MAX_CLIENTS) {
+            syslog(log_facility | LOG_WARNING, "MJPEG server is full, refusing a client on port %d", port);
+            close(socket_fd);
+            continue;
+        }
+
+        Client client;
+        client.socket_fd = socket_fd;
+        client.header_sent = 0;
+        client.streaming = false;
+        client.offset = 0;
+        client.next_sequence = 0;
+        clients.push_back(std::move(client));
+    }
+}
+
+
+bool MJPEG_server::read_request(Client& client)
+{
+    char buffer[1024];
+    ssize_t total_read = recv(client.socket_fd, buffer, sizeof(buffer), 0);
+    if (total_read == 0) {
+        return false;  // the client hung up
+    } else if (total_read < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+
+    client.request.append(buffer, total_read);
+    if (client.request.size() > MAX_REQUEST_LENGTH) {
+        return false;
+    }
+    if (client.request.find("\r\n\r\n") == string::npos) {
+        return true;  // wait for the rest of the request
+    }
+
+    if (client.request.compare(0, 4, "GET ") != 0) {
+        client.response_header = "HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n";
+        send(client.socket_fd, client.response_header.data(), client.response_header.size(), MSG_NOSIGNAL);
+        return false;
+    }
+
+    client.response_header = "HTTP/1.0 200 OK\r\n"
+                             "Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY "\r\n"
+                             "Cache-Control: no-cache, no-store\r\n"
+                             "Pragma: no-cache\r\n"
+                             "Connection: close\r\n\r\n";
+    client.size = parse_size(client.request);
+    client.request.clear();
+    client.streaming = true;
+    // Don't start the client off with a frame left over from an earlier viewer.
+    shared_ptr<const Encoded_frame> frame = newest_frame(client.size);
+    client.next_sequence = (frame != nullptr) ? frame->sequence + 1 : 0;
+    ++client_count;
+    update_wanted_sizes();
+
+    syslog(log_facility | LOG_NOTICE, "MJPEG client connected on port %d at %dx%d, %d watching", port,
+           client.size.width, client.size.height, client_count.load());
+    return true;
+}
+
+
+bool MJPEG_server::send_pending(Client& client)
+{
+    while (true) {
+        // What is left of the response header, and of the current frame: its part header, its JPEG and the
+        // CRLF after it. They are sent with a single sendmsg(), without being copied together first.
+        struct iovec parts[4];
+        int part_count = 0;
+        size_t remaining = 0;
+
+        if (client.header_sent < client.response_header.size()) {
+            parts[part_count].iov_base = (void*) (client.response_header.data() + client.header_sent);
+            parts[part_count].iov_len = client.response_header.size() - client.header_sent;
+            remaining += parts[part_count++].iov_len;
+        }
+        if (client.current == nullptr) {
+            // Jump straight to the newest frame. Any frames published while this client was busy
+            // are skipped, instead of being queued up for it.
+            shared_ptr<const Encoded_frame> frame = newest_frame(client.size);
+            if (frame != nullptr && frame->sequence >= client.next_sequence) {
+                client.current = std::move(frame);
+                client.offset = 0;
+            }
+        }
+        if (client.current != nullptr) {
+            const Encoded_frame& frame = *client.current;
+            const char* pieces[3] = { frame.part_header.data(), (const char*) frame.jpeg->bytes.data(), "\r\n" };
+            size_t lengths[3] = { frame.part_header.size(), frame.jpeg->bytes.size(), 2 };
+            size_t skip = client.offset;
+            for (int i = 0; i < 3; ++i) {
+                if (skip >= lengths[i]) {
+                    skip -= lengths[i];
+                    continue;
+                }
+                parts[part_count].iov_base = (void*) (pieces[i] + skip);
+                parts[part_count].iov_len = lengths[i] - skip;
+                remaining += parts[part_count++].iov_len;
+                skip = 0;
+            }
+        }
+        if (part_count == 0) {
+            return true;  // nothing new to send
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = parts;
+        message.msg_iovlen = part_count;
+        ssize_t total_sent = sendmsg(client.socket_fd, &message, MSG_NOSIGNAL);
+        if (total_sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        size_t sent = total_sent;
+        size_t header_sent = std::min(sent, client.response_header.size() - client.header_sent);
+        client.header_sent += header_sent;
+        if (client.current != nullptr) {
+            client.offset += sent - header_sent;
+            if (client.offset == client.current->length()) {
+                client.next_sequence = client.current->sequence + 1;
+                client.current = nullptr;
+            }
+        }
+
+        if (sent < remaining) {
+            return true;  // the socket is full, wait for POLLOUT
+        }
+    }
+}
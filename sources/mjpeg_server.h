@@ -0,0 +1,182 @@
+/**
+ * File Name:   mjpeg_server.h
+ *
+ * Description:
+ * This file contains the declaration of the MJPEG_server class.
+ * An instance of this class serves the live stream of a single camera as a multipart/x-mixed-replace
+ * MJPEG stream over HTTP on the loopback interface, so that any number of clients (web browsers, VLC, ...)
+ * can watch the camera at the same time.
+ *
+ * Every frame is JPEG encoded only once per resolution, no matter how many clients are connected, and the
+ * encoded frame is shared by all of them. A client that cannot keep up simply skips to the newest frame once
+ * it finishes sending the current one, so nothing is ever buffered per client.
+ *
+ * A client can ask for a smaller resolution with a query such as  GET /?size=640x360
+ * The frame is then resized by the camera daemon, once for every client and live stream that uses that size.
+ */
+
+#ifndef MJPEG_SERVER_H
+#define MJPEG_SERVER_H
+
+#include "resize_cache.h"
+#include "captured_frame.h"
+
+#include <opencv2/core.hpp>  /* for cv::Mat, cv::Size */
+#include <atomic>            /* for std::atomic */
+#include <cstdint>           /* for std::uint64_t, std::int64_t */
+#include <memory>            /* for std::shared_ptr */
+#include <mutex>             /* for std::mutex */
+#include <string>            /* for std::string */
+#include <thread>            /* for std::thread */
+#include <vector>            /* for std::vector */
+
+// The MJPEG stream of camera N is served on port MJPEG_BASE_PORT + N of the loopback interface.
+#define MJPEG_BASE_PORT 8090
+// The most clients that can watch one camera at the same time.
+#define MJPEG_MAX_CLIENTS 16
+
+
+class MJPEG_server {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * The server does not listen for connections until start() is called.
+     */
+    MJPEG_server();
+
+    /**
+     * The destructor calls MJPEG_server::stop().
+     */
+    ~MJPEG_server();
+
+    /**
+     * This function opens the listening socket and starts the thread serving the clients.
+     *
+     * @param int port - The TCP port on the loopback interface to listen on, 0 for any free port.
+     *
+     * @return bool - true  if the server is now listening.
+     *                false if the socket could not be opened, the reason is written to the syslog.
+     */
+    bool start(int port);
+
+    /**
+     * This function stops serving clients and closes all the connections.
+     * It waits for the serving thread to finish, which takes at most one pass of its loop.
+     */
+    void stop();
+
+    /**
+     * This function makes a frame the newest frame of the stream.
+     * It is encoded once for every resolution that a client is watching, and not at all if no client is
+     * connected.
+     *
+     * @param Resize_cache& frames - The captured frame, at every resolution.
+     *
+     * @param const Captured_frame& captured - The frame at the resolution it was captured at. The JPEG of that
+     *                                        resolution is shared with the recordings and the snapshots.
+     *
+     * @param int jpeg_quality - The JPEG quality to encode the frame at, from 1 to 100.
+     */
+    void publish(Resize_cache& frames, const Captured_frame& captured, int jpeg_quality);
+
+  private:
+    /**
+     * A frame as it is sent on the wire: the multipart header, the JPEG data and the trailing CRLF.
+     * It is built once and shared by every client that sends it. The JPEG is the one the camera encoded,
+     * shared with the recordings and the snapshots, only the small header is made for the stream.
+     */
+    struct Encoded_frame {
+        cv::Size size;
+        std::uint64_t sequence;
+        std::string part_header;  // The multipart header, up to and including the blank line.
+        Shared_jpeg jpeg;         // The JPEG data.
+
+        /**
+         * @return std::size_t - The length of the part on the wire, with the CRLF after the JPEG.
+         */
+        std::size_t length() const
+        {
+            return part_header.size() + jpeg->bytes.size() + 2;
+        }
+    };
+
+    /**
+     * The state of a single connected client.
+     */
+    struct Client {
+        int socket_fd;                                 // The connected socket.
+        std::string request;                           // The HTTP request read so far.
+        std::string response_header;                   // The HTTP response header, sent before the first frame.
+        std::size_t header_sent;                       // How much of response_header was already sent.
+        bool streaming;                                // Was the request accepted?
+        std::shared_ptr<const Encoded_frame> current;  // The frame being sent, nullptr if idle.
+        std::size_t offset;                            // How much of the part of current was already sent.
+        std::uint64_t next_sequence;                   // Frames older than this were already sent or skipped.
+        cv::Size size;                                 // The resolution asked for, empty for the captured one.
+    };
+
+    /**
+     * This function is the body of the thread serving the clients.
+     * It multiplexes the listening socket and all client sockets with poll().
+     */
+    void serve();
+
+    /**
+     * This function accepts all pending connections on the listening socket.
+     */
+    void accept_clients();
+
+    /**
+     * This function reads the HTTP request of a client that has not started streaming yet.
+     *
+     * @return bool - false if the client should be disconnected.
+     */
+    bool read_request(Client& client);
+
+    /**
+     * This function sends as much as the socket accepts without blocking.
+     * When the current frame is finished, the client moves on to the newest frame, skipping any frames
+     * that were published in the meantime.
+     *
+     * @return bool - false if the client should be disconnected.
+     */
+    bool send_pending(Client& client);
+
+    /**
+     * @param cv::Size size - The resolution of the frame.
+     *
+     * @return std::shared_ptr<const Encoded_frame> - The newest published frame at that resolution, or nullptr.
+     */
+    std::shared_ptr<const Encoded_frame> newest_frame(cv::Size size);
+
+    /**
+     * This function collects the resolutions that the streaming clients asked for, for publish() to encode.
+     * It is called by the serving thread whenever a client starts or stops streaming.
+     */
+    void update_wanted_sizes();
+
+    /**
+     * This function parses the resolution out of the request line of a client.
+     *
+     * @param const std::string& request - The HTTP request.
+     *
+     * @return cv::Size - The resolution in the query string, or an empty size if there is none.
+     */
+    static cv::Size parse_size(const std::string& request);
+
+    int listen_fd;                                // The listening socket, -1 if not listening.
+    int wake_fd;                                  // An eventfd that wakes up the serving thread.
+    int port;                                     // The port the server listens on.
+    std::atomic<bool> running;                    // Is the serving thread supposed to keep running?
+    std::thread serve_thread;                     // The thread serving the clients, joined by stop().
+    std::atomic<int> client_count;                // The number of clients that are streaming.
+    std::mutex newest_mutex;                      // Guards newest and wanted_sizes.
+    std::vector<std::shared_ptr<const Encoded_frame>> newest;  // The newest published frame at every resolution.
+    std::vector<cv::Size> wanted_sizes;           // The resolutions the streaming clients asked for.
+    std::vector<Client> clients;                  // Only accessed by the serving thread.
+    std::vector<cv::Size> publish_sizes;          // Re-used by publish(), a copy of wanted_sizes.
+    std::vector<std::shared_ptr<const Encoded_frame>> published;  // Re-used by publish(), the new frames.
+};
+
+
+#endif  /* MJPEG_SERVER_H */
@@ -10,7 +10,6 @@
  * This class is used to run motion detection on a Mat object, searching for differences between consecutive frames. 
  * Each instance of this class is to correspond to a single camera or video file.
  */
-#include "low_level_cctv_daemon_apis.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/tracking.hpp>
 #include <opencv2/core/ocl.hpp>
@@ -19,8 +18,6 @@
 #include <syslog.h>  /* for syslog() */
 #define log_facility LOG_LOCAL0
 
-extern Daemon_data daemon_data;
-
 MotionFilter::MotionFilter()
 {
 	initialized = false;
@@ -33,7 +30,7 @@ void MotionFilter::convertFrame(cv::Mat &frame)
     cv::GaussianBlur(frame, frame, cv::Size(21, 21), 0);
 }
 
-bool MotionFilter::differentFrames(cv::Mat oldFrame, cv::Mat newFrame)
+bool MotionFilter::differentFrames(cv::Mat oldFrame, cv::Mat newFrame, const Camera_config &config)
 {
 	cv::Mat frameDifference, frameThreshold;
     std::vector<std::vector<cv::Point>> contours;
@@ -44,13 +41,16 @@ bool MotionFilter::differentFrames(cv::Mat oldFrame, cv::Mat newFrame)
 	* a contour's area is used to determine the scale of the motion
 	**/
 	cv::absdiff(oldFrame, newFrame, frameDifference);
-	cv::threshold(frameDifference, frameThreshold, 25.0, 255.0, cv::THRESH_BINARY);
+	cv::threshold(frameDifference, frameThreshold, config.motion_threshold, 255.0, cv::THRESH_BINARY);
 	cv::dilate(frameThreshold, frameThreshold, cv::Mat(), cv::Point(-1,-1), 2);
+	//Kept for the live stream, which only re-sends the parts of the frame that changed
+	//findContours() may modify its input, so the mask is copied before
+	frameThreshold.copyTo(motionMask);
 	cv::findContours(frameThreshold, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
 
 	for(size_t i = 0; i< contours.size(); i++) 
 	{
-		if(cv::contourArea(contours[i]) > 10)
+		if(cv::contourArea(contours[i]) > config.motion_min_area)
 		{
 			return true;
 		}
@@ -73,13 +73,14 @@ std::string MotionFilter::putFrameInfo(cv::Mat frame, std::string outPut)
 	return outPut;
 }
 
-bool MotionFilter::runDetection(cv::Mat &frame)
+bool MotionFilter::runDetection(const cv::Mat &frame, const Camera_config &config)
 {
 	cv::Mat newFrame = frame.clone();
 	convertFrame(newFrame);
 	//Algorithm skips the first frame
 	if(!initialized)
 	{
+		motionMask.release();
 		oldFrame = newFrame;
 		initialized = true;
 		return false;
@@ -88,19 +89,16 @@ bool MotionFilter::runDetection(cv::Mat &frame)
 	//putText(frame, putFrameInfo(frame, "Rcv Frame: "), cv::Point(10, 20), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0,0,255),2);
 	//putText(frame, putFrameInfo(newFrame, "New Frame: "), cv::Point(10, 40), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0,0,255),2);
 	//putText(frame, putFrameInfo(oldFrame, "Old Frame: "), cv::Point(10, 60), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0,0,255),2);
-	if(differentFrames(oldFrame, newFrame))
+	if(differentFrames(oldFrame, newFrame, config))
 	{
 		oldFrame = newFrame;
-		if(daemon_data.enable_outlines)
-		{
-			putText(frame, "+", cv::Point(12, 24), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0,0,255),2);
-		}
 		return true;
 	}
 	oldFrame = newFrame;
-	if(daemon_data.enable_outlines)
-	{
-		putText(frame, "-", cv::Point(12, 24), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0,0,255),2);
-	}
 	return false;
 }
+
+const cv::Mat& MotionFilter::getMotionMask() const
+{
+	return motionMask;
+}
@@ -18,17 +18,21 @@
 #include <opencv2/tracking.hpp>
 #include <opencv2/core/ocl.hpp>
 #include <unistd.h>
+#include "camera_config.h"
 
 class MotionFilter
 {
 private:
 	cv::Mat oldFrame;
+	cv::Mat motionMask;
 	bool initialized;
 	void convertFrame(cv::Mat &frame);
-	bool differentFrames(cv::Mat oldFrame, cv::Mat newFrame);
+	bool differentFrames(cv::Mat oldFrame, cv::Mat newFrame, const Camera_config &config);
 	std::string putFrameInfo(cv::Mat frame, std::string outPut);
 public:
 	MotionFilter();
-	bool runDetection(cv::Mat &frame);
+	bool runDetection(const cv::Mat &frame, const Camera_config &config);
+	//The pixels that changed in the last frame passed to runDetection(), empty if it was the first frame
+	const cv::Mat& getMotionMask() const;
 };
 #endif
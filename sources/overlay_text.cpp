@@ -0,0 +1,123 @@
+/**
+ * File Name:   overlay_text.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions that draw the statistics overlay of the
+ * LiveStream Viewer Window with a tiny built-in 3x5 pixel font.
+ */
+
+#include "overlay_text.h"
+
+#include <cctype>  /* for toupper() */
+#include <vector>  /* for std::vector */
+
+// The size of a glyph in font pixels.
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+// The space between two glyphs, and around the text, in font pixels.
+#define GLYPH_SPACING 1
+
+
+/**
+ * One character of the font.
+ * Each row is 3 bits wide, the most significant bit is the leftmost pixel.
+ */
+struct Glyph {
+    char character;
+    unsigned char rows[GLYPH_HEIGHT];
+};
+
+static const Glyph font[] = {
+    { '0', {7, 5, 5, 5, 7} }, { '1', {2, 6, 2, 2, 7} }, { '2', {7, 1, 7, 4, 7} }, { '3', {7, 1, 7, 1, 7} },
+    { '4', {5, 5, 7, 1, 1} }, { '5', {7, 4, 7, 1, 7} }, { '6', {7, 4, 7, 5, 7} }, { '7', {7, 1, 1, 1, 1} },
+    { '8', {7, 5, 7, 5, 7} }, { '9', {7, 5, 7, 1, 7} },
+    { 'A', {2, 5, 7, 5, 5} }, { 'B', {6, 5, 6, 5, 6} }, { 'C', {3, 4, 4, 4, 3} }, { 'D', {6, 5, 5, 5, 6} },
+    { 'E', {7, 4, 6, 4, 7} }, { 'F', {7, 4, 6, 4, 4} }, { 'G', {3, 4, 5, 5, 3} }, { 'H', {5, 5, 7, 5, 5} },
+    { 'I', {7, 2, 2, 2, 7} }, { 'J', {1, 1, 1, 5, 2} }, { 'K', {5, 5, 6, 5, 5} }, { 'L', {4, 4, 4, 4, 7} },
+    { 'M', {5, 7, 7, 5, 5} }, { 'N', {6, 5, 5, 5, 5} }, { 'O', {2, 5, 5, 5, 2} }, { 'P', {6, 5, 6, 4, 4} },
+    { 'Q', {2, 5, 5, 6, 3} }, { 'R', {6, 5, 6, 5, 5} }, { 'S', {3, 4, 2, 1, 6} }, { 'T', {7, 2, 2, 2, 2} },
+    { 'U', {5, 5, 5, 5, 7} }, { 'V', {5, 5, 5, 5, 2} }, { 'W', {5, 5, 7, 7, 5} }, { 'X', {5, 5, 2, 5, 5} },
+    { 'Y', {5, 5, 2, 2, 2} }, { 'Z', {7, 1, 2, 4, 7} },
+    { '.', {0, 0, 0, 0, 2} }, { ':', {0, 2, 0, 2, 0} }, { '%', {5, 1, 2, 4, 5} }, { '#', {5, 7, 5, 7, 5} },
+    { '/', {1, 1, 2, 4, 4} }, { '-', {0, 0, 7, 0, 0} }, { '+', {0, 2, 7, 2, 0} },
+};
+
+
+/**
+ * This helper function looks up the glyph of a character.
+ *
+ * @return const Glyph* - The glyph, or nullptr for a space and for characters that are not in the font.
+ */
+static const Glyph* find_glyph(char character)
+{
+    char upper_case = (char) toupper((unsigned char) character);
+    for (const Glyph& glyph : font) {
+        if (glyph.character == upper_case) {
+            return &glyph;
+        }
+    }
+    return nullptr;
+}
+
+
+int overlay_text_width(const string& text, int scale)
+{
+    return ((int) text.length() * (GLYPH_WIDTH + GLYPH_SPACING) + GLYPH_SPACING) * scale;
+}
+
+
+int overlay_text_height(int scale)
+{
+    return (GLYPH_HEIGHT + 2 * GLYPH_SPACING) * scale;
+}
+
+
+void draw_overlay_text(SDL_Renderer* renderer, int x, int y, int scale, const string& text)
+{
+    // The rectangles are re-used from call to call, the overlay is drawn on every presented frame.
+    static std::vector<SDL_Rect> pixels;
+    pixels.clear();
+
+    for (size_t i = 0; i < text.length(); ++i) {
+        const Glyph* glyph = find_glyph(text[i]);
+        if (glyph == nullptr) {
+            continue;
+        }
+        int glyph_x = x + ((int) i * (GLYPH_WIDTH + GLYPH_SPACING) + GLYPH_SPACING) * scale;
+        int glyph_y = y + GLYPH_SPACING * scale;
+
+        for (int row = 0; row < GLYPH_HEIGHT; ++row) {
+            // Neighboring pixels of a row are drawn as one rectangle.
+            int column = 0;
+            while (column < GLYPH_WIDTH) {
+                if (!(glyph->rows[row] & (1 << (GLYPH_WIDTH - 1 - column)))) {
+                    ++column;
+                    continue;
+                }
+                int run_start = column;
+                while (column < GLYPH_WIDTH && (glyph->rows[row] & (1 << (GLYPH_WIDTH - 1 - column)))) {
+                    ++column;
+                }
+                SDL_Rect pixel_run = { glyph_x + run_start * scale, glyph_y + row * scale, (column - run_start) * scale, scale };
+                pixels.push_back(pixel_run);
+            }
+        }
+    }
+
+    SDL_BlendMode old_blend_mode;
+    SDL_GetRenderDrawBlendMode(renderer, &old_blend_mode);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    SDL_Rect background = { x, y, overlay_text_width(text, scale), overlay_text_height(scale) };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(renderer, &background);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    if (!pixels.empty()) {
+        SDL_RenderFillRects(renderer, pixels.data(), (int) pixels.size());
+    }
+
+    // SDL_RenderClear() uses the draw color, so it is put back to black.
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_SetRenderDrawBlendMode(renderer, old_blend_mode);
+}
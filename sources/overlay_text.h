@@ -0,0 +1,56 @@
+/**
+ * File Name:   overlay_text.h
+ *
+ * Description:
+ * This file contains the declarations of the functions that draw the statistics overlay of the
+ * LiveStream Viewer Window.
+ * The text is drawn with a tiny built-in 3x5 pixel font made of filled rectangles, so the LiveStream
+ * Viewer does not depend on a font library or on font files being installed.
+ * The font has the digits, the upper case letters (lower case letters are drawn as upper case),
+ * and the characters  . : % # / - +
+ */
+
+#ifndef OVERLAY_TEXT_H
+#define OVERLAY_TEXT_H
+
+#include <string>      /* for std::string */
+#include <SDL2/SDL.h>  /* for SDL_Renderer */
+
+using std::string;
+
+
+/**
+ * @param const string& text - The text to be measured.
+ *
+ * @param int scale - How many screen pixels each font pixel takes.
+ *
+ * @return int - The width of the text on the screen in pixels.
+ */
+int overlay_text_width(const string& text, int scale);
+
+
+/**
+ * @param int scale - How many screen pixels each font pixel takes.
+ *
+ * @return int - The height of a line of text on the screen in pixels.
+ */
+int overlay_text_height(int scale);
+
+
+/**
+ * This function draws a line of text on a dark, translucent box.
+ *
+ * @param SDL_Renderer* renderer - The renderer to draw with.
+ *
+ * @param int x - The left edge of the box.
+ *
+ * @param int y - The top edge of the box.
+ *
+ * @param int scale - How many screen pixels each font pixel takes.
+ *
+ * @param const string& text - The text to be drawn.
+ */
+void draw_overlay_text(SDL_Renderer* renderer, int x, int y, int scale, const string& text);
+
+
+#endif  /* OVERLAY_TEXT_H */
@@ -0,0 +1,106 @@
+/**
+ * File Name:   recordings_model.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Recordings_model class's methods.
+ */
+
+#include "recordings_model.h"
+
+#include <QColor>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QString>
+
+using std::shared_ptr;
+
+
+Recordings_model::Recordings_model(QObject* parent)
+    : QAbstractListModel(parent), pixmaps(RECORDINGS_PIXMAP_CACHE_SIZE), placeholder(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT)
+{
+    placeholder.fill(QColor(60, 60, 60));
+}
+
+
+void Recordings_model::set_recordings(const Recordings_scan& scan)
+{
+    beginResetModel();
+    recordings = scan.recordings;
+    pixmaps.clear();
+    thumbnails = scan.thumbnails;
+    thumbnail_of.assign(recordings.size(), -1);
+    for (size_t row = 0; thumbnails != nullptr && row < recordings.size(); ++row) {
+        thumbnail_of[row] = thumbnails->find(recordings[row]);
+    }
+    endResetModel();
+}
+
+
+void Recordings_model::set_thumbnails(shared_ptr<const Thumbnail_cache> thumbnails)
+{
+    this->thumbnails = thumbnails;
+    pixmaps.clear();
+    for (size_t row = 0; row < recordings.size(); ++row) {
+        thumbnail_of[row] = thumbnails->find(recordings[row]);
+    }
+    if (!recordings.empty()) {
+        emit dataChanged(index(0), index(recordings.size() - 1), { Qt::DecorationRole });
+    }
+}
+
+
+const Recording* Recordings_model::recording(const QModelIndex& index) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= (int) recordings.size()) {
+        return nullptr;
+    }
+    return &recordings[index.row()];
+}
+
+
+int Recordings_model::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : recordings.size();
+}
+
+
+QVariant Recordings_model::data(const QModelIndex& index, int role) const
+{
+    const Recording* video = recording(index);
+    if (video == nullptr) {
+        return QVariant();
+    }
+
+    switch (role) {
+        case Qt::DisplayRole:
+            return QString("%1\n%2").arg(video->camera < 0 ? QString("Video file") : QString("Camera %1").arg(video->camera + 1))
+                   .arg(QFileInfo(QString::fromStdString(video->clip)).completeBaseName());
+
+        case Qt::ToolTipRole:
+            return QString("%1\n%2 MB, saved %3").arg(QString::fromStdString(video->clip))
+                   .arg(video->bytes / 1048576.0, 0, 'f', 1)
+                   .arg(QDateTime::fromMSecsSinceEpoch(video->modified_us / 1000).toString("dd.MM.yyyy hh:mm:ss"));
+
+        case Qt::DecorationRole: {
+            int row = index.row();
+            if (QPixmap* cached = pixmaps.object(row)) {
+                return *cached;
+            }
+            int thumbnail = thumbnail_of[row];
+            if (thumbnail == -1 || thumbnails->entry(thumbnail).size == 0) {
+                return placeholder;
+            }
+            QPixmap* pixmap = new QPixmap();
+            if (!pixmap->loadFromData(thumbnails->jpeg(thumbnail), thumbnails->entry(thumbnail).size, "JPG")) {
+                delete pixmap;
+                return placeholder;
+            }
+            QPixmap decoded = *pixmap;
+            pixmaps.insert(row, pixmap);
+            return decoded;
+        }
+
+        default:
+            return QVariant();
+    }
+}
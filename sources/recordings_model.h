@@ -0,0 +1,72 @@
+/**
+ * File Name:   recordings_model.h
+ *
+ * Description:
+ * This file contains the declaration of the Recordings_model class, the list of the videos of the detections
+ * shown in the Recordings tab of the GUI, with their thumbnails (see thumbnail_cache.h).
+ *
+ * The model only holds the list of the videos and the mapped thumbnail file. A thumbnail is decoded the first
+ * time its video is shown, and the last RECORDINGS_PIXMAP_CACHE_SIZE of them are kept, so the list comes up
+ * without decoding a single JPEG however many videos there are.
+ */
+
+#ifndef RECORDINGS_MODEL_H
+#define RECORDINGS_MODEL_H
+
+#include "thumbnail_cache.h"
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+#include <memory>   /* for std::shared_ptr */
+#include <vector>   /* for std::vector */
+
+// How many decoded thumbnails are kept.
+#define RECORDINGS_PIXMAP_CACHE_SIZE 512
+
+
+class Recordings_model : public QAbstractListModel
+{
+public:
+    /**
+     * The constructor makes an empty list.
+     *
+     * @param QObject* parent - The parent of the model.
+     */
+    Recordings_model(QObject* parent = nullptr);
+
+    /**
+     * This function replaces the list of the videos.
+     *
+     * @param const Recordings_scan& scan - The videos and their thumbnails, from scan_recordings().
+     */
+    void set_recordings(const Recordings_scan& scan);
+
+    /**
+     * This function replaces the thumbnails, after update_thumbnails() wrote new ones.
+     *
+     * @param std::shared_ptr<const Thumbnail_cache> thumbnails - The thumbnail file.
+     */
+    void set_thumbnails(std::shared_ptr<const Thumbnail_cache> thumbnails);
+
+    /**
+     * @param const QModelIndex& index - A row of the model.
+     *
+     * @return const Recording* - The video of the row, or nullptr if the index is not valid.
+     */
+    const Recording* recording(const QModelIndex& index) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    std::vector<Recording> recordings;                   // The videos, newest first.
+    std::vector<int> thumbnail_of;                       // The index of the thumbnail of every video, -1 if none.
+    std::shared_ptr<const Thumbnail_cache> thumbnails;   // The mapped thumbnail file.
+    mutable QCache<int, QPixmap> pixmaps;                // The thumbnails that were decoded, by row.
+    QPixmap placeholder;                                 // Shown for a video without a thumbnail.
+};
+
+
+#endif  /* RECORDINGS_MODEL_H */
@@ -0,0 +1,70 @@
+/**
+ * File Name:   resize_cache.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Resize_cache class's methods.
+ * An instance of this class hands out the captured frame of a camera at whatever resolutions the live
+ * stream consumers are displaying it at, resizing each resolution at most once per frame.
+ */
+
+#include "resize_cache.h"
+
+#include <opencv2/imgproc.hpp>  /* for cv::resize() */
+
+
+Resize_cache::Resize_cache()
+ : frame(), frame_number(0), entries(), resize_count(0)
+{
+    //
+}
+
+
+void Resize_cache::set_frame(const cv::Mat& frame)
+{
+    this->frame = frame;
+    ++frame_number;
+
+    // Forget the resolutions nobody is displaying anymore, such as the old size of a resized window.
+    for (size_t i = entries.size(); i-- > 0; ) {
+        if (frame_number - entries[i].last_used > RESIZE_CACHE_EXPIRY_FRAMES) {
+            entries.erase(entries.begin() + i);
+        }
+    }
+}
+
+
+const cv::Mat& Resize_cache::get(cv::Size size)
+{
+    if (size.width <= 0 || size.height <= 0 || size.width >= frame.cols || size.height >= frame.rows) {
+        return frame;
+    }
+
+    Entry* entry = nullptr;
+    for (Entry& existing_entry : entries) {
+        if (existing_entry.size == size) {
+            entry = &existing_entry;
+            break;
+        }
+    }
+    if (entry == nullptr) {
+        entries.push_back(Entry());
+        entry = &entries.back();
+        entry->size = size;
+        entry->frame = 0;
+    }
+
+    entry->last_used = frame_number;
+    if (entry->frame != frame_number) {
+        // INTER_AREA averages the pixels, so small sizes don't shimmer the way nearest neighbour does.
+        cv::resize(frame, entry->resized, size, 0, 0, cv::INTER_AREA);
+        entry->frame = frame_number;
+        ++resize_count;
+    }
+    return entry->resized;
+}
+
+
+std::uint64_t Resize_cache::resizes() const
+{
+    return resize_count;
+}
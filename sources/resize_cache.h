@@ -0,0 +1,74 @@
+/**
+ * File Name:   resize_cache.h
+ *
+ * Description:
+ * This file contains the declaration of the Resize_cache class.
+ * An instance of this class hands out the captured frame of a camera at whatever resolutions the live
+ * stream consumers (the LiveStream Viewer and the MJPEG clients) are displaying it at.
+ *
+ * Each resolution is resized at most once per frame, no matter how many consumers ask for it, and the
+ * buffers of the resized frames are re-used from frame to frame. A resolution that nobody asked for in
+ * a while is forgotten.
+ */
+
+#ifndef RESIZE_CACHE_H
+#define RESIZE_CACHE_H
+
+#include <opencv2/core.hpp>  /* for cv::Mat, cv::Size */
+#include <cstdint>           /* for std::uint64_t */
+#include <deque>             /* for std::deque */
+
+// A resolution that was not asked for in this many frames is forgotten.
+#define RESIZE_CACHE_EXPIRY_FRAMES 300
+
+
+class Resize_cache {
+  public:
+    /**
+     * The constructor initializes an empty cache.
+     */
+    Resize_cache();
+
+    /**
+     * This function makes a newly captured frame the one handed out by get().
+     * The frame is not copied, it must stay unchanged until the next call.
+     *
+     * @param const cv::Mat& frame - The captured frame.
+     */
+    void set_frame(const cv::Mat& frame);
+
+    /**
+     * This function hands out the current frame at a resolution.
+     * The frame is only ever made smaller, if the resolution is not smaller than the captured frame, or it
+     * is empty, the captured frame itself is handed out.
+     *
+     * @param cv::Size size - The resolution, an empty size for the captured resolution.
+     *
+     * @return const cv::Mat& - The frame at that resolution, valid until the next call to set_frame().
+     */
+    const cv::Mat& get(cv::Size size);
+
+    /**
+     * @return std::uint64_t - The number of resizes done so far.
+     */
+    std::uint64_t resizes() const;
+
+  private:
+    /**
+     * The current frame resized to one resolution.
+     */
+    struct Entry {
+        cv::Size size;           // The resolution.
+        cv::Mat resized;         // The frame at that resolution, the buffer is re-used.
+        std::uint64_t frame;     // The frame that resized holds, see frame_number.
+        std::uint64_t last_used; // The frame that this resolution was last asked for.
+    };
+
+    cv::Mat frame;               // The captured frame.
+    std::uint64_t frame_number;  // Counts the calls to set_frame().
+    std::deque<Entry> entries;   // One entry per resolution in use, a deque so get() never moves them.
+    std::uint64_t resize_count;  // The number of resizes done so far.
+};
+
+
+#endif  /* RESIZE_CACHE_H */
@@ -0,0 +1,85 @@
+/**
+ * File Name:   segment_index.cpp
+ *
+ * Description:
+ * This file contains the definitions of the functions that read the index of the continuous recording
+ * of a camera.
+ */
+
+#include "segment_index.h"
+#include "detection_store.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for fstat() */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for close(), read() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <algorithm>    /* for std::lower_bound() */
+#include <cstring>      /* for memcmp() */
+
+using std::string;
+using std::vector;
+using std::int64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+const char segment_index_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'S', 'G', '1' };
+
+
+bool read_segment_index(const string& path, vector<Segment_entry>& entries)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            syslog(log_facility | LOG_ERR, "Error: Could not open %s : %m", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    struct stat file_status;
+    Store_header header;
+    if (fstat(fd, &file_status) == -1 || (size_t) file_status.st_size < sizeof(header)
+        || read(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)
+        || memcmp(header.magic, segment_index_magic, sizeof(header.magic)) != 0 || header.item_size != sizeof(Segment_entry)) {
+        syslog(log_facility | LOG_ERR, "Error: %s is not a segment index", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    // An entry cut short when the daemon was killed is left out.
+    size_t count = (file_status.st_size - sizeof(header)) / sizeof(Segment_entry);
+    size_t first = entries.size();
+    entries.resize(first + count);
+    size_t wanted = count * sizeof(Segment_entry);
+    ssize_t got = read(fd, entries.data() + first, wanted);
+    close(fd);
+    if (got != (ssize_t) wanted) {
+        syslog(log_facility | LOG_ERR, "Error: Could not read %s", path.c_str());
+        entries.resize(first);
+        return false;
+    }
+    for (size_t i = first; i < entries.size(); ++i) {
+        entries[i].file[sizeof(entries[i].file) - 1] = '\0';
+    }
+    return true;
+}
+
+
+bool query_segments(const string& directory, int64_t from_us, int64_t to_us, vector<Segment_entry>& found)
+{
+    vector<Segment_entry> entries;
+    if (!read_segment_index(directory + SEGMENT_INDEX_FILE, entries)) {
+        return false;
+    }
+
+    // The segments are recorded one after the other, so both their starts and their ends are in order.
+    auto first = std::lower_bound(entries.begin(), entries.end(), from_us,
+                                  [](const Segment_entry& entry, int64_t time_us) { return entry.end_us < time_us; });
+    for (auto segment = first; segment != entries.end() && segment->start_us < to_us; ++segment) {
+        found.push_back(*segment);
+    }
+    return true;
+}
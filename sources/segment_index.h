@@ -0,0 +1,76 @@
+/**
+ * File Name:   segment_index.h
+ *
+ * Description:
+ * This file contains the declarations of the index of the continuous recording of a camera, see
+ * segment_recorder.h, and of the functions that read it. They do not need OpenCV, so SmartCCTV_query
+ * finds the segments of a time range without linking the rest of the camera daemon.
+ *
+ * The segments of a camera are listed in segments.index, in the order they were recorded, as a Store_header
+ * (see detection_store.h) with the magic "SCCTVSG1" followed by one fixed size Segment_entry per segment.
+ * The files that cover a time range are found with a binary search over it, see query_segments().
+ */
+
+#ifndef SEGMENT_INDEX_H
+#define SEGMENT_INDEX_H
+
+#include <cstdint>  /* for std::uint32_t, std::uint64_t, std::int64_t */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// The directory of the segments, under the recordings directory of a camera.
+#define SEGMENT_DIR "segments/"
+// The name of the segment index, in the directory of the segments.
+#define SEGMENT_INDEX_FILE "segments.index"
+
+
+/**
+ * A segment in the index.
+ */
+struct Segment_entry {
+    std::int64_t start_us;    // The capture time of the first frame, in microseconds since the epoch.
+    std::int64_t end_us;      // The capture time of the last frame.
+    std::uint64_t bytes;      // The size of the file.
+    std::uint32_t frames;     // The number of frames, 0 for a segment recovered after the daemon was killed.
+    std::uint32_t reserved;
+    char file[32];            // The name of the file in the directory of the segments, '\0' terminated.
+};
+
+static_assert(sizeof(Segment_entry) == 64, "The segment index is read and written as is");
+
+// The magic of the Store_header of a segment index.
+extern const char segment_index_magic[8];
+
+
+/**
+ * This function reads the entries of a segment index.
+ *
+ * @param const std::string& path - The index.
+ *
+ * @param std::vector<Segment_entry>& entries - The entries are appended here, in the order of the index.
+ *
+ * @return bool - false if the index could not be read, the reason is written to the syslog.
+ *                An index that is not there has no entries, which is not an error.
+ */
+bool read_segment_index(const std::string& path, std::vector<Segment_entry>& entries);
+
+
+/**
+ * This function reads the segments of a camera that have frames within a time range.
+ *
+ * @param const std::string& directory - The directory of the segments, ending in '/'.
+ *
+ * @param std::int64_t from_us - The start of the range, in microseconds since the epoch.
+ *
+ * @param std::int64_t to_us - The end of the range, not included.
+ *
+ * @param std::vector<Segment_entry>& found - The segments are appended here, oldest first.
+ *
+ * @return bool - false if the index could not be read, the reason is written to the syslog.
+ *                A camera that has not recorded any segments yet has no index, which is not an error.
+ */
+bool query_segments(const std::string& directory, std::int64_t from_us, std::int64_t to_us,
+                    std::vector<Segment_entry>& found);
+
+
+#endif  /* SEGMENT_INDEX_H */
@@ -0,0 +1,378 @@
+/**
+ * File Name:   segment_recorder.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Segment_recorder class's methods, the continuous recording
+ * of a camera into fixed length segments within a quota, and of the function that looks up the segments.
+ */
+
+#include "segment_recorder.h"
+#include "detection_store.h"
+#include "event_bus.h"
+#include "async_log.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>   /* for mkdir(), stat(), fstat(), mode permissions constants */
+#include <fcntl.h>      /* for open(), fallocate(), FALLOC_FL_KEEP_SIZE, O_* constants */
+#include <unistd.h>     /* for close(), write(), ftruncate(), unlink() */
+#include <dirent.h>     /* for opendir(), readdir(), closedir() */
+#include <syslog.h>     /* for syslog() */
+#include <errno.h>      /* for errno */
+#include <algorithm>    /* for std::sort(), std::max(), std::min() */
+#include <cstdio>       /* for snprintf(), sscanf(), rename() */
+#include <cstring>      /* for memcpy(), memset(), strncpy(), strlen() */
+#include <ctime>        /* for time_t, struct tm, localtime_r(), mktime(), strftime() */
+#include <set>          /* for std::set */
+
+using std::string;
+using std::vector;
+using std::int64_t;
+using std::uint64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+static const char segment_extension[] = ".mjpeg";
+
+
+/**
+ * This helper function writes a whole buffer, write() may write less than it was asked to.
+ *
+ * @return bool - true if all of it was written.
+ */
+static bool write_all(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+
+/**
+ * This helper function finds the capture time of the first frame of a segment from the name of its file.
+ *
+ * @return int64_t - The time in microseconds since the epoch, or -1 if it is not the name of a segment.
+ */
+static int64_t segment_start_from_name(const char* name)
+{
+    size_t length = strlen(name);
+    size_t extension_length = sizeof(segment_extension) - 1;
+    if (length <= extension_length || strcmp(name + length - extension_length, segment_extension) != 0) {
+        return -1;
+    }
+
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    int milliseconds = 0;
+    if (sscanf(name, "%d-%d-%d_%d-%d-%d.%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+               &local.tm_hour, &local.tm_min, &local.tm_sec, &milliseconds) != 7) {
+        return -1;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    return (int64_t) mktime(&local) * 1000000 + milliseconds * 1000;
+}
+
+
+Segment_recorder::Segment_recorder()
+ : camera(-1), stored_bytes(0), segment_fd(-1), preallocated(0), preallocation_failed(false), retry_time_us(0)
+{
+    memset(&current, 0, sizeof(current));
+}
+
+
+Segment_recorder::~Segment_recorder()
+{
+    close();
+}
+
+
+bool Segment_recorder::open(const string& directory, int camera)
+{
+    if (mkdir(directory.c_str(), S_IRWXU) == -1 && errno != EEXIST) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create the segments directory %s : %m", directory.c_str());
+        return false;
+    }
+    this->directory = directory;
+    this->camera = camera;
+
+    vector<Segment_entry> entries;
+    if (!read_segment_index(directory + SEGMENT_INDEX_FILE, entries)) {
+        // The segments are still on the disk, recover() puts them back into a new index.
+        entries.clear();
+    }
+    segments.assign(entries.begin(), entries.end());
+    if (recover()) {
+        write_index();
+    }
+
+    stored_bytes = 0;
+    for (const Segment_entry& segment : segments) {
+        stored_bytes += segment.bytes;
+    }
+    syslog(log_facility | LOG_NOTICE, "%zu segments of %llu bytes in %s", segments.size(),
+           (unsigned long long) stored_bytes, directory.c_str());
+    return true;
+}
+
+
+bool Segment_recorder::recover()
+{
+    bool changed = false;
+
+    // A segment that was deleted by hand is dropped from the index.
+    std::set<string> indexed;
+    for (auto segment = segments.begin(); segment != segments.end(); ) {
+        struct stat file_status;
+        if (stat((directory + segment->file).c_str(), &file_status) == -1) {
+            segment = segments.erase(segment);
+            changed = true;
+        } else {
+            indexed.insert(segment->file);
+            ++segment;
+        }
+    }
+
+    // A segment that is not in the index was being written when the daemon was killed.
+    DIR* segments_directory = opendir(directory.c_str());
+    if (segments_directory == nullptr) {
+        syslog(log_facility | LOG_ERR, "Error: Could not list %s : %m", directory.c_str());
+        return changed;
+    }
+    vector<Segment_entry> found;
+    while (struct dirent* file = readdir(segments_directory)) {
+        int64_t start_us = segment_start_from_name(file->d_name);
+        if (start_us < 0 || strlen(file->d_name) >= sizeof(current.file) || indexed.count(file->d_name) > 0) {
+            continue;
+        }
+
+        string path = directory + file->d_name;
+        struct stat file_status;
+        if (stat(path.c_str(), &file_status) == -1) {
+            continue;
+        }
+        // It still has the blocks that were preallocated for it.
+        if (truncate(path.c_str(), file_status.st_size) == -1) {
+            syslog(log_facility | LOG_WARNING, "Could not trim %s : %m", path.c_str());
+        }
+
+        Segment_entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.start_us = start_us;
+        entry.end_us = std::max(start_us, (int64_t) file_status.st_mtim.tv_sec * 1000000 + file_status.st_mtim.tv_nsec / 1000);
+        entry.bytes = file_status.st_size;
+        strncpy(entry.file, file->d_name, sizeof(entry.file) - 1);
+        found.push_back(entry);
+        syslog(log_facility | LOG_NOTICE, "Recovered the segment %s", path.c_str());
+    }
+    closedir(segments_directory);
+
+    if (!found.empty()) {
+        segments.insert(segments.end(), found.begin(), found.end());
+        std::sort(segments.begin(), segments.end(),
+                  [](const Segment_entry& a, const Segment_entry& b) { return a.start_us < b.start_us; });
+        changed = true;
+    }
+    return changed;
+}
+
+
+bool Segment_recorder::write_index()
+{
+    // The new index is written under another name and renamed into place, so a reader never sees half of it.
+    string path = directory + SEGMENT_INDEX_FILE;
+    string temporary_path = path + ".new";
+    int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not write %s : %m", temporary_path.c_str());
+        return false;
+    }
+
+    Store_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, segment_index_magic, sizeof(header.magic));
+    header.item_size = sizeof(Segment_entry);
+    bool ok = write_all(fd, &header, sizeof(header));
+    for (auto segment = segments.begin(); ok && segment != segments.end(); ++segment) {
+        ok = write_all(fd, &*segment, sizeof(*segment));
+    }
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || rename(temporary_path.c_str(), path.c_str()) == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not write %s : %m", path.c_str());
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+void Segment_recorder::evict(uint64_t needed, uint64_t quota)
+{
+    bool evicted = false;
+    while (!segments.empty() && stored_bytes + needed > quota) {
+        const Segment_entry& oldest = segments.front();
+        string path = directory + oldest.file;
+        if (unlink(path.c_str()) == -1 && errno != ENOENT) {
+            async_log(log_facility | LOG_ERR, "Error: Could not delete the segment %s : %m", path.c_str());
+            break;
+        }
+        stored_bytes -= std::min(stored_bytes, oldest.bytes);
+        segments.pop_front();
+        evicted = true;
+    }
+    if (evicted) {
+        write_index();
+    }
+}
+
+
+bool Segment_recorder::start_segment(int64_t capture_time_us, uint64_t expected_bytes, uint64_t quota)
+{
+    // There has to be room for the whole segment before it is started, so the quota holds even while it is written.
+    expected_bytes = std::min(expected_bytes, quota);
+    evict(expected_bytes, quota);
+
+    memset(&current, 0, sizeof(current));
+    current.start_us = capture_time_us;
+    current.end_us = capture_time_us;
+
+    time_t seconds = capture_time_us / 1000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char stamp[24];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d_%H-%M-%S", &local);
+    snprintf(current.file, sizeof(current.file), "%s.%03d%s", stamp, (int) (capture_time_us / 1000 % 1000), segment_extension);
+
+    string path = directory + current.file;
+    segment_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (segment_fd == -1) {
+        async_log(log_facility | LOG_ERR, "Error: Could not create the segment %s : %m", path.c_str());
+        return false;
+    }
+
+    // The blocks are reserved without changing the size of the file, a player reading it while it is
+    // written only sees the frames that are there.
+    preallocated = 0;
+    if (!preallocation_failed && expected_bytes > 0) {
+        if (fallocate(segment_fd, FALLOC_FL_KEEP_SIZE, 0, expected_bytes) == 0) {
+            preallocated = expected_bytes;
+        } else if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            preallocation_failed = true;
+            async_log(log_facility | LOG_NOTICE, "The file system of %s cannot preallocate the segments", directory.c_str());
+        } else {
+            async_log(log_facility | LOG_WARNING, "Could not preallocate %llu bytes for %s : %m",
+                      (unsigned long long) expected_bytes, path.c_str());
+        }
+    }
+    return true;
+}
+
+
+void Segment_recorder::close()
+{
+    if (segment_fd == -1) {
+        return;
+    }
+
+    // The preallocated blocks past the last frame are given back.
+    string path = directory + current.file;
+    if (preallocated > current.bytes && ftruncate(segment_fd, current.bytes) == -1) {
+        async_log(log_facility | LOG_WARNING, "Could not trim %s : %m", path.c_str());
+    }
+    ::close(segment_fd);
+    segment_fd = -1;
+
+    if (current.frames == 0) {
+        unlink(path.c_str());
+        return;
+    }
+
+    segments.push_back(current);
+    stored_bytes += current.bytes;
+
+    // The index is only ever appended to here, the whole of it is written again when segments are deleted.
+    string index_path = directory + SEGMENT_INDEX_FILE;
+    int fd = ::open(index_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    bool appended = false;
+    if (fd != -1) {
+        struct stat file_status;
+        appended = fstat(fd, &file_status) == 0 && (size_t) file_status.st_size >= sizeof(Store_header)
+                   && (file_status.st_size - sizeof(Store_header)) % sizeof(Segment_entry) == 0
+                   && write_all(fd, &current, sizeof(current));
+        ::close(fd);
+    }
+    if (!appended) {
+        write_index();
+    }
+}
+
+
+void Segment_recorder::write(const Captured_frame& frame, const Camera_config& config)
+{
+    int64_t capture_time_us = frame.capture_time_us();
+    if (directory.empty() || capture_time_us < retry_time_us) {
+        return;
+    }
+
+    int64_t segment_us = (int64_t) config.segment_seconds * 1000000;
+    if (segment_fd != -1 && capture_time_us - current.start_us >= segment_us) {
+        close();
+    }
+
+    Shared_jpeg jpeg = frame.jpeg(config.segment_jpeg_quality);
+    if (jpeg == nullptr) {
+        async_log(log_facility | LOG_ERR, "Error: Could not encode a frame of camera %d for its segment", camera);
+        return;
+    }
+    const std::vector<uchar>& jpeg_bytes = jpeg->bytes;
+
+    uint64_t quota = (uint64_t) config.segment_quota_mb * 1024 * 1024;
+    if (segment_fd == -1) {
+        // A segment is expected to be as big as the last one, scaled to its length.
+        uint64_t expected = jpeg_bytes.size() * SEGMENT_ESTIMATED_FPS * (uint64_t) config.segment_seconds;
+        if (!segments.empty()) {
+            const Segment_entry& last = segments.back();
+            int64_t last_us = last.end_us - last.start_us;
+            if (last.frames > 1 && last_us > 0) {
+                expected = (uint64_t) ((double) last.bytes * segment_us / last_us);
+            }
+        }
+        if (!start_segment(capture_time_us, expected + expected / 8, quota)) {
+            post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, camera, current.file);
+            retry_time_us = capture_time_us + SEGMENT_RETRY_US;
+            return;
+        }
+    }
+
+    if (!write_all(segment_fd, jpeg_bytes.data(), jpeg_bytes.size())) {
+        async_log(log_facility | LOG_ERR, "Error: Could not write to the segment %s%s : %m", directory.c_str(), current.file);
+        post_error(ERROR_VIDEO_SAVE_FAILED, SOURCE_DAEMON, camera, current.file);
+        close();
+        retry_time_us = capture_time_us + SEGMENT_RETRY_US;
+        return;
+    }
+    current.bytes += jpeg_bytes.size();
+    current.end_us = capture_time_us;
+    ++current.frames;
+
+    // The segment grew past what was made room for, the oldest segments go now rather than at the next one.
+    // A segment that does not fit into the quota by itself is ended early.
+    if (stored_bytes + current.bytes > quota) {
+        evict(current.bytes, quota);
+        if (current.bytes >= quota) {
+            close();
+        }
+    }
+}
+
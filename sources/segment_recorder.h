@@ -0,0 +1,129 @@
+/**
+ * File Name:   segment_recorder.h
+ *
+ * Description:
+ * This file contains the declaration of the Segment_recorder class, the continuous recording of a camera.
+ * While the segment_recording setting is on, every captured frame is written, whether anything was detected
+ * or not, into segments of segment_seconds each, in $HOME/SmartCCTV_recordings/cameraN/segments/.
+ *
+ * The segments of a camera never take up more than segment_quota_mb: before a segment is started, and
+ * whenever the current one grows past the quota, the oldest segments are deleted.
+ * Every segment is preallocated with fallocate() at the size it is expected to reach, so a file that is
+ * written a frame at a time is not spread all over the disk, and it is trimmed to its real size when it ends.
+ *
+ * A segment is a plain sequence of JPEG frames (a raw MJPEG stream), which media players open as is:
+ *     ffplay -f mjpeg 2026-10-19_14-03-00.000.mjpeg
+ *
+ * The segments of a camera are listed in segments.index, see segment_index.h.
+ */
+
+#ifndef SEGMENT_RECORDER_H
+#define SEGMENT_RECORDER_H
+
+#include "segment_index.h"
+#include "camera_config.h"
+#include "captured_frame.h"
+
+#include <cstdint>           /* for std::uint32_t, std::uint64_t, std::int64_t */
+#include <deque>             /* for std::deque */
+#include <string>            /* for std::string */
+#include <vector>            /* for std::vector */
+
+// The frame rate the size of the first segment is estimated with, before there is a segment to go by.
+#define SEGMENT_ESTIMATED_FPS 15
+// How long to wait before starting a segment again, after one could not be written.
+#define SEGMENT_RETRY_US 5000000
+
+
+class Segment_recorder {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * Nothing is recorded until open() is called.
+     */
+    Segment_recorder();
+
+    /**
+     * The destructor calls Segment_recorder::close().
+     */
+    ~Segment_recorder();
+
+    /**
+     * This function creates the directory of the segments, if it is not there yet, and reads its index.
+     * A segment that is not in the index, because the daemon was killed while writing it, is added to it.
+     *
+     * @param const std::string& directory - The directory of the segments, ending in '/'.
+     *
+     * @param int camera - The camera number, -1 for a video file.
+     *
+     * @return bool - true  if segments can be recorded.
+     *                false if the directory could not be created, the reason is written to the syslog.
+     */
+    bool open(const std::string& directory, int camera);
+
+    /**
+     * This function adds a frame to the current segment. It starts a new segment when there is none yet,
+     * or the current one is segment_seconds long, and deletes the oldest segments to stay within the quota.
+     *
+     * @param const Captured_frame& frame - The captured frame. Its JPEG of segment_jpeg_quality is shared with
+     *                                      the MJPEG stream and the snapshots.
+     *
+     * @param const Camera_config& config - The settings of the segments.
+     */
+    void write(const Captured_frame& frame, const Camera_config& config);
+
+    /**
+     * This function ends the current segment, if there is one, and adds it to the index.
+     */
+    void close();
+
+  private:
+    /**
+     * This function creates a new segment file and preallocates it.
+     *
+     * @param std::int64_t capture_time_us - The capture time of its first frame.
+     *
+     * @param std::uint64_t expected_bytes - The size it is expected to reach.
+     *
+     * @param std::uint64_t quota - The most bytes the segments may take up.
+     *
+     * @return bool - true if the segment is open.
+     */
+    bool start_segment(std::int64_t capture_time_us, std::uint64_t expected_bytes, std::uint64_t quota);
+
+    /**
+     * This function deletes the oldest segments until the ones left, and the given number of bytes, fit in the quota.
+     *
+     * @param std::uint64_t needed - The bytes that are about to be written.
+     *
+     * @param std::uint64_t quota - The most bytes the segments may take up.
+     */
+    void evict(std::uint64_t needed, std::uint64_t quota);
+
+    /**
+     * This function writes the index of the segments again, in place of the old one.
+     *
+     * @return bool - true if the index was written.
+     */
+    bool write_index();
+
+    /**
+     * This function adds the segments the index does not know about, and drops the ones whose file is gone.
+     *
+     * @return bool - true if the index changed.
+     */
+    bool recover();
+
+    std::string directory;                // The directory of the segments, empty until open() is called.
+    int camera;                           // The camera number, -1 for a video file.
+    std::deque<Segment_entry> segments;   // The finished segments, oldest first.
+    std::uint64_t stored_bytes;           // The size of all the finished segments.
+    int segment_fd;                       // The current segment, -1 if there is none.
+    Segment_entry current;                // The current segment.
+    std::uint64_t preallocated;           // How much of the current segment was preallocated.
+    bool preallocation_failed;            // fallocate() is not supported by the file system.
+    std::int64_t retry_time_us;           // No segment is started before this time, after one failed.
+};
+
+
+#endif  /* SEGMENT_RECORDER_H */
@@ -0,0 +1,51 @@
+/**
+ * File Name:   signal_free_thread.h
+ *
+ * Description:
+ * This file contains start_signal_free_thread(), which starts the background threads of the camera daemon.
+ *
+ * The signal handlers of the daemon only set a flag, which the capture loop of a camera checks between two
+ * frames, and the kernel delivers a process-directed signal to any thread that does not block it. The
+ * background threads (the MJPEG server, the control socket, the log flushing thread and the workers of a
+ * Thread_pool) block every signal, so the signals are always delivered to the threads that check for them,
+ * and never interrupt a poll() or a write() half way through. A new thread inherits the signal mask of the
+ * thread that creates it, so the mask is blocked just while the thread is created.
+ */
+
+#ifndef SIGNAL_FREE_THREAD_H
+#define SIGNAL_FREE_THREAD_H
+
+#include <signal.h>  /* for sigset_t, sigfillset(), pthread_sigmask() */
+#include <thread>    /* for std::thread */
+#include <utility>   /* for std::forward() */
+
+
+/**
+ * This function starts a thread that blocks every signal.
+ * The signal mask of the calling thread is left as it was, also when the thread cannot be started.
+ *
+ * @param Function&& function, Arguments&&... arguments - What the thread runs, as for the std::thread constructor.
+ *
+ * @return std::thread - The thread, which the caller joins or detaches.
+ *
+ * @throw std::system_error - If the thread could not be started.
+ */
+template <typename Function, typename... Arguments>
+std::thread start_signal_free_thread(Function&& function, Arguments&&... arguments)
+{
+    sigset_t all_signals;
+    sigset_t old_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+    try {
+        std::thread thread(std::forward<Function>(function), std::forward<Arguments>(arguments)...);
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+        return thread;
+    } catch (...) {
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+        throw;
+    }
+}
+
+
+#endif  /* SIGNAL_FREE_THREAD_H */
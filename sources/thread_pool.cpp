@@ -0,0 +1,153 @@
+/**
+ * File Name:   thread_pool.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Thread_pool class's methods.
+ */
+
+#include "thread_pool.h"
+#include "signal_free_thread.h"
+
+#include <syslog.h>     /* for syslog() */
+#include <chrono>       /* for std::chrono */
+#include <exception>    /* for std::exception */
+#include <system_error> /* for std::system_error */
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// How long a worker sleeps at most before it looks at stopping again.
+#define THREAD_POOL_POLL_MS 100
+
+
+Thread_pool::Thread_pool()
+ : stopping(false), unfinished_tasks(0), running_workers(0)
+{
+    //
+}
+
+
+Thread_pool::~Thread_pool()
+{
+    stop(0);
+}
+
+
+bool Thread_pool::start(int threads)
+{
+    if (!workers.empty()) {
+        return true;
+    }
+    stopping = false;
+
+    for (int i = 0; i < threads || workers.empty(); ++i) {
+        try {
+            ++running_workers;
+            workers.push_back(start_signal_free_thread(&Thread_pool::work, this));
+        } catch (const std::system_error& error) {
+            --running_workers;
+            syslog(log_facility | LOG_ERR, "Error: Could not start a worker thread : %s", error.what());
+            break;
+        }
+    }
+    return !workers.empty();
+}
+
+
+bool Thread_pool::submit(std::function<void()> task)
+{
+    if (workers.empty() || stopping) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        ++unfinished_tasks;
+    }
+    wake.notify_one();
+    return true;
+}
+
+
+bool Thread_pool::wait_idle(int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (unfinished_tasks > 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+
+void Thread_pool::stop(int timeout_ms)
+{
+    if (workers.empty()) {
+        return;
+    }
+
+    wait_idle(timeout_ms);
+    stopping = true;
+    wake.notify_all();
+
+    // The idle workers exit right away, only a worker stuck in a task keeps running.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2 * THREAD_POOL_POLL_MS);
+    while (running_workers > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    bool exited = running_workers == 0;
+    for (std::thread& worker : workers) {
+        if (exited) {
+            worker.join();
+        } else {
+            // The process is exiting, the task gets as long as the process lives.
+            worker.detach();
+        }
+    }
+    if (!exited) {
+        syslog(log_facility | LOG_WARNING, "%zu tasks were still running when the thread pool stopped", (size_t) unfinished_tasks);
+    }
+    workers.clear();
+}
+
+
+size_t Thread_pool::unfinished() const
+{
+    return unfinished_tasks;
+}
+
+
+size_t Thread_pool::size() const
+{
+    return workers.size();
+}
+
+
+void Thread_pool::work()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // stop() does not lock the mutex, so its notify can be missed, the timeout catches that.
+            while (tasks.empty() && !stopping) {
+                wake.wait_for(lock, std::chrono::milliseconds(THREAD_POOL_POLL_MS));
+            }
+            if (tasks.empty()) {
+                break;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        // A task that throws is written to the syslog, rather than taking the whole daemon down with it.
+        try {
+            task();
+        } catch (const std::exception& error) {
+            syslog(log_facility | LOG_ERR, "Error: A task of the thread pool failed : %s", error.what());
+        }
+        --unfinished_tasks;
+    }
+    --running_workers;
+}
@@ -0,0 +1,101 @@
+/**
+ * File Name:   thread_pool.h
+ *
+ * Description:
+ * This file contains the declaration of the Thread_pool class, a fixed number of worker threads that run
+ * tasks in the order they were submitted, for the work the camera daemon does not want on its capture thread.
+ *
+ * The worker threads block every signal, so the signal handlers of the daemon always run on its own threads.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>              /* for std::atomic */
+#include <condition_variable>  /* for std::condition_variable */
+#include <cstddef>             /* for std::size_t */
+#include <deque>               /* for std::deque */
+#include <functional>          /* for std::function */
+#include <mutex>               /* for std::mutex */
+#include <thread>              /* for std::thread */
+#include <vector>              /* for std::vector */
+
+
+class Thread_pool {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * No tasks are run until start() is called.
+     */
+    Thread_pool();
+
+    /**
+     * The destructor calls Thread_pool::stop(), without waiting for the tasks that are left.
+     */
+    ~Thread_pool();
+
+    /**
+     * This function starts the worker threads.
+     *
+     * @param int threads - How many worker threads to start, at least 1.
+     *
+     * @return bool - true  if the threads are running.
+     *                false if no thread could be started, the reason is written to the syslog.
+     */
+    bool start(int threads);
+
+    /**
+     * This function queues a task, which the first worker thread that is free runs.
+     *
+     * @param std::function<void()> task - The task.
+     *
+     * @return bool - false if the pool is not running, the task is then not run.
+     */
+    bool submit(std::function<void()> task);
+
+    /**
+     * This function waits until every task that was submitted has finished.
+     * It must not be called from a signal handler: the tasks are submitted under a lock, which a signal handler
+     * that interrupted submit() would wait for forever.
+     *
+     * @param int timeout_ms - The longest to wait.
+     *
+     * @return bool - true if every task has finished, false if the time ran out.
+     */
+    bool wait_idle(int timeout_ms);
+
+    /**
+     * This function waits for the tasks that were submitted, up to a time limit, and then stops the worker threads.
+     * A worker that is still running a task when the time runs out is left to finish it on its own.
+     *
+     * @param int timeout_ms - The longest to wait for the tasks.
+     */
+    void stop(int timeout_ms);
+
+    /**
+     * @return std::size_t - The number of tasks that were submitted and have not finished yet.
+     */
+    std::size_t unfinished() const;
+
+    /**
+     * @return std::size_t - The number of worker threads.
+     */
+    std::size_t size() const;
+
+  private:
+    /**
+     * This function is the body of every worker thread.
+     */
+    void work();
+
+    std::mutex mutex;                               // Guards tasks.
+    std::condition_variable wake;                   // Wakes up a worker when a task is queued, or the pool stops.
+    std::deque<std::function<void()>> tasks;        // The tasks that no worker has picked up yet.
+    std::vector<std::thread> workers;               // The worker threads.
+    std::atomic<bool> stopping;                     // Are the workers supposed to exit?
+    std::atomic<std::size_t> unfinished_tasks;      // The tasks queued or running.
+    std::atomic<std::size_t> running_workers;       // The workers that have not exited yet.
+};
+
+
+#endif  /* THREAD_POOL_H */
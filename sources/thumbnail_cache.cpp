@@ -0,0 +1,390 @@
+/**
+ * File Name:   thumbnail_cache.cpp
+ *
+ * Description:
+ * This file contains the implementation of the Thumbnail_cache class's methods, and of the functions that
+ * list the videos of the detections and make their thumbnails.
+ */
+
+#include "thumbnail_cache.h"
+
+#include <opencv2/core.hpp>       /* for cv::Mat, cv::Size */
+#include <opencv2/imgcodecs.hpp>  /* for cv::imencode() */
+#include <opencv2/imgproc.hpp>    /* for cv::resize() */
+#include <opencv2/videoio.hpp>    /* for cv::VideoCapture */
+#include <sys/types.h>
+#include <sys/stat.h>       /* for stat(), fstat(), mode permissions constants */
+#include <sys/mman.h>       /* for mmap(), munmap() */
+#include <sys/resource.h>   /* for setpriority() */
+#include <sys/syscall.h>    /* for SYS_ioprio_set, SYS_gettid */
+#include <dirent.h>         /* for opendir(), readdir(), closedir() */
+#include <fcntl.h>          /* for open(), O_* constants */
+#include <unistd.h>         /* for syscall(), write(), close(), unlink() */
+#include <syslog.h>         /* for syslog() */
+#include <errno.h>          /* for errno */
+#include <algorithm>        /* for std::sort(), std::lower_bound(), std::min() */
+#include <chrono>           /* for std::chrono::steady_clock */
+#include <cstdio>           /* for sscanf(), rename() */
+#include <cstring>          /* for memcmp(), memcpy(), memset(), strcmp(), strncmp(), strncpy() */
+#include <unordered_set>    /* for std::unordered_set */
+
+using std::string;
+using std::vector;
+using std::size_t;
+using std::int64_t;
+
+// You can change this to make the syslog() output to a different file.
+#define log_facility LOG_LOCAL0
+
+// The I/O priority classes of ioprio_set(), which glibc has no header for.
+#define THUMBNAIL_IOPRIO_WHO_PROCESS 1
+#define THUMBNAIL_IOPRIO_CLASS_IDLE 3
+#define THUMBNAIL_IOPRIO_CLASS_SHIFT 13
+
+static const char thumbnail_magic[8] = { 'S', 'C', 'C', 'T', 'V', 'T', 'H', '1' };
+
+
+/**
+ * A thumbnail that was just made, and is not in the thumbnail file yet.
+ */
+struct New_thumbnail {
+    Thumbnail_entry entry;
+    vector<unsigned char> jpeg;
+};
+
+
+Thumbnail_cache::Thumbnail_cache()
+ : data(nullptr), data_size(0), entries(nullptr), count(0)
+{
+    //
+}
+
+
+Thumbnail_cache::~Thumbnail_cache()
+{
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), data_size);
+    }
+}
+
+
+bool Thumbnail_cache::load(const string& path)
+{
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), data_size);
+    }
+    data = nullptr;
+    data_size = 0;
+    entries = nullptr;
+    count = 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat file_status;
+    if (fstat(fd, &file_status) == -1 || (size_t) file_status.st_size < sizeof(Store_header)) {
+        close(fd);
+        return false;
+    }
+    size_t size = file_status.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        syslog(log_facility | LOG_ERR, "Error: Could not map %s : %m", path.c_str());
+        return false;
+    }
+
+    const Store_header* header = static_cast<const Store_header*>(mapped);
+    if (memcmp(header->magic, thumbnail_magic, sizeof(header->magic)) != 0 || header->item_size != sizeof(Thumbnail_entry)
+        || sizeof(Store_header) + (size_t) header->reserved * sizeof(Thumbnail_entry) > size) {
+        syslog(log_facility | LOG_ERR, "Error: %s is not a thumbnail file", path.c_str());
+        munmap(mapped, size);
+        return false;
+    }
+
+    data = static_cast<const char*>(mapped);
+    data_size = size;
+    entries = reinterpret_cast<const Thumbnail_entry*>(data + sizeof(Store_header));
+    count = header->reserved;
+    return true;
+}
+
+
+int Thumbnail_cache::find(const Recording& recording) const
+{
+    auto earlier = [](const Thumbnail_entry& entry, const string& clip) {
+        return strncmp(entry.clip, clip.c_str(), sizeof(entry.clip)) < 0;
+    };
+    const Thumbnail_entry* found = std::lower_bound(entries, entries + count, recording.clip, earlier);
+    if (found == entries + count || strncmp(found->clip, recording.clip.c_str(), sizeof(found->clip)) != 0
+        || found->modified_us != recording.modified_us || found->bytes != recording.bytes
+        || found->offset + found->size > data_size) {
+        return -1;
+    }
+    return found - entries;
+}
+
+
+size_t Thumbnail_cache::size() const
+{
+    return count;
+}
+
+
+const Thumbnail_entry& Thumbnail_cache::entry(size_t index) const
+{
+    return entries[index];
+}
+
+
+const unsigned char* Thumbnail_cache::jpeg(size_t index) const
+{
+    return reinterpret_cast<const unsigned char*>(data + entries[index].offset);
+}
+
+
+/**
+ * This helper function lists the videos in the directory of a camera.
+ *
+ * @param const string& recordings_directory - The recordings directory, ending in '/'.
+ *
+ * @param const string& camera_name - The directory of the camera, as "cameraN", or DETECTION_FILE_CAMERA_DIR.
+ *
+ * @param int camera - The camera number, -1 for a video file.
+ *
+ * @param vector<Recording>& recordings - The videos are appended here.
+ */
+static void list_camera_recordings(const string& recordings_directory, const string& camera_name, int camera,
+                                   vector<Recording>& recordings)
+{
+    string directory = recordings_directory + camera_name + "/";
+    DIR* listing = opendir(directory.c_str());
+    if (listing == nullptr) {
+        return;
+    }
+    while (struct dirent* file = readdir(listing)) {
+        string name = file->d_name;
+        // The files that are being written start with a '.', and are renamed once they are whole.
+        if (name[0] == '.' || name.size() < 4) {
+            continue;
+        }
+        string extension = name.substr(name.size() - 4);
+        if (extension != ".avi" && extension != ".mp4") {
+            continue;
+        }
+        struct stat file_status;
+        if (stat((directory + name).c_str(), &file_status) == -1 || !S_ISREG(file_status.st_mode)) {
+            continue;
+        }
+        Recording recording;
+        recording.clip = camera_name + "/" + name;
+        recording.camera = camera;
+        recording.modified_us = (int64_t) file_status.st_mtim.tv_sec * 1000000 + file_status.st_mtim.tv_nsec / 1000;
+        recording.bytes = file_status.st_size;
+        recordings.push_back(std::move(recording));
+    }
+    closedir(listing);
+}
+
+
+Recordings_scan scan_recordings(const string& recordings_directory)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Recordings_scan scan;
+    DIR* listing = opendir(recordings_directory.c_str());
+    if (listing != nullptr) {
+        while (struct dirent* directory = readdir(listing)) {
+            int camera;
+            char rest;
+            if (sscanf(directory->d_name, "camera%d%c", &camera, &rest) == 1) {
+                list_camera_recordings(recordings_directory, directory->d_name, camera, scan.recordings);
+            } else if (strcmp(directory->d_name, DETECTION_FILE_CAMERA_DIR) == 0) {
+                list_camera_recordings(recordings_directory, directory->d_name, -1, scan.recordings);
+            }
+        }
+        closedir(listing);
+    }
+    std::sort(scan.recordings.begin(), scan.recordings.end(),
+              [](const Recording& first, const Recording& second) { return first.modified_us > second.modified_us; });
+
+    auto thumbnails = std::make_shared<Thumbnail_cache>();
+    thumbnails->load(recordings_directory + THUMBNAIL_FILE);
+    scan.missing = 0;
+    for (const Recording& recording : scan.recordings) {
+        if (thumbnails->find(recording) == -1) {
+            ++scan.missing;
+        }
+    }
+    scan.thumbnails = thumbnails;
+
+    auto duration = std::chrono::steady_clock::now() - start;
+    scan.scan_us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return scan;
+}
+
+
+bool make_thumbnail(const string& path, vector<unsigned char>& jpeg, int& width, int& height)
+{
+    cv::VideoCapture video(path);
+    cv::Mat frame;
+    if (!video.isOpened() || !video.read(frame) || frame.empty()) {
+        return false;
+    }
+
+    double scale = std::min((double) THUMBNAIL_WIDTH / frame.cols, (double) THUMBNAIL_HEIGHT / frame.rows);
+    width = std::max(1, (int) (frame.cols * scale + 0.5));
+    height = std::max(1, (int) (frame.rows * scale + 0.5));
+    cv::Mat thumbnail;
+    cv::resize(frame, thumbnail, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    std::vector<int> parameters = { cv::IMWRITE_JPEG_QUALITY, THUMBNAIL_JPEG_QUALITY };
+    return cv::imencode(".jpg", thumbnail, jpeg, parameters);
+}
+
+
+/**
+ * This helper function writes the thumbnail file, in place of the one there was.
+ *
+ * @param const string& path - The thumbnail file.
+ *
+ * @param const Thumbnail_cache& old - The thumbnail file as it is, its entries of the videos that are still
+ *                                     in recordings are kept.
+ *
+ * @param const vector<New_thumbnail>& made - The thumbnails that were made since.
+ *
+ * @param const vector<Recording>& recordings - The videos.
+ *
+ * @return bool - true if the file was written, otherwise the reason is written to the syslog.
+ */
+static bool write_thumbnail_file(const string& path, const Thumbnail_cache& old, const vector<New_thumbnail>& made,
+                                 const vector<Recording>& recordings)
+{
+    /**
+     * A thumbnail that goes into the file, and where its JPEG comes from.
+     */
+    struct Written {
+        Thumbnail_entry entry;
+        const unsigned char* jpeg;
+    };
+
+    std::unordered_set<string> made_clips;
+    vector<Written> written;
+    for (const New_thumbnail& thumbnail : made) {
+        made_clips.insert(thumbnail.entry.clip);
+        written.push_back({ thumbnail.entry, thumbnail.jpeg.data() });
+    }
+    for (const Recording& recording : recordings) {
+        int index = old.find(recording);
+        if (index != -1 && made_clips.count(recording.clip) == 0) {
+            written.push_back({ old.entry(index), old.jpeg(index) });
+        }
+    }
+    std::sort(written.begin(), written.end(),
+              [](const Written& first, const Written& second) { return strncmp(first.entry.clip, second.entry.clip, sizeof(first.entry.clip)) < 0; });
+
+    Store_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, thumbnail_magic, sizeof(header.magic));
+    header.item_size = sizeof(Thumbnail_entry);
+    header.reserved = written.size();
+
+    vector<char> contents(sizeof(header) + written.size() * sizeof(Thumbnail_entry));
+    memcpy(contents.data(), &header, sizeof(header));
+    for (size_t i = 0; i < written.size(); ++i) {
+        Thumbnail_entry& entry = written[i].entry;
+        entry.offset = contents.size();
+        contents.insert(contents.end(), written[i].jpeg, written[i].jpeg + entry.size);
+        memcpy(contents.data() + sizeof(header) + i * sizeof(Thumbnail_entry), &entry, sizeof(entry));
+    }
+
+    // Written under a hidden name and renamed into place, the browser may have the old file mapped.
+    string::size_type slash = path.rfind('/');
+    string temporary_path = path.substr(0, slash + 1) + "." + path.substr(slash + 1);
+    int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not create %s : %m", temporary_path.c_str());
+        return false;
+    }
+    const char* bytes = contents.data();
+    size_t remaining = contents.size();
+    while (remaining > 0) {
+        ssize_t written_bytes = write(fd, bytes, remaining);
+        if (written_bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        bytes += written_bytes;
+        remaining -= written_bytes;
+    }
+    bool ok = (close(fd) == 0) && remaining == 0;
+    if (!ok || rename(temporary_path.c_str(), path.c_str()) == -1) {
+        syslog(log_facility | LOG_ERR, "Error: Could not write %s : %m", path.c_str());
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+int update_thumbnails(const string& recordings_directory, const vector<Recording>& recordings, const std::atomic<bool>* cancel)
+{
+    // The thumbnails only get the CPU and the disk when nothing else wants them, the recordings come first.
+    pid_t thread = syscall(SYS_gettid);
+    if (syscall(SYS_ioprio_set, THUMBNAIL_IOPRIO_WHO_PROCESS, thread, THUMBNAIL_IOPRIO_CLASS_IDLE << THUMBNAIL_IOPRIO_CLASS_SHIFT) == -1) {
+        syslog(log_facility | LOG_WARNING, "Could not lower the I/O priority of the thumbnails : %m");
+    }
+    setpriority(PRIO_PROCESS, thread, 19);
+
+    string path = recordings_directory + THUMBNAIL_FILE;
+    Thumbnail_cache thumbnails;
+    thumbnails.load(path);
+
+    int made_total = 0;
+    vector<New_thumbnail> made;
+    for (const Recording& recording : recordings) {
+        if (cancel->load()) {
+            break;
+        }
+        if (thumbnails.find(recording) != -1) {
+            continue;
+        }
+
+        // A video that cannot be decoded gets an empty thumbnail, so it is not tried again until it changes.
+        New_thumbnail thumbnail;
+        memset(&thumbnail.entry, 0, sizeof(thumbnail.entry));
+        int width = 0;
+        int height = 0;
+        if (make_thumbnail(recordings_directory + recording.clip, thumbnail.jpeg, width, height)) {
+            thumbnail.entry.size = thumbnail.jpeg.size();
+            thumbnail.entry.width = width;
+            thumbnail.entry.height = height;
+            ++made_total;
+        } else {
+            thumbnail.jpeg.clear();
+        }
+        thumbnail.entry.modified_us = recording.modified_us;
+        thumbnail.entry.bytes = recording.bytes;
+        strncpy(thumbnail.entry.clip, recording.clip.c_str(), sizeof(thumbnail.entry.clip) - 1);
+        made.push_back(std::move(thumbnail));
+
+        if (made.size() >= THUMBNAIL_SAVE_INTERVAL) {
+            if (write_thumbnail_file(path, thumbnails, made, recordings)) {
+                thumbnails.load(path);
+            }
+            made.clear();
+        }
+    }
+
+    // The file is also written when nothing was made, to drop the thumbnails of the videos that were removed.
+    size_t current = 0;
+    for (const Recording& recording : recordings) {
+        current += thumbnails.find(recording) != -1 ? 1 : 0;
+    }
+    if (!made.empty() || current < thumbnails.size()) {
+        write_thumbnail_file(path, thumbnails, made, recordings);
+    }
+    return made_total;
+}
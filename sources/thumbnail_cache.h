@@ -0,0 +1,188 @@
+/**
+ * File Name:   thumbnail_cache.h
+ *
+ * Description:
+ * This file contains the declarations of the recordings browser's data: the list of the videos of the
+ * detections in $HOME/SmartCCTV_recordings/cameraN/, and the cache of their thumbnails.
+ *
+ * The thumbnails of all the videos are kept in a single file, $HOME/SmartCCTV_recordings/THUMBNAIL_FILE:
+ *     Store_header         (see detection_store.h) with the magic "SCCTVTH1", and the number of entries in reserved.
+ *     Thumbnail_entry      one per video, sorted by the name of the video, which is the index of the file.
+ *     The JPEGs of the thumbnails, one after the other, where their entries say.
+ * Opening the browser maps the file and reads only the index, a thumbnail is decoded when it is shown,
+ * so the list of thousands of videos comes up as fast as their directories can be listed.
+ *
+ * A thumbnail is the first frame of its video, which is always a keyframe, so making one decodes a single
+ * frame. They are made by update_thumbnails() in a background thread at idle CPU and I/O priority.
+ * An entry whose video was changed or removed is made again or dropped the next time the file is written.
+ *
+ * Nothing here uses Qt, so it can run in a background thread of the GUI.
+ */
+
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include "detection_store.h"
+
+#include <atomic>   /* for std::atomic */
+#include <cstddef>  /* for std::size_t */
+#include <cstdint>  /* for std::uint16_t, std::uint32_t, std::uint64_t, std::int64_t */
+#include <memory>   /* for std::shared_ptr */
+#include <string>   /* for std::string */
+#include <vector>   /* for std::vector */
+
+// The recordings directory, under the home directory.
+#define RECORDINGS_DIR "/SmartCCTV_recordings/"
+// The file of the thumbnails, in the recordings directory.
+#define THUMBNAIL_FILE "thumbnails.pack"
+// The size of a thumbnail, a frame of another shape is fit inside of it.
+#define THUMBNAIL_WIDTH 160
+#define THUMBNAIL_HEIGHT 90
+// The JPEG quality of the thumbnails.
+#define THUMBNAIL_JPEG_QUALITY 75
+// How many new thumbnails are made before the file is written, so the browser can show them.
+#define THUMBNAIL_SAVE_INTERVAL 32
+
+
+/**
+ * A video of a detection.
+ */
+struct Recording {
+    std::string clip;            // The video, relative to the recordings directory, as "cameraN/name".
+    int camera;                  // The camera number, -1 for a video file.
+    std::int64_t modified_us;    // When the video was last written, in microseconds since the epoch.
+    std::int64_t bytes;          // The size of the video.
+};
+
+
+/**
+ * The index entry of a thumbnail in the thumbnail file.
+ */
+struct Thumbnail_entry {
+    std::uint64_t offset;        // Where the JPEG starts in the file.
+    std::uint32_t size;          // The size of the JPEG, 0 if the video could not be decoded.
+    std::uint16_t width;         // The size of the thumbnail.
+    std::uint16_t height;
+    std::int64_t modified_us;    // Recording::modified_us of the video it was made from.
+    std::int64_t bytes;          // Recording::bytes of the video it was made from.
+    char clip[96];               // Recording::clip of the video it was made from, '\0' terminated.
+};
+
+static_assert(sizeof(Thumbnail_entry) == 128, "The thumbnail file is read and written as is");
+
+
+class Thumbnail_cache {
+  public:
+    /**
+     * The constructor initializes all the private variables to their initial values.
+     * The cache is empty until load() is called.
+     */
+    Thumbnail_cache();
+
+    /**
+     * The destructor unmaps the thumbnail file.
+     */
+    ~Thumbnail_cache();
+
+    Thumbnail_cache(const Thumbnail_cache&) = delete;
+    Thumbnail_cache& operator=(const Thumbnail_cache&) = delete;
+
+    /**
+     * This function maps a thumbnail file, in place of the one mapped before.
+     *
+     * @param const std::string& path - The file.
+     *
+     * @return bool - false if there is no such file, or it is not a thumbnail file. The cache is then empty.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * This function finds the entry of a video.
+     *
+     * @param const Recording& recording - The video.
+     *
+     * @return int - The index of its entry, or -1 if there is none, or it was made from an older version of the video.
+     */
+    int find(const Recording& recording) const;
+
+    /**
+     * @return std::size_t - The number of entries.
+     */
+    std::size_t size() const;
+
+    /**
+     * @param std::size_t index - The index of an entry, less than size().
+     *
+     * @return const Thumbnail_entry& - The entry.
+     */
+    const Thumbnail_entry& entry(std::size_t index) const;
+
+    /**
+     * @param std::size_t index - The index of an entry, less than size().
+     *
+     * @return const unsigned char* - The JPEG of the entry, entry(index).size bytes long, in the mapped file.
+     */
+    const unsigned char* jpeg(std::size_t index) const;
+
+  private:
+    const char* data;                 // The mapped file, nullptr if none is mapped.
+    std::size_t data_size;            // The size of the file.
+    const Thumbnail_entry* entries;   // The index, in the mapped file.
+    std::size_t count;                // The number of entries.
+};
+
+
+/**
+ * The recordings listed by scan_recordings().
+ */
+struct Recordings_scan {
+    std::vector<Recording> recordings;                 // The videos, newest first.
+    std::shared_ptr<const Thumbnail_cache> thumbnails; // The thumbnail file, as it was when they were listed.
+    std::size_t missing;                               // How many of the videos have no thumbnail yet.
+    std::int64_t scan_us;                              // How long listing them and loading the index took.
+};
+
+
+/**
+ * This function lists the videos of the detections of every camera, and maps the thumbnail file.
+ *
+ * @param const std::string& recordings_directory - The recordings directory, ending in '/'.
+ *
+ * @return Recordings_scan - The videos and their thumbnails.
+ */
+Recordings_scan scan_recordings(const std::string& recordings_directory);
+
+
+/**
+ * This function makes the thumbnail of a video from its first frame.
+ *
+ * @param const std::string& path - The video.
+ *
+ * @param std::vector<unsigned char>& jpeg - Set to the thumbnail, as a JPEG.
+ *
+ * @param int& width, height - Set to the size of the thumbnail.
+ *
+ * @return bool - false if the video could not be decoded.
+ */
+bool make_thumbnail(const std::string& path, std::vector<unsigned char>& jpeg, int& width, int& height);
+
+
+/**
+ * This function makes the thumbnails that are missing from the thumbnail file, and drops those of the videos
+ * that are gone. It lowers the CPU and I/O priority of the thread that calls it to idle, so it must only be
+ * called from a thread that does nothing else. The file is written every THUMBNAIL_SAVE_INTERVAL thumbnails.
+ *
+ * @param const std::string& recordings_directory - The recordings directory, ending in '/'.
+ *
+ * @param const std::vector<Recording>& recordings - The videos, as listed by scan_recordings(),
+ *                                                   the thumbnails are made in this order.
+ *
+ * @param const std::atomic<bool>* cancel - Stops making the thumbnails when it is set, what was made is still written.
+ *
+ * @return int - How many thumbnails were made.
+ */
+int update_thumbnails(const std::string& recordings_directory, const std::vector<Recording>& recordings,
+                      const std::atomic<bool>* cancel);
+
+
+#endif  /* THUMBNAIL_CACHE_H */
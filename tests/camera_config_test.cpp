@@ -0,0 +1,147 @@
+/**
+ * File Name:   camera_config_test.cpp
+ *
+ * Description:
+ * This file contains the tests of the settings of the camera daemon that are changed by name, as they are
+ * over the control socket: which values are taken, which are refused, and that a refused value leaves the
+ * setting as it was.
+ */
+
+#include "../sources/camera_config.h"
+#include "test_check.h"
+
+#include <memory>  /* for std::make_shared() */
+#include <string>  /* for std::string */
+#include <vector>  /* for std::vector */
+
+using std::string;
+using std::vector;
+
+
+/**
+ * This helper function sets a value that has to be refused, and checks that the setting did not change.
+ *
+ * @return std::string - The reason it was refused.
+ */
+static string refuse(const string& key, const string& value)
+{
+    Camera_config config;
+    string before;
+    string after;
+    string error;
+    CHECK(get_camera_config_value(config, key, before));
+    CHECK(!set_camera_config_value(config, key, value, error));
+    CHECK(!error.empty());
+    CHECK(get_camera_config_value(config, key, after));
+    CHECK(before == after);
+    return error;
+}
+
+
+static void test_values_that_are_taken()
+{
+    Camera_config config;
+    string error;
+
+    CHECK(set_camera_config_value(config, "detection_stride", "4", error));
+    CHECK(config.detection_stride == 4);
+    CHECK(set_camera_config_value(config, "detection_stride", "1e3", error));
+    CHECK(config.detection_stride == 1000);
+    CHECK(set_camera_config_value(config, "face_min_neighbors", "0", error));
+    CHECK(config.face_min_neighbors == 0);
+    CHECK(set_camera_config_value(config, "segment_quota_mb", "16777216", error));
+    CHECK(config.segment_quota_mb == 16777216);
+
+    CHECK(set_camera_config_value(config, "hog_threshold", "-2.5", error));
+    CHECK(config.hog_threshold == -2.5);
+    CHECK(set_camera_config_value(config, "hog_scale", "1.01", error));
+    CHECK(config.hog_scale == 1.01);
+    CHECK(set_camera_config_value(config, "motion_min_area", "1e8", error));
+    CHECK(config.motion_min_area == 1e8);
+
+    CHECK(set_camera_config_value(config, "outlines", "0", error));
+    CHECK(!config.enable_outlines);
+    CHECK(set_camera_config_value(config, "outlines", "1", error));
+    CHECK(config.enable_outlines);
+    CHECK(set_camera_config_value(config, "segment_recording", "1.0", error));
+    CHECK(config.segment_recording);
+}
+
+
+static void test_values_that_are_refused()
+{
+    // Not a number, or not only a number.
+    CHECK(refuse("detection_stride", "") == "detection_stride must be a number");
+    CHECK(refuse("detection_stride", "12abc") == "detection_stride must be a number");
+    CHECK(refuse("detection_stride", "12 ") == "detection_stride must be a number");
+    CHECK(refuse("detection_stride", "abc") == "detection_stride must be a number");
+    CHECK(refuse("hog_threshold", "nan") == "hog_threshold must be a number");
+    CHECK(refuse("hog_threshold", "inf") == "hog_threshold must be a number");
+    CHECK(refuse("hog_threshold", "1e999") == "hog_threshold must be a number");
+
+    // Out of range, including numbers far too large for an int.
+    CHECK(refuse("detection_stride", "0") == "detection_stride must be between 1 and 1000");
+    CHECK(refuse("detection_stride", "1001") == "detection_stride must be between 1 and 1000");
+    CHECK(refuse("detection_stride", "1e300") == "detection_stride must be between 1 and 1000");
+    CHECK(refuse("detection_stride", "-1e300") == "detection_stride must be between 1 and 1000");
+    CHECK(refuse("segment_quota_mb", "16777217") == "segment_quota_mb must be between 16 and 1.67772e+07");
+    CHECK(refuse("hog_scale", "1.0") == "hog_scale must be between 1.01 and 2");
+    CHECK(refuse("outlines", "2") == "outlines must be between 0 and 1");
+    CHECK(refuse("outlines", "-1") == "outlines must be between 0 and 1");
+
+    // Whole numbers only, for the whole number and on/off settings.
+    CHECK(refuse("detection_stride", "1.5") == "detection_stride must be a whole number");
+    CHECK(refuse("recording_preset", "7.999") == "recording_preset must be a whole number");
+    CHECK(refuse("outlines", "0.5") == "outlines must be a whole number");
+
+    Camera_config config;
+    string error;
+    CHECK(!set_camera_config_value(config, "no_such_setting", "1", error));
+    CHECK(error == "unknown setting no_such_setting");
+    string value;
+    CHECK(!get_camera_config_value(config, "no_such_setting", value));
+}
+
+
+/**
+ * Every setting reads back as text that it takes again, starting with the defaults, which are in range.
+ */
+static void test_every_setting_reads_back()
+{
+    Camera_config config;
+    vector<string> keys = camera_config_keys();
+    CHECK(keys.size() == 21);
+    for (const string& key : keys) {
+        string value;
+        string error;
+        CHECK(get_camera_config_value(config, key, value));
+        CHECK(set_camera_config_value(config, key, value, error));
+        CHECK(error.empty());
+    }
+}
+
+
+static void test_publish()
+{
+    std::shared_ptr<const Camera_config> first = current_camera_config();
+    CHECK(first != nullptr);
+
+    auto changed = std::make_shared<Camera_config>(*first);
+    string error;
+    CHECK(set_camera_config_value(*changed, "detection_stride", "3", error));
+    publish_camera_config(changed);
+
+    CHECK(current_camera_config()->detection_stride == 3);
+    // The config handed out before keeps its values.
+    CHECK(first->detection_stride == Camera_config().detection_stride);
+}
+
+
+int main()
+{
+    test_values_that_are_taken();
+    test_values_that_are_refused();
+    test_every_setting_reads_back();
+    test_publish();
+    return test_result();
+}
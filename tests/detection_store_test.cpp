@@ -0,0 +1,349 @@
+/**
+ * File Name:   detection_store_test.cpp
+ *
+ * Description:
+ * This file contains the tests of the detection store: a store whose last record was cut short, the days
+ * on which the clocks change, the rollups of the hour that is repeated when the clocks are set back, and
+ * the cells of the grid at the edges of the frame.
+ *
+ * The tests run in the time zone of Los Angeles, which sets the clocks forward on the second Sunday of
+ * March and back on the first Sunday of November, and write the store into a new directory under /tmp.
+ */
+
+#include "../sources/detection_store.h"
+#include "test_check.h"
+
+#include <sys/stat.h>   /* for stat() */
+#include <dirent.h>     /* for opendir(), readdir(), closedir() */
+#include <fcntl.h>      /* for open(), O_* constants */
+#include <unistd.h>     /* for write(), close(), unlink(), rmdir() */
+#include <cstdlib>      /* for setenv(), mkdtemp() */
+#include <cstring>      /* for memset(), strcmp(), strncpy() */
+#include <ctime>        /* for struct tm, mktime(), tzset() */
+#include <string>       /* for std::string */
+#include <vector>       /* for std::vector */
+
+using std::string;
+using std::vector;
+using std::int64_t;
+using std::uint64_t;
+
+static const int64_t minute_us = 60 * (int64_t) 1000000;
+static const int64_t hour_us = 60 * minute_us;
+
+
+/**
+ * This helper function finds a moment from its local time.
+ *
+ * @param int is_dst - 1 for daylight saving time, 0 for standard time, which tells apart the two
+ *                     moments of the hour that is repeated when the clocks are set back.
+ *
+ * @return int64_t - The moment, in microseconds since the epoch.
+ */
+static int64_t local_us(int year, int month, int day, int hour, int minute, int is_dst)
+{
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = is_dst;
+    return (int64_t) mktime(&local) * 1000000;
+}
+
+
+static Detection_record make_record(int64_t time_us, const char* clip)
+{
+    Detection_record record;
+    memset(&record, 0, sizeof(record));
+    record.time_us = time_us;
+    record.duration_ms = 5000;
+    record.camera = 0;
+    record.types = DETECTION_HUMAN;
+    record.box_count = 1;
+    record.confidence = 1.0f;
+    strncpy(record.clip, clip, sizeof(record.clip) - 1);
+    return record;
+}
+
+
+/**
+ * @return std::string - A new empty directory for a store, ending in '/'.
+ */
+static string make_store_directory()
+{
+    char name[] = "/tmp/SmartCCTV_store_test.XXXXXX";
+    if (mkdtemp(name) == nullptr) {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+    return string(name) + "/";
+}
+
+
+/**
+ * This helper function removes a directory made by make_store_directory(), and the files of the store in it.
+ */
+static void remove_store_directory(const string& directory)
+{
+    DIR* entries = opendir(directory.c_str());
+    if (entries != nullptr) {
+        while (struct dirent* entry = readdir(entries)) {
+            if (entry->d_name[0] != '.') {
+                unlink((directory + entry->d_name).c_str());
+            }
+        }
+        closedir(entries);
+    }
+    rmdir(directory.c_str());
+}
+
+
+static int64_t file_size(const string& path)
+{
+    struct stat file_status;
+    if (stat(path.c_str(), &file_status) == -1) {
+        return -1;
+    }
+    return file_status.st_size;
+}
+
+
+static void append_bytes(const string& path, const char* bytes, size_t length)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
+    CHECK(fd != -1);
+    CHECK(write(fd, bytes, length) == (ssize_t) length);
+    close(fd);
+}
+
+
+/**
+ * The daemon can be killed in the middle of writing a record, the part that was written is removed
+ * the next time the file is opened, so the records after it are found where they belong.
+ */
+static void test_record_cut_short()
+{
+    string directory = make_store_directory();
+    string events_path = directory + "15.06.2026.events";
+    int64_t ten_am = local_us(2026, 6, 15, 10, 0, 1);
+
+    Detection_store store;
+    CHECK(store.open(directory));
+    CHECK(store.append(make_record(ten_am, "a.mp4")));
+    CHECK(store.append(make_record(ten_am + minute_us, "b.mp4")));
+    CHECK(store.append(make_record(ten_am + 2 * minute_us, "c.mp4")));
+    store.close();
+
+    const char partial[20] = "partial record";
+    append_bytes(events_path, partial, sizeof(partial));
+    CHECK(file_size(events_path) == (int64_t) (sizeof(Store_header) + 3 * sizeof(Detection_record) + sizeof(partial)));
+
+    Detection_store reopened;
+    CHECK(reopened.open(directory));
+    CHECK(reopened.append(make_record(ten_am + 3 * minute_us, "d.mp4")));
+    reopened.close();
+    CHECK(file_size(events_path) == (int64_t) (sizeof(Store_header) + 4 * sizeof(Detection_record)));
+
+    vector<Detection_record> records;
+    CHECK(query_detections(directory, ten_am, ten_am + hour_us, records));
+    CHECK(records.size() == 4);
+    if (records.size() == 4) {
+        CHECK(strcmp(records[2].clip, "c.mp4") == 0);
+        CHECK(strcmp(records[3].clip, "d.mp4") == 0);
+        CHECK(records[3].time_us == ten_am + 3 * minute_us);
+    }
+
+    // The rollups are updated in place, so the record that was cut short never counted.
+    vector<Minute_rollup> minutes;
+    CHECK(query_rollup(directory, ten_am, ten_am + 5 * minute_us, minutes));
+    CHECK(minutes.size() == 5);
+    if (minutes.size() == 5) {
+        CHECK(minutes[0].detections == 1);
+        CHECK(minutes[3].detections == 1);
+        CHECK(minutes[4].detections == 0);
+    }
+
+    // A header that was cut short is written again, which is a day without records.
+    string next_day_path = directory + "16.06.2026.events";
+    append_bytes(next_day_path, "SCCTV", 5);
+    int64_t next_day = local_us(2026, 6, 16, 9, 0, 1);
+    Detection_store header_cut;
+    CHECK(header_cut.open(directory));
+    CHECK(header_cut.append(make_record(next_day, "e.mp4")));
+    header_cut.close();
+    CHECK(file_size(next_day_path) == (int64_t) (sizeof(Store_header) + sizeof(Detection_record)));
+    records.clear();
+    CHECK(query_detections(directory, next_day, next_day + minute_us, records));
+    CHECK(records.size() == 1);
+
+    remove_store_directory(directory);
+}
+
+
+/**
+ * The day the clocks are set forward is 23 hours long, and the day they are set back is 25 hours long.
+ * A record belongs to the day of its local time, and a day is queried from its midnight to the next.
+ */
+static void test_days_that_change_the_clocks()
+{
+    string directory = make_store_directory();
+    Detection_store store;
+    CHECK(store.open(directory));
+
+    int64_t march_8 = local_us(2026, 3, 8, 0, 0, 0);
+    int64_t march_9 = local_us(2026, 3, 9, 0, 0, 1);
+    CHECK(march_9 - march_8 == 23 * hour_us);
+    CHECK(store.append(make_record(local_us(2026, 3, 8, 1, 30, 0), "before.mp4")));
+    CHECK(store.append(make_record(local_us(2026, 3, 8, 3, 30, 1), "after.mp4")));
+    CHECK(store.append(make_record(local_us(2026, 3, 8, 23, 59, 1), "last.mp4")));
+    CHECK(store.append(make_record(march_9, "next.mp4")));
+
+    vector<Detection_record> records;
+    CHECK(query_detections(directory, march_8, march_9, records));
+    CHECK(records.size() == 3);
+    CHECK(file_size(directory + "08.03.2026.events") == (int64_t) (sizeof(Store_header) + 3 * sizeof(Detection_record)));
+
+    // One rollup per minute that the day really has, 02:00 to 02:59 never happened.
+    vector<Minute_rollup> minutes;
+    CHECK(query_rollup(directory, march_8, march_9, minutes));
+    CHECK(minutes.size() == 23 * 60);
+    if (minutes.size() == 23 * 60) {
+        CHECK(minutes[90].detections == 1);       // 01:30
+        CHECK(minutes[150].detections == 1);      // 03:30, 150 minutes after midnight
+        CHECK(minutes[23 * 60 - 1].detections == 1);
+    }
+
+    int64_t november_1 = local_us(2026, 11, 1, 0, 0, 1);
+    int64_t november_2 = local_us(2026, 11, 2, 0, 0, 0);
+    CHECK(november_2 - november_1 == 25 * hour_us);
+    CHECK(store.append(make_record(local_us(2026, 11, 1, 23, 30, 0), "late.mp4")));
+    CHECK(store.append(make_record(november_2 + minute_us, "november_2.mp4")));
+    store.close();
+
+    records.clear();
+    CHECK(query_detections(directory, november_1, november_2, records));
+    CHECK(records.size() == 1);
+    if (records.size() == 1) {
+        CHECK(strcmp(records[0].clip, "late.mp4") == 0);
+    }
+    records.clear();
+    CHECK(query_detections(directory, november_2, november_2 + hour_us, records));
+    CHECK(records.size() == 1);
+
+    CHECK(query_rollup(directory, november_1, november_2, minutes));
+    CHECK(minutes.size() == 25 * 60);
+    if (minutes.size() == 25 * 60) {
+        CHECK(minutes[24 * 60 + 30].detections == 1);  // 23:30, the 25th hour of the day
+    }
+
+    remove_store_directory(directory);
+}
+
+
+/**
+ * When the clocks are set back, 01:00 to 01:59 happens twice, and both share the rollups of those minutes.
+ */
+static void test_rollup_of_repeated_hour()
+{
+    string directory = make_store_directory();
+    int64_t first_one_am = local_us(2026, 11, 1, 1, 0, 1);
+    int64_t second_one_am = local_us(2026, 11, 1, 1, 0, 0);
+    int64_t two_am = local_us(2026, 11, 1, 2, 0, 0);
+    CHECK(second_one_am - first_one_am == hour_us);
+    CHECK(two_am - second_one_am == hour_us);
+
+    Detection_store store;
+    CHECK(store.open(directory));
+    CHECK(store.append(make_record(first_one_am + 30 * minute_us, "first.mp4")));
+    CHECK(store.append(make_record(second_one_am + 10 * minute_us, "second.mp4")));
+    CHECK(store.append(make_record(second_one_am + 30 * minute_us, "third.mp4")));
+    store.close();
+
+    vector<Minute_rollup> minutes;
+    CHECK(query_rollup(directory, first_one_am, two_am, minutes));
+    CHECK(minutes.size() == 120);
+    if (minutes.size() == 120) {
+        CHECK(minutes[10].detections == 1);
+        CHECK(minutes[30].detections == 2);
+        CHECK(minutes[70].detections == 1);
+        CHECK(minutes[90].detections == 2);
+        CHECK(minutes[59].detections == 0);
+        CHECK(minutes[119].detections == 0);
+    }
+
+    // A range that starts within the second 01:00 finds the minutes of 01:00 as well.
+    CHECK(query_rollup(directory, second_one_am + 30 * minute_us, two_am, minutes));
+    CHECK(minutes.size() == 30);
+    if (minutes.size() == 30) {
+        CHECK(minutes[0].detections == 2);
+    }
+
+    // The records themselves keep their own times, and stay in order across the change.
+    vector<Detection_record> records;
+    CHECK(query_detections(directory, first_one_am, two_am, records));
+    CHECK(records.size() == 3);
+    if (records.size() == 3) {
+        CHECK(strcmp(records[0].clip, "first.mp4") == 0);
+        CHECK(strcmp(records[1].clip, "second.mp4") == 0);
+        CHECK(strcmp(records[2].clip, "third.mp4") == 0);
+    }
+    records.clear();
+    CHECK(query_detections(directory, second_one_am, two_am, records));
+    CHECK(records.size() == 2);
+
+    remove_store_directory(directory);
+}
+
+
+static uint64_t cell(int row, int column)
+{
+    return (uint64_t) 1 << (row * DETECTION_GRID_SIZE + column);
+}
+
+
+static void test_grid_cells_at_edges()
+{
+    CHECK(DETECTION_GRID_SIZE == 8);
+    CHECK(detection_grid_cells(0, 0, 1, 1) == ~(uint64_t) 0);
+    CHECK(detection_grid_cells(-0.5, -0.5, 1.5, 1.5) == ~(uint64_t) 0);
+
+    // The corners.
+    CHECK(detection_grid_cells(0, 0, 0.01, 0.01) == cell(0, 0));
+    CHECK(detection_grid_cells(0.99, 0, 1, 0.01) == cell(0, 7));
+    CHECK(detection_grid_cells(0, 0.99, 0.01, 1) == cell(7, 0));
+    CHECK(detection_grid_cells(0.99, 0.99, 1, 1) == cell(7, 7));
+    CHECK(detection_grid_cells(0.99, 0.99, 1.2, 1.2) == cell(7, 7));
+
+    // The first and last rows and columns.
+    CHECK(detection_grid_cells(0, 0.9, 1, 1) == 0xFF00000000000000ULL);
+    CHECK(detection_grid_cells(0, 0, 1, 0.1) == 0x00000000000000FFULL);
+    CHECK(detection_grid_cells(0, 0, 0.1, 1) == 0x0101010101010101ULL);
+    CHECK(detection_grid_cells(0.9, 0, 1, 1) == 0x8080808080808080ULL);
+
+    // A box that ends on the line between two cells does not cover the second one.
+    CHECK(detection_grid_cells(0, 0, 0.25, 0.125) == (cell(0, 0) | cell(0, 1)));
+    CHECK(detection_grid_cells(0.875, 0.875, 1, 1) == cell(7, 7));
+
+    // Boxes with nothing inside the frame.
+    CHECK(detection_grid_cells(1, 0, 1.2, 1) == 0);
+    CHECK(detection_grid_cells(0, 1, 1, 1.5) == 0);
+    CHECK(detection_grid_cells(-1, -1, -0.5, -0.5) == 0);
+    CHECK(detection_grid_cells(0.5, 0.5, 0.5, 0.6) == 0);
+    CHECK(detection_grid_cells(0.6, 0.5, 0.4, 0.6) == 0);
+}
+
+
+int main()
+{
+    setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1);
+    tzset();
+
+    test_record_cut_short();
+    test_days_that_change_the_clocks();
+    test_rollup_of_repeated_hour();
+    test_grid_cells_at_edges();
+    return test_result();
+}
@@ -0,0 +1,41 @@
+/**
+ * File Name:   test_check.h
+ *
+ * Description:
+ * This file contains the CHECK macro of the tests. A test program calls CHECK() for everything it expects,
+ * and returns test_result() from main(), so "make test" stops at the first program with a failed check.
+ */
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>   /* for fprintf() */
+#include <cstdlib>  /* for EXIT_SUCCESS, EXIT_FAILURE */
+
+// The number of checks that failed in this test program.
+static int failed_checks = 0;
+
+// Prints the check and where it is if it does not hold, and carries on with the next one.
+#define CHECK(condition)                                                                 \
+    do {                                                                                 \
+        if (!(condition)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failed_checks;                                                             \
+        }                                                                                \
+    } while (0)
+
+
+/**
+ * @return int - EXIT_SUCCESS if every check held, EXIT_FAILURE otherwise.
+ */
+static inline int test_result()
+{
+    if (failed_checks != 0) {
+        fprintf(stderr, "%d checks failed\n", failed_checks);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+#endif  /* TEST_CHECK_H */